@@ -0,0 +1,303 @@
+#include "AssetLoader.h"
+
+#include "GLCallCount.h"
+#include "GLLoader.h"
+#include "GLState.h"
+
+#include <cstdio>
+
+
+AssetLoader::AssetLoader(unsigned threads)
+{
+	running = true;
+	for (unsigned i = 0; i < threads; ++i)
+		workers.emplace_back(&AssetLoader::worker, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobs_mutex);
+		running = false;
+	}
+	jobs_cv.notify_all();
+	for (auto& t : workers)
+		t.join();
+}
+
+void AssetLoader::makePlaceholder(unsigned int tex_id)
+{
+	//шахматка 2x2 со всеми мип-уровнями, чтобы текстура была полной
+	//при любой фильтрации, пока грузится настоящая картинка
+	Image checker;
+	checker.width = 2;
+	checker.height = 2;
+	checker.pixels = {
+		200, 200, 200, 255,   255, 255, 255, 255,
+		255, 255, 255, 255,   200, 200, 200, 255 };
+
+	std::vector<Image> levels = buildMipChain(checker, true, 1);
+
+	glState.bindTexture(tex_id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for (size_t i = 0; i < levels.size(); ++i)
+		glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA, levels[i].width, levels[i].height, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, levels[i].pixels.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	setTextureFiltering(true, 1);
+}
+
+unsigned int AssetLoader::requestTexture(const char* path, const TextureOptions& options)
+{
+	GLuint id;
+	glGenTextures(1, &id);
+	makePlaceholder(id);
+
+	Job job;
+	job.path = path;
+	job.options = options;
+	//драйвер не умеет S3TC - грузим как обычно
+	job.options.compress = options.compress && supportsS3TC();
+	const bool gpu_levels = !options.mipmaps || (options.gpu_mipmaps && hasGenerateMipmaps());
+	job.use_pbo = !job.options.compress && gpu_levels && glCaps().pixel_buffer;
+	job.tex_id = id;
+	job.requested = std::chrono::steady_clock::now();
+
+	{
+		std::lock_guard<std::mutex> lock(jobs_mutex);
+		pending.push_back(std::move(job));
+		++in_flight;
+	}
+	jobs_cv.notify_one();
+	return id;
+}
+
+void AssetLoader::worker()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(jobs_mutex);
+			jobs_cv.wait(lock, [&]() { return !running || !pending.empty(); });
+			if (!running)
+				return;
+			job = std::move(pending.front());
+			pending.pop_front();
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		decode(job);
+		job.decode_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(jobs_mutex);
+		ready.push_back(std::move(job));
+	}
+}
+
+void AssetLoader::decode(Job& job)
+{
+	if (job.mapped)
+	{
+		//второй заход через PBO: буфер отображен, распаковываем прямо в него
+		job.ok = decodeImage(job.file.data(), job.file.size(), job.mapped);
+		job.file.close();
+		return;
+	}
+	if (job.use_pbo)
+	{
+		//первый заход: только размер, буфер под него заведет poll()
+		job.ok = job.file.open(job.path.c_str()) &&
+			imageSize(job.file.data(), job.file.size(), job.width, job.height);
+		return;
+	}
+
+	if (job.options.compress)
+	{
+		//сжатые уровни: из кеша, а если его нет - сожмем и сохраним
+		job.ok = loadCompressed(job.path.c_str(), job.options, job.format, job.blocks, &job.from_cache);
+		return;
+	}
+
+	Image image;
+	job.ok = loadImage(job.path.c_str(), image);
+	//если уровни будет строить видеокарта - отдаем только нулевой
+	if (job.ok && job.options.mipmaps && !job.options.gpu_mipmaps)
+		job.levels = buildMipChain(std::move(image), job.options.gamma_correct, 1);
+	else if (job.ok)
+		job.levels.push_back(std::move(image));
+}
+
+bool AssetLoader::mapPixelBuffer(Job& job)
+{
+	glfn.GenBuffers(1, &job.pbo);
+	glfn.BindBuffer(GL_PIXEL_UNPACK_BUFFER, job.pbo);
+	glfn.BufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)job.width * job.height * 4, nullptr, GL_STREAM_DRAW);
+	job.mapped = (unsigned char*)glfn.MapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+	glfn.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (job.mapped)
+		return true;
+	glfn.DeleteBuffers(1, &job.pbo);
+	job.pbo = 0;
+	return false;
+}
+
+int AssetLoader::poll(int max_uploads, std::vector<Upload>* uploads)
+{
+	int uploaded = 0;
+	while (uploaded < max_uploads)
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(jobs_mutex);
+			if (ready.empty())
+				break;
+			job = std::move(ready.front());
+			ready.pop_front();
+		}
+
+		//размер известен - отдаем фону отображенный буфер, а не вышло - пусть грузит по-старому
+		if (job.ok && job.use_pbo && !job.mapped)
+		{
+			if (!mapPixelBuffer(job))
+			{
+				job.use_pbo = false;
+				job.file.close();
+			}
+			{
+				std::lock_guard<std::mutex> lock(jobs_mutex);
+				pending.push_back(std::move(job));
+			}
+			jobs_cv.notify_one();
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(jobs_mutex);
+			--in_flight;
+		}
+
+		if (job.pbo)
+		{
+			//буфер надо вернуть драйверу в любом случае, а испорченный при этом - ошибка
+			glfn.BindBuffer(GL_PIXEL_UNPACK_BUFFER, job.pbo);
+			if (!glfn.UnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+				job.ok = false;
+			if (job.ok)
+			{
+				//заливаем прямо в текстуру-заглушку из буфера, по смещению 0
+				glState.bindTexture(job.tex_id);
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, job.width, job.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			}
+			glfn.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glfn.DeleteBuffers(1, &job.pbo);
+			job.pbo = 0;
+		}
+
+		if (!job.ok)
+		{
+			//картинку не прочитали - остается заглушка
+			char buf[512];
+			snprintf(buf, sizeof(buf), "AssetLoader: failed to load %s\n", job.path.c_str());
+			platformDebugOutput(buf);
+			if (uploads)
+				uploads->push_back({ job.tex_id, false, 0 });
+			continue;
+		}
+
+		if (job.options.compress)
+		{
+			glState.bindTexture(job.tex_id);
+			uploadCompressed(job.format, job.blocks);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, job.options.wrap);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, job.options.wrap);
+			setTextureFiltering(job.options.mipmaps, job.options.anisotropy);
+
+			size_t bytes = 0;
+			for (auto& l : job.blocks)
+				bytes += l.data.size();
+			double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.requested).count();
+			char buf[512];
+			snprintf(buf, sizeof(buf), "AssetLoader: %s %dx%d %s %s, %zu KB in VRAM, ready in %.1f ms, on screen %.1f ms after request\n",
+				job.path.c_str(), job.blocks[0].width, job.blocks[0].height,
+				job.format == BlockFormat::BC1 ? "BC1" : "BC3", job.from_cache ? "from cache" : "encoded",
+				bytes / 1024, job.decode_ms, total_ms);
+			platformDebugOutput(buf);
+			if (uploads)
+				uploads->push_back({ job.tex_id, true, bytes });
+
+			++uploaded;
+			continue;
+		}
+
+		if (job.mapped)
+		{
+			if (job.options.mipmaps)
+				generateMipmaps();
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, job.options.wrap);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, job.options.wrap);
+			setTextureFiltering(job.options.mipmaps, job.options.anisotropy);
+
+			size_t bytes = (size_t)job.width * job.height * 4;
+			if (job.options.mipmaps)
+				bytes += bytes / 3;
+			double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.requested).count();
+			char buf[512];
+			snprintf(buf, sizeof(buf), "AssetLoader: %s %dx%d decoded into PBO in %.1f ms, on screen %.1f ms after request\n",
+				job.path.c_str(), job.width, job.height, job.decode_ms, total_ms);
+			platformDebugOutput(buf);
+			if (uploads)
+				uploads->push_back({ job.tex_id, true, bytes });
+
+			++uploaded;
+			continue;
+		}
+
+		//мип-уровни просили строить на видеокарте, а она не умеет - досчитываем тут
+		bool gpu_mips = job.options.mipmaps && job.levels.size() == 1;
+		if (gpu_mips && !hasGenerateMipmaps())
+		{
+			job.levels = buildMipChain(std::move(job.levels[0]), job.options.gamma_correct, job.options.threads);
+			gpu_mips = false;
+		}
+
+		//заливаем прямо в текстуру-заглушку, ее id уже раздан
+		glState.bindTexture(job.tex_id);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		for (size_t i = 0; i < job.levels.size(); ++i)
+			glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA, job.levels[i].width, job.levels[i].height, 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, job.levels[i].pixels.data());
+		if (gpu_mips)
+			generateMipmaps();
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, job.options.wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, job.options.wrap);
+		setTextureFiltering(job.options.mipmaps, job.options.anisotropy);
+
+		size_t bytes = 0;
+		for (auto& l : job.levels)
+			bytes += l.pixels.size();
+		//уровни построила видеокарта: вся цепочка - еще треть от нулевого
+		if (gpu_mips)
+			bytes += bytes / 3;
+
+		double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.requested).count();
+		char buf[512];
+		snprintf(buf, sizeof(buf), "AssetLoader: %s %dx%d decoded in %.1f ms, on screen %.1f ms after request\n",
+			job.path.c_str(), job.levels[0].width, job.levels[0].height, job.decode_ms, total_ms);
+		platformDebugOutput(buf);
+		if (uploads)
+			uploads->push_back({ job.tex_id, true, bytes });
+
+		++uploaded;
+	}
+	return uploaded;
+}
+
+bool AssetLoader::idle()
+{
+	std::lock_guard<std::mutex> lock(jobs_mutex);
+	return in_flight == 0;
+}
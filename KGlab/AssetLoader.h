@@ -0,0 +1,101 @@
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Texture.h"
+#include "TextureCompress.h"
+
+//Фоновая загрузка текстур.
+//requestTexture сразу создает текстуру-заглушку (шахматку) и возвращает ее id,
+//а разбор PNG и построение мип-уровней идут в фоновых потоках.
+//Когда картинка готова, poll() (из потока рендера) заливает ее
+//в ту же самую текстуру - id не меняется, перепривязывать ничего не надо.
+//
+//Контекст OpenGL один, поэтому вызовы GL идут в потоке рендера,
+//а вся тяжелая работа (чтение, распаковка, переворот, мип-уровни) - в фоне.
+//Если есть буфер распаковки (GLCaps::pixel_buffer), а мип-уровни не нужны или их строит
+//видеокарта, заливка идет как в loadTexture: фон читает размер картинки, poll() заводит
+//и отображает в память PBO, фон распаковывает картинку прямо в него, а следующий poll()
+//отдает его в glTexImage2D - копия в памяти процесса и ее копирование драйвером не нужны.
+class AssetLoader
+{
+public:
+
+	AssetLoader(unsigned threads = 2);
+	~AssetLoader();
+
+	//нужен активный контекст OpenGL
+	unsigned int requestTexture(const char* path, const TextureOptions& options = TextureOptions());
+
+	//обработанный в poll() запрос
+	struct Upload
+	{
+		unsigned int tex_id;
+		//false - картинку не прочитали, осталась заглушка
+		bool ok;
+		//сколько текстура занимает в видеопамяти со всеми уровнями
+		size_t bytes;
+	};
+
+	//вызывать раз в кадр из потока рендера.
+	//Заливает не больше max_uploads готовых картинок, чтобы не дергать кадр.
+	//Возвращает, сколько текстур было заменено.
+	//В uploads (если не nullptr) дописываются все обработанные запросы, в том числе неудачные
+	int poll(int max_uploads = 1, std::vector<Upload>* uploads = nullptr);
+
+	//все ли запросы выполнены
+	bool idle();
+
+private:
+
+	struct Job
+	{
+		std::string path;
+		TextureOptions options;
+		unsigned int tex_id;
+		std::chrono::steady_clock::time_point requested;
+
+		std::vector<Image> levels;
+		//если options.compress - уровни лежат тут, уже сжатые
+		BlockFormat format = BlockFormat::BC1;
+		std::vector<CompressedImage> blocks;
+		bool from_cache = false;
+		bool ok = false;
+		double decode_ms = 0;
+
+		//заливка через PBO: фон открыл файл и узнал размер, poll() отобразил буфер
+		//в mapped, фон распаковал туда картинку
+		bool use_pbo = false;
+		MappedFile file;
+		int width = 0;
+		int height = 0;
+		unsigned int pbo = 0;
+		unsigned char* mapped = nullptr;
+	};
+
+	std::vector<std::thread> workers;
+	std::atomic_bool running;
+
+	std::mutex jobs_mutex;
+	std::condition_variable jobs_cv;
+	std::deque<Job> pending;
+	std::deque<Job> ready;
+	int in_flight = 0;
+
+	void worker();
+	void decode(Job& job);
+	//false - буфер не дали, job пойдет обычным путем
+	bool mapPixelBuffer(Job& job);
+	static void makePlaceholder(unsigned int tex_id);
+};
+
+#endif
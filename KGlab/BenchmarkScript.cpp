@@ -0,0 +1,146 @@
+#include "BenchmarkScript.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "Render.h"
+
+
+bool BenchmarkScript::load(const char* path, std::string& error)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		error = std::string("can't open ") + path;
+		return false;
+	}
+
+	camera.clear();
+	light.clear();
+	modes.clear();
+	capture_list.clear();
+	end_time = 0;
+	frame_width = frame_height = 0;
+	bool has_end = false;
+
+	std::string line;
+	for (int line_no = 1; std::getline(file, line); ++line_no)
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream in(line);
+		double time;
+		std::string command;
+		if (!(in >> time))
+		{
+			//пустая строка или только комментарий
+			if (line.find_first_not_of(" \t\r") == std::string::npos)
+				continue;
+			error = std::string(path) + ":" + std::to_string(line_no) + ": expected time";
+			return false;
+		}
+
+		bool ok = time >= 0 && (bool)(in >> command);
+		if (ok && (command == "camera" || command == "light"))
+		{
+			Key key = { time };
+			ok = (bool)(in >> key.x >> key.y >> key.z);
+			(command == "camera" ? camera : light).push_back(key);
+		}
+		else if (ok && command == "mode")
+		{
+			std::string name, state;
+			ok = (bool)(in >> name >> state) && (state == "on" || state == "off");
+			Mode mode = { time, 0, state == "on" };
+			if (name == "texturing")
+				mode.key = 'T';
+			else if (name == "lightning")
+				mode.key = 'L';
+			else if (name == "alpha")
+				mode.key = 'A';
+			else if (name == "mipmapping")
+				mode.key = 'M';
+			ok = ok && mode.key;
+			modes.push_back(mode);
+		}
+		else if (ok && command == "capture")
+		{
+			Capture capture = { "", time };
+			ok = (bool)(in >> capture.name);
+			capture_list.push_back(capture);
+		}
+		else if (ok && command == "size")
+		{
+			//один на весь сценарий
+			ok = time == 0 && frame_width == 0 && (bool)(in >> frame_width >> frame_height) &&
+				frame_width > 0 && frame_height > 0;
+		}
+		else if (ok && command == "end")
+		{
+			has_end = true;
+			end_time = time;
+		}
+		else
+			ok = false;
+
+		std::string rest;
+		if (!ok || in >> rest)
+		{
+			error = std::string(path) + ":" + std::to_string(line_no) + ": bad command: " + line;
+			return false;
+		}
+		if (!has_end)
+			end_time = std::max(end_time, time);
+	}
+
+	//команды могут идти не по порядку, при равном времени - порядок файла
+	auto by_time = [](const auto& a, const auto& b) { return a.time < b.time; };
+	std::stable_sort(camera.begin(), camera.end(), by_time);
+	std::stable_sort(light.begin(), light.end(), by_time);
+	std::stable_sort(modes.begin(), modes.end(), by_time);
+	std::stable_sort(capture_list.begin(), capture_list.end(), by_time);
+	return true;
+}
+
+bool BenchmarkScript::interpolate(const std::vector<Key>& keys, double t, double& x, double& y, double& z)
+{
+	if (keys.empty())
+		return false;
+
+	//первый ключ позже t
+	auto next = std::upper_bound(keys.begin(), keys.end(), t,
+		[](double t, const Key& k) { return t < k.time; });
+	if (next == keys.begin() || next == keys.end())
+	{
+		//до первого ключа и после последнего - стоим на месте
+		const Key& k = next == keys.begin() ? keys.front() : keys.back();
+		x = k.x;
+		y = k.y;
+		z = k.z;
+		return true;
+	}
+
+	const Key& a = *(next - 1);
+	const Key& b = *next;
+	double s = (t - a.time) / (b.time - a.time);
+	x = a.x + (b.x - a.x) * s;
+	y = a.y + (b.y - a.y) * s;
+	z = a.z + (b.z - a.z) * s;
+	return true;
+}
+
+void BenchmarkScript::apply(double t) const
+{
+	double x, y, z;
+	if (interpolate(camera, t, x, y, z))
+		setCameraPosition(x, y, z);
+	if (interpolate(light, t, x, y, z))
+		setLightPosition(x, y, z);
+
+	for (const Mode& m : modes)
+	{
+		if (m.time > t)
+			break;
+		setRenderMode(m.key, m.on);
+	}
+}
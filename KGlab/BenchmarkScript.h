@@ -0,0 +1,81 @@
+#ifndef BENCHMARK_SCRIPT_H
+#define BENCHMARK_SCRIPT_H
+
+#include <string>
+#include <vector>
+
+//Сценарий для пакетного режима (KGlab --headless --script bench.txt, см. Headless.h):
+//где камера и свет и какие режимы включены в каждый момент.
+//Строка - "время_в_секундах команда аргументы", после # - комментарий:
+//  0    size 640 480          размер кадра (только в момент 0): эталоны сняты в нем,
+//                             --size другого размера - ошибка, без --size - берется этот
+//  0    camera 2 1.5 1.5      положение камеры, между соседними camera - линейно
+//  0    light 1 1 1           положение света, тоже с интерполяцией
+//  2    mode texturing off    texturing, lightning, alpha, mipmapping (как клавиши T, L, A, M)
+//  2    capture no_textures   снимок кадра, эталон - <папка эталонов>/no_textures.png
+//  5    end                   конец сценария (иначе - последняя команда)
+//Время модельное: кадр i рисуется в момент i * timestep, скорость машины на картинку не влияет
+class BenchmarkScript
+{
+public:
+
+	struct Capture
+	{
+		std::string name;
+		double time;
+	};
+
+	//false - файла нет или в нем ошибка (текст в error, с номером строки)
+	bool load(const char* path, std::string& error);
+
+	//длительность, с
+	double duration() const
+	{
+		return end_time;
+	}
+
+	const std::vector<Capture>& captures() const
+	{
+		return capture_list;
+	}
+
+	//размер кадра из команды size, false - команды нет
+	bool frameSize(int& width, int& height) const
+	{
+		width = frame_width;
+		height = frame_height;
+		return frame_width > 0;
+	}
+
+	//выставляет сцену на момент t (через функции из Render.h)
+	void apply(double t) const;
+
+private:
+
+	struct Key
+	{
+		double time;
+		double x, y, z;
+	};
+
+	struct Mode
+	{
+		double time;
+		char key;
+		bool on;
+	};
+
+	//все списки отсортированы по времени
+	std::vector<Key> camera;
+	std::vector<Key> light;
+	std::vector<Mode> modes;
+	std::vector<Capture> capture_list;
+	double end_time = 0;
+	int frame_width = 0;
+	int frame_height = 0;
+
+	//положение в момент t по ключам, false - ключей нет
+	static bool interpolate(const std::vector<Key>& keys, double t, double& x, double& y, double& z);
+};
+
+#endif
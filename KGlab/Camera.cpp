@@ -1,8 +1,8 @@
 #include "Camera.h"
 
-#include <windows.h>
-#include <gl/GL.h>
-#include <gl/GLU.h>
+#include "GLCallCount.h"
+#include "ShadedLighting.h"
+#include <cmath>
 
 void Camera::setPosition(double x, double y, double z)
 {
@@ -75,4 +75,6 @@ void Camera::SetUpCamera()
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 	gluLookAt(camX, camY, camZ, 0, 0, 0, 0, 0, camNz);
+	const double eye[] = { camX, camY, camZ }, center[] = { 0, 0, 0 }, up[] = { 0, 0, (double)camNz };
+	shadedLighting.setView(eye, center, up);
 }
@@ -0,0 +1,45 @@
+#include "DisplayListCache.h"
+
+#include "ImmediateBatch.h"
+
+DisplayListCache displayLists;
+
+
+void DisplayListCache::draw(const char* name, unsigned long long inputs, const std::function<void()>& block)
+{
+	if (!enabled)
+	{
+		block();
+		return;
+	}
+
+	//накопленное рекордером рисуется до списка, иначе сменится порядок
+	imm.flush();
+
+	Entry& e = lists[name];
+	if (!e.list || e.inputs != inputs)
+	{
+		if (!e.list)
+			e.list = glGenLists(1);
+		if (!e.list)
+		{
+			block();
+			return;
+		}
+		//GL_COMPILE только записывает, рисует список glCallList ниже
+		glNewList(e.list, GL_COMPILE);
+		block();
+		imm.flush();
+		glEndList();
+		e.inputs = inputs;
+		++compile_count;
+	}
+	glCallList(e.list);
+}
+
+void DisplayListCache::clear()
+{
+	for (auto& l : lists)
+		glDeleteLists(l.second.list, 1);
+	lists.clear();
+}
@@ -0,0 +1,83 @@
+#ifndef DISPLAYLISTCACHE_H
+#define DISPLAYLISTCACHE_H
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "GLCallCount.h"
+
+//Статическая геометрия в display list'ах (glNewList/glCallList) - быстрый путь для контекстов
+//без буферов вершин (GL 1.1): список один раз собирается драйвером, дальше кадр - один glCallList.
+//    displayLists.draw("walls", hashInputs(A, B, height), [&]()
+//    {
+//        imm.begin(GL_QUADS);
+//        ...
+//        imm.end();
+//    });
+//Блок записывается заново, когда поменялся хеш его входов, так что в хеш нужно
+//положить все, от чего зависит геометрия. В блоке - только геометрия: состояние
+//(glState, текстуры, матрицы) менять снаружи, иначе кэш GLState.h разойдется с GL.
+//Выключенный кэш просто вызывает блок. Только поток рендера.
+class DisplayListCache
+{
+public:
+
+	void draw(const char* name, unsigned long long inputs, const std::function<void()>& block);
+
+	void setEnabled(bool on)
+	{
+		enabled = on;
+	}
+	bool isEnabled() const
+	{
+		return enabled;
+	}
+
+	//удаляет все списки
+	void clear();
+
+	//сколько раз списки собирались с последнего resetCounters()
+	unsigned long long compileCount() const
+	{
+		return compile_count;
+	}
+	void resetCounters()
+	{
+		compile_count = 0;
+	}
+
+private:
+
+	struct Entry
+	{
+		GLuint list = 0;
+		unsigned long long inputs = 0;
+	};
+
+	bool enabled = false;
+	std::unordered_map<std::string, Entry> lists;
+	unsigned long long compile_count = 0;
+};
+
+extern DisplayListCache displayLists;
+
+//FNV-1a по байтам значений (только простые типы без указателей)
+template<class... T>
+unsigned long long hashInputs(const T&... values)
+{
+	unsigned long long h = 14695981039346656037ull;
+	auto mix = [&h](const void* data, size_t size)
+	{
+		const unsigned char* p = (const unsigned char*)data;
+		for (size_t i = 0; i < size; ++i)
+		{
+			h ^= p[i];
+			h *= 1099511628211ull;
+		}
+	};
+	(mix(&values, sizeof(values)), ...);
+	return h;
+}
+
+#endif
@@ -0,0 +1,735 @@
+#include "FastInflate.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+
+namespace
+{
+	//Элемент таблицы декодирования, 32 бита:
+	//  0..4   - сколько бит съесть: код (у пары литералов - оба кода),
+	//           у длины и расстояния - код вместе с дополнительными битами
+	//  5..7   - тип
+	//  8..11  - у длины и расстояния - длина самого кода (дальше идут доп. биты),
+	//           у подтаблицы - ее разрядность
+	//  12..31 - значение: литерал(ы), база длины/расстояния, смещение подтаблицы
+	enum : uint32_t
+	{
+		E_LIT = 0,
+		E_LIT2 = 1,
+		E_LEN = 2,
+		E_DIST = 3,
+		E_END = 4,
+		E_SUB = 5,
+		E_BAD = 6
+	};
+
+	inline uint32_t entry(uint32_t type, uint32_t extra, uint32_t value)
+	{
+		return (type << 5) | (extra << 8) | (value << 12);
+	}
+	inline uint32_t entryBits(uint32_t e)
+	{
+		return e & 31;
+	}
+	inline uint32_t entryType(uint32_t e)
+	{
+		return (e >> 5) & 7;
+	}
+	inline uint32_t entryCode(uint32_t e)
+	{
+		return (e >> 8) & 15;
+	}
+	inline uint32_t entryValue(uint32_t e)
+	{
+		return e >> 12;
+	}
+
+	const int MAX_BITS = 15;
+	const int LIT_BITS = 11;
+	const int DIST_BITS = 9;
+	const int CL_BITS = 7;
+
+	//с запасом на подтаблицы: кодов длиннее основной таблицы не больше, чем символов,
+	//и у каждого префикса подтаблица не больше 2^(15 - разрядность основной)
+	const int LIT_TABLE = (1 << LIT_BITS) + 288 * (1 << (MAX_BITS - LIT_BITS));
+	const int DIST_TABLE = (1 << DIST_BITS) + 32 * (1 << (MAX_BITS - DIST_BITS));
+
+	const uint16_t length_base[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t length_extra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t dist_base[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t dist_extra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	const uint8_t cl_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	//что означает каждый символ алфавита.
+	//В поле длины пока только число доп. бит, длину кода добавит buildTable
+	uint32_t litSymbol(int sym)
+	{
+		if (sym < 256)
+			return entry(E_LIT, 0, sym);
+		if (sym == 256)
+			return entry(E_END, 0, 0);
+		if (sym < 286)
+			return entry(E_LEN, 0, length_base[sym - 257]) | length_extra[sym - 257];
+		return entry(E_BAD, 0, 0);
+	}
+	uint32_t distSymbol(int sym)
+	{
+		if (sym < 30)
+			return entry(E_DIST, 0, dist_base[sym]) | dist_extra[sym];
+		return entry(E_BAD, 0, 0);
+	}
+	uint32_t clSymbol(int sym)
+	{
+		return entry(E_LIT, 0, sym);
+	}
+
+	//Строит таблицу канонических кодов Хаффмана по длинам.
+	//Коды в потоке идут младшим битом вперед, поэтому индекс таблицы -
+	//это код, записанный задом наперед, а все индексы с теми же младшими битами
+	//заполняются тем же символом. false - длины не образуют код (переподписка)
+	bool buildTable(const uint8_t* lengths, int num, int bits, uint32_t* table, uint32_t(*symbol)(int))
+	{
+		int count[MAX_BITS + 1] = {};
+		for (int i = 0; i < num; ++i)
+			++count[lengths[i]];
+		count[0] = 0;
+
+		int left = 1;
+		for (int len = 1; len <= MAX_BITS; ++len)
+		{
+			left = (left << 1) - count[len];
+			if (left < 0)
+				return false;
+		}
+
+		int next_code[MAX_BITS + 2];
+		next_code[1] = 0;
+		for (int len = 1; len <= MAX_BITS; ++len)
+			next_code[len + 1] = (next_code[len] + count[len]) << 1;
+
+		const int size = 1 << bits;
+		const uint32_t mask = size - 1;
+		for (int i = 0; i < size; ++i)
+			table[i] = entry(E_BAD, 0, 0);
+
+		//разворачиваем коды и считаем разрядность подтаблиц для длинных
+		uint16_t rev[288];
+		uint8_t sub_bits[1 << LIT_BITS] = {};
+		for (int sym = 0; sym < num; ++sym)
+		{
+			int len = lengths[sym];
+			if (!len)
+				continue;
+			int code = next_code[len]++;
+			int r = 0;
+			for (int i = 0; i < len; ++i)
+				r |= ((code >> i) & 1) << (len - 1 - i);
+			rev[sym] = (uint16_t)r;
+			if (len > bits && sub_bits[r & mask] < len - bits)
+				sub_bits[r & mask] = (uint8_t)(len - bits);
+		}
+
+		int next_sub = size;
+		for (int p = 0; p < size; ++p)
+			if (sub_bits[p])
+			{
+				table[p] = entry(E_SUB, sub_bits[p], next_sub) | bits;
+				for (int i = 0; i < (1 << sub_bits[p]); ++i)
+					table[next_sub + i] = entry(E_BAD, 0, 0);
+				next_sub += 1 << sub_bits[p];
+			}
+
+		for (int sym = 0; sym < num; ++sym)
+		{
+			int len = lengths[sym];
+			if (!len)
+				continue;
+			uint32_t e = symbol(sym);
+			if (len <= bits)
+			{
+				e += len | (len << 8);
+				for (int i = rev[sym]; i < size; i += 1 << len)
+					table[i] = e;
+			}
+			else
+			{
+				//в подтаблице код короче на уже съеденные bits
+				uint32_t sub = table[rev[sym] & mask];
+				int sb = entryCode(sub);
+				uint32_t* st = table + entryValue(sub);
+				e += (len - bits) | ((len - bits) << 8);
+				for (int i = rev[sym] >> bits; i < (1 << sb); i += 1 << (len - bits))
+					st[i] = e;
+			}
+		}
+		return true;
+	}
+
+	//Если после короткого литерала в те же 11 бит целиком влезает еще один -
+	//кладем в элемент оба, тогда частые литералы распаковываются парами
+	void pairLiterals(uint32_t* table)
+	{
+		const int size = 1 << LIT_BITS;
+		uint32_t single[size];
+		std::memcpy(single, table, sizeof(single));
+
+		for (int i = 0; i < size; ++i)
+		{
+			uint32_t e = single[i];
+			if (entryType(e) != E_LIT)
+				continue;
+			uint32_t len1 = entryBits(e);
+			uint32_t e2 = single[i >> len1];
+			if (entryType(e2) != E_LIT || len1 + entryBits(e2) > LIT_BITS)
+				continue;
+			uint32_t len = len1 + entryBits(e2);
+			table[i] = entry(E_LIT2, len, entryValue(e) | (entryValue(e2) << 8)) | len;
+		}
+	}
+
+	struct Tables
+	{
+		uint32_t lit[LIT_TABLE];
+		uint32_t dist[DIST_TABLE];
+	};
+
+	//таблицы фиксированных кодов (блоки типа 1) строятся один раз
+	const Tables& fixedTables()
+	{
+		static const Tables* t = []() {
+			static Tables fixed;
+			uint8_t lengths[288];
+			int i = 0;
+			for (; i < 144; ++i) lengths[i] = 8;
+			for (; i < 256; ++i) lengths[i] = 9;
+			for (; i < 280; ++i) lengths[i] = 7;
+			for (; i < 288; ++i) lengths[i] = 8;
+			buildTable(lengths, 288, LIT_BITS, fixed.lit, litSymbol);
+			pairLiterals(fixed.lit);
+			for (i = 0; i < 32; ++i) lengths[i] = 5;
+			buildTable(lengths, 32, DIST_BITS, fixed.dist, distSymbol);
+			return &fixed;
+		}();
+		return *t;
+	}
+
+	//Чтение бит младшим вперед через 64-битный буфер.
+	//Биты выше count - либо нули, либо уже следующие байты входа.
+	//Вход может быть из нескольких кусков подряд (IDAT в PNG), in/end - текущий
+	struct BitReader
+	{
+		const uint8_t* in;
+		const uint8_t* end;
+		const InflateInput* next_part = nullptr;
+		const InflateInput* last_part = nullptr;
+		uint64_t buf = 0;
+		unsigned count = 0;
+		//сколько нулевых байт подставлено за концом входа
+		size_t overread = 0;
+
+		//следующий непустой кусок, false - вход кончился
+		bool nextPart()
+		{
+			while (next_part < last_part)
+			{
+				const InflateInput& part = *next_part++;
+				if (part.size > 0)
+				{
+					in = part.data;
+					end = part.data + part.size;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		//после вызова в буфере не меньше 56 бит:
+		//хватает на код длины, ее доп. биты, код расстояния и его доп. биты (15+5+15+13)
+		bool refill()
+		{
+			if (end - in >= 8)
+			{
+				uint64_t v;
+				//x86 и ARM - little endian, байты ложатся в буфер как есть
+				std::memcpy(&v, in, 8);
+				buf |= v << count;
+				in += (63 - count) >> 3;
+				count |= 56;
+				return true;
+			}
+			while (count < 56)
+			{
+				uint64_t byte = 0;
+				if (in < end || nextPart())
+					byte = *in++;
+				else
+					++overread;
+				buf |= byte << count;
+				count += 8;
+			}
+			//настоящему потоку больше 7 байт сверху не нужно
+			return overread <= 8;
+		}
+
+		uint32_t peek(unsigned n) const
+		{
+			return (uint32_t)(buf & ((1ull << n) - 1));
+		}
+		void consume(unsigned n)
+		{
+			buf >>= n;
+			count -= n;
+		}
+		uint32_t take(unsigned n)
+		{
+			uint32_t v = peek(n);
+			consume(n);
+			return v;
+		}
+		//не съели ли больше, чем было на входе
+		bool valid() const
+		{
+			return count >= overread * 8;
+		}
+	};
+
+	struct Inflater
+	{
+		BitReader bits;
+		InflateOutput& out;
+		InflateRealloc realloc_fn;
+		uint8_t* start;
+		uint8_t* pos;
+		uint8_t* limit;
+
+		//потоковый режим: сколько байт в начале буфера уже отдано в sink
+		InflateSink sink = nullptr;
+		void* user = nullptr;
+		size_t handed = 0;
+		size_t streamed = 0;
+
+		//дальше всего повтор ссылается на 32 КБ назад
+		static const size_t WINDOW = 32768;
+
+		//пока до конца буфера дальше этого, повторы копируются по 8 байт не глядя
+		static const size_t MARGIN = 258 + 16;
+
+		Inflater(const InflateInput* parts, size_t count, InflateOutput& out, InflateRealloc realloc_fn)
+			: out(out), realloc_fn(realloc_fn)
+		{
+			bits.in = bits.end = nullptr;
+			bits.next_part = parts;
+			bits.last_part = parts + count;
+			bits.nextPart();
+			start = out.data;
+			pos = out.data;
+			limit = out.data + out.capacity;
+		}
+
+		//все новое отдаем в sink, последние WINDOW байт переносим в начало буфера
+		bool drain()
+		{
+			if (pos - start > (ptrdiff_t)handed && !sink(user, start + handed, pos - start - handed))
+				return false;
+			streamed += pos - start - handed;
+			size_t keep = std::min((size_t)(pos - start), WINDOW);
+			std::memmove(start, pos - keep, keep);
+			pos = start + keep;
+			handed = keep;
+			return true;
+		}
+
+		//места нужно еще need байт: растим буфер вдвое, как stb
+		bool grow(size_t need)
+		{
+			if (sink)
+				return drain() && (size_t)(limit - pos) >= need;
+			if (!realloc_fn)
+				return false;
+			size_t used = pos - start;
+			size_t cap = out.capacity ? out.capacity : 1;
+			while (cap - used < need)
+			{
+				if (cap > ((size_t)1 << 62))
+					return false;
+				cap *= 2;
+			}
+			uint8_t* p = (uint8_t*)realloc_fn(start, out.capacity, cap);
+			if (!p)
+				return false;
+			start = p;
+			pos = p + used;
+			limit = p + cap;
+			out.data = p;
+			out.capacity = cap;
+			return true;
+		}
+
+		bool stored()
+		{
+			//до границы байта
+			bits.consume(bits.count & 7);
+			if (!bits.refill())
+				return false;
+			uint32_t len = bits.take(16);
+			uint32_t nlen = bits.take(16);
+			if (len != (~nlen & 0xFFFF))
+				return false;
+
+			if ((size_t)(limit - pos) < len && !grow(len))
+				return false;
+
+			//Сначала байты, которые уже в буфере бит, дальше - прямо со входа.
+			//Подставленные за концом нули сюда не попадут: их съест valid()
+			while (len > 0 && bits.count >= 8)
+			{
+				*pos++ = (uint8_t)bits.take(8);
+				--len;
+			}
+			if (len == 0)
+				return true;
+			if (bits.overread)
+				return false;
+			bits.buf = 0;
+			bits.count = 0;
+			while (len > 0)
+			{
+				if (bits.in == bits.end && !bits.nextPart())
+					return false;
+				size_t n = std::min((size_t)len, (size_t)(bits.end - bits.in));
+				std::memcpy(pos, bits.in, n);
+				pos += n;
+				bits.in += n;
+				len -= (uint32_t)n;
+			}
+			return true;
+		}
+
+		bool dynamicTables(Tables& t)
+		{
+			if (!bits.refill())
+				return false;
+			int hlit = bits.take(5) + 257;
+			int hdist = bits.take(5) + 1;
+			int hclen = bits.take(4) + 4;
+
+			uint8_t cl_lengths[19] = {};
+			for (int i = 0; i < hclen; ++i)
+			{
+				if (!bits.refill())
+					return false;
+				cl_lengths[cl_order[i]] = (uint8_t)bits.take(3);
+			}
+			uint32_t cl_table[1 << CL_BITS];
+			if (!buildTable(cl_lengths, 19, CL_BITS, cl_table, clSymbol))
+				return false;
+
+			uint8_t lengths[288 + 32];
+			int total = hlit + hdist;
+			for (int n = 0; n < total; )
+			{
+				if (!bits.refill())
+					return false;
+				uint32_t e = cl_table[bits.peek(CL_BITS)];
+				if (entryType(e) != E_LIT)
+					return false;
+				bits.consume(entryBits(e));
+
+				int sym = entryValue(e);
+				int repeat;
+				uint8_t value = 0;
+				if (sym < 16)
+				{
+					lengths[n++] = (uint8_t)sym;
+					continue;
+				}
+				else if (sym == 16)
+				{
+					if (n == 0)
+						return false;
+					value = lengths[n - 1];
+					repeat = 3 + bits.take(2);
+				}
+				else if (sym == 17)
+					repeat = 3 + bits.take(3);
+				else
+					repeat = 11 + bits.take(7);
+
+				if (n + repeat > total)
+					return false;
+				std::memset(lengths + n, value, repeat);
+				n += repeat;
+			}
+			//без кода конца блок не закончить
+			if (lengths[256] == 0)
+				return false;
+
+			if (!buildTable(lengths, hlit, LIT_BITS, t.lit, litSymbol))
+				return false;
+			pairLiterals(t.lit);
+			return buildTable(lengths + hlit, hdist, DIST_BITS, t.dist, distSymbol);
+		}
+
+		bool huffman(const Tables& t)
+		{
+			const uint32_t* lit = t.lit;
+			const uint32_t* dist = t.dist;
+
+			//Состояние держим в локальных переменных: запись байта через uint8_t*
+			//может "попасть" в любой член класса, и компилятор перечитывал бы их после каждой записи.
+			//В члены все возвращается только на редких медленных ветках
+			uint64_t buf = bits.buf;
+			unsigned count = bits.count;
+			const uint8_t* in = bits.in;
+			uint8_t* out = pos;
+			//дальше этих границ - медленные ветки с проверками
+			const uint8_t* in_fast = bits.end - bits.in >= 8 ? bits.end - 8 : bits.in;
+			uint8_t* out_fast = (size_t)(limit - start) >= MARGIN ? limit - MARGIN : start;
+
+			auto save = [&]() {
+				bits.buf = buf;
+				bits.count = count;
+				bits.in = in;
+				pos = out;
+			};
+			auto load = [&]() {
+				buf = bits.buf;
+				count = bits.count;
+				in = bits.in;
+				out = pos;
+				in_fast = bits.end - bits.in >= 8 ? bits.end - 8 : bits.in;
+				out_fast = (size_t)(limit - start) >= MARGIN ? limit - MARGIN : start;
+			};
+			//после дозагрузки в буфере не меньше 56 бит
+			auto refill = [&]() {
+				if (in < in_fast)
+				{
+					uint64_t v;
+					//x86 и ARM - little endian, байты ложатся в буфер как есть
+					std::memcpy(&v, in, 8);
+					buf |= v << count;
+					in += (63 - count) >> 3;
+					count |= 56;
+					return true;
+				}
+				save();
+				bool ok = bits.refill();
+				load();
+				return ok;
+			};
+			//Символ из таблицы, съедает его код вместе с доп. битами (до 15 + 5 бит).
+			//Доп. биты потом берутся из saved - буфера до сдвига
+			uint64_t saved;
+			auto decode = [&](const uint32_t* table, unsigned table_bits) {
+				uint32_t e = table[buf & ((1u << table_bits) - 1)];
+				if (entryType(e) == E_SUB)
+				{
+					buf >>= table_bits;
+					count -= table_bits;
+					e = table[entryValue(e) + (buf & ((1u << entryCode(e)) - 1))];
+				}
+				saved = buf;
+				buf >>= entryBits(e);
+				count -= entryBits(e);
+				return e;
+			};
+			auto extra = [&](uint32_t e) {
+				return (uint32_t)((saved & ((1u << entryBits(e)) - 1)) >> entryCode(e));
+			};
+
+			for (;;)
+			{
+				if (!refill())
+					return false;
+				uint32_t e = decode(lit, LIT_BITS);
+
+				//литералы идут подряд без дозагрузки, пока в буфере хватает бит на следующий код
+				while (entryType(e) <= E_LIT2)
+				{
+					uint32_t n = 1 + entryType(e);
+					if (out < out_fast)
+					{
+						//пишем два байта всегда, для одиночного литерала второй перезапишется
+						out[0] = (uint8_t)entryValue(e);
+						out[1] = (uint8_t)(entryValue(e) >> 8);
+						out += n;
+					}
+					else
+					{
+						save();
+						if ((size_t)(limit - pos) < n && !grow(n))
+							return false;
+						pos[0] = (uint8_t)entryValue(e);
+						if (n == 2)
+							pos[1] = (uint8_t)(entryValue(e) >> 8);
+						pos += n;
+						load();
+					}
+					if (count < 20)
+						break;
+					e = decode(lit, LIT_BITS);
+				}
+
+				uint32_t type = entryType(e);
+				if (type <= E_LIT2)
+					continue;
+				if (type == E_END)
+				{
+					save();
+					return true;
+				}
+				if (type != E_LEN)
+					return false;
+
+				uint32_t length = entryValue(e) + extra(e);
+
+				//на расстояние нужно до 28 бит, а после литералов их могло остаться меньше
+				if (!refill())
+					return false;
+				uint32_t d = decode(dist, DIST_BITS);
+				if (entryType(d) != E_DIST)
+					return false;
+				uint32_t distance = entryValue(d) + extra(d);
+
+				if (distance > (size_t)(out - start))
+					return false;
+
+				if (out < out_fast)
+				{
+					const uint8_t* src = out - distance;
+					uint8_t* dst = out;
+					out += length;
+					if (distance >= 8)
+					{
+						//перекрытие не мешает: каждые 8 байт источника уже записаны
+						do
+						{
+							std::memcpy(dst, src, 8);
+							dst += 8;
+							src += 8;
+						} while (dst < out);
+					}
+					else if (distance == 1)
+					{
+						//повтор одного байта - пишем его по 8 штук
+						uint64_t v = 0x0101010101010101ull * src[0];
+						do
+						{
+							std::memcpy(dst, &v, 8);
+							dst += 8;
+						} while (dst < out);
+					}
+					else
+					{
+						//Короткий период (у RGBA-картинок часто 3-4 байта - соседний пиксель).
+						//Первые байты по одному, пока не наберется кратное периоду расстояние >= 8,
+						//дальше копируем по 8 байт с этого расстояния - узор тот же
+						uint32_t step = distance * ((8 + distance - 1) / distance);
+						uint8_t* head = dst + step < out ? dst + step : out;
+						while (dst < head)
+							*dst++ = *src++;
+						src = dst - step;
+						while (dst < out)
+						{
+							std::memcpy(dst, src, 8);
+							dst += 8;
+							src += 8;
+						}
+					}
+					continue;
+				}
+
+				//у конца буфера - аккуратно, байт за байтом
+				save();
+				if ((size_t)(limit - pos) < length && !grow(length))
+					return false;
+				const uint8_t* src = pos - distance;
+				for (uint32_t i = 0; i < length; ++i)
+					pos[i] = src[i];
+				pos += length;
+				load();
+			}
+		}
+
+		bool run(bool parse_header)
+		{
+			if (parse_header)
+			{
+				if (!bits.refill())
+					return false;
+				int cmf = bits.take(8);
+				int flg = bits.take(8);
+				//контрольная сумма заголовка, словарь не поддерживается, метод 8 = deflate
+				if ((cmf * 256 + flg) % 31 != 0 || (flg & 32) || (cmf & 15) != 8)
+					return false;
+			}
+
+			Tables dynamic;
+			bool final;
+			do
+			{
+				if (!bits.refill())
+					return false;
+				final = bits.take(1) != 0;
+				uint32_t type = bits.take(2);
+
+				bool ok;
+				if (type == 0)
+					ok = stored();
+				else if (type == 1)
+					ok = huffman(fixedTables());
+				else if (type == 2)
+					ok = dynamicTables(dynamic) && huffman(dynamic);
+				else
+					ok = false;
+
+				if (!ok || !bits.valid())
+					return false;
+			} while (!final);
+
+			//контрольную сумму adler32 stb тоже не проверяет
+			if (sink)
+			{
+				if (!drain())
+					return false;
+				out.size = streamed;
+				return true;
+			}
+			out.size = pos - start;
+			return true;
+		}
+	};
+}
+
+bool fastInflate(const unsigned char* in, size_t in_size, bool parse_header,
+	InflateOutput& out, InflateRealloc realloc_fn)
+{
+	InflateInput part = { in, in_size };
+	Inflater inflater(&part, 1, out, realloc_fn);
+	return inflater.run(parse_header);
+}
+
+bool fastInflateStream(const InflateInput* parts, size_t count, bool parse_header,
+	unsigned char* buffer, size_t buffer_size, InflateSink sink, void* user)
+{
+	if (buffer_size < INFLATE_STREAM_MIN)
+		return false;
+	InflateOutput out;
+	out.data = buffer;
+	out.capacity = buffer_size;
+	Inflater inflater(parts, count, out, nullptr);
+	inflater.sink = sink;
+	inflater.user = user;
+	return inflater.run(parse_header);
+}
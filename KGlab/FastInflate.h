@@ -0,0 +1,57 @@
+#ifndef FASTINFLATE_H
+#define FASTINFLATE_H
+
+#include <cstddef>
+
+//Распаковщик deflate (zlib), которым stb_image разжимает PNG,
+//если собран с STBI_FAST_INFLATE (см. Render.cpp; stbi_set_fast_inflate(0) вернет штатный).
+//Им же PngDecode.cpp разжимает PNG потоком.
+//
+//В отличие от штатного в stb:
+// - таблица кодов на 11 бит сразу дает символ (длинные коды - через подтаблицы),
+//   а если в 11 бит влезают два литерала подряд - то оба за один поиск;
+// - биты читаются по 8 байт в 64-битный буфер, одна дозагрузка на символ;
+// - повторы копируются по 8 байт, пока до конца буфера далеко.
+//Результат побайтно совпадает со штатным распаковщиком.
+
+//перевыделение буфера вывода: старый размер, новый размер.
+//nullptr - буфер не растет, не влезло - ошибка
+typedef void* (*InflateRealloc)(void* data, size_t old_size, size_t new_size);
+
+struct InflateOutput
+{
+	unsigned char* data = nullptr;
+	//сколько распаковано
+	size_t size = 0;
+	//сколько выделено
+	size_t capacity = 0;
+};
+
+//распаковывает in в out.data (с начала).
+//parse_header - поток с заголовком zlib (как в PNG), иначе голый deflate.
+//При росте out.data/out.capacity меняются, при ошибке буфер остается у вызывающего
+bool fastInflate(const unsigned char* in, size_t in_size, bool parse_header,
+	InflateOutput& out, InflateRealloc realloc_fn);
+
+//кусок сжатых данных
+struct InflateInput
+{
+	const unsigned char* data;
+	size_t size;
+};
+
+//получатель распакованного потока: очередной кусок по порядку, false - прервать
+typedef bool (*InflateSink)(void* user, const unsigned char* data, size_t size);
+
+//сколько нужно буферу потоковой распаковки: окно повторов 32 КБ + несжатый блок до 64 КБ
+const size_t INFLATE_STREAM_MIN = 128 * 1024;
+
+//То же, но результат целиком в памяти не держится: распаковка идет в buffer,
+//а когда он заполнен, все, кроме последних 32 КБ (на них ссылаются повторы), отдается в sink
+//и окно переезжает в начало. buffer_size - не меньше INFLATE_STREAM_MIN.
+//Вход - count кусков одного потока подряд (например, IDAT прямо из файла, без склейки).
+//Так большую картинку можно разжимать сразу в конечный буфер, без промежуточных копий
+bool fastInflateStream(const InflateInput* parts, size_t count, bool parse_header,
+	unsigned char* buffer, size_t buffer_size, InflateSink sink, void* user);
+
+#endif
@@ -0,0 +1,186 @@
+#include "FrameStats.h"
+
+#include "GLCallCount.h"
+#include "GLState.h"
+#include "ImmediateBatch.h"
+
+#include <algorithm>
+
+
+namespace
+{
+	//цвета этапов: события, сцена, swap, остальное
+	const unsigned char stage_colors[FrameStats::STAGE_COUNT + 1][4] =
+	{
+		{ 230, 160, 20, 255 },
+		{ 40, 120, 220, 255 },
+		{ 60, 180, 60, 255 },
+		{ 150, 150, 150, 255 },
+	};
+	const unsigned char hitch_color[4] = { 230, 20, 20, 255 };
+	const unsigned char grid_color[4] = { 0, 0, 0, 90 };
+	const unsigned char avg_color[4] = { 20, 20, 160, 255 };
+	const unsigned char p99_color[4] = { 170, 20, 170, 255 };
+	//подложка - белая, 60%
+	const unsigned char background_color[4] = { 255, 255, 255, 153 };
+
+	double msSince(std::chrono::steady_clock::time_point t)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+	}
+}
+
+
+FrameStats::FrameStats()
+{
+	head = 0;
+	for (auto& s : samples)
+	{
+		s.frame = 0;
+		for (auto& x : s.stage)
+			x = 0;
+	}
+}
+
+void FrameStats::beginFrame()
+{
+	frame_start = std::chrono::steady_clock::now();
+	overhead_ms = 0;
+	graph_ms = 0;
+	Sample& s = samples[head.load(std::memory_order_relaxed) % HISTORY];
+	for (auto& x : s.stage)
+		x.store(0, std::memory_order_relaxed);
+	overhead_ms += msSince(frame_start);
+}
+
+void FrameStats::setStage(Stage stage, double ms)
+{
+	auto start = std::chrono::steady_clock::now();
+	Sample& s = samples[head.load(std::memory_order_relaxed) % HISTORY];
+	s.stage[stage].store((float)ms, std::memory_order_relaxed);
+	overhead_ms += msSince(start);
+}
+
+void FrameStats::endFrame()
+{
+	auto end = std::chrono::steady_clock::now();
+	Sample& s = samples[head.load(std::memory_order_relaxed) % HISTORY];
+	s.frame.store((float)std::chrono::duration<double, std::milli>(end - frame_start).count(), std::memory_order_relaxed);
+	//публикуем кадр: все записи выше становятся видны тем, кто прочитал head
+	head.fetch_add(1, std::memory_order_release);
+	last_overhead_ms = overhead_ms + msSince(end);
+	last_graph_ms = graph_ms;
+}
+
+FrameStats::Summary FrameStats::stats() const
+{
+	Summary r;
+
+	unsigned h = head.load(std::memory_order_acquire);
+	//слот head % HISTORY сейчас может переписываться - его не трогаем
+	int n = (int)std::min<unsigned>(h, HISTORY - 1);
+	if (n == 0)
+		return r;
+
+	float frames[HISTORY];
+	for (int i = 0; i < n; ++i)
+		frames[i] = samples[(h - n + i) % HISTORY].frame.load(std::memory_order_relaxed);
+
+	double sum = 0;
+	r.min = r.max = frames[0];
+	for (int i = 0; i < n; ++i)
+	{
+		sum += frames[i];
+		r.min = std::min<double>(r.min, frames[i]);
+		r.max = std::max<double>(r.max, frames[i]);
+	}
+	r.avg = sum / n;
+	r.count = n;
+
+	for (int i = 0; i < n; ++i)
+		if (frames[i] > r.avg * hitch_factor)
+			++r.hitches;
+
+	int k = std::max(0, (n * 99 + 99) / 100 - 1);
+	std::nth_element(frames, frames + k, frames + n);
+	r.p99 = frames[k];
+
+	return r;
+}
+
+void FrameStats::line(float x0, float y0, float x1, float y1, const unsigned char* c)
+{
+	imm.color4d(c[0] / 255.0, c[1] / 255.0, c[2] / 255.0, c[3] / 255.0);
+	imm.vertex2d(x0, y0);
+	imm.vertex2d(x1, y1);
+}
+
+void FrameStats::DrawGraph(double x, double y, double w, double h)
+{
+	//смена состояния рисует то, что HUD накопил до графика, - это не наше время
+	glState.disable(GL_LIGHTING);
+	glState.disable(GL_TEXTURE_2D);
+	glState.enable(GL_BLEND);
+	glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	imm.setAttributes(ImmediateBatch::Colors);
+
+	auto start = std::chrono::steady_clock::now();
+	Summary s = stats();
+	unsigned hd = head.load(std::memory_order_acquire);
+	int n = (int)std::min<unsigned>(hd, HISTORY - 1);
+
+	//шкала: не меньше 33.3 мс, чтобы обычные кадры не прыгали
+	double range = std::max(1000.0 / 30, s.p99 * 1.25);
+	double k = h / range;
+	double dx = w / HISTORY;
+
+	//Все - отрезками в одном imm.begin(GL_LINES), и подложка тоже: по вертикальному отрезку
+	//в каждый столбец. Четырехугольник подложки (другой режим) imm нарисовал бы отдельной
+	//пачкой, а столбики четырехугольниками - вдвое больше вершин, чем отрезками
+	imm.begin(GL_LINES);
+	const unsigned char* c = background_color;
+	imm.color4d(c[0] / 255.0, c[1] / 255.0, c[2] / 255.0, c[3] / 255.0);
+	for (int i = 0; i < HISTORY; ++i)
+	{
+		double bx = x + i * dx;
+		imm.vertex2d(bx, y);
+		imm.vertex2d(bx, y + h);
+	}
+
+	//от старого кадра к новому, новый - справа
+	for (int i = 0; i < n; ++i)
+	{
+		const Sample& smp = samples[(hd - n + i) % HISTORY];
+		float frame = smp.frame.load(std::memory_order_relaxed);
+		float bx = (float)(x + (HISTORY - n + i) * dx);
+
+		double y0 = y;
+		double total = 0;
+		for (int st = 0; st < STAGE_COUNT; ++st)
+		{
+			double ms = smp.stage[st].load(std::memory_order_relaxed);
+			if (ms <= 0)
+				continue;
+			total += ms;
+			double y1 = y + std::min(total, range) * k;
+			line(bx, (float)y0, bx, (float)y1, stage_colors[st]);
+			y0 = y1;
+		}
+		//то, что не попало ни в один этап (смена размера, сам замер)
+		if (frame > total)
+			line(bx, (float)y0, bx, (float)(y + std::min<double>(frame, range) * k), stage_colors[STAGE_COUNT]);
+
+		if (frame > s.avg * hitch_factor)
+			line(bx, (float)(y + h), bx, (float)(y + h + 6), hitch_color);
+	}
+
+	//опорные линии: 60 и 30 кадров в секунду, среднее и p99
+	float x0 = (float)x, x1 = (float)(x + w);
+	line(x0, (float)(y + 1000.0 / 60 * k), x1, (float)(y + 1000.0 / 60 * k), grid_color);
+	line(x0, (float)(y + 1000.0 / 30 * k), x1, (float)(y + 1000.0 / 30 * k), grid_color);
+	line(x0, (float)(y + s.avg * k), x1, (float)(y + s.avg * k), avg_color);
+	line(x0, (float)(y + s.p99 * k), x1, (float)(y + s.p99 * k), p99_color);
+
+	imm.end();
+	graph_ms += msSince(start);
+}
@@ -0,0 +1,94 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <atomic>
+#include <chrono>
+
+//История времени кадров для графика в HUD.
+//Кольцевой буфер последних HISTORY кадров без блокировок:
+//пишет только поток рендера (beginFrame/setStage/endFrame),
+//читать (stats/DrawGraph) можно из любого потока.
+//Кадр становится виден читателям только после endFrame.
+class FrameStats
+{
+public:
+
+	static const int HISTORY = 256;
+
+	//этапы кадра, замеряются в OpenGL::render
+	enum Stage
+	{
+		Events,		//разбор событий мыши и клавиатуры
+		Scene,		//Render() - сцена и HUD
+		Swap,		//SwapBuffers, тут же ожидание vsync
+		STAGE_COUNT
+	};
+
+	struct Summary
+	{
+		double min = 0;
+		double avg = 0;
+		double p99 = 0;
+		double max = 0;
+		int hitches = 0;
+		int count = 0;
+	};
+
+	//кадр считается рывком, если он дольше среднего во столько раз
+	double hitch_factor = 2.0;
+
+	FrameStats();
+
+	//полное время кадра - от beginFrame до endFrame по тем же часам, что и этапы,
+	//поэтому столбик и его этапы всегда от одного кадра
+	void beginFrame();
+	void setStage(Stage stage, double ms);
+	void endFrame();
+
+	//на запись этапов и построение графика вместе - не больше этого за кадр, мс
+	static constexpr double BUDGET_MS = 0.05;
+
+	//время последнего кадра, мс: на запись этапов (beginFrame/setStage/endFrame)
+	//и на вершины графика в DrawGraph (рисует их уже imm.flush после). Только поток рендера
+	double overheadMs() const
+	{
+		return last_overhead_ms;
+	}
+	double graphMs() const
+	{
+		return last_graph_ms;
+	}
+
+	//min/avg/p99 по всей истории
+	Summary stats() const;
+
+	//рисует график (в координатах glOrtho HUD-а) с левым нижним углом в (x, y).
+	//Столбик на кадр, раскрашенный по этапам, линии 16.7/33.3 мс
+	//и красные засечки над рывками. Все - одной пачкой imm, на экран она попадет
+	//при следующем imm.flush(). Смешивание и формат imm (только цвет) остаются
+	//как для графика - вернуть их после flush должен вызывающий
+	void DrawGraph(double x, double y, double w, double h);
+
+private:
+
+	struct Sample
+	{
+		std::atomic<float> frame;
+		std::atomic<float> stage[STAGE_COUNT];
+	};
+
+	Sample samples[HISTORY];
+	//сколько кадров записано всего, индекс в кольце - head % HISTORY
+	std::atomic<unsigned> head;
+
+	std::chrono::steady_clock::time_point frame_start;
+	double overhead_ms = 0;
+	double last_overhead_ms = 0;
+	double graph_ms = 0;
+	double last_graph_ms = 0;
+
+	//отрезок в текущий imm.begin(GL_LINES)
+	void line(float x0, float y0, float x1, float y1, const unsigned char* c);
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "GLCallCount.h"
+
+namespace
+{
+	//голова списка инициализируется статически, до конструкторов счетчиков
+	GLCallCounter* counters = nullptr;
+}
+
+GLCallCounter::GLCallCounter(const char* name, bool draw)
+	: name(name), draw(draw), next(counters)
+{
+	counters = this;
+}
+
+GLCallCounter* glCallCounters()
+{
+	return counters;
+}
+
+unsigned long long glCallTotal()
+{
+	unsigned long long n = 0;
+	for (GLCallCounter* c = counters; c; c = c->next)
+		n += c->count;
+	return n;
+}
+
+unsigned long long glDrawCallTotal()
+{
+	unsigned long long n = 0;
+	for (GLCallCounter* c = counters; c; c = c->next)
+		if (c->draw)
+			n += c->count;
+	return n;
+}
+
+void glResetCallCounters()
+{
+	for (GLCallCounter* c = counters; c; c = c->next)
+		c->count = 0;
+}
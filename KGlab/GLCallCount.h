@@ -0,0 +1,226 @@
+#ifndef GLCALLCOUNT_H
+#define GLCALLCOUNT_H
+
+//Счетчики вызовов OpenGL.
+//Подключается вместо <GL/gl.h>: макросы ниже превращают каждый вызов glXxx(...)
+//в "счетчик++, glXxx(...)". Стоит это одно сложение на вызов, поэтому включено всегда.
+//GL зовется только из потока рендера, так что счетчики без атомиков.
+//Функции новее 1.1 (glfn.GenerateMipmap и т.п.) считаются своими счетчиками, см. GLLoader.h.
+
+#include "Platform.h"
+#include <GL/gl.h>
+#include <GL/glu.h>
+
+struct GLCallCounter
+{
+	const char* name;
+	//вызов, который что-то рисует (glBegin, glDrawArrays, glCallList...)
+	bool draw;
+	unsigned long long count = 0;
+	GLCallCounter* next;
+
+	GLCallCounter(const char* name, bool draw);
+};
+
+//все счетчики списком, по next
+GLCallCounter* glCallCounters();
+//всего вызовов и из них рисующих с последнего сброса
+unsigned long long glCallTotal();
+unsigned long long glDrawCallTotal();
+void glResetCallCounters();
+
+//Функции OpenGL 1.1, которые считаются: X(имя, рисует ли).
+//По списку заводятся счетчики gl_count_<имя>, а сами вызовы подменяют макросы ниже -
+//их по списку не сделать (#define из макроса не получить), зато расхождения ловит компилятор:
+//макрос без счетчика не соберется, а функцию из списка без макроса найдет static_assert
+#define GL_COUNTED_FUNCTIONS(X) \
+	X(glAlphaFunc, false) \
+	X(glBegin, true) \
+	X(glBindTexture, false) \
+	X(glBlendFunc, false) \
+	X(glCallList, true) \
+	X(glCallLists, true) \
+	X(glClear, false) \
+	X(glClearColor, false) \
+	X(glColor3d, false) \
+	X(glColor3f, false) \
+	X(glColor3ub, false) \
+	X(glColor4d, false) \
+	X(glColor4f, false) \
+	X(glColor4ub, false) \
+	X(glColorPointer, false) \
+	X(glCullFace, false) \
+	X(glDeleteLists, false) \
+	X(glDeleteTextures, false) \
+	X(glDepthFunc, false) \
+	X(glDepthMask, false) \
+	X(glDisable, false) \
+	X(glDisableClientState, false) \
+	X(glDrawArrays, true) \
+	X(glDrawElements, true) \
+	X(glEnable, false) \
+	X(glEnableClientState, false) \
+	X(glEnd, false) \
+	X(glEndList, false) \
+	X(glFinish, false) \
+	X(glFlush, false) \
+	X(glFrontFace, false) \
+	X(glGenLists, false) \
+	X(glGenTextures, false) \
+	X(glGetDoublev, false) \
+	X(glGetError, false) \
+	X(glGetFloatv, false) \
+	X(glGetIntegerv, false) \
+	X(glGetString, false) \
+	X(glIsEnabled, false) \
+	X(glLightf, false) \
+	X(glLightfv, false) \
+	X(glLineWidth, false) \
+	X(glLoadIdentity, false) \
+	X(glLoadMatrixd, false) \
+	X(glLoadMatrixf, false) \
+	X(glMaterialf, false) \
+	X(glMaterialfv, false) \
+	X(glMatrixMode, false) \
+	X(glMultMatrixd, false) \
+	X(glMultMatrixf, false) \
+	X(glNewList, false) \
+	X(glNormal3d, false) \
+	X(glNormal3dv, false) \
+	X(glNormal3f, false) \
+	X(glNormal3fv, false) \
+	X(glNormalPointer, false) \
+	X(glOrtho, false) \
+	X(glPixelStorei, false) \
+	X(glPointSize, false) \
+	X(glPolygonMode, false) \
+	X(glPopAttrib, false) \
+	X(glPopMatrix, false) \
+	X(glPushAttrib, false) \
+	X(glPushMatrix, false) \
+	X(glReadPixels, false) \
+	X(glRotated, false) \
+	X(glScaled, false) \
+	X(glShadeModel, false) \
+	X(glTexCoord2d, false) \
+	X(glTexCoord2dv, false) \
+	X(glTexCoord2f, false) \
+	X(glTexCoord2fv, false) \
+	X(glTexCoordPointer, false) \
+	X(glTexEnvf, false) \
+	X(glTexEnvi, false) \
+	X(glTexImage2D, false) \
+	X(glTexParameterf, false) \
+	X(glTexParameteri, false) \
+	X(glTexSubImage2D, false) \
+	X(glTranslated, false) \
+	X(glVertex2d, false) \
+	X(glVertex2f, false) \
+	X(glVertex3d, false) \
+	X(glVertex3dv, false) \
+	X(glVertex3f, false) \
+	X(glVertex3fv, false) \
+	X(glVertexPointer, false) \
+	X(glViewport, false)
+
+#define GL_COUNTER(name, draw) inline GLCallCounter gl_count_##name(#name, draw);
+GL_COUNTED_FUNCTIONS(GL_COUNTER)
+
+#define glAlphaFunc(...) (++gl_count_glAlphaFunc.count, glAlphaFunc(__VA_ARGS__))
+#define glBegin(...) (++gl_count_glBegin.count, glBegin(__VA_ARGS__))
+#define glBindTexture(...) (++gl_count_glBindTexture.count, glBindTexture(__VA_ARGS__))
+#define glBlendFunc(...) (++gl_count_glBlendFunc.count, glBlendFunc(__VA_ARGS__))
+#define glCallList(...) (++gl_count_glCallList.count, glCallList(__VA_ARGS__))
+#define glCallLists(...) (++gl_count_glCallLists.count, glCallLists(__VA_ARGS__))
+#define glClear(...) (++gl_count_glClear.count, glClear(__VA_ARGS__))
+#define glClearColor(...) (++gl_count_glClearColor.count, glClearColor(__VA_ARGS__))
+#define glColor3d(...) (++gl_count_glColor3d.count, glColor3d(__VA_ARGS__))
+#define glColor3f(...) (++gl_count_glColor3f.count, glColor3f(__VA_ARGS__))
+#define glColor3ub(...) (++gl_count_glColor3ub.count, glColor3ub(__VA_ARGS__))
+#define glColor4d(...) (++gl_count_glColor4d.count, glColor4d(__VA_ARGS__))
+#define glColor4f(...) (++gl_count_glColor4f.count, glColor4f(__VA_ARGS__))
+#define glColor4ub(...) (++gl_count_glColor4ub.count, glColor4ub(__VA_ARGS__))
+#define glColorPointer(...) (++gl_count_glColorPointer.count, glColorPointer(__VA_ARGS__))
+#define glCullFace(...) (++gl_count_glCullFace.count, glCullFace(__VA_ARGS__))
+#define glDeleteLists(...) (++gl_count_glDeleteLists.count, glDeleteLists(__VA_ARGS__))
+#define glDeleteTextures(...) (++gl_count_glDeleteTextures.count, glDeleteTextures(__VA_ARGS__))
+#define glDepthFunc(...) (++gl_count_glDepthFunc.count, glDepthFunc(__VA_ARGS__))
+#define glDepthMask(...) (++gl_count_glDepthMask.count, glDepthMask(__VA_ARGS__))
+#define glDisable(...) (++gl_count_glDisable.count, glDisable(__VA_ARGS__))
+#define glDisableClientState(...) (++gl_count_glDisableClientState.count, glDisableClientState(__VA_ARGS__))
+#define glDrawArrays(...) (++gl_count_glDrawArrays.count, glDrawArrays(__VA_ARGS__))
+#define glDrawElements(...) (++gl_count_glDrawElements.count, glDrawElements(__VA_ARGS__))
+#define glEnable(...) (++gl_count_glEnable.count, glEnable(__VA_ARGS__))
+#define glEnableClientState(...) (++gl_count_glEnableClientState.count, glEnableClientState(__VA_ARGS__))
+#define glEnd(...) (++gl_count_glEnd.count, glEnd(__VA_ARGS__))
+#define glEndList(...) (++gl_count_glEndList.count, glEndList(__VA_ARGS__))
+#define glFinish(...) (++gl_count_glFinish.count, glFinish(__VA_ARGS__))
+#define glFlush(...) (++gl_count_glFlush.count, glFlush(__VA_ARGS__))
+#define glFrontFace(...) (++gl_count_glFrontFace.count, glFrontFace(__VA_ARGS__))
+#define glGenLists(...) (++gl_count_glGenLists.count, glGenLists(__VA_ARGS__))
+#define glGenTextures(...) (++gl_count_glGenTextures.count, glGenTextures(__VA_ARGS__))
+#define glGetDoublev(...) (++gl_count_glGetDoublev.count, glGetDoublev(__VA_ARGS__))
+#define glGetError(...) (++gl_count_glGetError.count, glGetError(__VA_ARGS__))
+#define glGetFloatv(...) (++gl_count_glGetFloatv.count, glGetFloatv(__VA_ARGS__))
+#define glGetIntegerv(...) (++gl_count_glGetIntegerv.count, glGetIntegerv(__VA_ARGS__))
+#define glGetString(...) (++gl_count_glGetString.count, glGetString(__VA_ARGS__))
+#define glIsEnabled(...) (++gl_count_glIsEnabled.count, glIsEnabled(__VA_ARGS__))
+#define glLightf(...) (++gl_count_glLightf.count, glLightf(__VA_ARGS__))
+#define glLightfv(...) (++gl_count_glLightfv.count, glLightfv(__VA_ARGS__))
+#define glLineWidth(...) (++gl_count_glLineWidth.count, glLineWidth(__VA_ARGS__))
+#define glLoadIdentity(...) (++gl_count_glLoadIdentity.count, glLoadIdentity(__VA_ARGS__))
+#define glLoadMatrixd(...) (++gl_count_glLoadMatrixd.count, glLoadMatrixd(__VA_ARGS__))
+#define glLoadMatrixf(...) (++gl_count_glLoadMatrixf.count, glLoadMatrixf(__VA_ARGS__))
+#define glMaterialf(...) (++gl_count_glMaterialf.count, glMaterialf(__VA_ARGS__))
+#define glMaterialfv(...) (++gl_count_glMaterialfv.count, glMaterialfv(__VA_ARGS__))
+#define glMatrixMode(...) (++gl_count_glMatrixMode.count, glMatrixMode(__VA_ARGS__))
+#define glMultMatrixd(...) (++gl_count_glMultMatrixd.count, glMultMatrixd(__VA_ARGS__))
+#define glMultMatrixf(...) (++gl_count_glMultMatrixf.count, glMultMatrixf(__VA_ARGS__))
+#define glNewList(...) (++gl_count_glNewList.count, glNewList(__VA_ARGS__))
+#define glNormal3d(...) (++gl_count_glNormal3d.count, glNormal3d(__VA_ARGS__))
+#define glNormal3dv(...) (++gl_count_glNormal3dv.count, glNormal3dv(__VA_ARGS__))
+#define glNormal3f(...) (++gl_count_glNormal3f.count, glNormal3f(__VA_ARGS__))
+#define glNormal3fv(...) (++gl_count_glNormal3fv.count, glNormal3fv(__VA_ARGS__))
+#define glNormalPointer(...) (++gl_count_glNormalPointer.count, glNormalPointer(__VA_ARGS__))
+#define glOrtho(...) (++gl_count_glOrtho.count, glOrtho(__VA_ARGS__))
+#define glPixelStorei(...) (++gl_count_glPixelStorei.count, glPixelStorei(__VA_ARGS__))
+#define glPointSize(...) (++gl_count_glPointSize.count, glPointSize(__VA_ARGS__))
+#define glPolygonMode(...) (++gl_count_glPolygonMode.count, glPolygonMode(__VA_ARGS__))
+#define glPopAttrib(...) (++gl_count_glPopAttrib.count, glPopAttrib(__VA_ARGS__))
+#define glPopMatrix(...) (++gl_count_glPopMatrix.count, glPopMatrix(__VA_ARGS__))
+#define glPushAttrib(...) (++gl_count_glPushAttrib.count, glPushAttrib(__VA_ARGS__))
+#define glPushMatrix(...) (++gl_count_glPushMatrix.count, glPushMatrix(__VA_ARGS__))
+#define glReadPixels(...) (++gl_count_glReadPixels.count, glReadPixels(__VA_ARGS__))
+#define glRotated(...) (++gl_count_glRotated.count, glRotated(__VA_ARGS__))
+#define glScaled(...) (++gl_count_glScaled.count, glScaled(__VA_ARGS__))
+#define glShadeModel(...) (++gl_count_glShadeModel.count, glShadeModel(__VA_ARGS__))
+#define glTexCoord2d(...) (++gl_count_glTexCoord2d.count, glTexCoord2d(__VA_ARGS__))
+#define glTexCoord2dv(...) (++gl_count_glTexCoord2dv.count, glTexCoord2dv(__VA_ARGS__))
+#define glTexCoord2f(...) (++gl_count_glTexCoord2f.count, glTexCoord2f(__VA_ARGS__))
+#define glTexCoord2fv(...) (++gl_count_glTexCoord2fv.count, glTexCoord2fv(__VA_ARGS__))
+#define glTexCoordPointer(...) (++gl_count_glTexCoordPointer.count, glTexCoordPointer(__VA_ARGS__))
+#define glTexEnvf(...) (++gl_count_glTexEnvf.count, glTexEnvf(__VA_ARGS__))
+#define glTexEnvi(...) (++gl_count_glTexEnvi.count, glTexEnvi(__VA_ARGS__))
+#define glTexImage2D(...) (++gl_count_glTexImage2D.count, glTexImage2D(__VA_ARGS__))
+#define glTexParameterf(...) (++gl_count_glTexParameterf.count, glTexParameterf(__VA_ARGS__))
+#define glTexParameteri(...) (++gl_count_glTexParameteri.count, glTexParameteri(__VA_ARGS__))
+#define glTexSubImage2D(...) (++gl_count_glTexSubImage2D.count, glTexSubImage2D(__VA_ARGS__))
+#define glTranslated(...) (++gl_count_glTranslated.count, glTranslated(__VA_ARGS__))
+#define glVertex2d(...) (++gl_count_glVertex2d.count, glVertex2d(__VA_ARGS__))
+#define glVertex2f(...) (++gl_count_glVertex2f.count, glVertex2f(__VA_ARGS__))
+#define glVertex3d(...) (++gl_count_glVertex3d.count, glVertex3d(__VA_ARGS__))
+#define glVertex3dv(...) (++gl_count_glVertex3dv.count, glVertex3dv(__VA_ARGS__))
+#define glVertex3f(...) (++gl_count_glVertex3f.count, glVertex3f(__VA_ARGS__))
+#define glVertex3fv(...) (++gl_count_glVertex3fv.count, glVertex3fv(__VA_ARGS__))
+#define glVertexPointer(...) (++gl_count_glVertexPointer.count, glVertexPointer(__VA_ARGS__))
+#define glViewport(...) (++gl_count_glViewport.count, glViewport(__VA_ARGS__))
+
+//name(0) раскрывается в "(++gl_count_...", только если для name есть макрос
+#define GL_COUNTED_STRING(x) #x
+#define GL_COUNTED_EXPANDED(x) GL_COUNTED_STRING(x)
+#define GL_COUNTED_CHECK(name, draw) \
+	static_assert(GL_COUNTED_EXPANDED(name(0))[0] == '(', #name " is not counted: add a macro for it");
+GL_COUNTED_FUNCTIONS(GL_COUNTED_CHECK)
+#undef GL_COUNTED_CHECK
+
+#endif
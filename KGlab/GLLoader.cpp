@@ -0,0 +1,170 @@
+#include "GLLoader.h"
+
+#include "GLState.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT 0x84FF
+#endif
+
+GLFunctions glfn;
+
+namespace
+{
+	GLCaps caps;
+	std::set<std::string> extensions;
+
+	//имя, потом с ARB, потом с EXT
+	void* load(const char* name)
+	{
+		for (const char* suffix : { "", "ARB", "EXT" })
+			if (void* f = platformGetProcAddress((std::string(name) + suffix).c_str()))
+				return f;
+		return nullptr;
+	}
+
+	void readExtensions()
+	{
+		extensions.clear();
+		//в 3.0+ по одному (в core-профиле длинной строки уже нет)
+		if (caps.atLeast(3, 0) && glfn.GetStringi.ptr)
+		{
+			GLint n = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+			for (GLint i = 0; i < n; ++i)
+				if (const GLubyte* e = glfn.GetStringi(GL_EXTENSIONS, (GLuint)i))
+					extensions.insert((const char*)e);
+			if (!extensions.empty())
+				return;
+		}
+
+		const char* all = (const char*)glGetString(GL_EXTENSIONS);
+		while (all && *all)
+		{
+			const char* end = std::strchr(all, ' ');
+			if (!end)
+				end = all + std::strlen(all);
+			if (end > all)
+				extensions.insert(std::string(all, end));
+			all = *end ? end + 1 : end;
+		}
+	}
+}
+
+bool loadGL()
+{
+	const char* version = (const char*)glGetString(GL_VERSION);
+	if (!version)
+		return false;
+
+	//новый контекст - состояние в нем по умолчанию, старая тень не годится
+	glState.invalidate();
+
+	caps = GLCaps();
+	caps.version = version;
+	caps.vendor = (const char*)glGetString(GL_VENDOR);
+	caps.renderer = (const char*)glGetString(GL_RENDERER);
+	//"4.6.0 NVIDIA 551.23", "4.5 (Compatibility Profile) Mesa 22.3.6"
+	sscanf(version, "%d.%d", &caps.major, &caps.minor);
+
+#define GL_LOAD_FUNCTION(ret, name, params, draw) \
+	glfn.name.ptr = (decltype(glfn.name.ptr))load("gl" #name);
+	GL_LOADED_FUNCTIONS(GL_LOAD_FUNCTION)
+#undef GL_LOAD_FUNCTION
+
+	if (caps.atLeast(3, 2))
+	{
+		GLint mask = 0;
+		glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &mask);
+		caps.compatibility = (mask & GL_CONTEXT_COMPATIBILITY_PROFILE_BIT) != 0;
+	}
+	readExtensions();
+
+	//флаг ставится, только если есть и версия (или расширение), и все функции
+	auto all = [](std::initializer_list<const void*> functions)
+	{
+		return std::all_of(functions.begin(), functions.end(), [](const void* f) { return f != nullptr; });
+	};
+
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &caps.max_texture_size);
+	caps.compressed_textures = caps.atLeast(1, 3) && all({ (void*)glfn.CompressedTexImage2D.ptr });
+	caps.s3tc = caps.compressed_textures && hasGLExtension("GL_EXT_texture_compression_s3tc");
+
+	caps.anisotropy = caps.atLeast(4, 6) || hasGLExtension("GL_EXT_texture_filter_anisotropic") ||
+		hasGLExtension("GL_ARB_texture_filter_anisotropic");
+	if (caps.anisotropy)
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &caps.max_anisotropy);
+
+	bool has_fbo = caps.atLeast(3, 0) || hasGLExtension("GL_ARB_framebuffer_object") ||
+		hasGLExtension("GL_EXT_framebuffer_object");
+	caps.generate_mipmap = has_fbo && all({ (void*)glfn.GenerateMipmap.ptr });
+	caps.fbo = has_fbo && all({ (void*)glfn.GenFramebuffers.ptr, (void*)glfn.DeleteFramebuffers.ptr,
+		(void*)glfn.BindFramebuffer.ptr, (void*)glfn.CheckFramebufferStatus.ptr, (void*)glfn.FramebufferRenderbuffer.ptr,
+		(void*)glfn.GenRenderbuffers.ptr, (void*)glfn.DeleteRenderbuffers.ptr, (void*)glfn.BindRenderbuffer.ptr,
+		(void*)glfn.RenderbufferStorage.ptr });
+
+	caps.vbo = (caps.atLeast(1, 5) || hasGLExtension("GL_ARB_vertex_buffer_object")) &&
+		all({ (void*)glfn.GenBuffers.ptr, (void*)glfn.DeleteBuffers.ptr, (void*)glfn.BindBuffer.ptr,
+			(void*)glfn.BufferData.ptr, (void*)glfn.BufferSubData.ptr, (void*)glfn.MapBuffer.ptr, (void*)glfn.UnmapBuffer.ptr });
+	caps.map_buffer_range = caps.vbo && (caps.atLeast(3, 0) || hasGLExtension("GL_ARB_map_buffer_range")) &&
+		all({ (void*)glfn.MapBufferRange.ptr, (void*)glfn.FlushMappedBufferRange.ptr });
+	caps.pixel_buffer = caps.vbo && (caps.atLeast(2, 1) || hasGLExtension("GL_ARB_pixel_buffer_object"));
+	caps.vao = (caps.atLeast(3, 0) || hasGLExtension("GL_ARB_vertex_array_object")) &&
+		all({ (void*)glfn.GenVertexArrays.ptr, (void*)glfn.DeleteVertexArrays.ptr, (void*)glfn.BindVertexArray.ptr });
+	caps.glsl = caps.atLeast(2, 0) &&
+		all({ (void*)glfn.CreateShader.ptr, (void*)glfn.DeleteShader.ptr, (void*)glfn.ShaderSource.ptr,
+			(void*)glfn.CompileShader.ptr, (void*)glfn.GetShaderiv.ptr, (void*)glfn.GetShaderInfoLog.ptr,
+			(void*)glfn.CreateProgram.ptr, (void*)glfn.DeleteProgram.ptr, (void*)glfn.AttachShader.ptr,
+			(void*)glfn.LinkProgram.ptr, (void*)glfn.GetProgramiv.ptr, (void*)glfn.GetProgramInfoLog.ptr,
+			(void*)glfn.UseProgram.ptr, (void*)glfn.GetUniformLocation.ptr, (void*)glfn.Uniform1i.ptr });
+	caps.uniform_buffer = caps.glsl && caps.vbo && (caps.atLeast(3, 1) || hasGLExtension("GL_ARB_uniform_buffer_object")) &&
+		all({ (void*)glfn.GetUniformBlockIndex.ptr, (void*)glfn.UniformBlockBinding.ptr, (void*)glfn.BindBufferRange.ptr });
+	caps.instancing = caps.glsl && caps.vbo &&
+		(caps.atLeast(3, 3) || ((caps.atLeast(3, 1) || hasGLExtension("GL_ARB_draw_instanced")) &&
+			hasGLExtension("GL_ARB_instanced_arrays"))) &&
+		all({ (void*)glfn.GetAttribLocation.ptr, (void*)glfn.VertexAttribPointer.ptr, (void*)glfn.EnableVertexAttribArray.ptr,
+			(void*)glfn.DisableVertexAttribArray.ptr, (void*)glfn.DrawElementsInstanced.ptr, (void*)glfn.VertexAttribDivisor.ptr });
+	caps.multi_draw_indirect = caps.glsl && caps.vbo &&
+		(caps.atLeast(4, 3) || (hasGLExtension("GL_ARB_multi_draw_indirect") && hasGLExtension("GL_ARB_shader_storage_buffer_object"))) &&
+		hasGLExtension("GL_ARB_shader_draw_parameters") &&
+		all({ (void*)glfn.BindBufferBase.ptr, (void*)glfn.MultiDrawElementsIndirect.ptr });
+	caps.program_binary = caps.glsl && (caps.atLeast(4, 1) || hasGLExtension("GL_ARB_get_program_binary")) &&
+		all({ (void*)glfn.GetProgramBinary.ptr, (void*)glfn.ProgramBinary.ptr, (void*)glfn.ProgramParameteri.ptr });
+	if (caps.program_binary)
+	{
+		//расширение может быть и без единого формата - тогда сохранять нечего
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		caps.program_binary = formats > 0;
+	}
+	caps.sync = (caps.atLeast(3, 2) || hasGLExtension("GL_ARB_sync")) &&
+		all({ (void*)glfn.FenceSync.ptr, (void*)glfn.ClientWaitSync.ptr, (void*)glfn.DeleteSync.ptr });
+	caps.buffer_storage = caps.map_buffer_range && caps.sync &&
+		(caps.atLeast(4, 4) || hasGLExtension("GL_ARB_buffer_storage")) &&
+		all({ (void*)glfn.BufferStorage.ptr });
+	caps.timer_query = (caps.atLeast(3, 3) || hasGLExtension("GL_ARB_timer_query")) &&
+		all({ (void*)glfn.GenQueries.ptr, (void*)glfn.DeleteQueries.ptr, (void*)glfn.BeginQuery.ptr,
+			(void*)glfn.EndQuery.ptr, (void*)glfn.GetQueryObjectiv.ptr, (void*)glfn.QueryCounter.ptr,
+			(void*)glfn.GetQueryObjectui64v.ptr });
+
+	char buf[512];
+	snprintf(buf, sizeof(buf), "OpenGL %d.%d %s, %s (%s): vbo %d, pbo %d, vao %d, fbo %d, glsl %d, ubo %d, instancing %d, multi draw indirect %d, program binary %d, sync %d, buffer storage %d, timer query %d, s3tc %d\n",
+		caps.major, caps.minor, caps.compatibility ? "compatibility" : "core", caps.renderer.c_str(), caps.vendor.c_str(),
+		caps.vbo, caps.pixel_buffer, caps.vao, caps.fbo, caps.glsl, caps.uniform_buffer, caps.instancing, caps.multi_draw_indirect, caps.program_binary, caps.sync, caps.buffer_storage, caps.timer_query, caps.s3tc);
+	platformDebugOutput(buf);
+	return true;
+}
+
+const GLCaps& glCaps()
+{
+	return caps;
+}
+
+bool hasGLExtension(const char* name)
+{
+	return extensions.count(name) != 0;
+}
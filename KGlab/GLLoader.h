@@ -0,0 +1,282 @@
+#ifndef GLLOADER_H
+#define GLLOADER_H
+
+//Функции OpenGL новее 1.1 и возможности контекста.
+//opengl32.lib дает только OpenGL 1.1, все остальное драйвер отдает по имени.
+//loadGL() один раз после создания контекста заполняет таблицу glfn по списку GL_LOADED_FUNCTIONS
+//и флаги glCaps(), по которым рендер выбирает быстрый путь:
+//    if (glCaps().vbo)
+//        glfn.GenBuffers(1, &id);
+//Указатель может оказаться ненулевым и без поддержки (GLX отдает заглушки на любое имя),
+//поэтому проверять нужно флаги, а не указатели.
+//Вызовы через glfn считаются теми же счетчиками, что и в GLCallCount.h.
+
+#include "GLCallCount.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+//типы и константы новее 1.1 - под Windows их в gl.h нет, под Linux их дает glext.h
+#ifndef GL_VERSION_1_5
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_STREAM_DRAW 0x88E0
+#define GL_STATIC_DRAW 0x88E4
+#define GL_DYNAMIC_DRAW 0x88E8
+#define GL_WRITE_ONLY 0x88B9
+#define GL_QUERY_RESULT 0x8866
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef GL_VERSION_2_0
+typedef char GLchar;
+#define GL_FRAGMENT_SHADER 0x8B30
+#define GL_VERTEX_SHADER 0x8B31
+#define GL_COMPILE_STATUS 0x8B81
+#define GL_LINK_STATUS 0x8B82
+#define GL_INFO_LOG_LENGTH 0x8B84
+#endif
+#ifndef GL_VERSION_2_1
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_VERSION_3_0
+#define GL_MAJOR_VERSION 0x821B
+#define GL_MINOR_VERSION 0x821C
+#define GL_NUM_EXTENSIONS 0x821D
+#define GL_MAP_READ_BIT 0x0001
+#define GL_MAP_WRITE_BIT 0x0002
+#define GL_MAP_INVALIDATE_RANGE_BIT 0x0004
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#define GL_MAP_FLUSH_EXPLICIT_BIT 0x0010
+#define GL_MAP_UNSYNCHRONIZED_BIT 0x0020
+#define GL_FRAMEBUFFER 0x8D40
+#define GL_RENDERBUFFER 0x8D41
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#define GL_DEPTH_COMPONENT24 0x81A6
+#endif
+#ifndef GL_VERSION_3_1
+#define GL_UNIFORM_BUFFER 0x8A11
+#define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#define GL_INVALID_INDEX 0xFFFFFFFFu
+#endif
+#ifndef GL_VERSION_3_2
+typedef struct __GLsync* GLsync;
+typedef uint64_t GLuint64;
+typedef int64_t GLint64;
+#define GL_CONTEXT_PROFILE_MASK 0x9126
+#define GL_CONTEXT_COMPATIBILITY_PROFILE_BIT 0x00000002
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_ALREADY_SIGNALED 0x911A
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_CONDITION_SATISFIED 0x911C
+#define GL_WAIT_FAILED 0x911D
+#endif
+#ifndef GL_VERSION_3_3
+#define GL_TIME_ELAPSED 0x88BF
+#define GL_TIMESTAMP 0x8E28
+#endif
+#ifndef GL_VERSION_4_0
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_VERSION_4_3
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+
+//Список функций: X(результат, имя без gl, параметры, рисующая ли).
+//Если функции нет под своим именем, ищется с суффиксом ARB, потом EXT
+#define GL_LOADED_FUNCTIONS(X) \
+	/* 1.3 */ \
+	X(void, CompressedTexImage2D, (GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, \
+		GLint border, GLsizei size, const void* data), false) \
+	/* 1.5: буферы и запросы */ \
+	X(void, GenBuffers, (GLsizei n, GLuint* buffers), false) \
+	X(void, DeleteBuffers, (GLsizei n, const GLuint* buffers), false) \
+	X(void, BindBuffer, (GLenum target, GLuint buffer), false) \
+	X(void, BufferData, (GLenum target, GLsizeiptr size, const void* data, GLenum usage), false) \
+	X(void, BufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data), false) \
+	X(void*, MapBuffer, (GLenum target, GLenum access), false) \
+	X(GLboolean, UnmapBuffer, (GLenum target), false) \
+	X(void, GenQueries, (GLsizei n, GLuint* ids), false) \
+	X(void, DeleteQueries, (GLsizei n, const GLuint* ids), false) \
+	X(void, BeginQuery, (GLenum target, GLuint id), false) \
+	X(void, EndQuery, (GLenum target), false) \
+	X(void, GetQueryObjectiv, (GLuint id, GLenum pname, GLint* params), false) \
+	/* 2.0: шейдеры */ \
+	X(GLuint, CreateShader, (GLenum type), false) \
+	X(void, DeleteShader, (GLuint shader), false) \
+	X(void, ShaderSource, (GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths), false) \
+	X(void, CompileShader, (GLuint shader), false) \
+	X(void, GetShaderiv, (GLuint shader, GLenum pname, GLint* params), false) \
+	X(void, GetShaderInfoLog, (GLuint shader, GLsizei size, GLsizei* length, GLchar* log), false) \
+	X(GLuint, CreateProgram, (), false) \
+	X(void, DeleteProgram, (GLuint program), false) \
+	X(void, AttachShader, (GLuint program, GLuint shader), false) \
+	X(void, LinkProgram, (GLuint program), false) \
+	X(void, GetProgramiv, (GLuint program, GLenum pname, GLint* params), false) \
+	X(void, GetProgramInfoLog, (GLuint program, GLsizei size, GLsizei* length, GLchar* log), false) \
+	X(void, UseProgram, (GLuint program), false) \
+	X(GLint, GetUniformLocation, (GLuint program, const GLchar* name), false) \
+	X(void, Uniform1i, (GLint location, GLint value), false) \
+	X(GLint, GetAttribLocation, (GLuint program, const GLchar* name), false) \
+	X(void, VertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, \
+		const void* pointer), false) \
+	X(void, EnableVertexAttribArray, (GLuint index), false) \
+	X(void, DisableVertexAttribArray, (GLuint index), false) \
+	/* 3.0: FBO, VAO, отображение части буфера */ \
+	X(const GLubyte*, GetStringi, (GLenum name, GLuint index), false) \
+	X(void, GenerateMipmap, (GLenum target), false) \
+	X(void, GenFramebuffers, (GLsizei n, GLuint* ids), false) \
+	X(void, DeleteFramebuffers, (GLsizei n, const GLuint* ids), false) \
+	X(void, BindFramebuffer, (GLenum target, GLuint id), false) \
+	X(GLenum, CheckFramebufferStatus, (GLenum target), false) \
+	X(void, FramebufferRenderbuffer, (GLenum target, GLenum attachment, GLenum rb_target, GLuint rb), false) \
+	X(void, GenRenderbuffers, (GLsizei n, GLuint* ids), false) \
+	X(void, DeleteRenderbuffers, (GLsizei n, const GLuint* ids), false) \
+	X(void, BindRenderbuffer, (GLenum target, GLuint id), false) \
+	X(void, RenderbufferStorage, (GLenum target, GLenum format, GLsizei width, GLsizei height), false) \
+	X(void, GenVertexArrays, (GLsizei n, GLuint* arrays), false) \
+	X(void, DeleteVertexArrays, (GLsizei n, const GLuint* arrays), false) \
+	X(void, BindVertexArray, (GLuint array), false) \
+	X(void*, MapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), false) \
+	X(void, FlushMappedBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length), false) \
+	/* 3.1: буферы uniform */ \
+	X(GLuint, GetUniformBlockIndex, (GLuint program, const GLchar* name), false) \
+	X(void, UniformBlockBinding, (GLuint program, GLuint block, GLuint binding), false) \
+	X(void, BindBufferRange, (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size), false) \
+	X(void, BindBufferBase, (GLenum target, GLuint index, GLuint buffer), false) \
+	X(void, DrawElementsInstanced, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances), true) \
+	/* 3.2: синхронизация с видеокартой */ \
+	X(GLsync, FenceSync, (GLenum condition, GLbitfield flags), false) \
+	X(GLenum, ClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout), false) \
+	X(void, DeleteSync, (GLsync sync), false) \
+	/* 3.3: время на видеокарте */ \
+	X(void, QueryCounter, (GLuint id, GLenum target), false) \
+	X(void, GetQueryObjectui64v, (GLuint id, GLenum pname, GLuint64* params), false) \
+	X(void, VertexAttribDivisor, (GLuint index, GLuint divisor), false) \
+	/* 4.1: готовые программы */ \
+	X(void, GetProgramBinary, (GLuint program, GLsizei size, GLsizei* length, GLenum* format, void* binary), false) \
+	X(void, ProgramBinary, (GLuint program, GLenum format, const void* binary, GLsizei length), false) \
+	X(void, ProgramParameteri, (GLuint program, GLenum pname, GLint value), false) \
+	/* 4.3: много отрисовок одним вызовом */ \
+	X(void, MultiDrawElementsIndirect, (GLenum mode, GLenum type, const void* indirect, GLsizei count, GLsizei stride), true) \
+	/* 4.4: неизменяемые буферы */ \
+	X(void, BufferStorage, (GLenum target, GLsizeiptr size, const void* data, GLbitfield flags), false)
+
+
+//Указатель на функцию драйвера, вызов которого попадает в счетчик
+template<class Signature>
+struct GLFunction;
+
+template<class R, class... Args>
+struct GLFunction<R(Args...)>
+{
+	typedef R(APIENTRY* Pointer)(Args...);
+
+	GLCallCounter* counter;
+	Pointer ptr = nullptr;
+
+	R operator()(Args... args) const
+	{
+		++counter->count;
+		return ptr(args...);
+	}
+};
+
+#define GL_LOADED_COUNTER(ret, name, params, draw) GL_COUNTER(gl##name, draw)
+GL_LOADED_FUNCTIONS(GL_LOADED_COUNTER)
+#undef GL_LOADED_COUNTER
+
+struct GLFunctions
+{
+#define GL_LOADED_MEMBER(ret, name, params, draw) GLFunction<ret params> name{ &gl_count_gl##name };
+	GL_LOADED_FUNCTIONS(GL_LOADED_MEMBER)
+#undef GL_LOADED_MEMBER
+};
+
+extern GLFunctions glfn;
+
+
+//что умеет текущий контекст
+struct GLCaps
+{
+	//версия, которую реально дали (может быть выше запрошенной)
+	int major = 1;
+	int minor = 1;
+	bool compatibility = true;
+	std::string vendor;
+	std::string renderer;
+	std::string version;
+
+	//GL_MAX_TEXTURE_SIZE, 0 - контекста не было
+	int max_texture_size = 0;
+	//glCompressedTexImage2D (1.3)
+	bool compressed_textures = false;
+	//BC1/BC3 (GL_EXT_texture_compression_s3tc)
+	bool s3tc = false;
+	//GL_EXT_texture_filter_anisotropic
+	bool anisotropy = false;
+	float max_anisotropy = 1;
+	//glGenerateMipmap (3.0, GL_ARB_framebuffer_object или GL_EXT_framebuffer_object)
+	bool generate_mipmap = false;
+	//буферы вершин (1.5)
+	bool vbo = false;
+	//glMapBufferRange (3.0, GL_ARB_map_buffer_range)
+	bool map_buffer_range = false;
+	//буферы пикселей: glTexImage2D из буфера OpenGL (2.1, GL_ARB_pixel_buffer_object)
+	bool pixel_buffer = false;
+	//шейдеры GLSL (2.0)
+	bool glsl = false;
+	//буферы uniform (3.1, GL_ARB_uniform_buffer_object)
+	bool uniform_buffer = false;
+	//glDrawElementsInstanced (3.1, GL_ARB_draw_instanced) и атрибуты на копию -
+	//glVertexAttribDivisor (3.3, GL_ARB_instanced_arrays)
+	bool instancing = false;
+	//glMultiDrawElementsIndirect (4.3, GL_ARB_multi_draw_indirect), буферы хранения в шейдере
+	//(4.3, GL_ARB_shader_storage_buffer_object) и gl_DrawIDARB (GL_ARB_shader_draw_parameters)
+	bool multi_draw_indirect = false;
+	//glGetProgramBinary/glProgramBinary (4.1, GL_ARB_get_program_binary) и хотя бы один формат
+	bool program_binary = false;
+	//FBO (3.0, GL_ARB_framebuffer_object или GL_EXT_framebuffer_object)
+	bool fbo = false;
+	//VAO (3.0, GL_ARB_vertex_array_object)
+	bool vao = false;
+	//glFenceSync (3.2, GL_ARB_sync)
+	bool sync = false;
+	//glBufferStorage (4.4, GL_ARB_buffer_storage) - буфер, отображенный в память насовсем;
+	//вместе с glMapBufferRange и sync, без них такой буфер не из чего собрать
+	bool buffer_storage = false;
+	//glQueryCounter и GL_TIME_ELAPSED (3.3, GL_ARB_timer_query)
+	bool timer_query = false;
+
+	bool atLeast(int maj, int min) const
+	{
+		return major > maj || (major == maj && minor >= min);
+	}
+};
+
+//Грузит функции и заполняет glCaps() для текущего контекста.
+//Вызывать из потока рендера сразу после platformCreateContext, false - контекста нет
+bool loadGL();
+const GLCaps& glCaps();
+
+//есть ли расширение у текущего контекста (список читается в loadGL)
+bool hasGLExtension(const char* name);
+
+#endif
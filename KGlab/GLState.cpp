@@ -0,0 +1,319 @@
+#include "GLState.h"
+
+#include <cstring>
+
+GLStateCache glState;
+
+namespace
+{
+	int materialIndex(GLenum pname)
+	{
+		switch (pname)
+		{
+		case GL_AMBIENT: return 0;
+		case GL_DIFFUSE: return 1;
+		case GL_SPECULAR: return 2;
+		case GL_EMISSION: return 3;
+		case GL_SHININESS: return 4;
+		default: return -1;
+		}
+	}
+
+	int lightIndex(GLenum pname)
+	{
+		switch (pname)
+		{
+		case GL_AMBIENT: return 0;
+		case GL_DIFFUSE: return 1;
+		case GL_SPECULAR: return 2;
+		default: return -1;
+		}
+	}
+}
+
+
+bool GLStateCache::change(Vec4& slot, const GLfloat* values, int n)
+{
+	if (slot.known && memcmp(slot.v, values, n * sizeof(GLfloat)) == 0)
+		return false;
+	slot.known = true;
+	memcpy(slot.v, values, n * sizeof(GLfloat));
+	return true;
+}
+
+template<class T>
+bool GLStateCache::change(bool& known, T& slot, T value)
+{
+	if (known && slot == value)
+	{
+		++elided_count;
+		return false;
+	}
+	known = true;
+	slot = value;
+	issue();
+	return true;
+}
+
+GLStateCache::Cap* GLStateCache::findCap(GLenum cap)
+{
+	for (int i = 0; i < caps_count; ++i)
+		if (caps[i].cap == cap)
+			return &caps[i];
+	if (caps_count == sizeof(caps) / sizeof(caps[0]))
+		return nullptr;
+	caps[caps_count] = { cap, Unknown };
+	return &caps[caps_count++];
+}
+
+
+void GLStateCache::setEnabled(GLenum cap, bool on)
+{
+	Cap* c = findCap(cap);
+	Known state = on ? On : Off;
+	if (c && c->state == state)
+	{
+		++elided_count;
+		return;
+	}
+	if (c)
+		c->state = state;
+	//дальше материал меняет glColor - запомненный уже не верен
+	if (cap == GL_COLOR_MATERIAL && on)
+		for (auto& f : materials)
+			for (auto& m : f)
+				m.known = false;
+	issue();
+	if (on)
+		glEnable(cap);
+	else
+		glDisable(cap);
+}
+
+bool GLStateCache::isEnabled(GLenum cap)
+{
+	Cap* c = findCap(cap);
+	if (c && c->state != Unknown)
+	{
+		++elided_count;
+		return c->state == On;
+	}
+	++issued_count;
+	bool on = glIsEnabled(cap) == GL_TRUE;
+	if (c)
+		c->state = on ? On : Off;
+	return on;
+}
+
+void GLStateCache::bindTexture(GLuint id)
+{
+	if (change(texture_known, texture, id))
+		glBindTexture(GL_TEXTURE_2D, id);
+}
+
+void GLStateCache::deleteTextures(GLsizei n, const GLuint* ids)
+{
+	for (GLsizei i = 0; i < n; ++i)
+		if (texture_known && ids[i] == texture && texture != 0)
+			texture = 0;
+	issue();
+	glDeleteTextures(n, ids);
+}
+
+void GLStateCache::blendFunc(GLenum src, GLenum dst)
+{
+	if (blend_known && blend_src == src && blend_dst == dst)
+	{
+		++elided_count;
+		return;
+	}
+	blend_known = true;
+	blend_src = src;
+	blend_dst = dst;
+	issue();
+	glBlendFunc(src, dst);
+}
+
+void GLStateCache::shadeModel(GLenum mode)
+{
+	if (change(shade_known, shade, mode))
+		glShadeModel(mode);
+}
+
+void GLStateCache::texEnvMode(GLenum mode)
+{
+	if (change(tex_env_known, tex_env, mode))
+		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, (GLint)mode);
+}
+
+void GLStateCache::material(GLenum face, GLenum pname, const GLfloat* params)
+{
+	//GL_COLOR_MATERIAL меняет материал через glColor - тут его не уследить
+	//(сам этот запрос в счетчики не идет - иначе каждый материал считался бы дважды)
+	Cap* color_material = findCap(GL_COLOR_MATERIAL);
+	if (color_material && color_material->state == Unknown)
+		color_material->state = glIsEnabled(GL_COLOR_MATERIAL) == GL_TRUE ? On : Off;
+	bool tracked = color_material && color_material->state == Off;
+
+	if (pname == GL_AMBIENT_AND_DIFFUSE && tracked)
+	{
+		bool ambient = false, diffuse = false;
+		for (int f = 0; f < 2; ++f)
+			if (face == GL_FRONT_AND_BACK || face == (f ? GL_BACK : GL_FRONT))
+			{
+				ambient |= change(materials[f][0], params, 4);
+				diffuse |= change(materials[f][1], params, 4);
+			}
+		if (!ambient && !diffuse)
+		{
+			++elided_count;
+			return;
+		}
+		issue();
+		glMaterialfv(face, pname, params);
+		return;
+	}
+
+	int index = materialIndex(pname);
+	if (index < 0 || !tracked)
+	{
+		for (auto& f : materials)
+			for (auto& m : f)
+				m.known = false;
+		issue();
+		glMaterialfv(face, pname, params);
+		return;
+	}
+
+	int n = pname == GL_SHININESS ? 1 : 4;
+	bool changed = false;
+	for (int f = 0; f < 2; ++f)
+		if (face == GL_FRONT_AND_BACK || face == (f ? GL_BACK : GL_FRONT))
+			changed |= change(materials[f][index], params, n);
+	if (!changed)
+	{
+		++elided_count;
+		return;
+	}
+	issue();
+	if (n == 1)
+		glMaterialf(face, pname, params[0]);
+	else
+		glMaterialfv(face, pname, params);
+}
+
+void GLStateCache::light(GLenum light, GLenum pname, const GLfloat* params)
+{
+	int l = (int)light - GL_LIGHT0;
+	int index = lightIndex(pname);
+	if (l >= 0 && l < LIGHTS && index >= 0)
+	{
+		if (!change(lights[l][index], params, 4))
+		{
+			++elided_count;
+			return;
+		}
+	}
+	issue();
+	glLightfv(light, pname, params);
+}
+
+void GLStateCache::setPointSize(float size)
+{
+	if (change(point_known, point_size, size))
+		glPointSize(size);
+}
+
+float GLStateCache::pointSize()
+{
+	if (point_known)
+	{
+		++elided_count;
+		return point_size;
+	}
+	++issued_count;
+	glGetFloatv(GL_POINT_SIZE, &point_size);
+	point_known = true;
+	return point_size;
+}
+
+void GLStateCache::setLineWidth(float width)
+{
+	if (change(line_known, line_width, width))
+		glLineWidth(width);
+}
+
+float GLStateCache::lineWidth()
+{
+	if (line_known)
+	{
+		++elided_count;
+		return line_width;
+	}
+	++issued_count;
+	glGetFloatv(GL_LINE_WIDTH, &line_width);
+	line_known = true;
+	return line_width;
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei w, GLsizei h)
+{
+	GLint v[4] = { x, y, w, h };
+	if (viewport_known && memcmp(v, viewport_v, sizeof(v)) == 0)
+	{
+		++elided_count;
+		return;
+	}
+	viewport_known = true;
+	memcpy(viewport_v, v, sizeof(v));
+	issue();
+	glViewport(x, y, w, h);
+}
+
+void GLStateCache::getViewport(GLint v[4])
+{
+	if (viewport_known)
+		++elided_count;
+	else
+	{
+		++issued_count;
+		glGetIntegerv(GL_VIEWPORT, viewport_v);
+		viewport_known = true;
+	}
+	memcpy(v, viewport_v, sizeof(viewport_v));
+}
+
+void GLStateCache::useProgram(GLuint id)
+{
+	if (change(program_known, program, id))
+		glfn.UseProgram(id);
+}
+
+void GLStateCache::uniformBuffer(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	UniformBinding* b = index < UNIFORM_BINDINGS ? &uniform_bindings[index] : nullptr;
+	if (b && b->known && b->buffer == buffer && b->offset == offset && b->size == size)
+	{
+		++elided_count;
+		return;
+	}
+	if (b)
+		*b = { true, buffer, offset, size };
+	issue();
+	glfn.BindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+}
+
+void GLStateCache::invalidate()
+{
+	caps_count = 0;
+	texture_known = blend_known = shade_known = tex_env_known = false;
+	point_known = line_known = viewport_known = program_known = false;
+	for (auto& b : uniform_bindings)
+		b.known = false;
+	for (auto& f : materials)
+		for (auto& m : f)
+			m.known = false;
+	for (auto& l : lights)
+		for (auto& p : l)
+			p.known = false;
+}
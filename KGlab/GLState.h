@@ -0,0 +1,172 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+//Тень состояния OpenGL.
+//Каждый кадр рендер заново включает свет, текстуры, смешивание, ставит материал и т.п.,
+//хотя обычно оно уже такое и есть. Драйвер на каждый такой вызов проверяет состояние
+//и часто помечает его "грязным", а glGet/glIsEnabled вообще ждут поток драйвера.
+//GLStateCache помнит, что уже выставлено, и пропускает повторы, а запросы отвечает сам:
+//    glState.enable(GL_LIGHTING);     //вместо glEnable
+//    glState.bindTexture(id);         //вместо glBindTexture(GL_TEXTURE_2D, id)
+//    float s = glState.pointSize();   //вместо glGetFloatv(GL_POINT_SIZE, &s)
+//Пока значение не выставлялось через кэш, оно считается неизвестным и первый вызов идет в GL.
+//Если что-то меняет это состояние в обход кэша (glPushAttrib/glPopAttrib, чужой код),
+//после него нужен invalidate(). Внутри glNewList/glEndList кэш не использовать:
+//там вызовы записываются в список, а не выполняются.
+//Позиция и направление света зависят от текущей матрицы, поэтому не кэшируются.
+//Только поток рендера.
+
+#include "GLCallCount.h"
+#include "GLLoader.h"
+
+class GLStateCache
+{
+public:
+
+	void enable(GLenum cap)
+	{
+		setEnabled(cap, true);
+	}
+	void disable(GLenum cap)
+	{
+		setEnabled(cap, false);
+	}
+	void setEnabled(GLenum cap, bool on);
+	bool isEnabled(GLenum cap);
+
+	//только GL_TEXTURE_2D первого текстурного блока
+	void bindTexture(GLuint id);
+	//glDeleteTextures; удаление текущей текстуры сбрасывает привязку на 0
+	void deleteTextures(GLsizei n, const GLuint* ids);
+
+	void blendFunc(GLenum src, GLenum dst);
+	void shadeModel(GLenum mode);
+	//GL_TEXTURE_ENV_MODE
+	void texEnvMode(GLenum mode);
+
+	//GL_AMBIENT, GL_DIFFUSE, GL_SPECULAR, GL_EMISSION, GL_SHININESS, GL_AMBIENT_AND_DIFFUSE;
+	//остальное (и все при включенном GL_COLOR_MATERIAL) уходит в GL как есть
+	void material(GLenum face, GLenum pname, const GLfloat* params);
+	void material(GLenum face, GLenum pname, GLfloat param)
+	{
+		material(face, pname, &param);
+	}
+	//GL_AMBIENT, GL_DIFFUSE, GL_SPECULAR источников GL_LIGHT0..7; остальное - в GL как есть
+	void light(GLenum light, GLenum pname, const GLfloat* params);
+
+	void setPointSize(float size);
+	float pointSize();
+	void setLineWidth(float width);
+	float lineWidth();
+
+	void viewport(GLint x, GLint y, GLsizei w, GLsizei h);
+	void getViewport(GLint v[4]);
+
+	//glUseProgram (0 - фиксированный конвейер)
+	void useProgram(GLuint program);
+	//glBindBufferRange(GL_UNIFORM_BUFFER, ...) для точек привязки 0..UNIFORM_BINDINGS-1
+	void uniformBuffer(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	//все забыть: новый контекст или состояние менялось в обход кэша
+	void invalidate();
+
+	//вызывается прямо перед каждым изменением, которое дойдет до GL
+	//(рекордер ImmediateBatch так рисует накопленное со старым состоянием)
+	void setBeforeChange(void (*hook)())
+	{
+		before_change = hook;
+	}
+
+	//вызовы и запросы, дошедшие до GL и отвеченные кэшем, с последнего resetCounters()
+	unsigned long long issued() const
+	{
+		return issued_count;
+	}
+	unsigned long long elided() const
+	{
+		return elided_count;
+	}
+	void resetCounters()
+	{
+		issued_count = elided_count = 0;
+	}
+
+private:
+
+	//значение не известно - первый вызов обязательно идет в GL
+	enum Known : signed char { Unknown = -1, Off = 0, On = 1 };
+
+	struct Cap
+	{
+		GLenum cap;
+		Known state;
+	};
+
+	//сколько параметров материала и света помнится
+	static const int MATERIAL_PARAMS = 5;
+	static const int LIGHTS = 8;
+	static const int LIGHT_PARAMS = 3;
+	static const int UNIFORM_BINDINGS = 4;
+
+	struct Vec4
+	{
+		bool known = false;
+		GLfloat v[4];
+	};
+
+	//true - значение поменялось (или было неизвестно) и вызов нужен
+	bool change(Vec4& slot, const GLfloat* values, int n);
+	template<class T>
+	bool change(bool& known, T& slot, T value);
+
+	//включенные возможности: их немного, поиск подряд быстрее хэша
+	Cap caps[32];
+	int caps_count = 0;
+	Cap* findCap(GLenum cap);
+
+	bool texture_known = false;
+	GLuint texture = 0;
+	bool blend_known = false;
+	GLenum blend_src = 0, blend_dst = 0;
+	bool shade_known = false;
+	GLenum shade = 0;
+	bool tex_env_known = false;
+	GLenum tex_env = 0;
+	bool point_known = false;
+	float point_size = 1;
+	bool line_known = false;
+	float line_width = 1;
+	bool viewport_known = false;
+	GLint viewport_v[4] = {};
+	bool program_known = false;
+	GLuint program = 0;
+
+	struct UniformBinding
+	{
+		bool known = false;
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+	UniformBinding uniform_bindings[UNIFORM_BINDINGS];
+
+	//[0] - GL_FRONT, [1] - GL_BACK
+	Vec4 materials[2][MATERIAL_PARAMS];
+	Vec4 lights[LIGHTS][LIGHT_PARAMS];
+
+	void (*before_change)() = nullptr;
+	//изменение уходит в GL
+	void issue()
+	{
+		++issued_count;
+		if (before_change)
+			before_change();
+	}
+
+	unsigned long long issued_count = 0;
+	unsigned long long elided_count = 0;
+};
+
+extern GLStateCache glState;
+
+#endif
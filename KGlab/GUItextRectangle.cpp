@@ -1,29 +1,29 @@
 ﻿#include "GUItextRectangle.h"
 #include <algorithm>
 
-#include <windows.h>
-#include <gl\GL.h>
+#include "GLCallCount.h"
+#include "GLState.h"
+#include "ImmediateBatch.h"
 
 class GuiTextRectanglePrivate
 {
 public:
-	HBITMAP bitmap;
+	//текст рисует ОС, отсюда берем маску
+	TextRaster raster;
 	int w;
 	int h;
-	HDC dc;
 	
 	int pos_x;
 	int pos_y;
 	
-	unsigned char *b;
 	unsigned char *_tmp;
 
 	GLuint tex_id;
-	tagRECT r;
 
 	GuiTextRectanglePrivate()
 	{
 		_tmp = nullptr;
+		tex_id = 0;
 	}
 
 };
@@ -34,60 +34,44 @@ public:
 GuiTextRectangle::GuiTextRectangle()
 {
 	d_ptr = new GuiTextRectanglePrivate;
-	d_func()->r.top = 0;
-	d_func()->r.left = 0;
 }
 
 GuiTextRectangle::~GuiTextRectangle()
 {
-	glDeleteTextures(1, &d_func()->tex_id);
-	DeleteObject(d_func()->bitmap);
-	DeleteDC(d_func()->dc);
-	delete d_func()->_tmp;
+	release();
+	delete[] d_func()->_tmp;
 	delete d_ptr;
 }
 
-void GuiTextRectangle::setSize(int width, int height)
+void GuiTextRectangle::release()
 {
 	GuiTextRectanglePrivate *_d = d_func();
-	
-	
-	DeleteObject(d_func()->bitmap);
+	if (_d->tex_id)
+		glState.deleteTextures(1, &_d->tex_id);
+	_d->tex_id = 0;
+}
 
-	//повнимательнее проверить!!!!
+void GuiTextRectangle::setSize(int width, int height)
+{
+	GuiTextRectanglePrivate *_d = d_func();
 	
 	_d->h = height;
 	_d->w = width;
 
-
-	_d->dc = CreateCompatibleDC(0);
-
-	BITMAPINFOHEADER binfo;
-	memset(&binfo, 0, sizeof(BITMAPINFOHEADER));
-
-	binfo.biBitCount = 32;
-	binfo.biWidth = width;
-	binfo.biHeight = height;
-	binfo.biSize = sizeof(binfo);
-	binfo.biPlanes = 1;
-	binfo.biCompression = BI_RGB;
-
-	
-	_d->bitmap = CreateDIBSection(0, (BITMAPINFO*)&binfo, DIB_RGB_COLORS, (void**)&(_d->b), 0, 0);
-	SelectObject(_d->dc, _d->bitmap);
+	_d->raster.init(width, height, L"Consolas", 16, true);
 
 	if (_d->_tmp!=nullptr)
-		delete _d->_tmp;
+		delete[] _d->_tmp;
 	_d->_tmp = new unsigned char[_d->w*_d->h * 4];
 	
 
 	//прямоугольник для текста
 
 
-	glDeleteTextures(1, &(_d->tex_id));
+	glState.deleteTextures(1, &(_d->tex_id));
 	glGenTextures(1, &(_d->tex_id));
 
-	glBindTexture(GL_TEXTURE_2D, _d->tex_id);
+	glState.bindTexture(_d->tex_id);
 
 	
 
@@ -122,51 +106,27 @@ void GuiTextRectangle::setPosition(int x, int y)
 void GuiTextRectangle::setText(const wchar_t* text, char r, char g , char b )
 {
 	GuiTextRectanglePrivate *_d = d_func();
-	_d->r.right = _d->w;
-	_d->r.bottom = _d->h;
-
-	std::fill<byte*, byte>((byte*)(_d->b), (byte*)(_d->b) + _d->w * _d->h * 4, (byte)255);
-	//std::fill<byte*, byte>((byte*)(_d->_tmp), (byte*)(_d->_tmp) + _d->w * _d->h * 4, (byte)0);
-
-	SetBkColor(_d->dc, RGB(255, 255, 255));
-	SetTextColor(_d->dc, RGB(r, g, b));
-	
-
-	HFONT hFont = CreateFont(
-		16, 0, 0, 0, FW_HEAVY, FALSE, FALSE, FALSE,
-		DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-		DEFAULT_QUALITY, DEFAULT_PITCH, L"Consolas");
-
-	SelectObject(_d->dc, hFont);
 
 	//рисуем текст
-	DrawText(_d->dc, text, -1, &(_d->r), 0);
-
-	DeleteObject(hFont);
-
-	glBindTexture(GL_TEXTURE_2D, _d->tex_id);
+	_d->raster.clear();
+	_d->raster.draw(text, 0, 0);
+	const unsigned char* mask = _d->raster.mask();
 
+	glState.bindTexture(_d->tex_id);
 
+	//Как будто текст цвета (r, g, b) нарисован по белому фону:
+	//фон прозрачный, все остальное - непрозрачное.
+	//Маска идет сверху вниз, а строка 0 текстуры - низ прямоугольника
 	unsigned char *_tmp = _d->_tmp;
 	for (int i = 0; i < _d->h; ++i)
 		for (int j = 0; j < _d->w; ++j)
 		{
-			*(_tmp + i*_d->w * 4 + j * 4 + 0) = *(_d->b + i*_d->w * 4 + j * 4 + 0);
-			*(_tmp + i*_d->w * 4 + j * 4 + 1) = *(_d->b + i*_d->w * 4 + j * 4 + 1);
-			*(_tmp + i*_d->w * 4 + j * 4 + 2) = *(_d->b + i*_d->w * 4 + j * 4 + 2);
-
-			//*(_tmp + i * _d->w * 4 + j * 4 + 3) = 255 - *(_tmp + i * _d->w * 4 + j * 4 + 0) * 0.333 +
-			//	*(_tmp + i * _d->w * 4 + j * 4 + 1) * 0.333 +
-			//	*(_tmp + i * _d->w * 4 + j * 4 + 2) * 0.333;
-
-
-			if (*(_d->b + i*_d->w * 4 + j * 4 + 0) == 255 &&
-				*(_d->b + i*_d->w * 4 + j * 4 + 1) == 255 &&
-				*(_d->b + i*_d->w * 4 + j * 4 + 2) == 255)
-				
-				*(_tmp + i*_d->w * 4 + j * 4 + 3) = 0;
-			else
-				*(_tmp + i*_d->w * 4 + j * 4 + 3) = 255;
+			int a = mask[(_d->h - 1 - i) * _d->w + j];
+			unsigned char *p = _tmp + i*_d->w * 4 + j * 4;
+			p[0] = (unsigned char)(255 - (255 - (unsigned char)r) * a / 255);
+			p[1] = (unsigned char)(255 - (255 - (unsigned char)g) * a / 255);
+			p[2] = (unsigned char)(255 - (255 - (unsigned char)b) * a / 255);
+			p[3] = a ? 255 : 0;
 		}
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, _d->w, _d->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, _tmp);
 	
@@ -177,38 +137,46 @@ void GuiTextRectangle::setText(const wchar_t* text, char r, char g , char b )
 void GuiTextRectangle::Draw()
 {
 	GuiTextRectanglePrivate *_d = d_func();
-	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	glState.texEnvMode(GL_MODULATE);
 												  // 
 	
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glState.enable(GL_BLEND);
+	glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	glDisable(GL_LIGHTING);
-	bool _b = glIsEnabled(GL_TEXTURE_2D);
+	glState.disable(GL_LIGHTING);
+	bool _b = glState.isEnabled(GL_TEXTURE_2D);
 	
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, _d->tex_id);
+	glState.enable(GL_TEXTURE_2D);
+	glState.bindTexture(_d->tex_id);
+
+	//четырехугольник - через imm и потоковый буфер, как остальной HUD
+	unsigned attributes = imm.enabledAttributes();
+	imm.setAttributes(ImmediateBatch::Colors | ImmediateBatch::TexCoords);
+
+	imm.color4d(1, 1, 1, 1);
+	imm.begin(GL_QUADS);
 
-	glColor4d(1, 1, 1, 1);
-	glBegin(GL_QUADS);
+	imm.texCoord2d(0, 0);
+	imm.vertex2d(_d->pos_x, _d->pos_y);
 
-	glTexCoord2d(0, 0);
-	glVertex2d(_d->pos_x, _d->pos_y);
+	imm.texCoord2d(0, 1);
+	imm.vertex2d(_d->pos_x, _d->pos_y+_d->h);
 
-	glTexCoord2d(0, 1);
-	glVertex2d(_d->pos_x, _d->pos_y+_d->h);
+	imm.texCoord2d(1, 1);
+	imm.vertex2d(_d->pos_x + _d->w, _d->pos_y+_d->h);
 
-	glTexCoord2d(1, 1);
-	glVertex2d(_d->pos_x + _d->w, _d->pos_y+_d->h);
+	imm.texCoord2d(1, 0);
+	imm.vertex2d(_d->pos_x + _d->w, _d->pos_y);
 
-	glTexCoord2d(1, 0);
-	glVertex2d(_d->pos_x + _d->w, _d->pos_y);
+	imm.end();
 
-	glEnd();
+	//текстуру перезаливает setText - рисуем, пока в ней этот текст
+	imm.setAttributes(attributes);
+	imm.flush();
 
 	if (!_b)
-		glDisable(GL_TEXTURE_2D);
+		glState.disable(GL_TEXTURE_2D);
 
-	glDisable(GL_BLEND);
+	glState.disable(GL_BLEND);
 }
 
@@ -25,6 +25,9 @@ public:
 	void setText(const wchar_t* text, char r = 0, char g = 0, char b = 0);
 
 	void Draw();
+
+	//удаляет текстуру, пока контекст OpenGL еще жив
+	void release();
 };
 
 
@@ -0,0 +1,680 @@
+#include "Headless.h"
+
+#include "GLLoader.h"
+#include "GLState.h"
+#include "DisplayListCache.h"
+#include "ImmediateBatch.h"
+#include "ProgramCache.h"
+#include "MeshArena.h"
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchmarkScript.h"
+#include "InputJournal.h"
+#include "MyOGL.h"
+#include "Render.h"
+#include "Texture.h"
+
+extern OpenGL gl;
+
+namespace
+{
+	//цель рендера: цвет RGBA8 и глубина 24 бита
+	struct Framebuffer
+	{
+		GLuint fbo = 0;
+		GLuint color = 0;
+		GLuint depth = 0;
+
+		bool create(int width, int height)
+		{
+			if (!glCaps().fbo)
+				return false;
+
+			glfn.GenRenderbuffers(1, &color);
+			glfn.BindRenderbuffer(GL_RENDERBUFFER, color);
+			glfn.RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+			glfn.GenRenderbuffers(1, &depth);
+			glfn.BindRenderbuffer(GL_RENDERBUFFER, depth);
+			glfn.RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+			glfn.GenFramebuffers(1, &fbo);
+			glfn.BindFramebuffer(GL_FRAMEBUFFER, fbo);
+			glfn.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+			glfn.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+			return glfn.CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		}
+
+		void destroy()
+		{
+			if (!glCaps().fbo)
+				return;
+			glfn.BindFramebuffer(GL_FRAMEBUFFER, 0);
+			if (fbo)
+				glfn.DeleteFramebuffers(1, &fbo);
+			if (color)
+				glfn.DeleteRenderbuffers(1, &color);
+			if (depth)
+				glfn.DeleteRenderbuffers(1, &depth);
+			fbo = color = depth = 0;
+		}
+	};
+
+	//значение, ниже которого доля p отсортированных замеров
+	double percentile(const std::vector<double>& sorted, double p)
+	{
+		if (sorted.empty())
+			return 0;
+		size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(i, sorted.size() - 1)];
+	}
+
+	std::string jsonString(const char* s)
+	{
+		std::string out = "\"";
+		for (; s && *s; ++s)
+		{
+			if (*s == '"' || *s == '\\')
+				out += '\\';
+			if ((unsigned char)*s >= 0x20)
+				out += *s;
+		}
+		return out + "\"";
+	}
+
+	std::string format(const char* fmt, double v)
+	{
+		char buf[64];
+		snprintf(buf, sizeof(buf), fmt, v);
+		return buf;
+	}
+
+	bool parseInt(const std::string& s, int& v)
+	{
+		char* end = nullptr;
+		long x = strtol(s.c_str(), &end, 10);
+		if (s.empty() || *end)
+			return false;
+		v = (int)x;
+		return true;
+	}
+
+	bool parseDouble(const std::string& s, double& v)
+	{
+		char* end = nullptr;
+		v = strtod(s.c_str(), &end);
+		return !s.empty() && !*end;
+	}
+
+	//имя снимка по шаблону --capture-path. Шаблон приходит из командной строки,
+	//поэтому в snprintf его не отдаем, а разбираем сами: ровно один номер кадра
+	//%d (можно с шириной: %4d, %04d), %% - сам знак процента. false - шаблон не такой
+	bool capturePath(const std::string& pattern, int frame, std::string& path)
+	{
+		path.clear();
+		int numbers = 0;
+		for (size_t i = 0; i < pattern.size(); ++i)
+		{
+			if (pattern[i] != '%')
+			{
+				path += pattern[i];
+				continue;
+			}
+			if (++i < pattern.size() && pattern[i] == '%')
+			{
+				path += '%';
+				continue;
+			}
+			bool zeros = i < pattern.size() && pattern[i] == '0';
+			size_t width = 0;
+			for (; i < pattern.size() && isdigit((unsigned char)pattern[i]); ++i)
+				width = width * 10 + (pattern[i] - '0');
+			if (i == pattern.size() || pattern[i] != 'd' || width > 32 || ++numbers > 1)
+				return false;
+			std::string number = std::to_string(frame);
+			if (number.size() < width)
+				number.insert(frame < 0 && zeros ? 1 : 0, width - number.size(), zeros ? '0' : ' ');
+			path += number;
+		}
+		return numbers == 1;
+	}
+
+	//какой кадр сохранить и с чем сравнить
+	struct Shot
+	{
+		int frame;
+		//имя из сценария, пусто - снимок по --capture
+		std::string name;
+
+		//что получилось
+		std::string path;
+		std::string golden;
+		bool compared = false;
+		bool passed = true;
+		int max_diff = 0;
+		size_t bad_pixels = 0;
+	};
+
+	//Сравнивает снимок с эталоном того же размера по каналам: max_diff - самое большое отличие,
+	//bad_pixels - сколько пикселей отличаются больше tolerance
+	void compareImages(const Image& image, const Image& golden, int tolerance, int& max_diff, size_t& bad_pixels)
+	{
+		max_diff = 0;
+		bad_pixels = 0;
+		const unsigned char* a = image.pixels.data();
+		const unsigned char* b = golden.pixels.data();
+		for (size_t i = 0, n = (size_t)image.width * image.height; i < n; ++i, a += 4, b += 4)
+		{
+			int d = 0;
+			for (int c = 0; c < 4; ++c)
+				d = std::max(d, std::abs(a[c] - b[c]));
+			max_diff = std::max(max_diff, d);
+			if (d > tolerance)
+				++bad_pixels;
+		}
+	}
+}
+
+
+bool isHeadless(const std::vector<std::string>& args)
+{
+	return std::find(args.begin(), args.end(), "--headless") != args.end();
+}
+
+bool parseHeadlessOptions(const std::vector<std::string>& args, HeadlessOptions& options, std::string& error)
+{
+	for (size_t i = 0; i < args.size(); ++i)
+	{
+		const std::string& a = args[i];
+		if (a == "--headless")
+			continue;
+		if (a == "--update-golden")
+		{
+			options.update_golden = true;
+			continue;
+		}
+
+		if (i + 1 >= args.size())
+		{
+			error = "no value for " + a;
+			return false;
+		}
+		const std::string& v = args[++i];
+
+		bool ok = true;
+		if (a == "--size")
+		{
+			options.size_set = true;
+			ok = sscanf(v.c_str(), "%dx%d", &options.width, &options.height) == 2 &&
+				options.width > 0 && options.height > 0;
+		}
+		else if (a == "--frames")
+			ok = parseInt(v, options.frames) && options.frames > 0;
+		else if (a == "--warmup")
+			ok = parseInt(v, options.warmup) && options.warmup >= 0;
+		else if (a == "--timestep")
+			ok = (options.timestep = atof(v.c_str())) > 0;
+		else if (a == "--capture")
+		{
+			//номера через запятую
+			size_t start = 0;
+			while (ok && start <= v.size())
+			{
+				size_t end = v.find(',', start);
+				if (end == std::string::npos)
+					end = v.size();
+				int frame;
+				ok = parseInt(v.substr(start, end - start), frame);
+				if (ok)
+					options.capture.push_back(frame);
+				start = end + 1;
+			}
+		}
+		else if (a == "--capture-path")
+		{
+			std::string path;
+			options.capture_path = v;
+			ok = capturePath(v, 0, path);
+		}
+		else if (a == "--report")
+			options.report_path = v;
+		else if (a == "--script")
+			options.script_path = v;
+		else if (a == "--golden")
+			options.golden_dir = v;
+		else if (a == "--tolerance")
+			ok = parseInt(v, options.tolerance) && options.tolerance >= 0;
+		else if (a == "--replay")
+			options.replay_path = v;
+		else if (a == "--replay-speed")
+			ok = parseDouble(v, options.replay_speed) && options.replay_speed > 0;
+		else if (a == "--geometry")
+		{
+			options.geometry = v;
+			ok = v == "immediate" || v == "batch" || v == "lists" || v == "indirect";
+		}
+		else if (a == "--lighting")
+		{
+			options.lighting = v;
+			ok = v == "fixed" || v == "shader";
+		}
+		else if (a == "--instances")
+			ok = parseInt(v, options.instances) && options.instances >= 0;
+		else if (a == "--instancing")
+		{
+			options.instancing = v;
+			ok = v == "hardware" || v == "replicated";
+		}
+		else if (a == "--program-cache")
+		{
+			options.program_cache = v == "on";
+			ok = v == "on" || v == "off";
+		}
+		else if (a == "--stream")
+		{
+			options.persistent_stream = v == "persistent";
+			ok = v == "persistent" || v == "orphan";
+		}
+		else if (a == "--max-bad")
+			ok = parseDouble(v, options.max_bad) && options.max_bad >= 0 && options.max_bad <= 1;
+		else
+		{
+			error = "unknown option " + a;
+			return false;
+		}
+
+		if (!ok)
+		{
+			error = "bad value for " + a + ": " + v;
+			return false;
+		}
+	}
+	return true;
+}
+
+int runHeadless(const HeadlessOptions& options)
+{
+	//со сценарием число кадров - по нему (кадр в момент end тоже рисуется),
+	//HUD выключен: в нем время кадра, картинки с ним не повторяются
+	BenchmarkScript script;
+	int frames = options.frames;
+	if (!options.script_path.empty())
+	{
+		std::string error;
+		if (!script.load(options.script_path.c_str(), error))
+		{
+			fprintf(stderr, "headless: %s\n", error.c_str());
+			return 1;
+		}
+		frames = (int)(script.duration() / options.timestep + 0.5) + 1;
+		setRenderOverlay(false);
+	}
+
+	//размер из сценария: эталоны в другом не сравнить
+	int width = options.width, height = options.height;
+	int script_width, script_height;
+	if (script.frameSize(script_width, script_height))
+	{
+		if (options.size_set && (width != script_width || height != script_height))
+		{
+			fprintf(stderr, "headless: --size %dx%d, but %s is for %dx%d\n",
+				width, height, options.script_path.c_str(), script_width, script_height);
+			return 1;
+		}
+		width = script_width;
+		height = script_height;
+	}
+
+	//с журналом - пока он не кончится (или сценарий, если он длиннее)
+	InputReplay replay;
+	if (!options.replay_path.empty())
+	{
+		std::string error;
+		if (!replay.load(options.replay_path.c_str(), error))
+		{
+			fprintf(stderr, "headless: %s\n", error.c_str());
+			return 1;
+		}
+		int replay_frames = (int)(replay.duration() / options.replay_speed / options.timestep + 0.5) + 1;
+		frames = options.script_path.empty() ? replay_frames : std::max(frames, replay_frames);
+	}
+
+	std::vector<Shot> shots;
+	for (int frame : options.capture)
+		shots.push_back({ frame });
+	for (const auto& c : script.captures())
+		shots.push_back({ (int)(c.time / options.timestep + 0.5), c.name });
+	const bool golden = !options.golden_dir.empty();
+
+	//эталоны пишем и в папку, которой еще нет
+	if (golden && options.update_golden)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(options.golden_dir, ec);
+		if (ec)
+		{
+			fprintf(stderr, "headless: can't create %s: %s\n", options.golden_dir.c_str(), ec.message().c_str());
+			return 1;
+		}
+	}
+
+	if (!platformCreateHeadlessContext() || !loadGL())
+	{
+		fprintf(stderr, "headless: failed to create OpenGL context\n");
+		return 1;
+	}
+
+	Framebuffer fb;
+	if (!fb.create(width, height))
+	{
+		fprintf(stderr, "headless: framebuffer objects are not supported\n");
+		fb.destroy();
+		platformDestroyContext();
+		return 1;
+	}
+
+	//то же, что render_cycle в MyOGL.cpp, только без окна
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	glState.enable(GL_DEPTH_TEST);
+	programs.setBinaryCache(options.program_cache);
+	imm.stream().setPersistent(options.persistent_stream);
+	//до initRender - он заранее готовит программы освещения
+	if (!options.lighting.empty())
+		setLightingPath(options.lighting == "shader" ? LightingPath::Shaders : LightingPath::FixedFunction);
+	initRender();
+	if (options.geometry == "immediate")
+		setGeometryPath(GeometryPath::Immediate);
+	else if (options.geometry == "batch")
+		setGeometryPath(GeometryPath::Batched);
+	else if (options.geometry == "lists")
+		setGeometryPath(GeometryPath::DisplayLists);
+	else if (options.geometry == "indirect")
+		setGeometryPath(GeometryPath::Indirect);
+	setStressInstances(options.instances);
+	if (!options.instancing.empty())
+		setInstancingPath(options.instancing == "hardware" ? InstancingPath::Hardware : InstancingPath::Replicated);
+
+	gl.setHeadless(true);
+	gl.try_to_resize(width, height);
+	script.apply(0);
+	if (!options.replay_path.empty())
+		InputReplay::setActive(&replay);
+
+	auto ms_since = [](std::chrono::steady_clock::time_point t)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+	};
+
+	//без текстур кадры были бы другими, ждем их (но не вечно)
+	auto wait_start = std::chrono::steady_clock::now();
+	while (renderLoading() && ms_since(wait_start) < 30000)
+	{
+		gl.render(options.timestep);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	double load_wait_ms = ms_since(wait_start);
+	for (int i = 0; i < options.warmup; ++i)
+		gl.render(options.timestep);
+
+	std::vector<double> frame_ms;
+	frame_ms.reserve(frames);
+	unsigned long long total_calls = 0;
+	unsigned long long draw_calls = 0;
+	unsigned long long state_issued = 0;
+	unsigned long long state_elided = 0;
+	unsigned long long batch_vertices = 0;
+	unsigned long long batch_draws = 0;
+	unsigned long long list_compiles = 0;
+	double queue_items = 0, queue_sort_ms = 0;
+	double arena_objects = 0, arena_submit_ms = 0;
+	double stats_overhead_ms = 0, stats_overhead_max_ms = 0, stats_graph_ms = 0;
+	std::vector<std::pair<const char*, unsigned long long>> per_function;
+	for (GLCallCounter* c = glCallCounters(); c; c = c->next)
+		per_function.push_back({ c->name, 0 });
+
+	Image image;
+	image.width = width;
+	image.height = height;
+
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		script.apply(frame * options.timestep);
+		Message m;
+		while (replay.next(frame * options.timestep * options.replay_speed, m))
+			dispatch_message(m);
+
+		glResetCallCounters();
+		glState.resetCounters();
+		imm.resetCounters();
+		displayLists.resetCounters();
+		auto start = std::chrono::steady_clock::now();
+		gl.render(options.timestep);
+		frame_ms.push_back(ms_since(start));
+
+		total_calls += glCallTotal();
+		draw_calls += glDrawCallTotal();
+		state_issued += glState.issued();
+		state_elided += glState.elided();
+		batch_vertices += imm.vertexCount();
+		batch_draws += imm.drawCount();
+		list_compiles += displayLists.compileCount();
+		queue_items += renderQueue.lastCount();
+		queue_sort_ms += renderQueue.lastSortMs();
+		arena_objects += staticScene.lastCount();
+		arena_submit_ms += staticScene.lastSubmitMs();
+		stats_overhead_ms += gl.stats.overheadMs();
+		stats_overhead_max_ms = std::max(stats_overhead_max_ms, gl.stats.overheadMs());
+		stats_graph_ms += gl.stats.graphMs();
+		size_t k = 0;
+		for (GLCallCounter* c = glCallCounters(); c; c = c->next, ++k)
+			per_function[k].second += c->count;
+
+		bool read = false;
+		for (Shot& shot : shots)
+		{
+			if (shot.frame != frame)
+				continue;
+			if (!read)
+			{
+				//строки из glReadPixels идут снизу вверх - как и в Image
+				image.pixels.resize((size_t)image.width * image.height * 4);
+				glPixelStorei(GL_PACK_ALIGNMENT, 4);
+				glReadPixels(0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+				read = true;
+			}
+
+			std::string path;
+			capturePath(options.capture_path, frame, path);
+			if (saveImagePng(path.c_str(), image))
+				shot.path = path;
+			else
+				fprintf(stderr, "headless: failed to write %s\n", path.c_str());
+
+			if (!golden || shot.name.empty())
+				continue;
+			shot.golden = options.golden_dir + "/" + shot.name + ".png";
+			if (options.update_golden)
+			{
+				if (!saveImagePng(shot.golden.c_str(), image))
+				{
+					fprintf(stderr, "headless: failed to write %s\n", shot.golden.c_str());
+					shot.passed = false;
+				}
+				continue;
+			}
+
+			shot.compared = true;
+			Image reference;
+			if (!loadImage(shot.golden.c_str(), reference))
+			{
+				fprintf(stderr, "headless: no golden image %s\n", shot.golden.c_str());
+				shot.passed = false;
+				continue;
+			}
+			if (reference.width != image.width || reference.height != image.height)
+			{
+				fprintf(stderr, "headless: %s is %dx%d, golden %s is %dx%d\n", shot.path.c_str(),
+					image.width, image.height, shot.golden.c_str(), reference.width, reference.height);
+				shot.passed = false;
+				continue;
+			}
+			compareImages(image, reference, options.tolerance, shot.max_diff, shot.bad_pixels);
+			shot.passed = shot.bad_pixels <= options.max_bad * image.width * image.height;
+			if (!shot.passed)
+				fprintf(stderr, "headless: %s differs from %s: %zu pixels, max difference %d\n",
+					shot.path.c_str(), shot.golden.c_str(), shot.bad_pixels, shot.max_diff);
+		}
+	}
+
+	std::string renderer = glCaps().renderer;
+	std::string version = glCaps().version;
+
+	fb.destroy();
+	shutdownRender();
+	platformDestroyContext();
+	InputReplay::setActive(nullptr);
+
+	//отчет
+	std::vector<double> sorted = frame_ms;
+	std::sort(sorted.begin(), sorted.end());
+	double sum = 0;
+	for (double ms : frame_ms)
+		sum += ms;
+	const double n = (double)frames;
+
+	std::sort(per_function.begin(), per_function.end(),
+		[](const auto& a, const auto& b) { return a.second > b.second; });
+
+	std::string json = "{\n";
+	json += "  \"renderer\": " + jsonString(renderer.c_str()) + ",\n";
+	json += "  \"version\": " + jsonString(version.c_str()) + ",\n";
+	json += "  \"width\": " + std::to_string(width) + ",\n";
+	json += "  \"height\": " + std::to_string(height) + ",\n";
+	json += "  \"frames\": " + std::to_string(frames) + ",\n";
+	if (!options.script_path.empty())
+		json += "  \"script\": " + jsonString(options.script_path.c_str()) + ",\n";
+	if (!options.replay_path.empty())
+		json += "  \"replay\": " + jsonString(options.replay_path.c_str()) + ",\n";
+	const char* geometry_names[] = { "immediate", "batch", "lists", "indirect" };
+	json += "  \"geometry\": " + jsonString(geometry_names[(int)geometryPath()]) + ",\n";
+	json += "  \"lighting\": " + jsonString(lightingPath() == LightingPath::Shaders ? "shader" : "fixed") + ",\n";
+	if (stressInstances())
+		json += "  \"instances\": {\"count\": " + std::to_string(stressInstances()) + ", \"path\": " +
+			jsonString(geometryPath() == GeometryPath::Indirect ? (staticScene.isIndirect() ? "indirect" : "replicated") :
+				instancingPath() == InstancingPath::Hardware ? "hardware" : "replicated") + "},\n";
+	json += "  \"timestep_ms\": " + format("%.4f", options.timestep * 1000) + ",\n";
+	json += "  \"load_wait_ms\": " + format("%.1f", load_wait_ms) + ",\n";
+	json += "  \"frame_ms\": {";
+	json += "\"mean\": " + format("%.4f", sum / n);
+	json += ", \"p50\": " + format("%.4f", percentile(sorted, 0.50));
+	json += ", \"p95\": " + format("%.4f", percentile(sorted, 0.95));
+	json += ", \"p99\": " + format("%.4f", percentile(sorted, 0.99));
+	json += ", \"min\": " + format("%.4f", sorted.front());
+	json += ", \"max\": " + format("%.4f", sorted.back());
+	json += "},\n";
+	json += "  \"gl_calls_per_frame\": {";
+	json += "\"total\": " + format("%.1f", total_calls / n);
+	json += ", \"draw\": " + format("%.1f", draw_calls / n);
+	json += ", \"by_function\": {";
+	bool first = true;
+	for (const auto& f : per_function)
+	{
+		if (!f.second)
+			continue;
+		json += (first ? "" : ", ") + jsonString(f.first) + ": " + format("%.1f", f.second / n);
+		first = false;
+	}
+	json += "}},\n";
+	json += "  \"gl_state_per_frame\": {";
+	json += "\"issued\": " + format("%.1f", state_issued / n);
+	json += ", \"elided\": " + format("%.1f", state_elided / n);
+	json += "},\n";
+	json += "  \"immediate_batch_per_frame\": {";
+	json += "\"vertices\": " + format("%.1f", batch_vertices / n);
+	json += ", \"draws\": " + format("%.1f", batch_draws / n);
+	json += "},\n";
+	json += "  \"render_queue_per_frame\": {";
+	json += "\"items\": " + format("%.1f", queue_items / n);
+	json += ", \"sort_ms\": " + format("%.4f", queue_sort_ms / n);
+	json += "},\n";
+	json += "  \"static_scene_per_frame\": {";
+	json += "\"objects\": " + format("%.1f", arena_objects / n);
+	json += ", \"submit_ms\": " + format("%.4f", arena_submit_ms / n);
+	json += "},\n";
+	const StreamBuffer& stream = imm.stream();
+	//запись этапов кадра; график рисуется только с HUD, то есть без сценария
+	json += "  \"frame_stats_ms\": {";
+	json += "\"record_mean\": " + format("%.4f", stats_overhead_ms / n);
+	json += ", \"record_max\": " + format("%.4f", stats_overhead_max_ms);
+	json += ", \"graph_mean\": " + format("%.4f", stats_graph_ms / n);
+	json += ", \"budget\": " + format("%.2f", FrameStats::BUDGET_MS);
+	json += "},\n";
+	json += "  \"stream_buffer\": {";
+	json += std::string("\"persistent\": ") + (stream.isPersistent() ? "true" : "false");
+	json += ", \"size_kb\": " + std::to_string(stream.size() / 1024);
+	json += ", \"waits\": " + std::to_string(stream.waitCount());
+	json += ", \"wait_ms\": " + format("%.2f", stream.waitMs());
+	json += "},\n";
+	json += "  \"programs\": {";
+	json += "\"built\": " + std::to_string(programs.buildCount());
+	json += ", \"from_binary\": " + std::to_string(programs.binaryLoadCount());
+	json += ", \"setup_ms\": " + format("%.2f", programs.setupMs());
+	json += "},\n";
+	json += "  \"display_list_compiles\": " + std::to_string(list_compiles) + ",\n";
+	bool passed = true;
+	json += "  \"captures\": [";
+	for (size_t i = 0; i < shots.size(); ++i)
+	{
+		const Shot& shot = shots[i];
+		passed = passed && shot.passed;
+		json += i ? ",\n    {" : "\n    {";
+		json += "\"frame\": " + std::to_string(shot.frame);
+		if (!shot.name.empty())
+			json += ", \"name\": " + jsonString(shot.name.c_str());
+		json += ", \"path\": " + jsonString(shot.path.c_str());
+		if (!shot.golden.empty())
+			json += ", \"golden\": " + jsonString(shot.golden.c_str());
+		if (shot.compared)
+		{
+			json += ", \"max_diff\": " + std::to_string(shot.max_diff);
+			json += ", \"bad_pixels\": " + std::to_string(shot.bad_pixels);
+		}
+		if (!shot.golden.empty())
+			json += std::string(", \"passed\": ") + (shot.passed ? "true" : "false");
+		json += "}";
+	}
+	json += shots.empty() ? "]" : "\n  ]";
+	if (golden)
+	{
+		json += ",\n  \"golden\": {\"tolerance\": " + std::to_string(options.tolerance);
+		json += ", \"max_bad\": " + format("%g", options.max_bad);
+		json += std::string(", \"updated\": ") + (options.update_golden ? "true" : "false");
+		json += std::string(", \"passed\": ") + (passed ? "true" : "false") + "}";
+	}
+	json += "\n}\n";
+
+	const int code = passed ? 0 : 3;
+	if (options.report_path.empty())
+	{
+		fputs(json.c_str(), stdout);
+		return code;
+	}
+	FILE* f = fopen(options.report_path.c_str(), "w");
+	if (!f)
+	{
+		fprintf(stderr, "headless: failed to write %s\n", options.report_path.c_str());
+		return 1;
+	}
+	fputs(json.c_str(), f);
+	fclose(f);
+	return code;
+}
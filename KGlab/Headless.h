@@ -0,0 +1,75 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <string>
+#include <vector>
+
+//Пакетный режим: без окна, кадры рисуются в FBO заданного размера.
+//Запуск: KGlab --headless [--size 1280x720] [--frames 300] [--timestep 0.016667]
+//                         [--capture 0,100,299] [--capture-path frame_%04d.png] [--report stats.json]
+//                         [--script bench.txt [--golden dir] [--tolerance 2] [--max-bad 0.001] [--update-golden]]
+//                         [--replay input.kgj [--replay-speed 1]] [--geometry immediate|batch|lists|indirect]
+//                         [--lighting fixed|shader] [--program-cache on|off]
+//                         [--instances 10000 [--instancing hardware|replicated]] [--stream persistent|orphan]
+//В конце печатает (или пишет в --report) JSON со временем кадров, числом вызовов GL
+//и изменений состояния, пропущенных кэшем GLState.h.
+//Со сценарием (см. BenchmarkScript.h) число кадров берется из него, HUD не рисуется,
+//а снимки сравниваются с эталонами: так видно, что оптимизация и быстрее, и рисует то же самое.
+//С журналом ввода (см. InputJournal.h) его сообщения отдаются перед кадром, до которого они пришли
+//(по модельному времени), - одинаково при каждом запуске, удобно для профилировщика.
+//Работает и на серверах без видеокарты через Mesa llvmpipe - для автоматической проверки производительности.
+struct HeadlessOptions
+{
+	int width = 1280;
+	int height = 720;
+	//размер задан --size (иначе его может задать сценарий)
+	bool size_set = false;
+	int frames = 300;
+	//время кадра для анимации, с - не зависит от скорости машины
+	double timestep = 1.0 / 60;
+	//сколько кадров прогнать до замеров (кроме ожидания загрузки текстур)
+	int warmup = 10;
+	//какие кадры сохранить в PNG
+	std::vector<int> capture;
+	//имя файла для снимка: ровно одно %d (или %04d и т.п.) - номер кадра, %% - знак процента
+	std::string capture_path = "frame_%04d.png";
+	//куда писать отчет, пусто - в stdout
+	std::string report_path;
+	//сценарий, пусто - камера стоит на месте
+	std::string script_path;
+	//папка с эталонными снимками <имя>.png, пусто - без сравнения
+	std::string golden_dir;
+	//на сколько может отличаться канал пикселя от эталона
+	int tolerance = 2;
+	//какая доля пикселей может отличаться больше tolerance
+	double max_bad = 0.001;
+	//не сравнивать, а записать снимки как новые эталоны
+	bool update_golden = false;
+	//журнал ввода, пусто - без него
+	std::string replay_path;
+	//во сколько раз быстрее записи проигрывать журнал
+	double replay_speed = 1;
+	//как рисовать геометрию (см. GeometryPath в Render.h), пусто - как выберет initRender
+	std::string geometry;
+	//чем считать освещение (см. LightingPath в Render.h), пусто - шейдером, если он есть
+	std::string lighting;
+	//сохранять ли собранные шейдеры на диск и грузить их готовыми (см. ProgramCache.h)
+	bool program_cache = true;
+	//копий призмы в нагрузочной сцене (см. setStressInstances в Render.h), 0 - без нее
+	int instances = 0;
+	//как их рисовать (см. InstancingPath в Render.h), пусто - одним вызовом, если есть instancing
+	std::string instancing;
+	//потоковый буфер imm (см. StreamBuffer.h): false - только orphaning, даже если есть buffer_storage
+	bool persistent_stream = true;
+};
+
+//есть ли среди аргументов --headless
+bool isHeadless(const std::vector<std::string>& args);
+//разбирает аргументы, false - что-то не так (текст ошибки в error)
+bool parseHeadlessOptions(const std::vector<std::string>& args, HeadlessOptions& options, std::string& error);
+
+//рисует кадры и пишет отчет, возвращает код выхода программы:
+//0 - все хорошо, 1 - ошибка, 3 - снимок не совпал с эталоном
+int runHeadless(const HeadlessOptions& options);
+
+#endif
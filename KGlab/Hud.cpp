@@ -0,0 +1,158 @@
+#include "Hud.h"
+
+
+Hud::Hud()
+{
+}
+
+bool Hud::same(Slot slot, double x, double y, double z) const
+{
+	const HudSlot& s = slots[slot];
+	return s.valid && s.value[0] == x && s.value[1] == y && s.value[2] == z;
+}
+
+void Hud::store(Slot slot, const Line& line, double x, double y, double z)
+{
+	HudSlot& s = slots[slot];
+	s.value[0] = x;
+	s.value[1] = y;
+	s.value[2] = z;
+	s.valid = true;
+
+	//значение поменялось, но после округления текст мог остаться тем же
+	if (s.line != line)
+	{
+		s.line = line;
+		dirty = true;
+	}
+}
+
+void Hud::setFlag(Slot slot, bool value)
+{
+	if (same(slot, value))
+		return;
+
+	Line l;
+	switch (slot)
+	{
+	case Texturing:
+		l << L"T - ";
+		break;
+	case Lightning:
+		l << L"L - ";
+		break;
+	case Alpha:
+		l << L"A - ";
+		break;
+	case Mipmapping:
+		l << L"M - ";
+		break;
+	default:
+		return;
+	}
+
+	l << (value ? L"[вкл]выкл  " : L" вкл[выкл] ");
+
+	switch (slot)
+	{
+	case Texturing:
+		l << L"текстур";
+		break;
+	case Lightning:
+		l << L"освещение";
+		break;
+	case Alpha:
+		l << L"альфа-наложение";
+		break;
+	case Mipmapping:
+		l << L"мип-уровни";
+		break;
+	default:
+		break;
+	}
+
+	store(slot, l, value);
+}
+
+void Hud::setVec3(Slot slot, double x, double y, double z)
+{
+	if (same(slot, x, y, z))
+		return;
+
+	Line l;
+	switch (slot)
+	{
+	case LightPos:
+		l << L"Коорд. света: (";
+		l.append(x, 3, 7) << L',';
+		l.append(y, 3, 7) << L',';
+		l.append(z, 3, 7) << L')';
+		break;
+	case CameraPos:
+		l << L"Коорд. камеры: (";
+		l.append(x, 3, 7) << L',';
+		l.append(y, 3, 7) << L',';
+		l.append(z, 3, 7) << L')';
+		break;
+	case CameraParams:
+		//x - R, y - fi1, z - fi2
+		l << L"Параметры камеры: R=";
+		l.append(x, 3, 7) << L",fi1=";
+		l.append(y, 3, 7) << L",fi2=";
+		l.append(z, 3, 7);
+		break;
+	default:
+		return;
+	}
+
+	store(slot, l, x, y, z);
+}
+
+void Hud::setDeltaTime(double delta_time)
+{
+	if (same(DeltaTime, delta_time))
+		return;
+
+	Line l;
+	l << L"delta_time: ";
+	l.append(delta_time, 5);
+
+	store(DeltaTime, l, delta_time);
+}
+
+void Hud::setFrameTimes(double min, double avg, double p99)
+{
+	if (same(FrameTimes, min, avg, p99))
+		return;
+
+	Line l;
+	l << L"кадр, мс: min=";
+	l.append(min, 2) << L" avg=";
+	l.append(avg, 2) << L" p99=";
+	l.append(p99, 2);
+
+	store(FrameTimes, l, min, avg, p99);
+}
+
+const wchar_t* Hud::text()
+{
+	if (!dirty)
+		return full.c_str();
+
+	full.clear();
+	full << slots[Texturing].line << L'\n';
+	full << slots[Lightning].line << L'\n';
+	full << slots[Alpha].line << L'\n';
+	full << slots[Mipmapping].line << L'\n';
+	full << L"F - Свет из камеры\n";
+	full << L"G - двигать свет по горизонтали\n";
+	full << L"G+ЛКМ двигать свет по вертекали\n";
+	full << slots[LightPos].line << L'\n';
+	full << slots[CameraPos].line << L'\n';
+	full << slots[CameraParams].line << L'\n';
+	full << slots[DeltaTime].line << L'\n';
+	full << slots[FrameTimes].line << L'\n';
+
+	dirty = false;
+	return full.c_str();
+}
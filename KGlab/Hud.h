@@ -0,0 +1,68 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include "HudText.h"
+
+//Модель текста в верхнем левом углу.
+//Каждая строка - отдельный слот, который переформатируется
+//только когда его значение реально поменялось.
+//Целиком текст пересобирается, только если поменялся хоть один слот,
+//а значит и GuiTextRectangle::setText (дорогая перерисовка через GDI)
+//дергается только по делу.
+class Hud
+{
+public:
+
+	enum Slot
+	{
+		Texturing,
+		Lightning,
+		Alpha,
+		Mipmapping,
+		LightPos,
+		CameraPos,
+		CameraParams,
+		DeltaTime,
+		FrameTimes,
+		SLOT_COUNT
+	};
+
+	typedef WTextBuilder<96> Line;
+	typedef WTextBuilder<1024> Text;
+
+	Hud();
+
+	void setFlag(Slot slot, bool value);
+	void setVec3(Slot slot, double x, double y, double z);
+	void setDeltaTime(double delta_time);
+	//сводка по истории кадров, в миллисекундах
+	void setFrameTimes(double min, double avg, double p99);
+
+	//поменялось ли что-нибудь с последнего вызова text()
+	bool changed() const
+	{
+		return dirty;
+	}
+
+	//собранный текст, пересобирается если что-то поменялось
+	const wchar_t* text();
+
+private:
+
+	struct HudSlot
+	{
+		double value[3];
+		bool valid = false;
+		Line line;
+	};
+
+	HudSlot slots[SLOT_COUNT];
+	Text full;
+	bool dirty = true;
+
+	//true если значения слота не поменялись
+	bool same(Slot slot, double x, double y = 0, double z = 0) const;
+	void store(Slot slot, const Line& line, double x, double y = 0, double z = 0);
+};
+
+#endif
@@ -0,0 +1,124 @@
+//строитель текста для HUD без выделений памяти
+#ifndef HUDTEXT_H
+#define HUDTEXT_H
+
+#include <charconv>
+#include <cwchar>
+#include <cstddef>
+
+
+//Строка фиксированной емкости, живет на стеке.
+//Заменяет std::wstringstream: ничего не аллоцирует,
+//не трогает локаль, числа форматируются через std::to_chars.
+//Если место кончилось - текст молча обрезается.
+template <size_t N>
+class WTextBuilder
+{
+	wchar_t buf[N];
+	size_t len = 0;
+
+public:
+
+	WTextBuilder()
+	{
+		buf[0] = 0;
+	}
+
+	void clear()
+	{
+		len = 0;
+		buf[0] = 0;
+	}
+
+	size_t size() const
+	{
+		return len;
+	}
+
+	const wchar_t* c_str() const
+	{
+		return buf;
+	}
+
+	WTextBuilder& append(wchar_t c)
+	{
+		if (len + 1 < N)
+		{
+			buf[len++] = c;
+			buf[len] = 0;
+		}
+		return *this;
+	}
+
+	WTextBuilder& append(const wchar_t* s)
+	{
+		while (*s && len + 1 < N)
+			buf[len++] = *s++;
+		buf[len] = 0;
+		return *this;
+	}
+
+	WTextBuilder& append(const wchar_t* s, size_t count)
+	{
+		for (size_t i = 0; i < count && len + 1 < N; ++i)
+			buf[len++] = s[i];
+		buf[len] = 0;
+		return *this;
+	}
+
+	//число с фиксированной точкой
+	//precision - знаков после запятой
+	//width - минимальная ширина, добивается пробелами слева (как std::setw)
+	WTextBuilder& append(double v, int precision, int width = 0)
+	{
+		char tmp[64];
+		auto res = std::to_chars(tmp, tmp + sizeof(tmp), v, std::chars_format::fixed, precision);
+		if (res.ec != std::errc())
+			return append(L"?");
+
+		int n = (int)(res.ptr - tmp);
+		for (int i = n; i < width; ++i)
+			append(L' ');
+		//to_chars выдает только ASCII - расширяем посимвольно
+		for (int i = 0; i < n; ++i)
+			append((wchar_t)tmp[i]);
+		return *this;
+	}
+
+	WTextBuilder& append(int v)
+	{
+		char tmp[16];
+		auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+		for (char* p = tmp; p < res.ptr; ++p)
+			append((wchar_t)*p);
+		return *this;
+	}
+
+	WTextBuilder& operator<<(const wchar_t* s)
+	{
+		return append(s);
+	}
+
+	WTextBuilder& operator<<(wchar_t c)
+	{
+		return append(c);
+	}
+
+	template <size_t M>
+	WTextBuilder& operator<<(const WTextBuilder<M>& other)
+	{
+		return append(other.c_str(), other.size());
+	}
+
+	bool operator==(const WTextBuilder& other) const
+	{
+		return len == other.len && std::wmemcmp(buf, other.buf, len) == 0;
+	}
+
+	bool operator!=(const WTextBuilder& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+#endif
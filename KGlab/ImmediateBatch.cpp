@@ -0,0 +1,191 @@
+#include "ImmediateBatch.h"
+
+#include <cstddef>
+
+#include "GLState.h"
+
+ImmediateBatch imm;
+
+namespace
+{
+	//во что склеивается примитив
+	GLenum batchMode(GLenum mode)
+	{
+		switch (mode)
+		{
+		case GL_POINTS:
+			return GL_POINTS;
+		case GL_LINES:
+		case GL_LINE_STRIP:
+		case GL_LINE_LOOP:
+			return GL_LINES;
+		case GL_QUADS:
+		case GL_QUAD_STRIP:
+			return GL_QUADS;
+		default:
+			return GL_TRIANGLES;
+		}
+	}
+}
+
+
+void ImmediateBatch::begin(GLenum mode)
+{
+	if (!hooked)
+	{
+		//перед настоящей сменой состояния накопленное должно нарисоваться со старым
+		glState.setBeforeChange([]() { imm.flush(); });
+		hooked = true;
+	}
+	if (direct)
+	{
+		glBegin(mode);
+		return;
+	}
+	GLenum m = batchMode(mode);
+	if (m != batch_mode)
+		flush();
+	batch_mode = m;
+	primitive_mode = mode;
+	primitive.clear();
+}
+
+void ImmediateBatch::end()
+{
+	if (direct)
+	{
+		glEnd();
+		return;
+	}
+	const std::vector<Vertex>& p = primitive;
+	size_t n = p.size();
+	switch (primitive_mode)
+	{
+	//неполный последний примитив GL отбрасывает, мы тоже
+	case GL_POINTS:
+		vertices.insert(vertices.end(), p.begin(), p.end());
+		break;
+	case GL_LINES:
+		vertices.insert(vertices.end(), p.begin(), p.begin() + n / 2 * 2);
+		break;
+	case GL_TRIANGLES:
+		vertices.insert(vertices.end(), p.begin(), p.begin() + n / 3 * 3);
+		break;
+	case GL_QUADS:
+		vertices.insert(vertices.end(), p.begin(), p.begin() + n / 4 * 4);
+		break;
+	case GL_LINE_STRIP:
+	case GL_LINE_LOOP:
+		for (size_t i = 0; i + 1 < n; ++i)
+		{
+			vertices.push_back(p[i]);
+			vertices.push_back(p[i + 1]);
+		}
+		if (primitive_mode == GL_LINE_LOOP && n > 2)
+		{
+			vertices.push_back(p[n - 1]);
+			vertices.push_back(p[0]);
+		}
+		break;
+	case GL_TRIANGLE_STRIP:
+		//у нечетных треугольников первые две вершины меняются местами, чтобы обход не менялся
+		for (size_t i = 0; i + 2 < n; ++i)
+		{
+			vertices.push_back(p[i + (i & 1)]);
+			vertices.push_back(p[i + 1 - (i & 1)]);
+			vertices.push_back(p[i + 2]);
+		}
+		break;
+	case GL_TRIANGLE_FAN:
+	case GL_POLYGON:
+		for (size_t i = 1; i + 1 < n; ++i)
+		{
+			vertices.push_back(p[0]);
+			vertices.push_back(p[i]);
+			vertices.push_back(p[i + 1]);
+		}
+		break;
+	case GL_QUAD_STRIP:
+		for (size_t i = 0; i + 3 < n; i += 2)
+		{
+			vertices.push_back(p[i]);
+			vertices.push_back(p[i + 1]);
+			vertices.push_back(p[i + 3]);
+			vertices.push_back(p[i + 2]);
+		}
+		break;
+	}
+	primitive.clear();
+}
+
+void ImmediateBatch::upload(const void*& pointer)
+{
+	size_t bytes = vertices.size() * sizeof(Vertex);
+	if (!glCaps().vbo)
+	{
+		//буферов нет - массивы прямо из памяти, все равно один вызов на пачку
+		pointer = vertices.data();
+		return;
+	}
+
+	pointer = (const void*)stream_buffer.write(vertices.data(), bytes);
+}
+
+void ImmediateBatch::flush()
+{
+	if (vertices.empty())
+		return;
+	if (captured)
+	{
+		if (batch_mode == GL_TRIANGLES)
+			captured->insert(captured->end(), vertices.begin(), vertices.end());
+		else if (batch_mode == GL_QUADS)
+			for (size_t i = 0; i + 3 < vertices.size(); i += 4)
+				for (size_t k : { 0, 1, 2, 0, 2, 3 })
+					captured->push_back(vertices[i + k]);
+		else if (batch_mode == GL_LINES && captured_lines)
+			captured_lines->insert(captured_lines->end(), vertices.begin(), vertices.end());
+		vertices.clear();
+		return;
+	}
+
+	const void* base;
+	upload(base);
+	const char* p = (const char*)base;
+	const GLsizei stride = sizeof(Vertex);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, stride, p + offsetof(Vertex, pos));
+	if (attributes & Normals)
+	{
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glNormalPointer(GL_FLOAT, stride, p + offsetof(Vertex, normal));
+	}
+	if (attributes & Colors)
+	{
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(4, GL_FLOAT, stride, p + offsetof(Vertex, color));
+	}
+	if (attributes & TexCoords)
+	{
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, stride, p + offsetof(Vertex, tex));
+	}
+
+	glDrawArrays(batch_mode, 0, (GLsizei)vertices.size());
+
+	if (attributes & TexCoords)
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	if (attributes & Colors)
+		glDisableClientState(GL_COLOR_ARRAY);
+	if (attributes & Normals)
+		glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	//остальной код рисует массивами из памяти - буфер не должен оставаться привязанным
+	if (glCaps().vbo)
+		glfn.BindBuffer(GL_ARRAY_BUFFER, 0);
+
+	vertex_count += vertices.size();
+	++draw_count;
+	vertices.clear();
+}
@@ -0,0 +1,206 @@
+#ifndef IMMEDIATEBATCH_H
+#define IMMEDIATEBATCH_H
+
+#include <vector>
+
+#include "GLLoader.h"
+#include "StreamBuffer.h"
+
+//Рекордер в стиле glBegin/glVertex.
+//Рисовать так удобно, но каждая вершина - это 2-4 вызова драйвера (нормаль, цвет,
+//текстурные координаты, вершина). imm повторяет тот же набор функций, только складывает
+//вершины в массив, а рисует их одним glDrawArrays из потокового буфера вершин (StreamBuffer.h):
+//    imm.begin(GL_QUADS);           //вместо glBegin(GL_QUADS)
+//    imm.normal3dv(n);              //вместо glNormal3dv(n)
+//    imm.color3d(1, 0, 0);          //вместо glColor3d(1, 0, 0)
+//    imm.vertex3dv(v);              //вместо glVertex3dv(v)
+//    imm.end();                     //вместо glEnd()
+//Подряд идущие begin/end с одним состоянием GL попадают в одну пачку.
+//Ленты, веера и многоугольники переводятся в отдельные треугольники (а полосы четырехугольников -
+//в четырехугольники), чтобы склеиваться с соседями. Пачка рисуется, когда:
+// - GLState (GLState.h) собирается действительно поменять состояние - поэтому свет, текстуры,
+//   смешивание и т.п. надо менять только через glState;
+// - меняется тип примитивов (точки, линии, треугольники, четырехугольники);
+// - вызван flush() - перед сменой матриц и перед прямыми glBegin/glDrawArrays мимо imm.
+//Текущие нормаль, цвет и текстурные координаты у рекордера свои и, как в GL,
+//сохраняются между begin/end и кадрами. Только поток рендера.
+class ImmediateBatch
+{
+public:
+
+	//какие массивы кроме координат отдаются в glDrawArrays
+	enum Attribute
+	{
+		Normals = 1,
+		Colors = 2,
+		TexCoords = 4,
+
+		AllAttributes = Normals | Colors | TexCoords
+	};
+
+	struct Vertex
+	{
+		float pos[3] = { 0, 0, 0 };
+		float normal[3] = { 0, 0, 1 };
+		float color[4] = { 1, 1, 1, 1 };
+		float tex[2] = { 0, 0 };
+	};
+
+	void begin(GLenum mode);
+	void end();
+
+	//true - сразу в glBegin/glVertex, без пачек (для замеров и display list на старом GL)
+	void setDirect(bool on)
+	{
+		flush();
+		direct = on;
+	}
+	bool isDirect() const
+	{
+		return direct;
+	}
+
+	void normal3d(double x, double y, double z)
+	{
+		if (direct)
+		{
+			glNormal3d(x, y, z);
+			return;
+		}
+		current.normal[0] = (float)x;
+		current.normal[1] = (float)y;
+		current.normal[2] = (float)z;
+	}
+	void normal3dv(const double* n)
+	{
+		normal3d(n[0], n[1], n[2]);
+	}
+
+	void color3d(double r, double g, double b)
+	{
+		color4d(r, g, b, 1);
+	}
+	void color4d(double r, double g, double b, double a)
+	{
+		if (direct)
+		{
+			glColor4d(r, g, b, a);
+			return;
+		}
+		current.color[0] = (float)r;
+		current.color[1] = (float)g;
+		current.color[2] = (float)b;
+		current.color[3] = (float)a;
+	}
+
+	void texCoord2d(double s, double t)
+	{
+		if (direct)
+		{
+			glTexCoord2d(s, t);
+			return;
+		}
+		current.tex[0] = (float)s;
+		current.tex[1] = (float)t;
+	}
+	void texCoord2dv(const double* st)
+	{
+		texCoord2d(st[0], st[1]);
+	}
+
+	void vertex3d(double x, double y, double z)
+	{
+		if (direct)
+		{
+			glVertex3d(x, y, z);
+			return;
+		}
+		current.pos[0] = (float)x;
+		current.pos[1] = (float)y;
+		current.pos[2] = (float)z;
+		primitive.push_back(current);
+	}
+	void vertex3dv(const double* v)
+	{
+		vertex3d(v[0], v[1], v[2]);
+	}
+	void vertex2d(double x, double y)
+	{
+		vertex3d(x, y, 0);
+	}
+
+	//Формат вершин следующих пачек. Выключенный атрибут GL берет из текущего значения
+	//(glNormal/glColor/glTexCoord), поэтому выключать можно только то, что не влияет
+	//на картинку в текущем режиме (см. RenderModes.h). В direct не действует.
+	void setAttributes(unsigned mask)
+	{
+		if (mask != attributes)
+			flush();
+		attributes = mask;
+	}
+	unsigned enabledAttributes() const
+	{
+		return attributes;
+	}
+
+	//рисует накопленное
+	void flush();
+
+	//Пока задан triangles, пачки не рисуются, а дописываются в него отдельными треугольниками
+	//(четырехугольники делятся пополам), а линии - в lines (без него и точки - пропускаются).
+	//Так геометрию, нарисованную через imm, можно забрать в свой буфер (InstancedMesh.h, MeshArena.h).
+	//nullptr - снова рисовать. В direct не действует
+	void capture(std::vector<Vertex>* triangles, std::vector<Vertex>* lines = nullptr)
+	{
+		flush();
+		captured = triangles;
+		captured_lines = lines;
+	}
+
+	//вершин и glDrawArrays с последнего resetCounters()
+	unsigned long long vertexCount() const
+	{
+		return vertex_count;
+	}
+	unsigned long long drawCount() const
+	{
+		return draw_count;
+	}
+	void resetCounters()
+	{
+		vertex_count = draw_count = 0;
+	}
+
+	//откуда рисуются пачки (StreamBuffer.h)
+	StreamBuffer& stream()
+	{
+		return stream_buffer;
+	}
+
+private:
+
+	void upload(const void*& pointer);
+
+	Vertex current;
+	//вершины текущего begin/end, как их дали
+	std::vector<Vertex> primitive;
+	GLenum primitive_mode = 0;
+
+	//накопленная пачка, уже в виде отдельных примитивов batch_mode
+	std::vector<Vertex> vertices;
+	GLenum batch_mode = 0;
+
+	bool direct = false;
+	bool hooked = false;
+	std::vector<Vertex>* captured = nullptr;
+	std::vector<Vertex>* captured_lines = nullptr;
+	unsigned attributes = AllAttributes;
+	StreamBuffer stream_buffer;
+
+	unsigned long long vertex_count = 0;
+	unsigned long long draw_count = 0;
+};
+
+extern ImmediateBatch imm;
+
+#endif
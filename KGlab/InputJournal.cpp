@@ -0,0 +1,311 @@
+#include "InputJournal.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "MappedFile.h"
+#include "MyOGL.h"
+
+
+namespace
+{
+	const char MAGIC[4] = { 'K', 'G', 'I', 'J' };
+	const unsigned char VERSION = 1;
+
+	//журнал сбрасывается на диск не реже раза в секунду - на случай падения
+	const auto FLUSH_INTERVAL = std::chrono::seconds(1);
+
+	void putVarint(unsigned char*& p, unsigned long long v)
+	{
+		while (v >= 0x80)
+		{
+			*p++ = (unsigned char)(v | 0x80);
+			v >>= 7;
+		}
+		*p++ = (unsigned char)v;
+	}
+
+	//zigzag: маленькие по модулю отрицательные числа тоже занимают мало байт
+	void putSigned(unsigned char*& p, long long v)
+	{
+		putVarint(p, ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63));
+	}
+
+	struct Reader
+	{
+		const unsigned char* p;
+		const unsigned char* end;
+		bool ok = true;
+
+		unsigned long long varint()
+		{
+			unsigned long long v = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				if (p == end)
+					break;
+				unsigned char b = *p++;
+				v |= (unsigned long long)(b & 0x7F) << shift;
+				if (!(b & 0x80))
+					return v;
+			}
+			ok = false;
+			return 0;
+		}
+
+		long long sgned()
+		{
+			unsigned long long v = varint();
+			return (long long)(v >> 1) ^ -(long long)(v & 1);
+		}
+
+		int byte()
+		{
+			if (p == end)
+			{
+				ok = false;
+				return 0;
+			}
+			return *p++;
+		}
+	};
+
+	//поток проигрывания в окне
+	std::thread replay_thread;
+	std::mutex replay_mutex;
+	std::condition_variable replay_cv;
+	bool replay_stop = false;
+	std::atomic_bool replay_running{ false };
+	InputReplay window_replay;
+
+	std::atomic<InputReplay*> active_replay{ nullptr };
+}
+
+
+InputRecorder::~InputRecorder()
+{
+	close();
+}
+
+bool InputRecorder::open(const char* path)
+{
+	close();
+	file = fopen(path, "wb");
+	if (!file)
+		return false;
+	fwrite(MAGIC, 1, 4, file);
+	fwrite(&VERSION, 1, 1, file);
+	start = last_flush = std::chrono::steady_clock::now();
+	written_us = 0;
+	return true;
+}
+
+void InputRecorder::record(const Message& m)
+{
+	if (!file)
+		return;
+
+	//запись не длиннее 1 + 10 + 1 + 10 + 10 + 1 байт
+	unsigned char buf[40];
+	unsigned char* p = buf;
+
+	auto now = std::chrono::steady_clock::now();
+	long long us = std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+	putVarint(p, (unsigned long long)std::max(0LL, us - written_us));
+	written_us = std::max(us, written_us);
+
+	*p++ = (unsigned char)m.type;
+	switch (m.type)
+	{
+	case Message::MouseMove:
+	case Message::MouseDown:
+	case Message::MouseUp:
+		putSigned(p, m.x);
+		putSigned(p, m.y);
+		if (m.type != Message::MouseMove)
+			*p++ = (unsigned char)m.key;
+		break;
+	case Message::Wheel:
+		putSigned(p, (long long)m.wheel);
+		break;
+	case Message::KeyDown:
+	case Message::KeyUp:
+		*p++ = (unsigned char)m.key;
+		break;
+	case Message::Resize:
+		putVarint(p, (unsigned)m.x);
+		putVarint(p, (unsigned)m.y);
+		break;
+	default:
+		break;
+	}
+	fwrite(buf, 1, p - buf, file);
+
+	if (m.type == Message::Close || now - last_flush >= FLUSH_INTERVAL)
+	{
+		fflush(file);
+		last_flush = now;
+	}
+}
+
+void InputRecorder::close()
+{
+	if (file)
+		fclose(file);
+	file = nullptr;
+}
+
+
+bool InputReplay::load(const char* path, std::string& error)
+{
+	entries.clear();
+	position = 0;
+	for (auto& k : keys)
+		k = false;
+
+	MappedFile file(path);
+	if (!file.isOpen() || file.size() < 5 || memcmp(file.data(), MAGIC, 4) != 0)
+	{
+		error = std::string(path) + " is not an input journal";
+		return false;
+	}
+	if (file.data()[4] != VERSION)
+	{
+		error = std::string(path) + ": unsupported journal version";
+		return false;
+	}
+
+	Reader r{ file.data() + 5, file.data() + file.size() };
+	long long us = 0;
+	while (r.p != r.end)
+	{
+		us += (long long)r.varint();
+		JournalEntry e = { us / 1e6, Message{ (Message::Type)r.byte() } };
+		Message& m = e.message;
+		switch (m.type)
+		{
+		case Message::MouseMove:
+		case Message::MouseDown:
+		case Message::MouseUp:
+			m.x = (int)r.sgned();
+			m.y = (int)r.sgned();
+			if (m.type != Message::MouseMove)
+				m.key = r.byte();
+			break;
+		case Message::Wheel:
+			m.wheel = (float)r.sgned();
+			break;
+		case Message::KeyDown:
+		case Message::KeyUp:
+			m.key = r.byte();
+			break;
+		case Message::Resize:
+			m.x = (int)r.varint();
+			m.y = (int)r.varint();
+			break;
+		case Message::MouseLeave:
+		case Message::Close:
+			break;
+		default:
+			r.ok = false;
+		}
+
+		//оборванную последнюю запись (программа упала при записи) просто отбрасываем
+		if (!r.ok)
+			break;
+		entries.push_back(e);
+	}
+	return true;
+}
+
+bool InputReplay::nextTime(double& t) const
+{
+	if (position >= entries.size())
+		return false;
+	t = entries[position].time;
+	return true;
+}
+
+bool InputReplay::next(double t, Message& m)
+{
+	while (position < entries.size() && entries[position].time <= t)
+	{
+		m = entries[position++].message;
+		if (m.type == Message::Resize || m.type == Message::Close)
+			continue;
+
+		if (m.type == Message::KeyDown || m.type == Message::MouseDown)
+			keys[m.key & 0xFF] = true;
+		else if (m.type == Message::KeyUp || m.type == Message::MouseUp)
+			keys[m.key & 0xFF] = false;
+		return true;
+	}
+	return false;
+}
+
+void InputReplay::setActive(InputReplay* replay)
+{
+	active_replay = replay;
+}
+
+InputReplay* InputReplay::active()
+{
+	return active_replay;
+}
+
+
+bool startInputReplay(const char* path, double speed, std::string& error)
+{
+	if (!window_replay.load(path, error))
+		return false;
+
+	replay_stop = false;
+	replay_running = true;
+	InputReplay::setActive(&window_replay);
+	replay_thread = std::thread([speed]()
+	{
+		auto start = std::chrono::steady_clock::now();
+		double t;
+		while (window_replay.nextTime(t))
+		{
+			//ждем времени следующего сообщения, но просыпаемся на stopInputReplay
+			auto at = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(t / speed));
+			{
+				std::unique_lock<std::mutex> lock(replay_mutex);
+				if (replay_cv.wait_until(lock, at, []() { return replay_stop; }))
+					break;
+			}
+
+			Message m;
+			while (window_replay.next(t, m))
+				add_message(m);
+		}
+
+		//журнал кончился - дальше снова живой ввод
+		InputReplay::setActive(nullptr);
+		replay_running = false;
+		platformDebugOutput("input replay finished\n");
+	});
+	return true;
+}
+
+bool inputReplayRunning()
+{
+	return replay_running;
+}
+
+void stopInputReplay()
+{
+	if (!replay_thread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(replay_mutex);
+		replay_stop = true;
+	}
+	replay_cv.notify_all();
+	replay_thread.join();
+}
@@ -0,0 +1,102 @@
+#ifndef INPUT_JOURNAL_H
+#define INPUT_JOURNAL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Platform.h"
+
+//Журнал ввода: все сообщения окна со временем прихода, чтобы повторить
+//перетаскивание камеры или света и поймать тормоза под профилировщиком.
+//  KGlab --record input.kgj                          - пишет журнал, пока открыто окно
+//  KGlab --replay input.kgj [--replay-speed 4]       - проигрывает его в окне (живой ввод, кроме
+//                                                      закрытия и размера окна, не принимается)
+//  KGlab --headless --replay input.kgj ...           - проигрывает по модельному времени кадров, см. Headless.h
+//
+//Формат: "KGIJ", байт версии, дальше записи подряд:
+//  varint - микросекунды от предыдущей записи, байт - Message::Type, и поля по типу:
+//  MouseMove, MouseDown, MouseUp - x, y (zigzag varint), у Down/Up еще байт кнопки;
+//  Wheel - zigzag varint; KeyDown, KeyUp - байт клавиши; Resize - varint ширины и высоты.
+//Движение мыши обычно занимает 4-6 байт.
+
+struct JournalEntry
+{
+	//секунды от начала записи
+	double time;
+	Message message;
+};
+
+class InputRecorder
+{
+public:
+
+	~InputRecorder();
+
+	bool open(const char* path);
+	//пишет сообщение со временем прихода. Вызывать из одного потока
+	void record(const Message& m);
+	void close();
+
+	bool isOpen() const
+	{
+		return file != nullptr;
+	}
+
+private:
+
+	FILE* file = nullptr;
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point last_flush;
+	//время в журнале в целых микросекундах, чтобы не копилась ошибка округления
+	long long written_us = 0;
+};
+
+//Проигрывание журнала. Пока идет, OpenGL::isKeyPressed смотрит
+//на клавиши из журнала, а не на клавиатуру
+class InputReplay
+{
+public:
+
+	bool load(const char* path, std::string& error);
+
+	//длительность журнала, с
+	double duration() const
+	{
+		return entries.empty() ? 0 : entries.back().time;
+	}
+
+	//следующее сообщение со временем не позже t (время журнала), false - таких больше нет.
+	//Resize и Close пропускаются: размер и закрытие окна остаются за живым окном
+	bool next(double t, Message& m);
+
+	//время следующего сообщения, false - журнал кончился
+	bool nextTime(double& t) const;
+
+	//Делает этот журнал источником нажатых клавиш (nullptr - снова клавиатура)
+	static void setActive(InputReplay* replay);
+	static InputReplay* active();
+
+	//нажата ли клавиша по проигранным сообщениям
+	bool keyPressed(int key) const
+	{
+		return key > 0 && key < 256 && keys[key];
+	}
+
+private:
+
+	std::vector<JournalEntry> entries;
+	size_t position = 0;
+	//пишет поток проигрывания, читает поток рендера
+	std::atomic_bool keys[256] = {};
+};
+
+//Проигрывание в окне: отдельный поток отдает сообщения в add_message
+//в их исходном темпе, ускоренном в speed раз
+bool startInputReplay(const char* path, double speed, std::string& error);
+bool inputReplayRunning();
+void stopInputReplay();
+
+#endif
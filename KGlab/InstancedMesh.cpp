@@ -0,0 +1,194 @@
+#include "InstancedMesh.h"
+
+#include <cstddef>
+#include <string>
+
+#include "GLState.h"
+#include "ImmediateBatch.h"
+#include "ProgramCache.h"
+#include "RenderModes.h"
+
+namespace
+{
+	const char* VERSION = "#version 120";
+
+	const char* VERTEX_DECLARATIONS = R"(
+attribute vec4 offset_scale;
+attribute vec4 color_angle;
+varying vec4 color;
+)";
+
+	//между ними - FIXED_LIGHTING_GLSL
+	const char* VERTEX_MAIN = R"(
+void main()
+{
+	float c = cos(color_angle.w);
+	float s = sin(color_angle.w);
+	mat2 turn = mat2(c, s, -s, c);
+	vec4 position = vec4(vec3(turn * gl_Vertex.xy, gl_Vertex.z) * offset_scale.w + offset_scale.xyz, 1.0);
+	gl_Position = gl_ModelViewProjectionMatrix * position;
+#if LIGHTING
+	//цвет копии - фоновый и рассеянный
+	color = vec4(fixedLighting(vec3(turn * gl_Normal.xy, gl_Normal.z), position, color_angle.rgb), 1.0);
+#else
+	color = vec4(color_angle.rgb, 1.0);
+#endif
+}
+)";
+
+	const char* FRAGMENT_SOURCE = R"(
+varying vec4 color;
+
+void main()
+{
+	gl_FragColor = color;
+}
+)";
+}
+
+
+void InstancedMesh::build(const std::function<void()>& draw)
+{
+	std::vector<ImmediateBatch::Vertex> captured;
+	captureImmediate(draw, captured);
+
+	vertices.clear();
+	indices.clear();
+	MeshIndexer(vertices, indices).add(captured);
+	mesh_dirty = true;
+}
+
+void InstancedMesh::setInstances(const std::vector<Instance>& list)
+{
+	instances = list;
+	instances_dirty = true;
+}
+
+const InstancedMesh::Program* InstancedMesh::program(bool lighting)
+{
+	const GLCaps& caps = glCaps();
+	if (!hardware || !caps.instancing || !caps.compatibility)
+		return nullptr;
+
+	Program& p = variants[lighting ? 1 : 0];
+	if (!p.tried)
+	{
+		p.tried = true;
+		static const std::string vertex_source = std::string(VERTEX_DECLARATIONS) + FIXED_LIGHTING_GLSL + VERTEX_MAIN;
+		p.id = programs.get("instanced", lighting ? ModeLighting : 0, VERSION, vertex_source.c_str(), FRAGMENT_SOURCE);
+		if (p.id)
+		{
+			p.offset_scale = glfn.GetAttribLocation(p.id, "offset_scale");
+			p.color_angle = glfn.GetAttribLocation(p.id, "color_angle");
+		}
+		if (p.offset_scale < 0 || p.color_angle < 0)
+			p.id = 0;
+	}
+	return p.id ? &p : nullptr;
+}
+
+void InstancedMesh::draw(bool lighting)
+{
+	if (instances.empty() || indices.empty())
+		return;
+
+	glState.disable(GL_TEXTURE_2D);
+	glState.setEnabled(GL_LIGHTING, lighting);
+
+	const Program* p = program(lighting);
+	drawn_hardware = p != nullptr;
+	if (p)
+		drawHardware(*p);
+	else
+		drawReplicated(lighting);
+}
+
+void InstancedMesh::drawHardware(const Program& p)
+{
+	//дальше массивы мимо imm
+	imm.flush();
+
+	if (!vertex_buffer)
+	{
+		glfn.GenBuffers(1, &vertex_buffer);
+		glfn.GenBuffers(1, &index_buffer);
+		glfn.GenBuffers(1, &instance_buffer);
+		mesh_dirty = instances_dirty = true;
+	}
+	if (mesh_dirty)
+	{
+		glfn.BindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+		glfn.BufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), vertices.data(), GL_STATIC_DRAW);
+		glfn.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+		glfn.BufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+		mesh_dirty = false;
+	}
+	if (instances_dirty)
+	{
+		glfn.BindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+		glfn.BufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+		instances_dirty = false;
+	}
+
+	glState.useProgram(p.id);
+
+	bindMeshVertices(vertex_buffer, false);
+
+	//атрибуты копии: делитель 1 - следующее значение на каждую копию, а не на вершину
+	glfn.BindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+	const GLint attributes[] = { p.offset_scale, p.color_angle };
+	const size_t offsets[] = { offsetof(Instance, position), offsetof(Instance, color) };
+	for (int i = 0; i < 2; ++i)
+	{
+		glfn.EnableVertexAttribArray(attributes[i]);
+		glfn.VertexAttribPointer(attributes[i], 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void*)offsets[i]);
+		glfn.VertexAttribDivisor(attributes[i], 1);
+	}
+
+	glfn.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+	glfn.DrawElementsInstanced(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, nullptr, (GLsizei)instances.size());
+
+	for (GLint a : attributes)
+	{
+		glfn.VertexAttribDivisor(a, 0);
+		glfn.DisableVertexAttribArray(a);
+	}
+	unbindMeshVertices(false);
+}
+
+void InstancedMesh::drawReplicated(bool lighting)
+{
+	unsigned attributes = imm.enabledAttributes();
+	//цвет копии становится фоновым и рассеянным цветом материала, как в шейдере
+	glState.setEnabled(GL_COLOR_MATERIAL, lighting);
+	imm.setAttributes(lighting ? ImmediateBatch::Normals | ImmediateBatch::Colors : ImmediateBatch::Colors);
+
+	for (size_t i = 0; i < instances.size(); ++i)
+	{
+		const Instance& c = instances[i];
+		MeshPlacement place(c.position, c.scale, c.angle);
+		imm.color3d(c.color[0], c.color[1], c.color[2]);
+		imm.begin(GL_TRIANGLES);
+		for (GLuint index : indices)
+			place.emit(vertices[index], lighting);
+		imm.end();
+		if ((i + 1) % REPLICATE_BATCH == 0)
+			imm.flush();
+	}
+
+	imm.setAttributes(attributes);
+	glState.disable(GL_COLOR_MATERIAL);
+}
+
+void InstancedMesh::release()
+{
+	if (vertex_buffer)
+	{
+		GLuint buffers[] = { vertex_buffer, index_buffer, instance_buffer };
+		glfn.DeleteBuffers(3, buffers);
+	}
+	vertex_buffer = index_buffer = instance_buffer = 0;
+	mesh_dirty = instances_dirty = true;
+	for (Program& p : variants)
+		p = Program();
+}
@@ -0,0 +1,95 @@
+#ifndef INSTANCEDMESH_H
+#define INSTANCEDMESH_H
+
+#include <functional>
+#include <vector>
+
+#include "GLLoader.h"
+#include "MeshBuilder.h"
+
+//Одна сетка, много копий.
+//Сетка (координаты и нормали) один раз записывается из обычного рисования через imm
+//и заливается в буферы вершин и индексов. Копии - массив Instance (сдвиг, масштаб,
+//поворот вокруг Z, цвет) в своем буфере:
+//    mesh.build([]() { drawThing(); });   //imm.begin/vertex/end, как обычно
+//    mesh.setInstances(instances);         //когда копии поменялись
+//    mesh.draw(lighting);                  //каждый кадр
+//Если есть instancing (GLCaps::instancing) и профиль совместимости, все копии - один
+//glDrawElementsInstanced: вершинный шейдер берет копию из атрибутов с делителем 1
+//и освещает ее через FIXED_LIGHTING_GLSL (MeshBuilder.h), цвет копии - фоновый и рассеянный.
+//Иначе вершины размножаются на процессоре и рисуются через imm - та же картинка,
+//только медленно. Камера и свет - текущие матрицы и GL_LIGHT0. Только поток рендера.
+class InstancedMesh
+{
+public:
+
+	struct Instance
+	{
+		float position[3];
+		float scale;
+		float color[3];
+		//поворот вокруг Z, радианы
+		float angle;
+	};
+
+	//записывает треугольники и четырехугольники, нарисованные draw через imm
+	void build(const std::function<void()>& draw);
+	void setInstances(const std::vector<Instance>& list);
+
+	void draw(bool lighting);
+
+	//false - размножать вершины на процессоре и там, где есть instancing (для замеров)
+	void setHardware(bool on)
+	{
+		hardware = on;
+	}
+	//нарисовал ли последний draw() все копии одним glDrawElementsInstanced
+	bool isHardware() const
+	{
+		return drawn_hardware;
+	}
+
+	size_t instanceCount() const
+	{
+		return instances.size();
+	}
+	size_t triangleCount() const
+	{
+		return indices.size() / 3;
+	}
+
+	//удаляет буферы (например, перед сменой контекста); сетка и копии остаются
+	void release();
+
+private:
+
+	//программа и ее атрибуты копии
+	struct Program
+	{
+		bool tried = false;
+		GLuint id = 0;
+		GLint offset_scale = -1;
+		GLint color_angle = -1;
+	};
+	//0 - рисовать размножением
+	const Program* program(bool lighting);
+
+	void drawHardware(const Program& p);
+	void drawReplicated(bool lighting);
+
+	std::vector<MeshVertex> vertices;
+	std::vector<GLuint> indices;
+	std::vector<Instance> instances;
+	bool hardware = true;
+	bool drawn_hardware = false;
+	Program variants[2];
+
+	GLuint vertex_buffer = 0;
+	GLuint index_buffer = 0;
+	GLuint instance_buffer = 0;
+	//буферы отстали от массивов
+	bool mesh_dirty = false;
+	bool instances_dirty = false;
+};
+
+#endif
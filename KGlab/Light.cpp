@@ -1,8 +1,10 @@
 #include "Light.h"
 
-#include <windows.h>
-#include <gl/GL.h>
-#include <gl/GLU.h>
+#include "GLCallCount.h"
+#include "GLState.h"
+#include "ImmediateBatch.h"
+#include "DisplayListCache.h"
+#include "ShadedLighting.h"
 #include <tuple>
 #include <algorithm>
 #include "MyOGL.h"
@@ -19,7 +21,7 @@ std::tuple<double, double, double, double, double, double> getLookRay(int wndX,
 	GLdouble modelview[16];  // видовая матрица.
 	GLdouble wx, wy, wz;       // возвращаемые мировые координаты.
 
-	glGetIntegerv(GL_VIEWPORT, viewport);           // узнаём параметры viewport-a.
+	glState.getViewport(viewport);                  // узнаём параметры viewport-a.
 	glGetDoublev(GL_PROJECTION_MATRIX, projection); // узнаём матрицу проекции.
 	glGetDoublev(GL_MODELVIEW_MATRIX, modelview);   // узнаём видовую матрицу.
 
@@ -100,7 +102,7 @@ void Light::MoveLight(OpenGL* sender, MouseEventArg arg)
 
 		auto [oX, oY, oZ, dX, dY, dZ] = getLookRay(_x, _y);
 
-		if (!OpenGL::isKeyPressed(VK_LBUTTON)) //если не нажата левая кнопка мыши
+		if (!OpenGL::isKeyPressed(KEY_LBUTTON)) //если не нажата левая кнопка мыши
 		{
 			double z = posZ;
 
@@ -157,11 +159,13 @@ void Light::SetUpLight()
 	GLfloat lposition[] = { posX, posY, posZ, 1. };
 
 	//сообщаем эти значения openGL.
-	glLightfv(GL_LIGHT0, GL_POSITION, lposition);
-	glLightfv(GL_LIGHT0, GL_AMBIENT, lamb);
-	glLightfv(GL_LIGHT0, GL_DIFFUSE, ldif);
-	glLightfv(GL_LIGHT0, GL_SPECULAR, lspec);
-	glEnable(GL_LIGHT0);
+	glState.light(GL_LIGHT0, GL_POSITION, lposition);
+	glState.light(GL_LIGHT0, GL_AMBIENT, lamb);
+	glState.light(GL_LIGHT0, GL_DIFFUSE, ldif);
+	glState.light(GL_LIGHT0, GL_SPECULAR, lspec);
+	glState.enable(GL_LIGHT0);
+	//то же для освещения шейдером (ShadedLighting.h)
+	shadedLighting.setLight(lposition, lamb, ldif, lspec);
 }
 
 void Light::DrawLightGizmo()
@@ -169,50 +173,55 @@ void Light::DrawLightGizmo()
 	//рисуем точку, отквда идет свет
 
 //устанавливаем размер точки
-	GLfloat pointSize;
-	glGetFloatv(GL_POINT_SIZE, &pointSize);
-	glPointSize(10);
+	GLfloat pointSize = glState.pointSize();
+	glState.setPointSize(10);
 
 
 	//отключаем тест глубины, чтобы точка рисовалась сквозь все.
-	glDisable(GL_DEPTH_TEST);
+	glState.disable(GL_DEPTH_TEST);
 
 	//отключаем свет и текстуры
-	glDisable(GL_TEXTURE_2D);
-	glDisable(GL_LIGHTING);
+	glState.disable(GL_TEXTURE_2D);
+	glState.disable(GL_LIGHTING);
 
-	//рисуем точку
-	glBegin(GL_POINTS);
-	glColor3d(1, 0.7, 0.1);
-	glVertex3d(posX, posY, posZ);
-	glEnd();
+	//рисуем точку (список пересобирается, когда свет сдвинули)
+	unsigned long long position = hashInputs(posX, posY, posZ);
+	displayLists.draw("light point", position, [this]()
+	{
+		imm.begin(GL_POINTS);
+		imm.color3d(1, 0.7, 0.1);
+		imm.vertex3d(posX, posY, posZ);
+		imm.end();
+	});
 
 	//возращаем размер точки как был до нам
-	glPointSize(pointSize);
+	glState.setPointSize(pointSize);
 
 
 	//если нажата G - рисуем линии осей от света
 	if (!drag) return;
 
-	GLfloat lineWidth;
-	glGetFloatv(GL_LINE_WIDTH, &lineWidth);
+	GLfloat lineWidth = glState.lineWidth();
 
-	glLineWidth(3.0);
+	glState.setLineWidth(3.0);
 
-	glBegin(GL_LINES);
-	glColor3d(0, 0, 0.8);
-	glVertex3d(posX, posY, posZ);
-	glVertex3d(posX, posY, 0);
+	displayLists.draw("light axes", position, [this]()
+	{
+		imm.begin(GL_LINES);
+		imm.color3d(0, 0, 0.8);
+		imm.vertex3d(posX, posY, posZ);
+		imm.vertex3d(posX, posY, 0);
 
-	glColor3d(0.8, 0, 0);
-	glVertex3d(posX - 1, posY, 0);
-	glVertex3d(posX + 1, posY, 0);
+		imm.color3d(0.8, 0, 0);
+		imm.vertex3d(posX - 1, posY, 0);
+		imm.vertex3d(posX + 1, posY, 0);
 
-	glColor3d(0, 0.8, 0);
-	glVertex3d(posX, posY - 1, 0);
-	glVertex3d(posX, posY + 1, 0);
+		imm.color3d(0, 0.8, 0);
+		imm.vertex3d(posX, posY - 1, 0);
+		imm.vertex3d(posX, posY + 1, 0);
 
-	glEnd();
+		imm.end();
+	});
 
-	glLineWidth(lineWidth);
+	glState.setLineWidth(lineWidth);
 }
@@ -0,0 +1,167 @@
+#include "MappedFile.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	moveFrom(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		moveFrom(other);
+	}
+	return *this;
+}
+
+void MappedFile::moveFrom(MappedFile& other)
+{
+	ptr = other.ptr;
+	length = other.length;
+	other.ptr = nullptr;
+	other.length = 0;
+#ifdef _WIN32
+	file = other.file;
+	mapping = other.mapping;
+	other.file = nullptr;
+	other.mapping = nullptr;
+#else
+	fd = other.fd;
+	other.fd = -1;
+#endif
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (f == INVALID_HANDLE_VALUE)
+		return false;
+	file = f;
+
+	LARGE_INTEGER file_size;
+	//пустой файл отобразить нельзя, да и картинки в нем нет
+	if (!GetFileSizeEx(f, &file_size) || file_size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		close();
+		return false;
+	}
+
+	ptr = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!ptr)
+	{
+		close();
+		return false;
+	}
+	length = (size_t)file_size.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (ptr)
+		UnmapViewOfFile(ptr);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	ptr = nullptr;
+	length = 0;
+	mapping = nullptr;
+	file = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close();
+		return false;
+	}
+
+	void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	//читаем подряд - пусть ОС подкачивает страницы заранее
+	madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	ptr = (const unsigned char*)p;
+	length = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (ptr)
+		munmap((void*)ptr, length);
+	if (fd >= 0)
+		::close(fd);
+	ptr = nullptr;
+	length = 0;
+	fd = -1;
+}
+
+#endif
+
+std::string temporaryPath(const std::string& path)
+{
+	//счетчик - от потоков этого процесса, время - от других процессов с тем же кешем
+	static std::atomic<unsigned> counter(0);
+	auto now = (unsigned long long)std::chrono::steady_clock::now().time_since_epoch().count();
+	return path + "." + std::to_string(now) + "-" + std::to_string(counter++) + ".tmp";
+}
+
+bool replaceFile(const std::string& temporary, const std::string& path)
+{
+	//rename заменяет существующий файл целиком и на Windows (MoveFileEx с заменой)
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if (!error)
+		return true;
+	std::filesystem::remove(temporary, error);
+	return false;
+}
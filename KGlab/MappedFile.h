@@ -0,0 +1,65 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+//Файл, отображенный в память, только для чтения.
+//Страницы подкачивает ОС прямо из файлового кеша по мере чтения,
+//в наши буферы ничего не копируется и под весь файл память не выделяется.
+class MappedFile
+{
+public:
+
+	MappedFile() = default;
+	explicit MappedFile(const char* path)
+	{
+		open(path);
+	}
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	//false - файла нет или он пустой
+	bool open(const char* path);
+	void close();
+
+	bool isOpen() const
+	{
+		return ptr != nullptr;
+	}
+	const unsigned char* data() const
+	{
+		return ptr;
+	}
+	size_t size() const
+	{
+		return length;
+	}
+
+private:
+
+	const unsigned char* ptr = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+
+	void moveFrom(MappedFile& other);
+};
+
+//Кеши на диске пишутся во временный файл рядом (temporaryPath) и потом переименовываются
+//в настоящий (replaceFile): если процесс упадет посреди записи, останется недописанный
+//временный файл, а не обрезанный кеш, который потом прочитается.
+//Имена временных файлов разные у разных вызовов - можно писать из нескольких потоков
+std::string temporaryPath(const std::string& path);
+//false - не вышло, временный файл удален
+bool replaceFile(const std::string& temporary, const std::string& path);
+
+#endif
@@ -0,0 +1,289 @@
+#include "MeshArena.h"
+
+#include <chrono>
+#include <string>
+
+#include "GLState.h"
+#include "ImmediateBatch.h"
+#include "ProgramCache.h"
+#include "RenderModes.h"
+
+MeshArena staticScene;
+
+namespace
+{
+	const GLuint FAILED = ~0u;
+
+	const char* VERSION = "#version 430 compatibility";
+
+	const char* VERTEX_DECLARATIONS = R"(
+#extension GL_ARB_shader_draw_parameters : require
+
+struct Object
+{
+	vec4 offset_scale;
+	vec4 color;
+	vec4 params;
+};
+
+layout(std430, binding = 0) readonly buffer Objects
+{
+	Object objects[];
+};
+
+//номер первого объекта этого glMultiDrawElementsIndirect
+uniform int first_draw;
+
+out vec4 color;
+)";
+
+	//между ними - FIXED_LIGHTING_GLSL
+	const char* VERTEX_MAIN = R"(
+void main()
+{
+	Object o = objects[first_draw + gl_DrawIDARB];
+	float c = cos(o.params.x);
+	float s = sin(o.params.x);
+	mat2 turn = mat2(c, s, -s, c);
+	vec4 position = vec4(vec3(turn * gl_Vertex.xy, gl_Vertex.z) * o.offset_scale.w + o.offset_scale.xyz, 1.0);
+	gl_Position = gl_ModelViewProjectionMatrix * position;
+	color = gl_Color * o.color;
+#if LIGHTING
+	if (o.params.y > 0.5)
+		color.rgb = fixedLighting(vec3(turn * gl_Normal.xy, gl_Normal.z), position, color.rgb);
+#endif
+}
+)";
+
+	const char* FRAGMENT_SOURCE = R"(
+in vec4 color;
+out vec4 frag_color;
+
+void main()
+{
+	frag_color = color;
+}
+)";
+}
+
+
+int MeshArena::addMesh(const std::function<void()>& draw)
+{
+	std::vector<ImmediateBatch::Vertex> triangles, lines;
+	captureImmediate(draw, triangles, &lines);
+
+	//треугольники и линии сетки - с общими вершинами
+	MeshIndexer indexer(vertices, indices);
+	Mesh mesh;
+	mesh.base_vertex = indexer.baseVertex();
+	mesh.first_triangle = (GLuint)indices.size();
+	indexer.add(triangles);
+	mesh.triangle_indices = (GLuint)indices.size() - mesh.first_triangle;
+	mesh.first_line = (GLuint)indices.size();
+	indexer.add(lines);
+	mesh.line_indices = (GLuint)indices.size() - mesh.first_line;
+
+	meshes.push_back(mesh);
+	meshes_dirty = true;
+	return (int)meshes.size() - 1;
+}
+
+int MeshArena::addObject(int mesh, const Object& object)
+{
+	objects.push_back({ mesh, object });
+	objects_dirty = true;
+	return (int)objects.size() - 1;
+}
+
+void MeshArena::clearObjects()
+{
+	objects.clear();
+	objects_dirty = true;
+}
+
+GLuint MeshArena::program(bool lighting)
+{
+	const GLCaps& caps = glCaps();
+	if (!indirect || !caps.multi_draw_indirect || !caps.compatibility)
+		return 0;
+
+	int v = lighting ? 1 : 0;
+	if (!variants[v])
+	{
+		static const std::string vertex_source = std::string(VERTEX_DECLARATIONS) + FIXED_LIGHTING_GLSL + VERTEX_MAIN;
+		variants[v] = programs.get("arena", lighting ? ModeLighting : 0, VERSION, vertex_source.c_str(), FRAGMENT_SOURCE);
+		if (variants[v])
+			first_draw[v] = glfn.GetUniformLocation(variants[v], "first_draw");
+		if (!variants[v] || first_draw[v] < 0)
+			variants[v] = FAILED;
+	}
+	return variants[v] == FAILED ? 0 : variants[v];
+}
+
+void MeshArena::draw(bool lighting)
+{
+	auto start = std::chrono::steady_clock::now();
+	last_count = objects.size();
+	if (!objects.empty())
+	{
+		glState.disable(GL_TEXTURE_2D);
+		GLuint p = program(lighting);
+		drawn_indirect = p != 0;
+		if (p)
+			drawIndirect(p);
+		else
+			drawReplicated(lighting);
+	}
+	last_submit_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void MeshArena::upload()
+{
+	if (!vertex_buffer)
+	{
+		GLuint buffers[4];
+		glfn.GenBuffers(4, buffers);
+		vertex_buffer = buffers[0];
+		index_buffer = buffers[1];
+		command_buffer = buffers[2];
+		object_buffer = buffers[3];
+		meshes_dirty = objects_dirty = true;
+	}
+	if (meshes_dirty)
+	{
+		glfn.BindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+		glfn.BufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), vertices.data(), GL_STATIC_DRAW);
+		glfn.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+		glfn.BufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+		meshes_dirty = false;
+	}
+	if (!objects_dirty)
+		return;
+
+	//команды и объекты в одном порядке: i-я команда рисует i-й объект (gl_DrawIDARB)
+	std::vector<Command> commands;
+	std::vector<GpuObject> data;
+	for (int lines = 0; lines < 2; ++lines)
+	{
+		for (const auto& o : objects)
+		{
+			const Mesh& m = meshes[o.first];
+			GLuint count = lines ? m.line_indices : m.triangle_indices;
+			if (!count)
+				continue;
+			commands.push_back({ count, 1, lines ? m.first_line : m.first_triangle, m.base_vertex, 0 });
+			const Object& object = o.second;
+			GpuObject g = {
+				{ object.position[0], object.position[1], object.position[2], object.scale },
+				{ object.color[0], object.color[1], object.color[2], object.color[3] },
+				{ object.angle, object.lit ? 1.f : 0.f, 0, 0 }
+			};
+			data.push_back(g);
+		}
+		(lines ? line_draws : triangle_draws) = (GLsizei)commands.size() - (lines ? triangle_draws : 0);
+	}
+	glfn.BindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+	glfn.BufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(Command), commands.data(), GL_STATIC_DRAW);
+	glfn.BindBuffer(GL_SHADER_STORAGE_BUFFER, object_buffer);
+	glfn.BufferData(GL_SHADER_STORAGE_BUFFER, data.size() * sizeof(GpuObject), data.data(), GL_STATIC_DRAW);
+	glfn.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glfn.BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	objects_dirty = false;
+}
+
+void MeshArena::drawIndirect(GLuint program)
+{
+	imm.flush();
+	upload();
+
+	int v = program == variants[1] ? 1 : 0;
+	glState.useProgram(program);
+
+	bindMeshVertices(vertex_buffer, true);
+	glfn.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+	glfn.BindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+	glfn.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, object_buffer);
+
+	//gl_DrawIDARB в каждом вызове с нуля - номер первого объекта передается отдельно
+	if (triangle_draws)
+	{
+		glfn.Uniform1i(first_draw[v], 0);
+		glfn.MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, triangle_draws, 0);
+	}
+	if (line_draws)
+	{
+		glfn.Uniform1i(first_draw[v], triangle_draws);
+		glfn.MultiDrawElementsIndirect(GL_LINES, GL_UNSIGNED_INT, (const void*)(triangle_draws * sizeof(Command)), line_draws, 0);
+	}
+
+	glfn.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+	glfn.BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	unbindMeshVertices(true);
+}
+
+void MeshArena::drawReplicated(bool lighting)
+{
+	unsigned attributes = imm.enabledAttributes();
+
+	auto emit = [&](const Object& o, const Mesh& m, GLenum mode, GLuint first, GLuint count, bool normals)
+	{
+		MeshPlacement place(o.position, o.scale, o.angle);
+		imm.begin(mode);
+		for (GLuint i = first; i < first + count; ++i)
+		{
+			const MeshVertex& v = vertices[m.base_vertex + indices[i]];
+			imm.color4d(v.color[0] * o.color[0], v.color[1] * o.color[1], v.color[2] * o.color[2], v.color[3] * o.color[3]);
+			place.emit(v, normals);
+		}
+		imm.end();
+	};
+
+	//сначала все без освещения: линии и то, что светить не надо
+	glState.disable(GL_LIGHTING);
+	imm.setAttributes(ImmediateBatch::Colors);
+	for (size_t i = 0; i < objects.size(); ++i)
+	{
+		const Object& o = objects[i].second;
+		const Mesh& m = meshes[objects[i].first];
+		emit(o, m, GL_LINES, m.first_line, m.line_indices, false);
+		if (!lighting || !o.lit)
+			emit(o, m, GL_TRIANGLES, m.first_triangle, m.triangle_indices, false);
+		if ((i + 1) % REPLICATE_BATCH == 0)
+			imm.flush();
+	}
+
+	if (lighting)
+	{
+		glState.enable(GL_LIGHTING);
+		glState.enable(GL_COLOR_MATERIAL);
+		imm.setAttributes(ImmediateBatch::Normals | ImmediateBatch::Colors);
+		for (size_t i = 0; i < objects.size(); ++i)
+		{
+			const Object& o = objects[i].second;
+			const Mesh& m = meshes[objects[i].first];
+			if (o.lit)
+				emit(o, m, GL_TRIANGLES, m.first_triangle, m.triangle_indices, true);
+			if ((i + 1) % REPLICATE_BATCH == 0)
+				imm.flush();
+		}
+		glState.disable(GL_COLOR_MATERIAL);
+	}
+
+	imm.setAttributes(attributes);
+}
+
+void MeshArena::release()
+{
+	if (vertex_buffer)
+	{
+		GLuint buffers[] = { vertex_buffer, index_buffer, command_buffer, object_buffer };
+		glfn.DeleteBuffers(4, buffers);
+	}
+	vertex_buffer = index_buffer = command_buffer = object_buffer = 0;
+	meshes_dirty = objects_dirty = true;
+	for (int v = 0; v < 2; ++v)
+	{
+		variants[v] = 0;
+		first_draw[v] = -1;
+	}
+}
@@ -0,0 +1,141 @@
+#ifndef MESHARENA_H
+#define MESHARENA_H
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "GLLoader.h"
+#include "MeshBuilder.h"
+
+//Общая арена статической геометрии: все сетки в одном буфере вершин и одном буфере индексов,
+//все объекты - одним glMultiDrawElementsIndirect на тип примитивов (треугольники, линии).
+//Сетка один раз записывается из обычного рисования через imm, объект - сетка плюс
+//сдвиг, масштаб, поворот вокруг Z и цвет (умножается на цвет вершин):
+//    int mesh = arena.addMesh([]() { drawThing(); });
+//    arena.addObject(mesh, object);   //когда сцена поменялась
+//    arena.draw(lighting);            //каждый кадр
+//Команды отрисовки и данные объектов (буфер хранения, шейдер берет свой объект по gl_DrawIDARB)
+//заливаются, только когда объекты поменялись, поэтому число вызовов GL и время на процессоре
+//за кадр не зависят от числа объектов. Освещение - FIXED_LIGHTING_GLSL (MeshBuilder.h).
+//Без GLCaps::multi_draw_indirect или профиля совместимости объекты рисуются по одному
+//через imm - та же картинка, только медленно. Только поток рендера.
+class MeshArena
+{
+public:
+
+	struct Object
+	{
+		float position[3] = { 0, 0, 0 };
+		float scale = 1;
+		float color[4] = { 1, 1, 1, 1 };
+		//поворот вокруг Z, радианы
+		float angle = 0;
+		//false - цвет как есть и без освещения (оси, подписи)
+		bool lit = true;
+	};
+
+	//записывает треугольники, четырехугольники и линии, нарисованные draw через imm.
+	//Возвращает номер сетки
+	int addMesh(const std::function<void()>& draw);
+	bool hasMeshes() const
+	{
+		return !meshes.empty();
+	}
+
+	int addObject(int mesh, const Object& object);
+	void clearObjects();
+	size_t objectCount() const
+	{
+		return objects.size();
+	}
+
+	void draw(bool lighting);
+
+	//false - рисовать по одному объекту через imm и там, где есть multi draw indirect (для замеров)
+	void setIndirect(bool on)
+	{
+		indirect = on;
+	}
+	//нарисовал ли последний draw() все одним вызовом на тип примитивов
+	bool isIndirect() const
+	{
+		return drawn_indirect;
+	}
+
+	//объектов и время draw() на процессоре в последнем кадре, мс
+	size_t lastCount() const
+	{
+		return last_count;
+	}
+	double lastSubmitMs() const
+	{
+		return last_submit_ms;
+	}
+
+	//удаляет буферы (например, перед сменой контекста); сетки и объекты остаются
+	void release();
+
+private:
+
+	//индексы сетки: треугольники, потом линии, номера вершин - от base_vertex
+	struct Mesh
+	{
+		GLint base_vertex;
+		GLuint first_triangle, triangle_indices;
+		GLuint first_line, line_indices;
+	};
+
+	//как в GL: аргументы одной отрисовки из буфера GL_DRAW_INDIRECT_BUFFER
+	struct Command
+	{
+		GLuint count;
+		GLuint instances;
+		GLuint first_index;
+		GLint base_vertex;
+		GLuint base_instance;
+	};
+
+	//объект в буфере хранения, std430
+	struct GpuObject
+	{
+		float offset_scale[4];
+		float color[4];
+		//x - поворот, y - освещать ли
+		float params[4];
+	};
+
+	GLuint program(bool lighting);
+	void upload();
+	void drawIndirect(GLuint program);
+	void drawReplicated(bool lighting);
+
+	std::vector<MeshVertex> vertices;
+	std::vector<GLuint> indices;
+	std::vector<Mesh> meshes;
+	std::vector<std::pair<int, Object>> objects;
+	bool indirect = true;
+	bool drawn_indirect = false;
+
+	//0 - еще не собиралась, ~0 - не собралась
+	GLuint variants[2] = {};
+	GLint first_draw[2] = { -1, -1 };
+
+	GLuint vertex_buffer = 0;
+	GLuint index_buffer = 0;
+	GLuint command_buffer = 0;
+	GLuint object_buffer = 0;
+	bool meshes_dirty = true;
+	bool objects_dirty = true;
+	//сколько команд каждого типа лежит в command_buffer: сначала треугольники, потом линии
+	GLsizei triangle_draws = 0;
+	GLsizei line_draws = 0;
+
+	size_t last_count = 0;
+	double last_submit_ms = 0;
+};
+
+//оси и нагрузочная сцена в режиме GeometryPath::Indirect (см. Render.h)
+extern MeshArena staticScene;
+
+#endif
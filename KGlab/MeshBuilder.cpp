@@ -0,0 +1,100 @@
+#include "MeshBuilder.h"
+
+#include <cmath>
+#include <cstddef>
+
+#include "GLState.h"
+
+const char* const FIXED_LIGHTING_GLSL = R"(
+vec3 fixedLighting(vec3 normal, vec4 position, vec3 color)
+{
+	vec3 n = normalize(gl_NormalMatrix * normal);
+	vec3 eye = (gl_ModelViewMatrix * position).xyz;
+	vec4 light = gl_LightSource[0].position;
+	vec3 l = normalize(light.xyz - eye * light.w);
+	float lambert = max(dot(n, l), 0.0);
+	float blinn = lambert > 0.0 ? pow(max(dot(n, normalize(l + vec3(0.0, 0.0, 1.0))), 0.0), gl_FrontMaterial.shininess) : 0.0;
+	vec3 lit = (gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb) * color +
+		gl_LightSource[0].diffuse.rgb * color * lambert +
+		gl_LightSource[0].specular.rgb * gl_FrontMaterial.specular.rgb * blinn;
+	return clamp(lit, 0.0, 1.0);
+}
+)";
+
+
+void captureImmediate(const std::function<void()>& draw,
+	std::vector<ImmediateBatch::Vertex>& triangles, std::vector<ImmediateBatch::Vertex>* lines)
+{
+	bool direct = imm.isDirect();
+	imm.setDirect(false);
+	imm.capture(&triangles, lines);
+	draw();
+	imm.capture(nullptr);
+	imm.setDirect(direct);
+}
+
+MeshIndexer::MeshIndexer(std::vector<MeshVertex>& vertices, std::vector<GLuint>& indices)
+	: vertices(vertices), indices(indices), base_vertex((GLint)vertices.size())
+{
+}
+
+void MeshIndexer::add(const std::vector<ImmediateBatch::Vertex>& list)
+{
+	for (const ImmediateBatch::Vertex& v : list)
+	{
+		const float* n = v.normal;
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length > 0)
+			length = 1 / length;
+		std::array<float, 10> key = { v.pos[0], v.pos[1], v.pos[2], n[0] * length, n[1] * length, n[2] * length,
+			v.color[0], v.color[1], v.color[2], v.color[3] };
+		auto it = seen.find(key);
+		if (it == seen.end())
+		{
+			it = seen.emplace(key, (GLuint)(vertices.size() - base_vertex)).first;
+			vertices.push_back({ { key[0], key[1], key[2] }, { key[3], key[4], key[5] },
+				{ key[6], key[7], key[8], key[9] } });
+		}
+		indices.push_back(it->second);
+	}
+}
+
+MeshPlacement::MeshPlacement(const float position[3], float scale, float angle)
+	: cs(std::cos(angle)), sn(std::sin(angle)), scale(scale), position(position)
+{
+}
+
+void MeshPlacement::emit(const MeshVertex& v, bool normals) const
+{
+	if (normals)
+		imm.normal3d(cs * v.normal[0] - sn * v.normal[1], sn * v.normal[0] + cs * v.normal[1], v.normal[2]);
+	imm.vertex3d((cs * v.pos[0] - sn * v.pos[1]) * scale + position[0],
+		(sn * v.pos[0] + cs * v.pos[1]) * scale + position[1],
+		v.pos[2] * scale + position[2]);
+}
+
+void bindMeshVertices(GLuint buffer, bool colors)
+{
+	glfn.BindBuffer(GL_ARRAY_BUFFER, buffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex), (const void*)offsetof(MeshVertex, pos));
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(GL_FLOAT, sizeof(MeshVertex), (const void*)offsetof(MeshVertex, normal));
+	if (colors)
+	{
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(4, GL_FLOAT, sizeof(MeshVertex), (const void*)offsetof(MeshVertex, color));
+	}
+}
+
+void unbindMeshVertices(bool colors)
+{
+	if (colors)
+		glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	//как и после imm.flush() (см. ImmediateBatch.cpp)
+	glfn.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glfn.BindBuffer(GL_ARRAY_BUFFER, 0);
+	glState.useProgram(0);
+}
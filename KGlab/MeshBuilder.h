@@ -0,0 +1,84 @@
+#ifndef MESHBUILDER_H
+#define MESHBUILDER_H
+
+#include <array>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "GLLoader.h"
+#include "ImmediateBatch.h"
+
+//Общее у сеток из буферов, записанных через imm (InstancedMesh.h, MeshArena.h):
+//запись, индексация вершин, освещение в шейдере и размножение копий на процессоре.
+//Только поток рендера.
+
+//вершина в буфере: координаты, единичная нормаль, цвет
+struct MeshVertex
+{
+	float pos[3];
+	float normal[3];
+	float color[4];
+};
+
+//запоминает треугольники (и линии, если lines задан), нарисованные draw через imm, вместо того чтобы рисовать
+void captureImmediate(const std::function<void()>& draw,
+	std::vector<ImmediateBatch::Vertex>& triangles, std::vector<ImmediateBatch::Vertex>* lines = nullptr);
+
+//Складывает записанные вершины в vertices/indices: одинаковые вершины соседних примитивов -
+//один раз, дальше по индексу. Индексы - от baseVertex(): сколько вершин было до индексатора
+class MeshIndexer
+{
+public:
+
+	MeshIndexer(std::vector<MeshVertex>& vertices, std::vector<GLuint>& indices);
+
+	void add(const std::vector<ImmediateBatch::Vertex>& list);
+
+	GLint baseVertex() const
+	{
+		return base_vertex;
+	}
+
+private:
+
+	std::vector<MeshVertex>& vertices;
+	std::vector<GLuint>& indices;
+	GLint base_vertex;
+	std::map<std::array<float, 10>, GLuint> seen;
+};
+
+//Освещение по вершинам как у фиксированного конвейера с GL_COLOR_MATERIAL: цвет -
+//фоновый и рассеянный, зеркальная часть - из материала, GL_LIGHT0, наблюдатель на бесконечности.
+//Исходник функции GLSL
+//    vec3 fixedLighting(vec3 normal, vec4 position, vec3 color)
+//(нормаль и точка - в координатах модели). Встроенные gl_LightSource и т.п. есть только
+//в профиле совместимости. Вставляется в шейдер перед main
+extern const char* const FIXED_LIGHTING_GLSL;
+
+//без шейдера: столько копий на пачку imm, чтобы массив вершин не рос без предела
+const size_t REPLICATE_BATCH = 256;
+
+//поворот вокруг Z, масштаб и сдвиг копии - как в шейдерах
+class MeshPlacement
+{
+public:
+
+	MeshPlacement(const float position[3], float scale, float angle);
+
+	//imm.normal3d (если normals) и imm.vertex3d для вершины сетки
+	void emit(const MeshVertex& v, bool normals) const;
+
+private:
+
+	double cs, sn;
+	double scale;
+	const float* position;
+};
+
+//координаты и нормали (и цвет, если colors) из буфера buffer для glDrawElements*;
+//unbind снимает то же, а заодно буферы индексов и программу
+void bindMeshVertices(GLuint buffer, bool colors);
+void unbindMeshVertices(bool colors);
+
+#endif
@@ -1,8 +1,10 @@
 ﻿#include "MyOGL.h"
 #include <stdio.h>
-#include <Math.h>
-#include <GL/gl.h>
-#include <GL/glu.h>
+#include <math.h>
+#include "GLLoader.h"
+#include "GLState.h"
+#include "ImmediateBatch.h"
+#include "DisplayListCache.h"
 
 #include <mutex>
 #include <thread>
@@ -16,10 +18,7 @@
 
 OpenGL gl;
 
-HWND wnd;
-
 //блокировщики
-std::mutex					hwnd_mutex;
 std::mutex					message_mutex;
 std::condition_variable		message_cv;
 bool						have_message=true;
@@ -35,18 +34,15 @@ std::thread gl_thread;
 std::thread msg_thread;
 std::deque<Message> msg_deque;
 
+//время старта, от него считается время до первого кадра
+const auto app_start = std::chrono::steady_clock::now();
+
 std::atomic_bool bRender;
 std::atomic_bool bMsg;
 
 void render_cycle ();
 void message_cycle();
 
-void setHwnd(HWND window)
-{
-	std::lock_guard<std::mutex> guard(hwnd_mutex);
-	gl.setHWND(window);
-}
-
 void start_gl_thread()
 {
 	bRender = true;
@@ -81,14 +77,19 @@ void stop_all_threads()
 
 void render_cycle ()
 {	
-		gl.init();
+		if (!gl.init())
+		{
+			platformDebugOutput("failed to create OpenGL context\n");
+			return;
+		}
 
 		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-		glEnable(GL_DEPTH_TEST);
+		glState.enable(GL_DEPTH_TEST);
 
 		initRender();
 
 		auto end_render = std::chrono::steady_clock::now();
+		bool first_frame = true;
 	
 		while (bRender)
 		{
@@ -97,16 +98,68 @@ void render_cycle ()
 			double delta = 1.0*std::chrono::duration_cast<std::chrono::microseconds>(deltatime).count()/1000000;
 			end_render = cur_time;
 			gl.render(delta);
+
+			if (first_frame)
+			{
+				first_frame = false;
+				char buf[128];
+				snprintf(buf, sizeof(buf), "time to first frame: %.1f ms\n",
+					std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - app_start).count());
+				platformDebugOutput(buf);
+			}
 		}
+
+		shutdownRender();
+		platformDestroyContext();
+}
+
+void dispatch_message(const Message& m)
+{
+	switch (m.type)
+	{
+		case Message::MouseLeave:
+			gl.mouseLeave((short)m.x, (short)m.y);
+			break;
+		case Message::Wheel:
+			gl.wheelEvent(m.wheel);
+			break;	
+		case Message::MouseMove:
+			gl.mouseMovie((short)m.x, (short)m.y);
+			break;
+		case Message::Resize:
+			gl.try_to_resize(m.x, m.y);
+			break;
+		case Message::MouseDown:
+			if (m.key == KEY_LBUTTON)
+				gl.mouseLdown((short)m.x, (short)m.y);
+			else if (m.key == KEY_RBUTTON)
+				gl.mouseRdown((short)m.x, (short)m.y);
+			else
+				gl.mouseMdown((short)m.x, (short)m.y);
+			break;
+		case Message::MouseUp:
+			if (m.key == KEY_LBUTTON)
+				gl.mouseLup((short)m.x, (short)m.y);
+			else if (m.key == KEY_RBUTTON)
+				gl.mouseRup((short)m.x, (short)m.y);
+			else
+				gl.mouseMup((short)m.x, (short)m.y);
+			break;
+		case Message::KeyUp:
+			gl.keyUp(m.key);
+			break;
+		case Message::KeyDown:
+			gl.keyDown(m.key);
+			break;
+		default:
+			break;
+	}
 }
 
 void message_cycle()
 {
 	while (bMsg)
 	{
-		short mouseX = -1;
-		short mouseY = -1;
-
 		std::unique_lock<std::mutex> lock(message_mutex);
 		message_cv.wait(lock, [&]() {return have_message; });
 
@@ -115,52 +168,14 @@ void message_cycle()
 			auto m = msg_deque.front();
 			msg_deque.pop_front();
 
-			switch (m.message)
+			if (m.type == Message::Close)
 			{
-				case WM_MOUSELEAVE:
-					gl.mouseLeave(mouseX, mouseY);
-					break;
-				case WM_MOUSEWHEEL:		
-					gl.wheelEvent(GET_WHEEL_DELTA_WPARAM(m.wParam));
-					break;	
-				case WM_MOUSEMOVE:
-					mouseX = (short)LOWORD(m.lParam);
-					mouseY = (short)HIWORD(m.lParam);
-					gl.mouseMovie((short)LOWORD(m.lParam), (short)HIWORD(m.lParam));
-					break;
-				case WM_SIZE:
-					gl.try_to_resize((short)LOWORD(m.lParam), (short)HIWORD(m.lParam));
-					break;
-				case WM_LBUTTONDOWN:
-					gl.mouseLdown((short)LOWORD(m.lParam), (short)HIWORD(m.lParam));
-					break;
-				case WM_LBUTTONUP:
-					gl.mouseLup((short)LOWORD(m.lParam), (short)HIWORD(m.lParam));
-					break;
-				case WM_RBUTTONDOWN:
-					gl.mouseRdown((short)LOWORD(m.lParam), (short)HIWORD(m.lParam));
-					break;
-				case WM_RBUTTONUP:
-					gl.mouseRup((short)LOWORD(m.lParam), (short)HIWORD(m.lParam));
-					break;
-				case WM_MBUTTONDOWN:
-					gl.mouseMdown((short)LOWORD(m.lParam), (short)HIWORD(m.lParam));
-					break;
-				case WM_MBUTTONUP:
-					gl.mouseMup((short)LOWORD(m.lParam), (short)HIWORD(m.lParam));
-					break;
-				case WM_KEYUP:
-					gl.keyUp(m.wParam);
-					break;
-				case WM_KEYDOWN:
-					gl.keyDown(m.wParam);
-					break;
-				case WM_CLOSE:
-					//b_render = false;
-					bMsg = false;
-					msg_deque.clear();
-					break;									
-			}	
+				//b_render = false;
+				bMsg = false;
+				msg_deque.clear();
+				break;
+			}
+			dispatch_message(m);
 		}
 		if (!bMsg) break;
 		have_message = false;
@@ -178,13 +193,6 @@ OpenGL::~OpenGL()
 
 }
 
-void OpenGL::setHWND(HWND window)
-{
-	g_hWnd = window;
-}
-
-
-
 void OpenGL::wheelEvent(float delta)
 {
 	MouseWheelEventArg arg{ delta };
@@ -264,34 +272,47 @@ void OpenGL::keyUp(int key)
 }
 
 
+void OpenGL::AxesGeometry()
+{
+	imm.begin(GL_LINES);
+	imm.color3d(1, 0, 0);
+	imm.vertex3d(0, 0, 0);
+	imm.vertex3d(10, 0, 0);
+
+	imm.color3d(0, 1, 0);
+	imm.vertex3d(0, 0, 0);
+	imm.vertex3d(0, 10, 0);
+
+	imm.color3d(0, 0, 1);
+	imm.vertex3d(0, 0, 0);
+	imm.vertex3d(0, 0, 10);
+	imm.end();
+}
+
 void OpenGL::DrawAxes()
 {
-	glDisable(GL_LIGHTING);
-	glDisable(GL_TEXTURE_2D);
-
-	glBegin(GL_LINES);
-	glColor3f(1, 0, 0);
-	glVertex3d(0, 0, 0);
-	glVertex3d(10, 0, 0);
-
-	glColor3f(0, 1, 0);
-	glVertex3d(0, 0, 0);
-	glVertex3d(0, 10, 0);
-
-	glColor3f(0, 0, 1);
-	glVertex3d(0, 0, 0);
-	glVertex3d(0, 0, 10);
-	glEnd();
+	glState.disable(GL_LIGHTING);
+	glState.disable(GL_TEXTURE_2D);
+
+	//оси не меняются - входов у них нет
+	displayLists.draw("axes", 0, &OpenGL::AxesGeometry);
 	
 	
 
-	glColor3f(0.0f, 0.0f, 0.0f);
+	imm.color3d(0.0f, 0.0f, 0.0f);
 
 }
 
 
 void OpenGL::render(double delta)
 {
+	//замеры этапов кадра для графика времени кадров
+	auto ms_since = [](std::chrono::steady_clock::time_point t)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+	};
+	stats.beginFrame();
+	auto stage_start = std::chrono::steady_clock::now();
 	
 	glMatrixMode(GL_MODELVIEW);
 
@@ -309,18 +330,28 @@ void OpenGL::render(double delta)
 		events_for_render.clear();
 		
 	}
+	stats.setStage(FrameStats::Events, ms_since(stage_start));
+	stage_start = std::chrono::steady_clock::now();
 	
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glLoadIdentity();
 			
 
-	glDisable(GL_LIGHTING);
+	glState.disable(GL_LIGHTING);
 		
 	
 	Render(delta);
+	imm.flush();
+	stats.setStage(FrameStats::Scene, ms_since(stage_start));
+	stage_start = std::chrono::steady_clock::now();
 
 
-	SwapBuffers(g_hDC);
+	if (headless)
+		glFinish();
+	else
+		platformSwapBuffers();
+	stats.setStage(FrameStats::Swap, ms_since(stage_start));
+	stats.endFrame();
 }
 
 void OpenGL::try_to_resize(int w, int h)
@@ -334,7 +365,7 @@ void OpenGL::resize(int w, int h)
 {
 	width = w;
 	height = h;
-	glViewport(0, 0, width, height);	
+	glState.viewport(0, 0, width, height);	
 		
 	glMatrixMode(GL_PROJECTION);		
 	glLoadIdentity();	
@@ -345,45 +376,8 @@ void OpenGL::resize(int w, int h)
 	glLoadIdentity();									
 }
 
-void OpenGL::init(void)
+bool OpenGL::init(void)
 {
-	PIXELFORMATDESCRIPTOR pfd;
-	memset(&pfd, 0, sizeof(PIXELFORMATDESCRIPTOR));
-
-	pfd.nSize = sizeof(PIXELFORMATDESCRIPTOR);
-	pfd.nVersion = 1;
-	pfd.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER;
-	pfd.iPixelType = PFD_TYPE_RGBA;
-	pfd.cColorBits = 16;
-	pfd.cDepthBits = 16;
-
-	g_hDC = GetDC(g_hWnd);
-	GLuint iPixelFormat = ChoosePixelFormat(g_hDC, &pfd);
-
-	if (iPixelFormat != 0)
-	{
-		PIXELFORMATDESCRIPTOR bestMatch_pfd;
-		DescribePixelFormat(g_hDC, iPixelFormat, sizeof(pfd), &bestMatch_pfd);
-
-		if (bestMatch_pfd.cDepthBits < pfd.cDepthBits)
-		{
-			return;
-		}
-
-		if (SetPixelFormat(g_hDC, iPixelFormat, &pfd) == FALSE)
-		{
-			DWORD dwErrorCode = GetLastError();
-			return;
-		}
-	}
-	else
-	{
-		DWORD dwErrorCode = GetLastError();
-		return;
-	}
-
-	g_hRC = wglCreateContext(g_hDC);
-	wglMakeCurrent(g_hDC, g_hRC);
-
+	//OpenGL 3.3 (или выше) в совместимом профиле, функции новее 1.1 - в glfn
+	return platformCreateContext() && loadGL();
 }
-
@@ -1,22 +1,16 @@
 ﻿#pragma once
 
-#include <Windows.h>
 #include <atomic>
 
 #include "Event.h"
-
-struct Message
-{
-	UINT message;
-	WPARAM wParam;
-	LPARAM lParam;
-};
-
+#include "FrameStats.h"
+#include "InputJournal.h"
+#include "Platform.h"
 
 
-void setHwnd(HWND window);
-
 void add_message(Message msg);
+//отдает сообщение в OpenGL (события для потока рендера) - так же, как поток сообщений
+void dispatch_message(const Message& m);
 
 void start_gl_thread();
 void start_msg_thread();
@@ -45,9 +39,6 @@ struct KeyEventArg
 
 class OpenGL
 {
-	
-	HDC g_hDC;
-	HGLRC g_hRC;
 
 	std::atomic_int tmp_width, tmp_height;
 	
@@ -63,9 +54,10 @@ class OpenGL
 
 	std::mutex events_mutex;
 	std::list<std::function<void(void)>> events_for_render;
-	HWND g_hWnd;
 	std::atomic_int width, height;
 
+	bool headless = false;
+
 
 public:
 
@@ -85,6 +77,9 @@ public:
 	Event<OpenGL*, KeyEventArg> KeyUpEvent;
 	Event<OpenGL*, KeyEventArg> KeyDownEvent;
 
+	//история времени кадров, заполняется в render()
+	FrameStats stats;
+
 	int getHeight()
 	{
 		return height;
@@ -97,8 +92,6 @@ public:
 
 
 
-	void setHWND(HWND window);
-
 	void wheelEvent(float delta);
 	void mouseMovie(short mX, short mY);
 	void mouseLeave(short mX, short mY);
@@ -116,20 +109,31 @@ public:
 	void keyUp(int key);
 
 	void DrawAxes();
+	//только линии осей через imm, без состояния (для display list'а и MeshArena.h)
+	static void AxesGeometry();
 
 	void render(double);
 
 	void resize(int w, int h);
 	void try_to_resize(int w, int h);
 
-	void init(void);
+	//false - не удалось создать контекст OpenGL
+	bool init(void);
+
+	//Пакетный режим: кадр рисуется в FBO, вместо SwapBuffers - glFinish,
+	//чтобы время кадра включало и работу видеокарты
+	void setHeadless(bool on)
+	{
+		headless = on;
+	}
 
 
 	static bool isKeyPressed(int key)
 	{
-		short state = GetAsyncKeyState(key);
-
-		return (bool)(state & 0x8000);
+		//при проигрывании журнала клавиши - из него (см. InputJournal.h)
+		if (InputReplay* replay = InputReplay::active())
+			return replay->keyPressed(key);
+		return platformKeyPressed(key);
 	}
 
 };
@@ -0,0 +1,158 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+//Прослойка между движком и ОС: окно, контекст OpenGL, ввод, отладочный вывод, текст.
+//Реализаций две, собирается одна (по _WIN32):
+// - PlatformWin32.cpp - WinAPI, WGL, GDI;
+// - PlatformX11.cpp - Xlib, GLX, шрифты X-сервера, EGL для работы без окна.
+//   Под Linux все собирается так: g++ -std=c++17 -O2 *.cpp -lX11 -lEGL -lGL -lGLU -lpthread
+//Время везде меряем std::chrono::steady_clock - он и так переносимый
+//(в MSVC он сделан на QueryPerformanceCounter).
+
+#ifdef _WIN32
+//без него GL/gl.h под Windows не компилируется (WINGDIAPI, APIENTRY)
+#include <windows.h>
+#endif
+
+#include <cstddef>
+
+//Коды клавиш - те же, что виртуальные коды Windows.
+//Буквы и цифры - их ASCII-коды ('A'..'Z', '0'..'9')
+enum PlatformKey
+{
+	KEY_LBUTTON = 0x01,
+	KEY_RBUTTON = 0x02,
+	KEY_MBUTTON = 0x04,
+	KEY_BACK = 0x08,
+	KEY_TAB = 0x09,
+	KEY_RETURN = 0x0D,
+	KEY_SHIFT = 0x10,
+	KEY_CONTROL = 0x11,
+	KEY_ESCAPE = 0x1B,
+	KEY_SPACE = 0x20,
+	KEY_LEFT = 0x25,
+	KEY_UP = 0x26,
+	KEY_RIGHT = 0x27,
+	KEY_DOWN = 0x28,
+	//F2..F12 идут подряд
+	KEY_F1 = 0x70,
+};
+
+//сообщение окна, одинаковое для всех платформ
+struct Message
+{
+	enum Type
+	{
+		MouseMove,
+		MouseLeave,
+		MouseDown,
+		MouseUp,
+		Wheel,
+		KeyDown,
+		KeyUp,
+		Resize,
+		Close,
+	};
+
+	Type type;
+	//мышь в пикселях от левого верхнего угла окна, для Resize - новый размер
+	int x = 0;
+	int y = 0;
+	//клавиша, для MouseDown/MouseUp - кнопка (KEY_LBUTTON, KEY_RBUTTON, KEY_MBUTTON)
+	int key = 0;
+	//поворот колесика, как в Windows: 120 на щелчок
+	float wheel = 0;
+};
+
+typedef void (*MessageHandler)(const Message& msg);
+
+//создает и показывает окно. Сообщения уходят в handler в потоке,
+//который крутит platformRunMessageLoop (первые - еще до ее запуска, прямо отсюда)
+bool platformCreateWindow(const wchar_t* title, MessageHandler handler);
+
+//разбирает сообщения окна, пока его не закроют.
+//На Close окно разрушается после возврата из handler -
+//к этому моменту поток рендера должен быть остановлен
+void platformRunMessageLoop();
+
+//Какой контекст OpenGL просить (WGL_ARB_create_context, GLX_ARB_create_context, EGL_KHR_create_context).
+//Драйвер может дать версию и выше. Если такой не дали совсем - берется старый контекст
+//(wglCreateContext и т.п.), какой он получился - см. glCaps() в GLLoader.h
+struct GLContextSettings
+{
+	int major = 3;
+	int minor = 3;
+	//совместимый профиль: рендер рисует через glBegin/glEnd, в core их нет
+	bool compatibility = true;
+	//отладочный контекст (GL_KHR_debug), медленнее
+	bool debug = false;
+};
+
+//создает контекст OpenGL для окна и делает его текущим в вызвавшем потоке.
+//Буфер кадра - RGBA8, глубина 24 бита, трафарет 8 бит
+bool platformCreateContext(const GLContextSettings& settings = GLContextSettings());
+//Контекст без окна (пакетный режим): рисовать можно только в свой FBO.
+//Под Linux - EGL без поверхности, работает и на серверах без видеокарты (Mesa llvmpipe),
+//под Windows - контекст невидимого окна
+bool platformCreateHeadlessContext(const GLContextSettings& settings = GLContextSettings());
+void platformDestroyContext();
+void platformSwapBuffers();
+
+//адрес функции OpenGL новее 1.1, nullptr - драйвер ее не знает.
+//Нужен активный контекст. Обычно не нужна: все такие функции грузит loadGL() (GLLoader.h)
+void* platformGetProcAddress(const char* name);
+
+//нажата ли клавиша или кнопка мыши прямо сейчас, из любого потока
+bool platformKeyPressed(int key);
+
+//строка в отладчик (Windows) или в stderr. Как и OutputDebugString, только в отладочной сборке
+void platformDebugOutput(const char* text);
+
+//для --smoke-test: шлет своему окну через очередь ОС движение мыши, щелчок левой кнопкой,
+//щелчок колесика, нажатие и отпускание 'L' и последним - закрытие окна,
+//так что проходят весь разбор сообщений платформы. Можно из любого потока
+void platformSendTestInput();
+
+
+class TextRasterPrivate;
+
+//Растеризатор текста шрифтами ОС (GDI или шрифты X-сервера).
+//Рисует белым по черному в свой холст, mask() - яркость, байт на пиксель, строки сверху вниз.
+//Один объект - один поток, но потоков со своими объектами может быть сколько угодно
+class TextRaster
+{
+public:
+
+	TextRaster();
+	~TextRaster();
+
+	TextRaster(const TextRaster&) = delete;
+	TextRaster& operator=(const TextRaster&) = delete;
+
+	//холст width x height, жирный шрифт face высотой font_height пикселей.
+	//antialias = false - в маске только 0 и 255.
+	//Если такого шрифта нет, берется похожий
+	bool init(int width, int height, const wchar_t* face, int font_height, bool antialias);
+
+	int width() const;
+	int height() const;
+
+	//заливает холст черным
+	void clear();
+	//текст от (x, y) - левого верхнего угла первой строки, '\n' переводит строку
+	void draw(const wchar_t* text, int x, int y);
+	//ширина строки в пикселях
+	int textWidth(const wchar_t* text, size_t length);
+
+	//маска width * height, действительна до следующего вызова
+	const unsigned char* mask();
+
+private:
+
+	TextRasterPrivate* d = nullptr;
+
+	//init прошел успешно
+	bool ready() const;
+};
+
+#endif
@@ -0,0 +1,422 @@
+#ifdef _WIN32
+
+#include "Platform.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+
+//WGL_ARB_create_context, в wingdi.h его нет
+#define WGL_CONTEXT_MAJOR_VERSION_ARB 0x2091
+#define WGL_CONTEXT_MINOR_VERSION_ARB 0x2092
+#define WGL_CONTEXT_FLAGS_ARB 0x2094
+#define WGL_CONTEXT_PROFILE_MASK_ARB 0x9126
+#define WGL_CONTEXT_DEBUG_BIT_ARB 0x0001
+#define WGL_CONTEXT_CORE_PROFILE_BIT_ARB 0x0001
+#define WGL_CONTEXT_COMPATIBILITY_PROFILE_BIT_ARB 0x0002
+
+
+namespace
+{
+	typedef HGLRC(WINAPI* CreateContextAttribsFunc)(HDC dc, HGLRC share, const int* attribs);
+
+	HWND window = NULL;
+	HDC window_dc = NULL;
+	HGLRC context = NULL;
+	MessageHandler message_handler = nullptr;
+	bool track_mouse = false;
+
+	void send(const Message& m)
+	{
+		if (message_handler)
+			message_handler(m);
+	}
+
+	Message mouseMessage(Message::Type type, LPARAM lParam, int button = 0)
+	{
+		Message m{ type };
+		m.x = (short)LOWORD(lParam);
+		m.y = (short)HIWORD(lParam);
+		m.key = button;
+		return m;
+	}
+
+	LRESULT CALLBACK WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+	{
+		switch (uMsg)
+		{
+			case WM_MOUSELEAVE:
+				track_mouse = false;
+				send(Message{ Message::MouseLeave });
+				return 0;
+
+			case WM_LBUTTONDOWN:
+			case WM_RBUTTONDOWN:
+			case WM_MBUTTONDOWN:
+			{
+				SetCapture(hWnd);
+				int button = uMsg == WM_LBUTTONDOWN ? KEY_LBUTTON : uMsg == WM_RBUTTONDOWN ? KEY_RBUTTON : KEY_MBUTTON;
+				send(mouseMessage(Message::MouseDown, lParam, button));
+				return 0;
+			}
+			case WM_LBUTTONUP:
+			case WM_RBUTTONUP:
+			case WM_MBUTTONUP:
+			{
+				ReleaseCapture();
+				int button = uMsg == WM_LBUTTONUP ? KEY_LBUTTON : uMsg == WM_RBUTTONUP ? KEY_RBUTTON : KEY_MBUTTON;
+				send(mouseMessage(Message::MouseUp, lParam, button));
+				return 0;
+			}
+
+			case WM_KEYDOWN:
+			case WM_KEYUP:
+			{
+				Message m{ uMsg == WM_KEYDOWN ? Message::KeyDown : Message::KeyUp };
+				//наши коды клавиш и есть виртуальные коды
+				m.key = (int)wParam;
+				send(m);
+				return 0;
+			}
+			case WM_MOUSEWHEEL:
+			{
+				Message m{ Message::Wheel };
+				m.wheel = GET_WHEEL_DELTA_WPARAM(wParam);
+				send(m);
+				return 0;
+			}
+			case WM_MOUSEMOVE:
+			{
+				if (!track_mouse)
+				{
+					TRACKMOUSEEVENT tme_arg;
+					tme_arg.cbSize = sizeof(TRACKMOUSEEVENT);
+					tme_arg.dwFlags = TME_LEAVE;
+					tme_arg.dwHoverTime = HOVER_DEFAULT;
+					tme_arg.hwndTrack = hWnd;
+					track_mouse = TrackMouseEvent(&tme_arg);
+				}
+				send(mouseMessage(Message::MouseMove, lParam));
+				return 0;
+			}
+			case WM_SIZE:
+				send(mouseMessage(Message::Resize, lParam));
+				return 0;
+
+			case WM_CLOSE:
+				send(Message{ Message::Close });
+				DestroyWindow(hWnd);
+				return 0;
+			case WM_DESTROY:
+				PostQuitMessage(0);
+				return 0;
+
+			case WM_PAINT:
+			{
+				//рисует поток рендера, тут только подтверждаем перерисовку
+				PAINTSTRUCT ps;
+				BeginPaint(hWnd, &ps);
+				EndPaint(hWnd, &ps);
+				return 0;
+			}
+		}
+		return DefWindowProcW(hWnd, uMsg, wParam, lParam);
+	}
+}
+
+bool platformCreateWindow(const wchar_t* title, MessageHandler handler)
+{
+	message_handler = handler;
+
+	HINSTANCE instance = GetModuleHandleW(NULL);
+	const wchar_t CLASS_NAME[] = L"Window Class";
+
+	WNDCLASSW wc = { };
+	wc.lpfnWndProc = WindowProc;
+	wc.hInstance = instance;
+	wc.lpszClassName = CLASS_NAME;
+	wc.style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC;
+	wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+	RegisterClassW(&wc);
+
+	window = CreateWindowExW(0, CLASS_NAME, title, WS_OVERLAPPEDWINDOW,
+		CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT,
+		NULL, NULL, instance, NULL);
+	if (window == NULL)
+		return false;
+
+	ShowWindow(window, SW_SHOWDEFAULT);
+	return true;
+}
+
+void platformRunMessageLoop()
+{
+	MSG msg = { };
+	while (GetMessageW(&msg, NULL, 0, 0) > 0)
+	{
+		TranslateMessage(&msg);
+		DispatchMessageW(&msg);
+	}
+}
+
+bool platformCreateContext(const GLContextSettings& settings)
+{
+	PIXELFORMATDESCRIPTOR pfd;
+	memset(&pfd, 0, sizeof(PIXELFORMATDESCRIPTOR));
+
+	pfd.nSize = sizeof(PIXELFORMATDESCRIPTOR);
+	pfd.nVersion = 1;
+	pfd.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER;
+	pfd.iPixelType = PFD_TYPE_RGBA;
+	pfd.cColorBits = 32;
+	pfd.cAlphaBits = 8;
+	pfd.cDepthBits = 24;
+	pfd.cStencilBits = 8;
+
+	window_dc = GetDC(window);
+	int pixel_format = ChoosePixelFormat(window_dc, &pfd);
+	if (pixel_format == 0)
+		return false;
+
+	//24 бита глубины есть везде, но если дали меньше - 16 еще терпимо
+	PIXELFORMATDESCRIPTOR best_match;
+	DescribePixelFormat(window_dc, pixel_format, sizeof(pfd), &best_match);
+	if (best_match.cDepthBits < 16)
+		return false;
+
+	if (SetPixelFormat(window_dc, pixel_format, &pfd) == FALSE)
+		return false;
+
+	//wglCreateContextAttribsARB - сама функция драйвера, ее адрес дают
+	//только при активном контексте: сначала заводим старый
+	HGLRC legacy = wglCreateContext(window_dc);
+	if (!legacy || wglMakeCurrent(window_dc, legacy) == FALSE)
+		return false;
+	context = legacy;
+
+	auto create_context_attribs = (CreateContextAttribsFunc)platformGetProcAddress("wglCreateContextAttribsARB");
+	if (!create_context_attribs)
+	{
+		platformDebugOutput("wglCreateContextAttribsARB is not supported, using legacy context\n");
+		return true;
+	}
+
+	const int attribs[] = {
+		WGL_CONTEXT_MAJOR_VERSION_ARB, settings.major,
+		WGL_CONTEXT_MINOR_VERSION_ARB, settings.minor,
+		WGL_CONTEXT_PROFILE_MASK_ARB, settings.compatibility ?
+			WGL_CONTEXT_COMPATIBILITY_PROFILE_BIT_ARB : WGL_CONTEXT_CORE_PROFILE_BIT_ARB,
+		WGL_CONTEXT_FLAGS_ARB, settings.debug ? WGL_CONTEXT_DEBUG_BIT_ARB : 0,
+		0 };
+	HGLRC modern = create_context_attribs(window_dc, NULL, attribs);
+	if (!modern || wglMakeCurrent(window_dc, modern) == FALSE)
+	{
+		if (modern)
+			wglDeleteContext(modern);
+		wglMakeCurrent(window_dc, legacy);
+		platformDebugOutput("requested OpenGL version is not supported, using legacy context\n");
+		return true;
+	}
+
+	wglDeleteContext(legacy);
+	context = modern;
+	return true;
+}
+
+bool platformCreateHeadlessContext(const GLContextSettings& settings)
+{
+	//WGL без окна контекст не дает - заводим окно, но не показываем
+	HINSTANCE instance = GetModuleHandleW(NULL);
+	const wchar_t CLASS_NAME[] = L"Headless Window Class";
+
+	WNDCLASSW wc = { };
+	wc.lpfnWndProc = DefWindowProcW;
+	wc.hInstance = instance;
+	wc.lpszClassName = CLASS_NAME;
+	wc.style = CS_OWNDC;
+	RegisterClassW(&wc);
+
+	window = CreateWindowExW(0, CLASS_NAME, L"", WS_OVERLAPPEDWINDOW,
+		0, 0, 1, 1, NULL, NULL, instance, NULL);
+	if (window == NULL)
+		return false;
+	return platformCreateContext(settings);
+}
+
+void platformDestroyContext()
+{
+	wglMakeCurrent(NULL, NULL);
+	if (context)
+		wglDeleteContext(context);
+	context = NULL;
+	if (window_dc)
+		ReleaseDC(window, window_dc);
+	window_dc = NULL;
+}
+
+void platformSwapBuffers()
+{
+	SwapBuffers(window_dc);
+}
+
+void* platformGetProcAddress(const char* name)
+{
+	void* f = (void*)wglGetProcAddress(name);
+	//некоторые драйверы вместо NULL возвращают 1, 2, 3 или -1
+	if (f == (void*)1 || f == (void*)2 || f == (void*)3 || f == (void*)-1)
+		return nullptr;
+	return f;
+}
+
+bool platformKeyPressed(int key)
+{
+	return (GetAsyncKeyState(key) & 0x8000) != 0;
+}
+
+void platformDebugOutput(const char* text)
+{
+	OutputDebugStringA(text);
+}
+
+void platformSendTestInput()
+{
+	//PostMessage - та же очередь, что у настоящего ввода, из любого потока
+	const LPARAM at = MAKELPARAM(100, 100);
+	PostMessageW(window, WM_MOUSEMOVE, 0, at);
+	PostMessageW(window, WM_LBUTTONDOWN, MK_LBUTTON, at);
+	PostMessageW(window, WM_LBUTTONUP, 0, at);
+	PostMessageW(window, WM_MOUSEWHEEL, MAKEWPARAM(0, WHEEL_DELTA), at);
+	PostMessageW(window, WM_KEYDOWN, 'L', 1);
+	PostMessageW(window, WM_KEYUP, 'L', 0xC0000001);
+	PostMessageW(window, WM_CLOSE, 0, 0);
+}
+
+
+//=========================================================================================================
+
+class TextRasterPrivate
+{
+public:
+	HDC dc = 0;
+	HBITMAP bitmap = 0;
+	HFONT font = 0;
+	unsigned int* pixels = nullptr;
+	int w = 0;
+	int h = 0;
+	std::vector<unsigned char> mask;
+
+	~TextRasterPrivate()
+	{
+		if (font)
+			DeleteObject(font);
+		if (bitmap)
+			DeleteObject(bitmap);
+		if (dc)
+			DeleteDC(dc);
+	}
+};
+
+TextRaster::TextRaster()
+{
+}
+
+TextRaster::~TextRaster()
+{
+	delete d;
+}
+
+bool TextRaster::init(int width, int height, const wchar_t* face, int font_height, bool antialias)
+{
+	delete d;
+	d = new TextRasterPrivate;
+	d->w = width;
+	d->h = height;
+	//если шрифт не создастся, маска так и останется пустой
+	d->mask.assign((size_t)width * height, 0);
+
+	d->dc = CreateCompatibleDC(0);
+	if (!d->dc)
+		return false;
+
+	BITMAPINFOHEADER binfo;
+	memset(&binfo, 0, sizeof(BITMAPINFOHEADER));
+	binfo.biSize = sizeof(binfo);
+	binfo.biBitCount = 32;
+	binfo.biWidth = width;
+	binfo.biHeight = -height; //строки сверху вниз
+	binfo.biPlanes = 1;
+	binfo.biCompression = BI_RGB;
+
+	d->bitmap = CreateDIBSection(d->dc, (BITMAPINFO*)&binfo, DIB_RGB_COLORS, (void**)&d->pixels, 0, 0);
+	if (!d->bitmap)
+		return false;
+	SelectObject(d->dc, d->bitmap);
+
+	d->font = CreateFontW(
+		font_height, 0, 0, 0, FW_HEAVY, FALSE, FALSE, FALSE,
+		DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
+		antialias ? ANTIALIASED_QUALITY : NONANTIALIASED_QUALITY, DEFAULT_PITCH, face);
+	if (!d->font)
+		return false;
+	SelectObject(d->dc, d->font);
+
+	SetBkMode(d->dc, TRANSPARENT);
+	SetTextColor(d->dc, RGB(255, 255, 255));
+
+	clear();
+	return true;
+}
+
+bool TextRaster::ready() const
+{
+	return d && d->font;
+}
+
+int TextRaster::width() const
+{
+	return d ? d->w : 0;
+}
+
+int TextRaster::height() const
+{
+	return d ? d->h : 0;
+}
+
+void TextRaster::clear()
+{
+	if (!ready())
+		return;
+	std::fill(d->pixels, d->pixels + (size_t)d->w * d->h, 0u);
+}
+
+void TextRaster::draw(const wchar_t* text, int x, int y)
+{
+	if (!ready())
+		return;
+	RECT r = { x, y, d->w, d->h };
+	DrawTextW(d->dc, text, -1, &r, DT_NOPREFIX);
+}
+
+int TextRaster::textWidth(const wchar_t* text, size_t length)
+{
+	if (!ready())
+		return 0;
+	SIZE ext;
+	GetTextExtentPoint32W(d->dc, text, (int)length, &ext);
+	return ext.cx;
+}
+
+const unsigned char* TextRaster::mask()
+{
+	if (!ready())
+		return d ? d->mask.data() : nullptr;
+	GdiFlush();
+	//текст белый, так что каналы одинаковые - берем любой
+	size_t n = (size_t)d->w * d->h;
+	for (size_t i = 0; i < n; ++i)
+		d->mask[i] = (unsigned char)(d->pixels[i] >> 8);
+	return d->mask.data();
+}
+
+#endif
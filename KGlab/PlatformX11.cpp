@@ -0,0 +1,630 @@
+#ifndef _WIN32
+
+#include "Platform.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <GL/glx.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	//Xlib не любит, когда одно соединение дергают из двух потоков,
+	//поэтому у окна (поток сообщений) и у контекста (поток рендера) соединения свои
+	Display* display = nullptr;
+	Display* gl_display = nullptr;
+	Window window = 0;
+	GLXContext context = nullptr;
+	//контекст пакетного режима
+	EGLDisplay egl_display = EGL_NO_DISPLAY;
+	EGLContext egl_context = EGL_NO_CONTEXT;
+	Atom wm_delete = 0;
+	MessageHandler message_handler = nullptr;
+
+	//состояние клавиш для platformKeyPressed, пишет поток сообщений
+	std::atomic_bool key_state[256];
+
+	//буфер кадра окна: RGBA8, глубина 24, трафарет 8
+	const int FB_ATTRIBS[] = { GLX_X_RENDERABLE, True, GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT, GLX_RENDER_TYPE, GLX_RGBA_BIT,
+		GLX_DOUBLEBUFFER, True, GLX_RED_SIZE, 8, GLX_GREEN_SIZE, 8, GLX_BLUE_SIZE, 8, GLX_ALPHA_SIZE, 8,
+		GLX_DEPTH_SIZE, 24, GLX_STENCIL_SIZE, 8, None };
+	//конфигурация окна. Сами GLXFBConfig у каждого соединения свои, поэтому запоминаем номер
+	int fb_config_id = 0;
+
+	//Обработчик ошибок Xlib один на процесс, а соединение окна в это время крутит поток сообщений.
+	//Пока объект жив, ошибки соединения контекста молча пропускаются, остальные уходят
+	//прежнему обработчику, а поток сообщений стоит на XLockDisplay. Деструктор все возвращает
+	struct ProbeErrors
+	{
+		static XErrorHandler previous;
+
+		ProbeErrors()
+		{
+			if (display)
+				XLockDisplay(display);
+			previous = XSetErrorHandler([](Display* dpy, XErrorEvent* e) {
+				return dpy == gl_display ? 0 : previous(dpy, e);
+			});
+		}
+		~ProbeErrors()
+		{
+			XSetErrorHandler(previous);
+			if (display)
+				XUnlockDisplay(display);
+		}
+	};
+	XErrorHandler ProbeErrors::previous = nullptr;
+
+	//конфигурация с номером id (0 - первая подходящая) на соединении dpy
+	GLXFBConfig findConfig(Display* dpy, int id)
+	{
+		const int by_id[] = { GLX_FBCONFIG_ID, id, None };
+		int count = 0;
+		GLXFBConfig* configs = glXChooseFBConfig(dpy, DefaultScreen(dpy), id ? by_id : FB_ATTRIBS, &count);
+		if (!configs)
+			return nullptr;
+		GLXFBConfig config = count > 0 ? configs[0] : nullptr;
+		XFree(configs);
+		return config;
+	}
+
+	void send(const Message& m)
+	{
+		if (message_handler)
+			message_handler(m);
+	}
+
+	void setKey(int key, bool pressed)
+	{
+		if (key > 0 && key < 256)
+			key_state[key] = pressed;
+	}
+
+	//KeySym в наши коды (они же виртуальные коды Windows), 0 - такой клавиши у нас нет
+	int translateKey(KeySym sym)
+	{
+		if (sym >= XK_a && sym <= XK_z)
+			return 'A' + (int)(sym - XK_a);
+		if (sym >= XK_A && sym <= XK_Z)
+			return 'A' + (int)(sym - XK_A);
+		if (sym >= XK_0 && sym <= XK_9)
+			return '0' + (int)(sym - XK_0);
+		if (sym >= XK_F1 && sym <= XK_F12)
+			return KEY_F1 + (int)(sym - XK_F1);
+		switch (sym)
+		{
+			case XK_BackSpace: return KEY_BACK;
+			case XK_Tab: return KEY_TAB;
+			case XK_Return: return KEY_RETURN;
+			case XK_Shift_L: case XK_Shift_R: return KEY_SHIFT;
+			case XK_Control_L: case XK_Control_R: return KEY_CONTROL;
+			case XK_Escape: return KEY_ESCAPE;
+			case XK_space: return KEY_SPACE;
+			case XK_Left: return KEY_LEFT;
+			case XK_Up: return KEY_UP;
+			case XK_Right: return KEY_RIGHT;
+			case XK_Down: return KEY_DOWN;
+		}
+		return 0;
+	}
+
+	int translateButton(unsigned int button)
+	{
+		switch (button)
+		{
+			case Button1: return KEY_LBUTTON;
+			case Button2: return KEY_MBUTTON;
+			case Button3: return KEY_RBUTTON;
+		}
+		return 0;
+	}
+
+	std::string narrow(const wchar_t* text)
+	{
+		std::string s;
+		for (; *text; ++text)
+			s += *text < 0x80 ? (char)*text : '?';
+		return s;
+	}
+
+	std::string utf8(const wchar_t* text)
+	{
+		std::string s;
+		for (; *text; ++text)
+		{
+			unsigned c = (unsigned)*text;
+			if (c < 0x80)
+				s += (char)c;
+			else if (c < 0x800)
+			{
+				s += (char)(0xC0 | (c >> 6));
+				s += (char)(0x80 | (c & 0x3F));
+			}
+			else
+			{
+				s += (char)(0xE0 | ((c >> 12) & 0x0F));
+				s += (char)(0x80 | ((c >> 6) & 0x3F));
+				s += (char)(0x80 | (c & 0x3F));
+			}
+		}
+		return s;
+	}
+}
+
+bool platformCreateWindow(const wchar_t* title, MessageHandler handler)
+{
+	message_handler = handler;
+
+	XInitThreads();
+	display = XOpenDisplay(nullptr);
+	if (!display)
+		return false;
+
+	int screen = DefaultScreen(display);
+	GLXFBConfig config = findConfig(display, 0);
+	if (!config)
+		return false;
+	glXGetFBConfigAttrib(display, config, GLX_FBCONFIG_ID, &fb_config_id);
+	XVisualInfo* visual = glXGetVisualFromFBConfig(display, config);
+	if (!visual)
+		return false;
+
+	Window root = RootWindow(display, screen);
+	XSetWindowAttributes attr = {};
+	attr.colormap = XCreateColormap(display, root, visual->visual, AllocNone);
+	attr.event_mask = KeyPressMask | KeyReleaseMask | ButtonPressMask | ButtonReleaseMask |
+		PointerMotionMask | LeaveWindowMask | StructureNotifyMask | ExposureMask;
+
+	window = XCreateWindow(display, root, 0, 0, 1024, 768, 0, visual->depth, InputOutput, visual->visual,
+		CWColormap | CWEventMask, &attr);
+	XFree(visual);
+	if (!window)
+		return false;
+
+	//заголовок по-русски понимают только через _NET_WM_NAME в UTF-8,
+	//старый WM_NAME - для совсем древних оконных менеджеров
+	std::string caption = utf8(title);
+	XChangeProperty(display, window, XInternAtom(display, "_NET_WM_NAME", False),
+		XInternAtom(display, "UTF8_STRING", False), 8, PropModeReplace,
+		(const unsigned char*)caption.c_str(), (int)caption.size());
+	XStoreName(display, window, narrow(title).c_str());
+
+	//крестик окна приходит как ClientMessage, а не убивает соединение
+	wm_delete = XInternAtom(display, "WM_DELETE_WINDOW", False);
+	XSetWMProtocols(display, window, &wm_delete, 1);
+
+	//без этого автоповтор присылает пары KeyRelease/KeyPress и клавиша "мигает"
+	XkbSetDetectableAutoRepeat(display, True, nullptr);
+
+	XMapWindow(display, window);
+	XFlush(display);
+	return true;
+}
+
+void platformRunMessageLoop()
+{
+	int width = 0;
+	int height = 0;
+
+	for (;;)
+	{
+		XEvent e;
+		XNextEvent(display, &e);
+
+		switch (e.type)
+		{
+			case KeyPress:
+			case KeyRelease:
+			{
+				int key = translateKey(XLookupKeysym(&e.xkey, 0));
+				if (!key)
+					break;
+				setKey(key, e.type == KeyPress);
+				Message m{ e.type == KeyPress ? Message::KeyDown : Message::KeyUp };
+				m.key = key;
+				send(m);
+				break;
+			}
+			case ButtonPress:
+			case ButtonRelease:
+			{
+				//колесико в X - кнопки 4 и 5
+				if (e.xbutton.button == Button4 || e.xbutton.button == Button5)
+				{
+					if (e.type == ButtonPress)
+					{
+						Message m{ Message::Wheel };
+						m.wheel = e.xbutton.button == Button4 ? 120.0f : -120.0f;
+						send(m);
+					}
+					break;
+				}
+				int button = translateButton(e.xbutton.button);
+				if (!button)
+					break;
+				setKey(button, e.type == ButtonPress);
+				Message m{ e.type == ButtonPress ? Message::MouseDown : Message::MouseUp };
+				m.x = e.xbutton.x;
+				m.y = e.xbutton.y;
+				m.key = button;
+				send(m);
+				break;
+			}
+			case MotionNotify:
+			{
+				Message m{ Message::MouseMove };
+				m.x = e.xmotion.x;
+				m.y = e.xmotion.y;
+				send(m);
+				break;
+			}
+			case LeaveNotify:
+				send(Message{ Message::MouseLeave });
+				break;
+			case ConfigureNotify:
+				//приходит и при перемещении окна - размер шлем только если он поменялся
+				if (e.xconfigure.width != width || e.xconfigure.height != height)
+				{
+					width = e.xconfigure.width;
+					height = e.xconfigure.height;
+					Message m{ Message::Resize };
+					m.x = width;
+					m.y = height;
+					send(m);
+				}
+				break;
+			case ClientMessage:
+				if ((Atom)e.xclient.data.l[0] == wm_delete)
+				{
+					send(Message{ Message::Close });
+					XDestroyWindow(display, window);
+					XCloseDisplay(display);
+					display = nullptr;
+					return;
+				}
+				break;
+		}
+	}
+}
+
+bool platformCreateContext(const GLContextSettings& settings)
+{
+	gl_display = XOpenDisplay(nullptr);
+	if (!gl_display)
+		return false;
+
+	GLXFBConfig config = findConfig(gl_display, fb_config_id);
+	if (!config)
+		return false;
+
+	auto create_context_attribs = (PFNGLXCREATECONTEXTATTRIBSARBPROC)
+		glXGetProcAddressARB((const GLubyte*)"glXCreateContextAttribsARB");
+	if (create_context_attribs)
+	{
+		const int attribs[] = {
+			GLX_CONTEXT_MAJOR_VERSION_ARB, settings.major,
+			GLX_CONTEXT_MINOR_VERSION_ARB, settings.minor,
+			GLX_CONTEXT_PROFILE_MASK_ARB, settings.compatibility ?
+				GLX_CONTEXT_COMPATIBILITY_PROFILE_BIT_ARB : GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
+			GLX_CONTEXT_FLAGS_ARB, settings.debug ? GLX_CONTEXT_DEBUG_BIT_ARB : 0,
+			None };
+		//если версию не дадут, Xlib сообщит об ошибке протокола - ее пропускаем
+		ProbeErrors probe;
+		context = create_context_attribs(gl_display, config, nullptr, True, attribs);
+		XSync(gl_display, False);
+	}
+	if (!context)
+	{
+		platformDebugOutput("requested OpenGL version is not supported, using legacy context\n");
+		context = glXCreateNewContext(gl_display, config, GLX_RGBA_TYPE, nullptr, True);
+	}
+	if (!context)
+		return false;
+	return glXMakeCurrent(gl_display, window, context) == True;
+}
+
+bool platformCreateHeadlessContext(const GLContextSettings& settings)
+{
+	//платформа "surfaceless" из Mesa не требует ни X-сервера, ни видеокарты
+	auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (get_platform_display)
+		egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (egl_display == EGL_NO_DISPLAY)
+		egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, nullptr, nullptr))
+		return false;
+
+	//поверхности нет, поэтому и конфигурация не нужна (EGL_KHR_no_config_context)
+	if (!eglBindAPI(EGL_OPENGL_API))
+		return false;
+	const EGLint attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION_KHR, settings.major,
+		EGL_CONTEXT_MINOR_VERSION_KHR, settings.minor,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, settings.compatibility ?
+			EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR : EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+		EGL_CONTEXT_FLAGS_KHR, settings.debug ? EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR : 0,
+		EGL_NONE };
+	egl_context = eglCreateContext(egl_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+	if (egl_context == EGL_NO_CONTEXT)
+	{
+		platformDebugOutput("requested OpenGL version is not supported, using default context\n");
+		egl_context = eglCreateContext(egl_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, nullptr);
+	}
+	if (egl_context == EGL_NO_CONTEXT)
+		return false;
+	return eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context) == EGL_TRUE;
+}
+
+void platformDestroyContext()
+{
+	if (egl_display != EGL_NO_DISPLAY)
+	{
+		eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (egl_context != EGL_NO_CONTEXT)
+			eglDestroyContext(egl_display, egl_context);
+		eglTerminate(egl_display);
+		egl_display = EGL_NO_DISPLAY;
+		egl_context = EGL_NO_CONTEXT;
+	}
+	if (!gl_display)
+		return;
+	glXMakeCurrent(gl_display, None, nullptr);
+	if (context)
+		glXDestroyContext(gl_display, context);
+	context = nullptr;
+	XCloseDisplay(gl_display);
+	gl_display = nullptr;
+}
+
+void platformSwapBuffers()
+{
+	glXSwapBuffers(gl_display, window);
+}
+
+void* platformGetProcAddress(const char* name)
+{
+	if (egl_context != EGL_NO_CONTEXT)
+		return (void*)eglGetProcAddress(name);
+	return (void*)glXGetProcAddressARB((const GLubyte*)name);
+}
+
+bool platformKeyPressed(int key)
+{
+	return key > 0 && key < 256 && key_state[key];
+}
+
+void platformDebugOutput(const char* text)
+{
+	//OutputDebugString без отладчика никто не видит - в Release молчим и тут
+#ifndef NDEBUG
+	fputs(text, stderr);
+#else
+	(void)text;
+#endif
+}
+
+void platformSendTestInput()
+{
+	//свое соединение: соединение окна занято потоком сообщений в XNextEvent
+	Display* dpy = XOpenDisplay(nullptr);
+	if (!dpy)
+		return;
+
+	//пустая маска - событие получает создатель окна, то есть поток сообщений
+	auto post = [&](XEvent& e) {
+		e.xany.window = window;
+		XSendEvent(dpy, window, False, 0, &e);
+	};
+
+	XEvent e = {};
+	e.xmotion.type = MotionNotify;
+	e.xmotion.x = 100;
+	e.xmotion.y = 100;
+	e.xmotion.same_screen = True;
+	post(e);
+
+	for (unsigned button : { (unsigned)Button1, (unsigned)Button4 })
+		for (int type : { ButtonPress, ButtonRelease })
+		{
+			e = {};
+			e.xbutton.type = type;
+			e.xbutton.button = button;
+			e.xbutton.x = 100;
+			e.xbutton.y = 100;
+			e.xbutton.same_screen = True;
+			post(e);
+		}
+
+	for (int type : { KeyPress, KeyRelease })
+	{
+		e = {};
+		e.xkey.type = type;
+		e.xkey.keycode = XKeysymToKeycode(dpy, XK_l);
+		e.xkey.same_screen = True;
+		post(e);
+	}
+
+	e = {};
+	e.xclient.type = ClientMessage;
+	e.xclient.message_type = XInternAtom(dpy, "WM_PROTOCOLS", False);
+	e.xclient.format = 32;
+	e.xclient.data.l[0] = (long)wm_delete;
+	e.xclient.data.l[1] = CurrentTime;
+	post(e);
+
+	XCloseDisplay(dpy);
+}
+
+
+//=========================================================================================================
+
+class TextRasterPrivate
+{
+public:
+	Display* display = nullptr;
+	Pixmap pixmap = 0;
+	GC gc = 0;
+	XFontStruct* font = nullptr;
+	int w = 0;
+	int h = 0;
+	std::vector<unsigned char> mask;
+
+	~TextRasterPrivate()
+	{
+		if (!display)
+			return;
+		if (font)
+			XFreeFont(display, font);
+		if (gc)
+			XFreeGC(display, gc);
+		if (pixmap)
+			XFreePixmap(display, pixmap);
+		XCloseDisplay(display);
+	}
+
+	//Шрифты X-сервера ищутся по шаблону XLFD. Сначала пробуем запрошенный,
+	//потом похожие моноширинные, в конце - "fixed", который есть всегда
+	bool loadFont(const wchar_t* face, int height)
+	{
+		std::string name = narrow(face);
+		for (char& c : name)
+			c = (char)tolower((unsigned char)c);
+
+		const std::string families[] = { name, "dejavu sans mono", "liberation mono", "courier", "*" };
+		for (const std::string& family : families)
+		{
+			char pattern[256];
+			snprintf(pattern, sizeof(pattern), "-*-%s-bold-r-normal--%d-*-*-*-*-*-iso10646-1", family.c_str(), height);
+			font = XLoadQueryFont(display, pattern);
+			if (font)
+				return true;
+		}
+		font = XLoadQueryFont(display, "fixed");
+		return font != nullptr;
+	}
+
+	std::vector<XChar2b> toChar2b(const wchar_t* text, size_t length)
+	{
+		std::vector<XChar2b> s(length);
+		for (size_t i = 0; i < length; ++i)
+		{
+			unsigned c = text[i] < 0x10000 ? (unsigned)text[i] : '?';
+			s[i].byte1 = (unsigned char)(c >> 8);
+			s[i].byte2 = (unsigned char)c;
+		}
+		return s;
+	}
+};
+
+TextRaster::TextRaster()
+{
+}
+
+TextRaster::~TextRaster()
+{
+	delete d;
+}
+
+bool TextRaster::init(int width, int height, const wchar_t* face, int font_height, bool antialias)
+{
+	//у шрифтов X-сервера сглаживания нет, маска всегда 0/255
+	(void)antialias;
+
+	delete d;
+	d = new TextRasterPrivate;
+	d->w = width;
+	d->h = height;
+	//если шрифт не создастся, маска так и останется пустой
+	d->mask.assign((size_t)width * height, 0);
+
+	d->display = XOpenDisplay(nullptr);
+	if (!d->display)
+		return false;
+
+	Window root = DefaultRootWindow(d->display);
+	d->pixmap = XCreatePixmap(d->display, root, width, height, DefaultDepth(d->display, DefaultScreen(d->display)));
+	d->gc = XCreateGC(d->display, d->pixmap, 0, nullptr);
+	if (!d->loadFont(face, font_height))
+		return false;
+	XSetFont(d->display, d->gc, d->font->fid);
+
+	clear();
+	return true;
+}
+
+bool TextRaster::ready() const
+{
+	return d && d->font;
+}
+
+int TextRaster::width() const
+{
+	return d ? d->w : 0;
+}
+
+int TextRaster::height() const
+{
+	return d ? d->h : 0;
+}
+
+void TextRaster::clear()
+{
+	if (!ready())
+		return;
+	XSetForeground(d->display, d->gc, BlackPixel(d->display, DefaultScreen(d->display)));
+	XFillRectangle(d->display, d->pixmap, d->gc, 0, 0, d->w, d->h);
+}
+
+void TextRaster::draw(const wchar_t* text, int x, int y)
+{
+	if (!ready())
+		return;
+	XSetForeground(d->display, d->gc, WhitePixel(d->display, DefaultScreen(d->display)));
+
+	//XDrawString рисует от базовой линии и не знает про '\n'
+	int line_height = d->font->ascent + d->font->descent;
+	while (*text)
+	{
+		const wchar_t* end = text;
+		while (*end && *end != L'\n')
+			++end;
+		std::vector<XChar2b> line = d->toChar2b(text, end - text);
+		XDrawString16(d->display, d->pixmap, d->gc, x, y + d->font->ascent, line.data(), (int)line.size());
+		y += line_height;
+		text = *end ? end + 1 : end;
+	}
+}
+
+int TextRaster::textWidth(const wchar_t* text, size_t length)
+{
+	if (!ready())
+		return 0;
+	std::vector<XChar2b> s = d->toChar2b(text, length);
+	return XTextWidth16(d->font, s.data(), (int)s.size());
+}
+
+const unsigned char* TextRaster::mask()
+{
+	if (!ready())
+		return d ? d->mask.data() : nullptr;
+	XImage* image = XGetImage(d->display, d->pixmap, 0, 0, d->w, d->h, AllPlanes, ZPixmap);
+	if (!image)
+		return d->mask.data();
+	for (int y = 0; y < d->h; ++y)
+		for (int x = 0; x < d->w; ++x)
+			d->mask[(size_t)y * d->w + x] = XGetPixel(image, x, y) ? 255 : 0;
+	XDestroyImage(image);
+	return d->mask.data();
+}
+
+#endif
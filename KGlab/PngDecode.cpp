@@ -0,0 +1,344 @@
+#include "PngDecode.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "FastInflate.h"
+
+//SSE2 есть у всех x64 и у x86 с /arch:SSE2 (по умолчанию в Visual Studio)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	uint32_t be32(const unsigned char* p)
+	{
+		return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+	}
+
+	uint32_t chunkType(const char* name)
+	{
+		return be32((const unsigned char*)name);
+	}
+
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	//тот же предел, что у stb (STBI_MAX_DIMENSIONS)
+	const uint32_t MAX_SIDE = 1 << 24;
+
+	int paeth(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = std::abs(p - a);
+		int pb = std::abs(p - b);
+		int pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc)
+			return a;
+		return pb <= pc ? b : c;
+	}
+
+	//фильтры побайтно - для серых картинок (1-2 байта на пиксель) и без SSE2
+	bool unfilterBytes(int filter, unsigned char* cur, const unsigned char* prev, size_t n, int bpp)
+	{
+		switch (filter)
+		{
+		case 1:
+			for (size_t i = bpp; i < n; ++i)
+				cur[i] = (unsigned char)(cur[i] + cur[i - bpp]);
+			return true;
+		case 3:
+			for (int i = 0; i < bpp; ++i)
+				cur[i] = (unsigned char)(cur[i] + (prev[i] >> 1));
+			for (size_t i = bpp; i < n; ++i)
+				cur[i] = (unsigned char)(cur[i] + ((cur[i - bpp] + prev[i]) >> 1));
+			return true;
+		case 4:
+			for (int i = 0; i < bpp; ++i)
+				cur[i] = (unsigned char)(cur[i] + prev[i]);
+			for (size_t i = bpp; i < n; ++i)
+				cur[i] = (unsigned char)(cur[i] + paeth(cur[i - bpp], prev[i], prev[i - bpp]));
+			return true;
+		}
+		return false;
+	}
+
+#ifdef PNG_SSE2
+	//Sub, Average и Paeth зависят от левого соседа, поэтому идут по пикселю, зато все каналы
+	//пикселя (3 или 4 байта) - одной командой SSE2 в одном регистре.
+	//BPP - параметр шаблона: memcpy известной длины становится одной загрузкой,
+	//с длиной из переменной это вызов функции на каждый пиксель (в разы медленнее побайтного цикла)
+	template<int BPP>
+	inline __m128i loadPixel(const unsigned char* p)
+	{
+		int v = 0;
+		std::memcpy(&v, p, BPP);
+		return _mm_cvtsi32_si128(v);
+	}
+	template<int BPP>
+	inline void storePixel(unsigned char* p, __m128i v)
+	{
+		int x = _mm_cvtsi128_si32(v);
+		std::memcpy(p, &x, BPP);
+	}
+	inline __m128i select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+	inline __m128i abs16(__m128i x)
+	{
+		return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+	}
+
+	template<int BPP>
+	bool unfilterPixels(int filter, unsigned char* cur, const unsigned char* prev, size_t n)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i a = zero;
+		switch (filter)
+		{
+		case 1:
+			for (size_t i = 0; i < n; i += BPP)
+			{
+				a = _mm_add_epi8(a, loadPixel<BPP>(cur + i));
+				storePixel<BPP>(cur + i, a);
+			}
+			return true;
+		case 3:
+		{
+			//_mm_avg_epu8 округляет вверх, а PNG - вниз: вычитаем младший бит суммы
+			const __m128i one = _mm_set1_epi8(1);
+			for (size_t i = 0; i < n; i += BPP)
+			{
+				__m128i b = loadPixel<BPP>(prev + i);
+				__m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+				a = _mm_add_epi8(avg, loadPixel<BPP>(cur + i));
+				storePixel<BPP>(cur + i, a);
+			}
+			return true;
+		}
+		case 4:
+		{
+			//в 16-битных каналах: p - a = b - c, p - b = a - c, p - c = их сумма
+			__m128i c = zero;
+			for (size_t i = 0; i < n; i += BPP)
+			{
+				__m128i b = _mm_unpacklo_epi8(loadPixel<BPP>(prev + i), zero);
+				__m128i pa = _mm_sub_epi16(b, c);
+				__m128i pb = _mm_sub_epi16(a, c);
+				__m128i pc = abs16(_mm_add_epi16(pa, pb));
+				pa = abs16(pa);
+				pb = abs16(pb);
+				__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+				__m128i pred = select(_mm_cmpeq_epi16(smallest, pa), a,
+					select(_mm_cmpeq_epi16(smallest, pb), b, c));
+				//старшие байты каналов нулевые, сложение по байтам их не трогает
+				a = _mm_add_epi8(pred, _mm_unpacklo_epi8(loadPixel<BPP>(cur + i), zero));
+				storePixel<BPP>(cur + i, _mm_packus_epi16(a, a));
+				c = b;
+			}
+			return true;
+		}
+		}
+		return false;
+	}
+#endif
+
+	//снимает фильтр со строки cur (n байт, bpp байт на пиксель), prev - предыдущая, уже чистая
+	bool unfilter(int filter, unsigned char* cur, const unsigned char* prev, size_t n, int bpp)
+	{
+		if (filter == 0)
+			return true;
+		if (filter == 2)
+		{
+			//Up от соседей не зависит - этот цикл компилятор векторизует сам
+			for (size_t i = 0; i < n; ++i)
+				cur[i] = (unsigned char)(cur[i] + prev[i]);
+			return true;
+		}
+#ifdef PNG_SSE2
+		if (bpp == 4)
+			return unfilterPixels<4>(filter, cur, prev, n);
+		if (bpp == 3)
+			return unfilterPixels<3>(filter, cur, prev, n);
+#endif
+		return unfilterBytes(filter, cur, prev, n, bpp);
+	}
+
+	//собирает строки из потока распаковки и раскладывает их в dst
+	struct RowWriter
+	{
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		size_t row_bytes = 0;
+		unsigned char* dst = nullptr;
+		ptrdiff_t stride = 0;
+
+		//байт фильтра + строка, текущая и предыдущая
+		std::vector<unsigned char> rows;
+		unsigned char* cur = nullptr;
+		unsigned char* prev = nullptr;
+		size_t filled = 0;
+		int y = 0;
+
+		void begin()
+		{
+			rows.assign(2 * (row_bytes + 1), 0);
+			cur = rows.data();
+			prev = rows.data() + row_bytes + 1;
+		}
+
+		//строка готова: фильтр долой, в RGBA
+		bool finishRow()
+		{
+			if (!unfilter(cur[0], cur + 1, prev + 1, row_bytes, channels))
+				return false;
+
+			const unsigned char* s = cur + 1;
+			unsigned char* d = dst + stride * y;
+			switch (channels)
+			{
+			case 4:
+				std::memcpy(d, s, row_bytes);
+				break;
+			case 3:
+				for (int x = 0; x < width; ++x, s += 3, d += 4)
+				{
+					d[0] = s[0];
+					d[1] = s[1];
+					d[2] = s[2];
+					d[3] = 255;
+				}
+				break;
+			case 2:
+				for (int x = 0; x < width; ++x, s += 2, d += 4)
+				{
+					d[0] = d[1] = d[2] = s[0];
+					d[3] = s[1];
+				}
+				break;
+			default:
+				for (int x = 0; x < width; ++x, ++s, d += 4)
+				{
+					d[0] = d[1] = d[2] = s[0];
+					d[3] = 255;
+				}
+			}
+
+			std::swap(cur, prev);
+			filled = 0;
+			++y;
+			return true;
+		}
+
+		static bool take(void* user, const unsigned char* data, size_t size)
+		{
+			RowWriter& w = *(RowWriter*)user;
+			while (size > 0)
+			{
+				//лишнее после последней строки stb тоже молча пропускает
+				if (w.y == w.height)
+					return true;
+				size_t n = std::min(size, w.row_bytes + 1 - w.filled);
+				std::memcpy(w.cur + w.filled, data, n);
+				w.filled += n;
+				data += n;
+				size -= n;
+				if (w.filled == w.row_bytes + 1 && !w.finishRow())
+					return false;
+			}
+			return true;
+		}
+	};
+}
+
+bool readPngHeader(const unsigned char* data, size_t size, PngHeader& header)
+{
+	//подпись, длина и тип первого чанка, 13 байт IHDR
+	if (size < 8 + 8 + 13 || std::memcmp(data, signature, 8) != 0)
+		return false;
+	const unsigned char* ihdr = data + 8;
+	if (be32(ihdr) != 13 || be32(ihdr + 4) != chunkType("IHDR"))
+		return false;
+
+	const unsigned char* p = ihdr + 8;
+	uint32_t width = be32(p);
+	uint32_t height = be32(p + 4);
+	int depth = p[8];
+	int color = p[9];
+	if (width == 0 || height == 0 || width > MAX_SIDE || height > MAX_SIDE)
+		return false;
+
+	static const int channels[7] = { 1, 0, 3, 0, 2, 0, 4 };
+	header.width = (int)width;
+	header.height = (int)height;
+	header.channels = color <= 6 ? channels[color] : 0;
+	//сжатие, фильтр и interlace - нули
+	header.supported = depth == 8 && header.channels > 0 && p[10] == 0 && p[11] == 0 && p[12] == 0;
+	return true;
+}
+
+bool pngData(const unsigned char* data, size_t size, std::vector<InflateInput>& idat, bool& plain)
+{
+	PngHeader header;
+	if (!readPngHeader(data, size, header))
+		return false;
+
+	idat.clear();
+	plain = true;
+	size_t pos = 8;
+	for (;;)
+	{
+		if (size - pos < 12)
+			return false;
+		uint32_t length = be32(data + pos);
+		uint32_t type = be32(data + pos + 4);
+		if (length > size - pos - 12)
+			return false;
+		const unsigned char* body = data + pos + 8;
+
+		if (type == chunkType("IDAT"))
+			idat.push_back({ body, length });
+		else if (type == chunkType("IEND"))
+			break;
+		//прозрачный цвет и "iPhone PNG" (BGR с предумножением)
+		else if (type == chunkType("tRNS") || type == chunkType("CgBI"))
+			plain = false;
+		//неизвестный обязательный чанк (первая буква заглавная)
+		else if (!(type & 0x20000000) && type != chunkType("IHDR") && type != chunkType("PLTE"))
+			plain = false;
+		pos += 12 + (size_t)length;
+	}
+	return !idat.empty();
+}
+
+bool decodePng(const unsigned char* data, size_t size, unsigned char* dst, ptrdiff_t stride)
+{
+	PngHeader header;
+	if (!readPngHeader(data, size, header) || !header.supported)
+		return false;
+	std::vector<InflateInput> idat;
+	bool plain;
+	if (!pngData(data, size, idat, plain) || !plain)
+		return false;
+
+	RowWriter writer;
+	writer.width = header.width;
+	writer.height = header.height;
+	writer.channels = header.channels;
+	writer.row_bytes = (size_t)header.width * header.channels;
+	writer.dst = dst;
+	writer.stride = stride;
+	writer.begin();
+
+	//буфер распаковки: пара сотен килобайт вместо всей картинки
+	std::vector<unsigned char> buffer(INFLATE_STREAM_MIN * 2);
+	if (!fastInflateStream(idat.data(), idat.size(), true, buffer.data(), buffer.size(), RowWriter::take, &writer))
+		return false;
+	return writer.y == writer.height;
+}
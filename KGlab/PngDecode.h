@@ -0,0 +1,38 @@
+#ifndef PNGDECODE_H
+#define PNGDECODE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "FastInflate.h"
+
+//PNG без stb для самого частого случая: 8 бит на канал, серый, серый с альфой, RGB или RGBA,
+//без чересстрочности и без tRNS. Сжатые данные разжимаются потоком (fastInflateStream),
+//каждая строка снимается с фильтра и сразу пишется в конечный буфер уже в RGBA -
+//вся распакованная картинка целиком нигде не лежит, кроме самого буфера.
+//Результат побайтно совпадает с stbi_load_from_memory(..., 4).
+//Остальное (палитра, 16 бит, interlace, прозрачный цвет) - false, такие файлы грузит stb
+
+struct PngHeader
+{
+	int width = 0;
+	int height = 0;
+	//каналов в файле: 1 - серый, 2 - серый с альфой, 3 - RGB, 4 - RGBA
+	int channels = 0;
+	//подходит ли файл для decodePng (по IHDR, остальные чанки смотрит сама decodePng)
+	bool supported = false;
+};
+
+//читает IHDR, false - это не PNG
+bool readPngHeader(const unsigned char* data, size_t size, PngHeader& header);
+
+//Сжатый поток картинки: тела IDAT по порядку, прямо в data. false - файл битый.
+//plain - нет чанков, которые меняют пиксели (tRNS, CgBI) или неизвестных обязательных
+bool pngData(const unsigned char* data, size_t size, std::vector<InflateInput>& idat, bool& plain);
+
+//пишет картинку в dst по RGBA, width * 4 байт на строку, начало следующей строки -
+//через stride байт от начала предыдущей (отрицательный - снизу вверх, так и переворачивают).
+//false - файл битый или не поддерживается, в dst тогда что попало
+bool decodePng(const unsigned char* data, size_t size, unsigned char* dst, ptrdiff_t stride);
+
+#endif
@@ -0,0 +1,219 @@
+#include "ProgramCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "GLState.h"
+#include "MappedFile.h"
+#include "RenderModes.h"
+#include "TextureCompress.h"
+
+ProgramCache programs;
+
+namespace
+{
+	const char BINARY_ID[8] = { 'K', 'G', 'P', 'R', 'O', 'G', '0', '1' };
+
+	//заголовок файла готовой программы, дальше size байт от glGetProgramBinary
+	struct BinaryHeader
+	{
+		char id[8];
+		unsigned int format;
+		unsigned int size;
+	};
+
+	//0 - не собрался, лог уже выведен
+	GLuint compile(GLenum type, const char* name, const char* const* parts, int count)
+	{
+		GLuint shader = glfn.CreateShader(type);
+		glfn.ShaderSource(shader, count, parts, nullptr);
+		glfn.CompileShader(shader);
+
+		GLint ok = 0;
+		glfn.GetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+		if (ok)
+			return shader;
+
+		GLint length = 0;
+		glfn.GetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+		std::vector<GLchar> log(length + 1);
+		glfn.GetShaderInfoLog(shader, length, nullptr, log.data());
+		platformDebugOutput((std::string("shader ") + name + (type == GL_VERTEX_SHADER ? " (vertex): " : " (fragment): ") +
+			log.data() + "\n").c_str());
+		glfn.DeleteShader(shader);
+		return 0;
+	}
+
+	bool linked(GLuint program)
+	{
+		GLint ok = 0;
+		glfn.GetProgramiv(program, GL_LINK_STATUS, &ok);
+		return ok != 0;
+	}
+}
+
+
+GLuint ProgramCache::get(const char* name, unsigned modes, const char* version,
+	const char* vertex_source, const char* fragment_source)
+{
+	auto key = std::make_pair(std::string(name), modes);
+	auto it = programs.find(key);
+	if (it != programs.end())
+		return it->second;
+
+	if (!glCaps().glsl)
+		return programs[key] = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	std::string header = std::string(version) + "\n" + modeDefines(modes);
+
+	//ключ файла - все, от чего зависит двоичный код
+	bool binary = binary_cache && glCaps().program_binary;
+	std::string path;
+	GLuint program = 0;
+	if (binary)
+	{
+		const GLCaps& caps = glCaps();
+		std::string all = header + vertex_source + "\n" + fragment_source + "\n" +
+			caps.vendor + "\n" + caps.renderer + "\n" + caps.version;
+		char hash[32];
+		snprintf(hash, sizeof(hash), ".%016llx.glprog", contentHash(all.data(), all.size()));
+		path = cache_dir + "/" + name + hash;
+		program = loadBinary(path);
+	}
+	if (program)
+		++binary_load_count;
+	else
+	{
+		program = build(name, header, vertex_source, fragment_source, binary);
+		if (program && binary)
+			saveBinary(path, program);
+	}
+
+	setup_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	programs[key] = program;
+	return program;
+}
+
+GLuint ProgramCache::loadBinary(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return 0;
+
+	//файл мог оборваться или испортиться - размер из заголовка сверяем с настоящим,
+	//прежде чем под него выделять память
+	in.seekg(0, std::ios::end);
+	unsigned long long file_size = (unsigned long long)in.tellg();
+	in.seekg(0);
+	BinaryHeader h;
+	in.read((char*)&h, sizeof(h));
+	if (!in || memcmp(h.id, BINARY_ID, sizeof(BINARY_ID)) != 0 || h.size == 0 ||
+		h.size != file_size - sizeof(h))
+		return 0;
+	std::vector<char> data(h.size);
+	in.read(data.data(), data.size());
+	if (!in)
+		return 0;
+
+	GLuint program = glfn.CreateProgram();
+	glfn.ProgramBinary(program, h.format, data.data(), (GLsizei)data.size());
+	//драйвер вправе отказаться (другая сборка, другие настройки) - тогда соберем заново
+	if (linked(program))
+		return program;
+	glfn.DeleteProgram(program);
+	platformDebugOutput(("program binary " + path + " rejected by the driver, rebuilding\n").c_str());
+	return 0;
+}
+
+void ProgramCache::saveBinary(const std::string& path, GLuint program)
+{
+	GLint length = 0;
+	glfn.GetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> data(length);
+	GLenum format = 0;
+	glfn.GetProgramBinary(program, length, &length, &format, data.data());
+	if (length <= 0)
+		return;
+
+	BinaryHeader h;
+	memcpy(h.id, BINARY_ID, sizeof(BINARY_ID));
+	h.format = format;
+	h.size = (unsigned int)length;
+
+	std::error_code error;
+	std::filesystem::create_directories(cache_dir, error);
+	if (error)
+		return;
+
+	std::string temporary = temporaryPath(path);
+	std::ofstream out(temporary, std::ios::binary);
+	if (!out)
+		return;
+	out.write((const char*)&h, sizeof(h));
+	out.write(data.data(), length);
+	out.close();
+	if (!out)
+	{
+		std::remove(temporary.c_str());
+		return;
+	}
+	replaceFile(temporary, path);
+}
+
+GLuint ProgramCache::build(const char* name, const std::string& header,
+	const char* vertex_source, const char* fragment_source, bool retrievable)
+{
+	const char* vertex_parts[] = { header.c_str(), vertex_source };
+	const char* fragment_parts[] = { header.c_str(), fragment_source };
+	GLuint vertex = compile(GL_VERTEX_SHADER, name, vertex_parts, 2);
+	GLuint fragment = compile(GL_FRAGMENT_SHADER, name, fragment_parts, 2);
+	if (!vertex || !fragment)
+	{
+		if (vertex)
+			glfn.DeleteShader(vertex);
+		if (fragment)
+			glfn.DeleteShader(fragment);
+		return 0;
+	}
+
+	GLuint program = glfn.CreateProgram();
+	//без подсказки драйвер может не сохранить то, что нужно для glGetProgramBinary
+	if (retrievable)
+		glfn.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glfn.AttachShader(program, vertex);
+	glfn.AttachShader(program, fragment);
+	glfn.LinkProgram(program);
+	//шейдеры удалятся вместе с программой
+	glfn.DeleteShader(vertex);
+	glfn.DeleteShader(fragment);
+
+	if (!linked(program))
+	{
+		GLint length = 0;
+		glfn.GetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+		std::vector<GLchar> log(length + 1);
+		glfn.GetProgramInfoLog(program, length, nullptr, log.data());
+		platformDebugOutput((std::string("program ") + name + ": " + log.data() + "\n").c_str());
+		glfn.DeleteProgram(program);
+		return 0;
+	}
+	++build_count;
+	return program;
+}
+
+void ProgramCache::clear()
+{
+	glState.useProgram(0);
+	for (auto& p : programs)
+		if (p.second)
+			glfn.DeleteProgram(p.second);
+	programs.clear();
+}
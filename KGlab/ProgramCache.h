@@ -0,0 +1,90 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include "GLLoader.h"
+
+//Программы GLSL по имени и комбинации режимов (см. RenderModes.h).
+//Исходник пишется один раз, варианты отличаются строками #define, которые
+//вставляются сразу после #version:
+//    GLuint p = programs.get("lighting", modes, "#version 150", vertex_source, fragment_source);
+//    if (p)
+//        glState.useProgram(p);
+//Программа собирается при первом запросе, дальше берется из кэша. Ошибка сборки
+//пишется в отладочный вывод, и get() для этого варианта всегда возвращает 0 -
+//вызывающий код остается на фиксированном конвейере. Только поток рендера.
+//
+//Собранная программа сохраняется на диск (glGetProgramBinary) в папку кеша (cacheDirectory(),
+//создается при первой записи) как <имя>.<хеш>.glprog и при следующем запуске грузится готовой (glProgramBinary) -
+//без компиляции и линковки. В хеше исходники, #define и строки драйвера
+//(производитель, видеокарта, версия): обновили драйвер или шейдер - файл просто
+//не найдется. Если драйвер все же отверг файл или файл битый (размер не сходится с заголовком),
+//программа собирается заново и файл перезаписывается.
+class ProgramCache
+{
+public:
+
+	//version - строка "#version ..." без перевода строки
+	GLuint get(const char* name, unsigned modes, const char* version,
+		const char* vertex_source, const char* fragment_source);
+
+	//удаляет все программы (например, перед сменой контекста)
+	void clear();
+
+	//false - не читать и не писать готовые программы (для замеров), по умолчанию true
+	void setBinaryCache(bool on)
+	{
+		binary_cache = on;
+	}
+	bool binaryCache() const
+	{
+		return binary_cache;
+	}
+	//куда класть файлы .glprog, по умолчанию glcache в текущей папке
+	void setCacheDirectory(const std::string& dir)
+	{
+		cache_dir = dir;
+	}
+	const std::string& cacheDirectory() const
+	{
+		return cache_dir;
+	}
+
+	//сколько программ собрано из исходников и сколько загружено готовыми
+	unsigned long long buildCount() const
+	{
+		return build_count;
+	}
+	unsigned long long binaryLoadCount() const
+	{
+		return binary_load_count;
+	}
+	//время всех get(), которые собирали или загружали программу, мс
+	double setupMs() const
+	{
+		return setup_ms;
+	}
+
+private:
+
+	GLuint build(const char* name, const std::string& header,
+		const char* vertex_source, const char* fragment_source, bool retrievable);
+
+	GLuint loadBinary(const std::string& path);
+	void saveBinary(const std::string& path, GLuint program);
+
+	std::map<std::pair<std::string, unsigned>, GLuint> programs;
+	bool binary_cache = true;
+	std::string cache_dir = "glcache";
+
+	unsigned long long build_count = 0;
+	unsigned long long binary_load_count = 0;
+	double setup_ms = 0;
+};
+
+extern ProgramCache programs;
+
+#endif
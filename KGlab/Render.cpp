@@ -1,14 +1,40 @@
 ﻿#include "Render.h"
-#include <Windows.h>
-#include <GL\GL.h>
-#include <GL\GLU.h>
+#include "GLCallCount.h"
+#include "GLState.h"
+#include "ImmediateBatch.h"
+#include "DisplayListCache.h"
+#include "RenderQueue.h"
+#include "RenderModes.h"
+#include "ShadedLighting.h"
+#include "ProgramCache.h"
+#include "InstancedMesh.h"
+#include "MeshArena.h"
 #include <iostream>
-#include <iomanip>
 #include <sstream>
 #include "GUItextRectangle.h"
+#include "Hud.h"
+#include "SdfFont.h"
+#include "Texture.h"
+#include "AssetLoader.h"
+#include "TextureManager.h"
+#include "TextureAtlas.h"
 #include <random>
 #include <algorithm>
+#include <cmath>
 #include <vector>
+#include <thread>
+#include <chrono>
+#ifdef LOAD_BENCHMARK
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#endif
+#ifdef INFLATE_BENCHMARK
+#include "MappedFile.h"
+#include "PngDecode.h"
+#endif
 
 #define PI 3.14159265358979323846
 
@@ -66,13 +92,12 @@ Vector3 computeNormalSide(const double* A, const double* B, const double* C) {
 }
 
 #ifdef _DEBUG
-#include <Debugapi.h> 
 struct debug_print
 {
 	template<class C>
 	debug_print& operator<<(const C& a)
 	{
-		OutputDebugStringA((std::stringstream() << a).str().c_str());
+		platformDebugOutput((std::stringstream() << a).str().c_str());
 		return *this;
 	}
 } debout;
@@ -89,6 +114,9 @@ struct debug_print
 
 //библиотека для разгрузки изображений
 //https://github.com/nothings/stb
+//PNG разжимает быстрый распаковщик из FastInflate.cpp.
+//Закомментировать - вернется штатный из stb
+#define STBI_FAST_INFLATE
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -103,12 +131,15 @@ Camera camera;
 bool texturing = true;
 bool lightning = true;
 bool alpha = false;
+bool mipmapping = true;
+//HUD и график времени кадров
+bool overlay = true;
 
 //переключение режимов освещения, текстурирования, альфаналожения
 void switchModes(OpenGL *sender, KeyEventArg arg)
 {
-	//конвертируем код клавиши в букву
-	auto key = LOWORD(MapVirtualKeyA(arg.key, MAPVK_VK_TO_CHAR));
+	//коды букв - их заглавные ASCII-коды (см. Platform.h)
+	auto key = arg.key;
 
 	switch (key)
 	{
@@ -121,77 +152,97 @@ void switchModes(OpenGL *sender, KeyEventArg arg)
 	case 'A':
 		alpha = !alpha;
 		break;
+	case 'M':
+		mipmapping = !mipmapping;
+		break;
 	}
 }
 
 //Текстовый прямоугольничек в верхнем правом углу.
 //OGL не предоставляет возможности для хранения текста
-//внутри этого класса создается картинка с текстом (через виндовый GDI),
+//внутри этого класса создается картинка с текстом (шрифтом ОС, см. TextRaster),
 //в виде текстуры накладывается на прямоугольник и рисуется на экране.
 //Это самый простой способ что то написать на экране
 //но ооооочень не оптимальный
 GuiTextRectangle text;
+//содержимое этого прямоугольничка
+Hud hud;
+
+//Шрифт на поле расстояний: атлас строится один раз (и кешируется в font.sdf),
+//дальше любой текст любого размера - это просто прямоугольники.
+//Если атлас построить не удалось, рисуем старым GuiTextRectangle.
+SdfFont font;
+//высота текста HUD в пикселях, можно менять без перестроения атласа
+double hud_text_size = 16;
+
+//мип-уровни + трилинейная и анизотропная фильтрация.
+//Без них при отдалении камеры текстура мерцает и выборка скачет по памяти
+TextureOptions texOptions;
+//картинки разбираются в фоне, первый кадр их не ждет
+AssetLoader loader;
+//все текстуры из файлов, см. TextureManager.h
+TextureManager textures(loader);
+//текстура призмы
+TextureHandle texPrism;
+
+#ifdef MIP_BENCHMARK
+//Замер выборки из текстуры на разных расстояниях камеры:
+//на каждой дистанции по BENCH_FRAMES кадров без мип-уровней и с ними,
+//среднее время кадра пишется в отладочный вывод.
+const double bench_distances[] = { 2, 5, 10, 25, 50, 100 };
+const int BENCH_STEPS = 2 * sizeof(bench_distances) / sizeof(bench_distances[0]);
+const int BENCH_FRAMES = 240;
+const int BENCH_WARMUP = 30;
+int bench_frame = 0;
+double bench_time = 0;
+
+void mipBenchmarkStep(double delta_time)
+{
+	int step = bench_frame / BENCH_FRAMES;
+	if (step >= BENCH_STEPS)
+		return;
+
+	int frame = bench_frame % BENCH_FRAMES;
+	if (frame == 0)
+	{
+		//смотрим с той же стороны, меняем только расстояние
+		double d = bench_distances[step / 2];
+		double k = d / std::sqrt(2.0 * 2.0 + 1.5 * 1.5 + 1.5 * 1.5);
+		camera.setPosition(2 * k, 1.5 * k, 1.5 * k);
+		mipmapping = step % 2 == 1;
+		bench_time = 0;
+	}
+	if (frame >= BENCH_WARMUP)
+		bench_time += delta_time;
+	if (frame == BENCH_FRAMES - 1)
+		debout << "mip benchmark: R=" << bench_distances[step / 2]
+			<< (mipmapping ? " mipmaps " : " linear  ")
+			<< bench_time * 1000 / (BENCH_FRAMES - BENCH_WARMUP) << " ms/frame\n";
+
+	++bench_frame;
+}
+#endif
 
-//айдишник для текстуры
-GLuint texId;
 //выполняется один раз перед первым рендером
 void initRender()
 {
 	//==============НАСТРОЙКА ТЕКСТУР================
-	//4 байта на хранение пикселя
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	//просим сгенерировать нам Id для текстуры
-	//и положить его в texId
-	glGenTextures(1, &texId);
-
-	//делаем текущую текстуру активной
-	//все, что ниже будет применено texId текстуре.
-	glBindTexture(GL_TEXTURE_2D, texId);
-
-	int x, y, n;
-
-	//загружаем картинку
-	//см. #include "stb_image.h" 
-	unsigned char* data = stbi_load("texture.png", &x, &y, &n, 4);
-	//x - ширина изображения
-	//y - высота изображения
-	//n - количество каналов
-	//4 - нужное нам количество каналов
-	//пиксели будут храниться в памяти [R-G-B-A]-[R-G-B-A]-[..... 
-	// по 4 байта на пиксель - по байту на канал
-	//пустые каналы будут равны 255
-
-	//Картинка хранится в памяти перевернутой 
-	//так как ее начало в левом верхнем углу
-	//по этому мы ее переворачиваем -
-	//меняем первую строку с последней,
-	//вторую с предпоследней, и.т.д.
-	unsigned char* _tmp = new unsigned char[x * 4]; //времянка
-	for (int i = 0; i < y / 2; ++i)
-	{
-		std::memcpy(_tmp, data + i * x * 4, x * 4);//переносим строку i в времянку
-		std::memcpy(data + i * x * 4, data + (y - 1 - i) * x * 4, x * 4); //(y-1-i)я строка -> iя строка
-		std::memcpy(data + (y - 1 - i) * x * 4, _tmp, x * 4); //времянка -> (y-1-i)я строка
-	}
-	delete[] _tmp;
-
-	//загрузка изображения в видеопамять
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-
-	//выгрузка изображения из опперативной памяти
-	stbi_image_free(data);
+	//Пока картинка грузится и строятся мип-уровни (в фоне, см. AssetLoader.h),
+	//в текстуре лежит шахматка-заглушка.
+	//В видеопамяти texture.png хранится сжатой в BC1 (в 8 раз меньше GL_RGBA),
+	//сжатая версия кешируется рядом, в texture.png.<хеш>.ktx
+	texOptions.compress = true;
+	texPrism = textures.load("texture.png", texOptions);
+	//больше этого в видеопамяти не держим, давно не нужные текстуры выгружаются
+	textures.setBudget(64 * 1024 * 1024);
 
 	//настройка режима наложения текстур
-	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-												  //GL_REPLACE -- полная замена политога текстурой
-	//настройка тайлинга
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glState.texEnvMode(GL_MODULATE);
 
-	//настройка фильтрации
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	//на GL 1.1 пачки рисуются из памяти каждый кадр, списки драйвер хранит у себя
+	if (!glCaps().vbo)
+		setGeometryPath(GeometryPath::DisplayLists);
+												  //GL_REPLACE -- полная замена политога текстурой
 	//======================================================
 
 	//================НАСТРОЙКА КАМЕРЫ======================
@@ -211,73 +262,308 @@ void initRender()
 	//========================================================
 	//====================Прочее==============================
 	gl.KeyDownEvent.reaction(switchModes);
-	text.setSize(512, 180);
+	text.setSize(512, 200);
+
+#ifdef LOAD_BENCHMARK
+	//время и пиковая память при загрузке одной большой картинки (например 16384x16384).
+	//Пик - это PeakWorkingSetSize процесса (в Linux - ru_maxrss), поэтому замер делается до всего остального
+	{
+#ifndef LOAD_BENCHMARK_FILE
+#define LOAD_BENCHMARK_FILE "texture.png"
+#endif
+		auto peak_bytes = []() -> size_t
+		{
+#ifdef _WIN32
+			PROCESS_MEMORY_COUNTERS counters;
+			GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+			return counters.PeakWorkingSetSize;
+#else
+			rusage usage;
+			getrusage(RUSAGE_SELF, &usage);
+			return (size_t)usage.ru_maxrss * 1024;
+#endif
+		};
+		size_t before = peak_bytes();
+		auto start = std::chrono::steady_clock::now();
+		Image image;
+#ifdef LOAD_BENCHMARK_PBO
+		//сразу в текстуру через PBO (см. loadTexture), без картинки в памяти процесса
+		TextureOptions options;
+		options.gpu_mipmaps = true;
+		GLuint id = loadTexture(LOAD_BENCHMARK_FILE, options);
+		bool ok = id != 0;
+		glFinish();
+		glState.deleteTextures(1, &id);
+#else
+		bool ok = loadImage(LOAD_BENCHMARK_FILE, image);
+#endif
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		size_t after = peak_bytes();
+		debout << "load: " << LOAD_BENCHMARK_FILE << (ok ? "" : " FAILED") << " " << image.width << "x" << image.height
+			<< " in " << ms << " ms, image " << image.pixels.size() / (1024 * 1024) << " MB, peak working set +"
+			<< (after - before) / (1024 * 1024) << " MB\n";
+	}
+#endif
+#ifdef ATLAS_BENCHMARK
+	//раскладка 1000 случайных картинок от 8x8 до 64x64
+	{
+		std::mt19937 rng(1);
+		std::uniform_int_distribution<int> size(8, 64);
+		TextureAtlas atlas;
+		for (int i = 0; i < 1000; ++i)
+		{
+			Image image;
+			image.width = size(rng);
+			image.height = size(rng);
+			image.pixels.assign((size_t)image.width * image.height * 4, (unsigned char)i);
+			atlas.add(std::move(image));
+		}
+		atlas.pack();
+		debout << "atlas: " << atlas.imageCount() << " images, " << atlas.pageCount() << " pages, packed in "
+			<< atlas.packTimeMs() << " ms, pixels copied in " << atlas.blitTimeMs() << " ms\n";
+		for (int p = 0; p < atlas.pageCount(); ++p)
+			debout << "  page " << p << ": " << atlas.page(p).width << "x" << atlas.page(p).height
+				<< ", " << atlas.occupancy(p) * 100 << "% used\n";
+	}
+#endif
+#ifdef SDF_BENCHMARK
+	//замер построения атласа на всем наборе символов при разном числе потоков
+	for (unsigned t = 1; t <= std::max(1u, std::thread::hardware_concurrency()); t *= 2)
+	{
+		font.build(L"Consolas", t);
+		debout << "SDF atlas: " << SdfFont::charset().size() << " glyphs, "
+			<< font.buildThreads() << " threads, " << font.buildTimeMs() << " ms\n";
+	}
+#endif
+#ifdef INFLATE_BENCHMARK
+	//штатный распаковщик stb против FastInflate на одном большом потоке (все IDAT картинки)
+	//и PNG целиком: stbi_load_from_memory против decodeImage. Лучшее время из 20 раз
+	{
+#ifndef INFLATE_BENCHMARK_FILE
+#define INFLATE_BENCHMARK_FILE "texture.png"
+#endif
+		MappedFile file(INFLATE_BENCHMARK_FILE);
+		std::vector<InflateInput> idat;
+		bool plain;
+		int width, height;
+		if (file.isOpen() && pngData(file.data(), file.size(), idat, plain) &&
+			imageSize(file.data(), file.size(), width, height))
+		{
+			std::vector<unsigned char> stream;
+			for (const InflateInput& part : idat)
+				stream.insert(stream.end(), part.data, part.data + part.size);
+			std::vector<unsigned char> pixels((size_t)width * height * 4);
+
+			//[0] - stb, [1] - FastInflate
+			double inflate_ms[2] = { 1e9, 1e9 }, png_ms[2] = { 1e9, 1e9 };
+			int inflated = 0;
+			auto since = [](std::chrono::steady_clock::time_point start) {
+				return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			};
+			for (int run = 0; run < 20; ++run)
+			{
+				for (int fast = 0; fast < 2; ++fast)
+				{
+					stbi_set_fast_inflate(fast);
+					auto start = std::chrono::steady_clock::now();
+					char* out = stbi_zlib_decode_malloc_guesssize_headerflag((const char*)stream.data(),
+						(int)stream.size(), 16384, &inflated, 1);
+					inflate_ms[fast] = std::min(inflate_ms[fast], since(start));
+					stbi_image_free(out);
+				}
+
+				//stb переворачивает так же, как decodeImage, и разжимает своим распаковщиком
+				stbi_set_fast_inflate(0);
+				stbi_set_flip_vertically_on_load_thread(1);
+				auto start = std::chrono::steady_clock::now();
+				int x, y, n;
+				unsigned char* reference = stbi_load_from_memory(file.data(), (int)file.size(), &x, &y, &n, 4);
+				png_ms[0] = std::min(png_ms[0], since(start));
+				stbi_image_free(reference);
+				stbi_set_flip_vertically_on_load_thread(0);
+				stbi_set_fast_inflate(1);
+
+				start = std::chrono::steady_clock::now();
+				decodeImage(file.data(), file.size(), pixels.data());
+				png_ms[1] = std::min(png_ms[1], since(start));
+			}
+			debout << "inflate: " << INFLATE_BENCHMARK_FILE << " " << stream.size() / 1024 << " KB -> "
+				<< inflated / 1024 << " KB, stb " << inflate_ms[0] << " ms, FastInflate " << inflate_ms[1]
+				<< " ms, " << inflate_ms[0] / inflate_ms[1] << "x\n";
+			debout << "png: " << width << "x" << height << ", stb " << png_ms[0] << " ms, decodeImage "
+				<< png_ms[1] << " ms, " << png_ms[0] / png_ms[1] << "x\n";
+		}
+		else
+			debout << "inflate: " << INFLATE_BENCHMARK_FILE << " is not a PNG\n";
+	}
+#endif
+	if (font.load(L"Consolas", "font.sdf"))
+	{
+		if (font.fromCache())
+			debout << "SDF atlas: loaded from font.sdf\n";
+		else
+			debout << "SDF atlas: built in " << font.buildTimeMs() << " ms, "
+				<< font.buildThreads() << " threads\n";
+	}
+	//программы освещения - сразу, а не на первом кадре с новым режимом.
+	//Уже собиравшиеся грузятся готовыми (см. ProgramCache.h)
+	for (unsigned m = 0; m < MODE_COUNT; ++m)
+		if (m & ModeLighting)
+			shadedLighting.program(m);
+	if (programs.buildCount() || programs.binaryLoadCount())
+		debout << "programs: " << programs.buildCount() << " built, " << programs.binaryLoadCount()
+			<< " loaded from binaries, " << programs.setupMs() << " ms\n";
 	//========================================================
 
 	camera.setPosition(2, 1.5, 1.5);
 }
 
-void Render(double delta_time)
-{    
-	glEnable(GL_DEPTH_TEST);
-	
-	//натройка камеры и света
-	//в этих функциях находятся OGLные функции
-	//которые устанавливают параметры источника света
-	//и моделвью матрицу, связанные с камерой.
+bool renderLoading()
+{
+	return !loader.idle();
+}
 
-	if (gl.isKeyPressed('F')) //если нажата F - свет из камеры
+void setCameraPosition(double x, double y, double z)
+{
+	camera.setPosition(x, y, z);
+}
+
+void setLightPosition(double x, double y, double z)
+{
+	light.SetPosition(x, y, z);
+}
+
+void setRenderMode(char key, bool on)
+{
+	switch (key)
 	{
-		light.SetPosition(camera.x(), camera.y(), camera.z());
+	case 'L':
+		lightning = on;
+		break;
+	case 'T':
+		texturing = on;
+		break;
+	case 'A':
+		alpha = on;
+		break;
+	case 'M':
+		mipmapping = on;
+		break;
 	}
-	camera.SetUpCamera();
-	light.SetUpLight();
+}
 
-	//рисуем оси
-	gl.DrawAxes();
+void setRenderOverlay(bool on)
+{
+	overlay = on;
+}
 
-	glDisable(GL_LIGHTING);
-	glDisable(GL_TEXTURE_2D);
-	glDisable(GL_BLEND);
+//оси и нагрузочная сцена - из общей арены (см. Render)
+bool indirect_geometry = false;
 
-	//включаем режимы, в зависимости от нажания клавиш. см void switchModes(OpenGL *sender, KeyEventArg arg)
-	if (lightning)
-		glEnable(GL_LIGHTING);
-	if (texturing)
-	{
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, 0); //сбрасываем текущую текстуру
-	}
-		
-	if (alpha)
+void setGeometryPath(GeometryPath path)
+{
+	imm.setDirect(path == GeometryPath::Immediate);
+	displayLists.setEnabled(path == GeometryPath::DisplayLists);
+	indirect_geometry = path == GeometryPath::Indirect;
+}
+
+GeometryPath geometryPath()
+{
+	if (indirect_geometry)
+		return GeometryPath::Indirect;
+	if (displayLists.isEnabled())
+		return GeometryPath::DisplayLists;
+	return imm.isDirect() ? GeometryPath::Immediate : GeometryPath::Batched;
+}
+
+void setLightingPath(LightingPath path)
+{
+	shadedLighting.setEnabled(path == LightingPath::Shaders);
+}
+
+LightingPath lightingPath()
+{
+	return shadedLighting.program(ModeLighting) ? LightingPath::Shaders : LightingPath::FixedFunction;
+}
+
+//Нагрузочная сцена: мелкие копии призмы сеткой под основной, сетка копии
+//записывается на первом кадре (см. Render)
+InstancedMesh stressMesh;
+//те же копии для общей арены
+std::vector<InstancedMesh::Instance> stress_copies;
+//арену надо заполнить заново
+bool static_scene_dirty = true;
+//копий много и они мелкие - полукруг погрубее
+const int STRESS_ARC_SEGMENTS = 12;
+//сторона квадрата с копиями - весь он ближе дальней плоскости камеры (200)
+const double STRESS_EXTENT = 150;
+
+void setStressInstances(int count)
+{
+	std::vector<InstancedMesh::Instance> list(std::max(count, 0));
+	int side = (int)std::ceil(std::sqrt((double)list.size()));
+	double spacing = STRESS_EXTENT / std::max(side, 1);
+	//цвета и повороты случайные, но одинаковые при каждом запуске
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> color(0.3f, 1.0f);
+	std::uniform_real_distribution<float> angle(0, 2 * (float)PI);
+	for (size_t i = 0; i < list.size(); ++i)
 	{
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		InstancedMesh::Instance& c = list[i];
+		c.position[0] = (float)(((int)i % side + 0.5) * spacing - STRESS_EXTENT / 2);
+		c.position[1] = (float)(((int)i / side + 0.5) * spacing - STRESS_EXTENT / 2);
+		c.position[2] = -2;
+		//призма около 13 в поперечнике
+		c.scale = (float)(spacing / 16);
+		c.color[0] = color(rng);
+		c.color[1] = color(rng);
+		c.color[2] = color(rng);
+		c.angle = angle(rng);
 	}
-		
-	//=============НАСТРОЙКА МАТЕРИАЛА==============
+	stressMesh.setInstances(list);
+	stress_copies.swap(list);
+	static_scene_dirty = true;
+}
 
-	//настройка материала, все что рисуется ниже будет иметь этот метериал.
-	//массивы с настройками материала
-	float  amb[] = { 0.2, 0.2, 0.1, 1. };
-	float dif[] = { 0.4, 0.65, 0.5, 1. };
-	float spec[] = { 0.9, 0.8, 0.3, 1. };
-	float sh = 0.2f * 256;
-
-	//фоновая
-	glMaterialfv(GL_FRONT, GL_AMBIENT, amb);
-	//дифузная
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, dif);
-	//зеркальная
-	glMaterialfv(GL_FRONT, GL_SPECULAR, spec); 
-	//размер блика
-	glMaterialf(GL_FRONT, GL_SHININESS, sh);
+int stressInstances()
+{
+	return (int)stressMesh.instanceCount();
+}
 
-	//чтоб было красиво, без квадратиков (сглаживание освещения)
-	glShadeModel(GL_SMOOTH); //закраска по Гуро      
-			   //(GL_SMOOTH - плоская закраска)
+void setInstancingPath(InstancingPath path)
+{
+	stressMesh.setHardware(path == InstancingPath::Hardware);
+	staticScene.setIndirect(path == InstancingPath::Hardware);
+}
 
-	//============ РИСОВАТЬ ТУТ ==============
+InstancingPath instancingPath()
+{
+	return stressMesh.isHardware() ? InstancingPath::Hardware : InstancingPath::Replicated;
+}
+
+//геометрия призмы - ее считает Render(), рисуют варианты DrawPrism ниже
+struct Prism
+{
+	//низ и верх
+	Vector3 A, B, C, D, E, F, G, H;
+	Vector3 A1, B1, C1, D1, E1, F1, G1, H1;
+	double height;
+
+	//полукруг на ребре EF
+	double MID[3];
+	double radius;
+	double startfaza;
+	//отрезков в полукруге
+	int arc_segments;
+
+	double center_x, center_y;
+	//хеш точек - вход display list'ов
+	unsigned long long hash;
+};
+
+//призма с arc_segments отрезками в полукруге
+static Prism makePrism(int arc_segments)
+{
 	Vector3 A = { 1.0, 0.0, 0.0 };
 	Vector3 B = { 6.0, 3.0, 0.0 };
 	Vector3 C = { 4.0, 7.0, 0.0 };
@@ -298,186 +584,456 @@ void Render(double delta_time)
 	Vector3 G1 = { -2.0, -6.0, height };
 	Vector3 H1 = { 3.0, -4.0, height };
 
-	Vector3 Aс = { 0.615385 , 0.461538, 1 };
-	Vector3 Bс = { 1.000000  ,0.692308, 1 };
-	Vector3 Cс = { 0.846154 , 1.000000 ,1 };
-	Vector3 Dс = { 0.538462 , 0.615385 ,1 };
-	Vector3 Eс = { 0.230769  ,0.692308 ,1 };
-	Vector3 Fс = { 0.000000 , 0.307692 ,1 };
-	Vector3 Gс = { 0.384615 , 0.000000 ,1 };
-	Vector3 Hс = { 0.769231 , 0.153846 ,1 };
-
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, texId); //привязываем текстуру к текущему контексту
-
-	Vector3 normal = computeNormal(A, B, C);
-
-	glBegin(GL_QUADS);
-
-	// Floor
-	glNormal3d(0, 0, -1);
-	glColor3d(1, 0.213, 0.2);
-	glVertex3dv((double*)&A);
-	glVertex3dv((double*)&B);
-	glVertex3dv((double*)&C);
-	glVertex3dv((double*)&D);
-
-	glNormal3d(0, 0, -1);
-	glColor3d(0.8, 1.0, 0.3);
-	glVertex3dv((double*)&A);
-	glVertex3dv((double*)&D);
-	glVertex3dv((double*)&E);
-	glVertex3dv((double*)&H);
-
-	glNormal3d(0, 0, -1);
-	glColor3d(0.9, 0.32, 0.4);
-	glVertex3dv((double*)&E);
-	glVertex3dv((double*)&F);
-	glVertex3dv((double*)&G);
-	glVertex3dv((double*)&H);
-
-	// Walls connecting
-	normal = computeNormal(A, A1, B1);
-	glNormal3dv((double*)&normal);
-	glColor3d(0.1, 0.0, 0.5);
-	glVertex3dv((double*)&A);
-	glVertex3dv((double*)&A1);
-	glVertex3dv((double*)&B1);
-	glVertex3dv((double*)&B);
-
-	normal = computeNormal(B, B1, C1);
-	glNormal3dv((double*)&normal);
-	glColor3d(0.76, 0.2, 0.6);
-	glVertex3dv((double*)&B);
-	glVertex3dv((double*)&B1);
-	glVertex3dv((double*)&C1);
-	glVertex3dv((double*)&C);
-
-	normal = computeNormal(C, C1, D1);
-	glNormal3dv((double*)&normal);
-	glColor3d(0, 0.3, 0.7);
-	glVertex3dv((double*)&C);
-	glVertex3dv((double*)&C1);
-	glVertex3dv((double*)&D1);
-	glVertex3dv((double*)&D);
-
-	normal = computeNormal(D, D1, E1);
-	glNormal3dv((double*)&normal);
-	glColor3d(0.3, 0.4, 0.8);
-	glVertex3dv((double*)&D);
-	glVertex3dv((double*)&D1);
-	glVertex3dv((double*)&E1);
-	glVertex3dv((double*)&E);
-
-	normal = computeNormal(F, F1, G1);
-	glNormal3dv((double*)&normal);
-	glColor3d(0.3, 0.6, 1.0);
-	glVertex3dv((double*)&F);
-	glVertex3dv((double*)&F1);
-	glVertex3dv((double*)&G1);
-	glVertex3dv((double*)&G);
-
-	normal = computeNormal(G, G1, H1);
-	glNormal3dv((double*)&normal);
-	glColor3d(0.3, 0.7, 0.9);
-	glVertex3dv((double*)&G);
-	glVertex3dv((double*)&G1);
-	glVertex3dv((double*)&H1);
-	glVertex3dv((double*)&H);
-
-	normal = computeNormal(H, H1, A1);
-	glNormal3dv((double*)&normal);
-	glColor3d(0.3, 0.6, 0.8);
-	glVertex3dv((double*)&H);
-	glVertex3dv((double*)&H1);
-	glVertex3dv((double*)&A1);
-	glVertex3dv((double*)&A);
-
 	double VectorFE[] = { F.x - E.x, F.y - E.y, F.z - E.z };
 	double startfaza = PI + atan2(VectorFE[1], VectorFE[0]);
 	double MID[] = { (E.x + F.x) / 2, (E.y + F.y) / 2, (E.z + F.z) / 2 };
 	double radius = sqrt(VectorFE[0] * VectorFE[0] + VectorFE[1] * VectorFE[1]) / 2;
-	int i = 0;
-	glColor3d(0.3, 0.5, 0.1);
-	while (i < 90)
+
+	double center_x = (A.x + B.x + C.x + D.x + E.x + F.x + G.x + H.x) / 8;
+	double center_y = (A.y + B.y + C.y + D.y + E.y + F.y + G.y + H.y) / 8;
+
+	//геометрия зависит только от этих точек - в режиме display list
+	//она записывается один раз (см. DisplayListCache.h)
+	return { A, B, C, D, E, F, G, H, A1, B1, C1, D1, E1, F1, G1, H1,
+		height,
+		{ MID[0], MID[1], MID[2] }, radius, startfaza, arc_segments,
+		center_x, center_y, hashInputs(A, B, C, D, E, F, G, H, height, arc_segments) };
+}
+
+//Отрисовка призмы в режиме M (см. RenderModes.h): вариант на каждую комбинацию
+//освещения, текстур и прозрачности. Атрибуты, которые в режиме не видны, не считаются
+//и не пишутся: без освещения - нормали, с освещением - цвета (материал без GL_COLOR_MATERIAL),
+//без текстур - текстурные координаты. Проверки режима - только if constexpr.
+template<unsigned M>
+struct DrawPrism
+{
+	using Modes = RenderModes<M>;
+
+	static void normal(const Vector3& n)
+	{
+		if constexpr (Modes::lighting)
+			imm.normal3dv((const double*)&n);
+	}
+	static void normal(double x, double y, double z)
+	{
+		if constexpr (Modes::lighting)
+			imm.normal3d(x, y, z);
+	}
+	//нормаль грани ABC
+	static void faceNormal(const Vector3& A, const Vector3& B, const Vector3& C)
 	{
-		double x = MID[0] + radius * cos(2 * PI * i / 180 + startfaza);
-		double y = MID[1] + radius * sin(2 * PI * i / 180 + startfaza);
-		double z = MID[2];
-		double x1 = MID[0] + radius * cos(2 * PI * (i + 1) / 180 + startfaza);
-		double y1 = MID[1] + radius * sin(2 * PI * (i + 1) / 180 + startfaza);
-		double z1 = MID[2];
-
-		Vector3 normalBot = computeNormalBot(MID, new double[3] {x, y, z}, new double[3] {x1, y1, z1});
-		glNormal3dv((double*)&normalBot);
-		glColor3d(0.3, 0.5, 0.1);
-		glVertex3d(MID[0], MID[1], MID[2]);
-		glVertex3d(x, y, z);
-
-		glNormal3dv((double*)&normalBot);
-		glVertex3d(x1, y1, z1);
-		glVertex3d(MID[0], MID[1], MID[2]);
-
-		Vector3 normalSide = computeNormalSide(new double[3] {x, y, z}, new double[3] {x, y, z + height}, new double[3] {x1, y1, z1 + height});
-		glNormal3dv((double*)&normalSide);
-		glColor3d(1, 0.5, 0.1);
-		glVertex3d(x, y, z);
-		glVertex3d(x, y, z + height);
-		glVertex3d(x1, y1, z1 + height);
-		glVertex3d(x1, y1, z1);
-
-		i++;
-	}
-
-	i = 0;
-	glColor3d(0.3, 0.5, 0.1);
-
-	while (i<90)
+		if constexpr (Modes::lighting)
+			normal(computeNormal(A, B, C));
+	}
+	static void color(double r, double g, double b, double a = 1)
 	{
-		double x = MID[0] + radius * cos(2 * PI * i / 180 + startfaza);
-		double y = MID[1] + radius * sin(2 * PI * i / 180 + startfaza);
-		double z = MID[2];
-		double x1 = MID[0] + radius * cos(2 * PI * (i + 1) / 180 + startfaza);
-		double y1 = MID[1] + radius * sin(2 * PI * (i + 1) / 180 + startfaza);
-		double z1 = MID[2];
-		Vector3 normal = computeNormalTop(MID, new double[3] {x, y, z}, new double[3] {x1, y1, z1});
-		glNormal3dv((double*)&normal);
-		glColor4d(0.3, 0.5, 0.1, 0.5);
-		glVertex3d(MID[0], MID[1], MID[2] + height);
-		glVertex3d(x, y, z + height);
-		glVertex3d(x1, y1, z1 + height);
-		glVertex3d(MID[0], MID[1], MID[2] + height);
-		i++;
+		if constexpr (!Modes::lighting)
+			imm.color4d(r, g, b, a);
+	}
+	static void texCoord(double s, double t)
+	{
+		if constexpr (Modes::texturing)
+			imm.texCoord2d(s, t);
+	}
+	static void vertex(const Vector3& v)
+	{
+		imm.vertex3dv((const double*)&v);
+	}
+
+	//ставит части призмы в очередь
+	static void run(const Prism& p, int material)
+	{
+		//у каждой комбинации свои списки: в них записан только ее формат вершин
+		unsigned long long inputs = hashInputs(p.hash, M);
+		auto part = [&](const char* name, const TextureHandle& texture, double x, double y, double z,
+			void (*block)(const Prism&), bool lid)
+		{
+			RenderQueue::Item item;
+			if constexpr (Modes::texturing)
+				item.texture = &texture;
+			if constexpr (Modes::lighting)
+			{
+				item.material = material;
+				//0 - без шейдеров, светит GL_LIGHT0
+				item.shader = shadedLighting.program(M);
+			}
+			if constexpr (Modes::alpha)
+			{
+				//крышка полупрозрачная - после непрозрачного, сзади вперед
+				if (lid)
+				{
+					item.pass = RenderQueue::Transparent;
+					item.blend = RenderQueue::BlendAlpha;
+				}
+			}
+			item.center[0] = x;
+			item.center[1] = y;
+			item.center[2] = z;
+			const Prism* prism = &p;
+			item.draw = [name, inputs, prism, block]()
+			{
+				imm.setAttributes(Modes::attributes);
+				displayLists.draw(name, inputs, [prism, block]() { block(*prism); });
+			};
+			return item;
+		};
+
+		renderQueue.submit(part("walls", texPrism, p.center_x, p.center_y, p.height / 2, walls, false));
+		renderQueue.submit(part("arc", texPrism, p.MID[0], p.MID[1], p.height / 2, arc, false));
+		renderQueue.submit(part("arc cap", texPrism, p.MID[0], p.MID[1], p.height, cap, true));
+		renderQueue.submit(part("roof", texPrism, p.center_x, p.center_y, p.height, roof, true));
 	}
+
+	//пол и стены
+	static void walls(const Prism& p)
+	{
+		//текстурных координат у призмы нет - у всех вершин (0, 0)
+		texCoord(0, 0);
+
+		imm.begin(GL_QUADS);
+
+		// Floor
+		normal(0, 0, -1);
+		color(1, 0.213, 0.2);
+		vertex(p.A);
+		vertex(p.B);
+		vertex(p.C);
+		vertex(p.D);
+
+		normal(0, 0, -1);
+		color(0.8, 1.0, 0.3);
+		vertex(p.A);
+		vertex(p.D);
+		vertex(p.E);
+		vertex(p.H);
+
+		normal(0, 0, -1);
+		color(0.9, 0.32, 0.4);
+		vertex(p.E);
+		vertex(p.F);
+		vertex(p.G);
+		vertex(p.H);
+
+		// Walls connecting
+		faceNormal(p.A, p.A1, p.B1);
+		color(0.1, 0.0, 0.5);
+		vertex(p.A);
+		vertex(p.A1);
+		vertex(p.B1);
+		vertex(p.B);
+
+		faceNormal(p.B, p.B1, p.C1);
+		color(0.76, 0.2, 0.6);
+		vertex(p.B);
+		vertex(p.B1);
+		vertex(p.C1);
+		vertex(p.C);
+
+		faceNormal(p.C, p.C1, p.D1);
+		color(0, 0.3, 0.7);
+		vertex(p.C);
+		vertex(p.C1);
+		vertex(p.D1);
+		vertex(p.D);
+
+		faceNormal(p.D, p.D1, p.E1);
+		color(0.3, 0.4, 0.8);
+		vertex(p.D);
+		vertex(p.D1);
+		vertex(p.E1);
+		vertex(p.E);
+
+		faceNormal(p.F, p.F1, p.G1);
+		color(0.3, 0.6, 1.0);
+		vertex(p.F);
+		vertex(p.F1);
+		vertex(p.G1);
+		vertex(p.G);
+
+		faceNormal(p.G, p.G1, p.H1);
+		color(0.3, 0.7, 0.9);
+		vertex(p.G);
+		vertex(p.G1);
+		vertex(p.H1);
+		vertex(p.H);
+
+		faceNormal(p.H, p.H1, p.A1);
+		color(0.3, 0.6, 0.8);
+		vertex(p.H);
+		vertex(p.H1);
+		vertex(p.A1);
+		vertex(p.A);
+		imm.end();
+	}
+
+	//полукруглая стена на ребре EF
+	static void arc(const Prism& p)
+	{
+		const double* MID = p.MID;
+		texCoord(0, 0);
+		imm.begin(GL_QUADS);
+
+		int i = 0;
+		color(0.3, 0.5, 0.1);
+		while (i < p.arc_segments)
+		{
+			double a = PI * i / p.arc_segments + p.startfaza;
+			double a1 = PI * (i + 1) / p.arc_segments + p.startfaza;
+			double x = MID[0] + p.radius * cos(a);
+			double y = MID[1] + p.radius * sin(a);
+			double z = MID[2];
+			double x1 = MID[0] + p.radius * cos(a1);
+			double y1 = MID[1] + p.radius * sin(a1);
+			double z1 = MID[2];
+
+			Vector3 normalBot = { 0, 0, 0 };
+			if constexpr (Modes::lighting)
+			{
+				double P[3] = { x, y, z };
+				double P1[3] = { x1, y1, z1 };
+				normalBot = computeNormalBot(MID, P, P1);
+			}
+			normal(normalBot);
+			color(0.3, 0.5, 0.1);
+			imm.vertex3d(MID[0], MID[1], MID[2]);
+			imm.vertex3d(x, y, z);
+
+			normal(normalBot);
+			imm.vertex3d(x1, y1, z1);
+			imm.vertex3d(MID[0], MID[1], MID[2]);
+
+			//нормаль стены - по радиусу в каждой вершине, а не одна на отрезок:
+			//стена освещается как гладкий цилиндр и при редкой сетке
+			color(1, 0.5, 0.1);
+			normal(cos(a), sin(a), 0);
+			imm.vertex3d(x, y, z);
+			imm.vertex3d(x, y, z + p.height);
+			normal(cos(a1), sin(a1), 0);
+			imm.vertex3d(x1, y1, z1 + p.height);
+			imm.vertex3d(x1, y1, z1);
+
+			i++;
+		}
+
+		imm.end();
+	}
+
+	//крышка над полукругом
+	static void cap(const Prism& p)
+	{
+		const double* MID = p.MID;
+		texCoord(0, 0);
+		imm.begin(GL_QUADS);
+
+		int i = 0;
+		color(0.3, 0.5, 0.1);
+
+		while (i < p.arc_segments)
+		{
+			double x = MID[0] + p.radius * cos(PI * i / p.arc_segments + p.startfaza);
+			double y = MID[1] + p.radius * sin(PI * i / p.arc_segments + p.startfaza);
+			double z = MID[2];
+			double x1 = MID[0] + p.radius * cos(PI * (i + 1) / p.arc_segments + p.startfaza);
+			double y1 = MID[1] + p.radius * sin(PI * (i + 1) / p.arc_segments + p.startfaza);
+			double z1 = MID[2];
+			if constexpr (Modes::lighting)
+			{
+				double P[3] = { x, y, z };
+				double P1[3] = { x1, y1, z1 };
+				normal(computeNormalTop(MID, P, P1));
+			}
+			color(0.3, 0.5, 0.1, 0.5);
+			imm.vertex3d(MID[0], MID[1], MID[2] + p.height);
+			imm.vertex3d(x, y, z + p.height);
+			imm.vertex3d(x1, y1, z1 + p.height);
+			imm.vertex3d(MID[0], MID[1], MID[2] + p.height);
+			i++;
+		}
+		imm.end();
+	}
+
+	static void roof(const Prism& p)
+	{
+		texCoord(0, 0);
+		imm.begin(GL_QUADS);
+		normal(0, 0, 1);
+		color(0.3, 0.5, 0.1, 0.5);
+		vertex(p.A1);
+		vertex(p.B1);
+		vertex(p.C1);
+		vertex(p.D1);
+
+		normal(0, 0, 1);
+		color(0.3, 0.5, 0.1, 0.5);
+		vertex(p.A1);
+		vertex(p.D1);
+		vertex(p.E1);
+		vertex(p.H1);
+
+		normal(0, 0, 1);
+		color(0.3, 0.5, 0.1, 0.5);
+		vertex(p.E1);
+		vertex(p.F1);
+		vertex(p.G1);
+		vertex(p.H1);
+
+		imm.end();
+	}
+};
+
+//вариант на каждую комбинацию режимов, выбирается раз за кадр
+static const auto drawPrism = modeTable<DrawPrism>();
+
+//копия призмы для нагрузочной сцены: координаты и нормали, цвет белый - его дает копия
+static void stressPrismGeometry()
+{
+	Prism p = makePrism(STRESS_ARC_SEGMENTS);
+	imm.color4d(1, 1, 1, 1);
+	DrawPrism<ModeLighting>::walls(p);
+	DrawPrism<ModeLighting>::arc(p);
+	DrawPrism<ModeLighting>::cap(p);
+	DrawPrism<ModeLighting>::roof(p);
+}
+
+//оси и копии призмы - объекты общей арены (GeometryPath::Indirect)
+static void buildStaticScene()
+{
+	static int axes_mesh, prism_mesh;
+	if (!staticScene.hasMeshes())
+	{
+		axes_mesh = staticScene.addMesh(&OpenGL::AxesGeometry);
+		prism_mesh = staticScene.addMesh(stressPrismGeometry);
+	}
+	staticScene.clearObjects();
+
+	MeshArena::Object axes;
+	axes.lit = false;
+	staticScene.addObject(axes_mesh, axes);
+	for (const InstancedMesh::Instance& c : stress_copies)
+	{
+		MeshArena::Object o;
+		for (int k = 0; k < 3; ++k)
+		{
+			o.position[k] = c.position[k];
+			o.color[k] = c.color[k];
+		}
+		o.scale = c.scale;
+		o.angle = c.angle;
+		staticScene.addObject(prism_mesh, o);
+	}
+	static_scene_dirty = false;
+}
+
+void Render(double delta_time)
+{    
+	glState.enable(GL_DEPTH_TEST);
 	
-	glNormal3d(0, 0, 1);
-	glColor4d(0.3, 0.5, 0.1, 0.5);
-	glVertex3dv((double*)&A1);
-	glVertex3dv((double*)&B1);
-	glVertex3dv((double*)&C1);
-	glVertex3dv((double*)&D1);
-
-	glNormal3d(0, 0, 1);
-	glColor4d(0.3, 0.5, 0.1, 0.5);
-	glVertex3dv((double*)&A1);
-	glVertex3dv((double*)&D1);
-	glVertex3dv((double*)&E1);
-	glVertex3dv((double*)&H1);
-
-	glNormal3d(0, 0, 1);
-	glColor4d(0.3, 0.5, 0.1, 0.5);
-	glVertex3dv((double*)&E1);
-	glVertex3dv((double*)&F1);
-	glVertex3dv((double*)&G1);
-	glVertex3dv((double*)&H1);
-
-	glEnd();
+	//натройка камеры и света
+	//в этих функциях находятся OGLные функции
+	//которые устанавливают параметры источника света
+	//и моделвью матрицу, связанные с камерой.
+
+	if (gl.isKeyPressed('F')) //если нажата F - свет из камеры
+	{
+		light.SetPosition(camera.x(), camera.y(), camera.z());
+	}
+	//подменяем заглушки загруженными картинками
+	textures.poll();
+	textures.setMipmapping(mipmapping);
+
+#ifdef MIP_BENCHMARK
+	mipBenchmarkStep(delta_time);
+#endif
+	camera.SetUpCamera();
+	light.SetUpLight();
+
+	//рисуем оси (в режиме общей арены - вместе с ней, после призмы)
+	if (!indirect_geometry)
+		gl.DrawAxes();
+
+	glState.disable(GL_LIGHTING);
+	glState.disable(GL_TEXTURE_2D);
+	glState.disable(GL_BLEND);
+
+	//включаем режимы, в зависимости от нажания клавиш. см void switchModes(OpenGL *sender, KeyEventArg arg)
+	if (lightning)
+		glState.enable(GL_LIGHTING);
+	if (texturing)
+	{
+		glState.enable(GL_TEXTURE_2D);
+		glState.bindTexture(0); //сбрасываем текущую текстуру
+	}
+		
+	//=============НАСТРОЙКА МАТЕРИАЛА==============
+
+	//настройка материала, все что рисуется ниже будет иметь этот метериал.
+	//Его ставит очередь (см. RenderQueue.h) перед элементами, которым он нужен
+	Material prism_material = {
+		{ 0.2f, 0.2f, 0.1f, 1.f },   //фоновая
+		{ 0.4f, 0.65f, 0.5f, 1.f },  //дифузная
+		{ 0.9f, 0.8f, 0.3f, 1.f },   //зеркальная
+		0.2f * 256                   //размер блика
+	};
+	int material = renderQueue.material(prism_material);
+
+	//чтоб было красиво, без квадратиков (сглаживание освещения)
+	glState.shadeModel(GL_SMOOTH); //закраска по Гуро      
+			   //(GL_SMOOTH - плоская закраска)
+
+	//============ РИСОВАТЬ ТУТ ==============
+	//Частая сетка полукруга нужна только освещению по вершинам (блик по Гуро).
+	//Шейдер светит каждый пиксель, а без света сетка видна только по краю
+	unsigned modes = renderModes(lightning, texturing, alpha);
+	int arc_segments = lightning && !shadedLighting.program(modes) ? 90 : 24;
+	Prism prism = makePrism(arc_segments);
+
+	//Призма рисуется через очередь: непрозрачное - сгруппировано по текстуре, крышка
+	//в режиме прозрачности - после всего непрозрачного и сзади вперед.
+	//Геометрия каждой части записывается в display list, если они включены.
+	//Вариант отрисовки под текущие режимы выбирается здесь, один раз (см. RenderModes.h)
+	renderQueue.setEye(camera.x(), camera.y(), camera.z(), 200);
+	drawPrism[modes](prism, material);
+
+	renderQueue.execute();
+	imm.setAttributes(ImmediateBatch::AllAttributes);
+
+	//нагрузочная сцена - тем же светом, цвет у каждой копии свой
+	if (indirect_geometry || stressMesh.instanceCount())
+	{
+		const GLfloat specular[] = { 0.3f, 0.3f, 0.3f, 1 };
+		glState.material(GL_FRONT_AND_BACK, GL_SPECULAR, specular);
+		glState.material(GL_FRONT_AND_BACK, GL_SHININESS, 32);
+		glState.disable(GL_BLEND);
+	}
+	if (indirect_geometry)
+	{
+		//все объекты арены (и оси) - по вызову на треугольники и линии
+		if (static_scene_dirty)
+			buildStaticScene();
+		staticScene.draw(lightning);
+	}
+	else if (stressMesh.instanceCount())
+	{
+		if (!stressMesh.triangleCount())
+			stressMesh.build(stressPrismGeometry);
+		stressMesh.draw(lightning);
+	}
+	//дальше (источник света, HUD) смешивание - как выбрано клавишей A
+	glState.setEnabled(GL_BLEND, alpha);
+	glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	
 	//===============================================
 
 	//рисуем источник света
 	light.DrawLightGizmo();
 
+	//дорисовываем накопленное рекордером до смены матриц
+	imm.flush();
+
+	//дальше только HUD и график
+	if (!overlay)
+		return;
+
 	//================Сообщение в верхнем левом углу=======================
 	//переключаемся на матрицу проекции
 	glMatrixMode(GL_PROJECTION);
@@ -500,26 +1056,56 @@ void Render(double delta_time)
 	//нижний левый угол окна - точка (0,0)
 	//верхний правый угол (ширина_окна - 1, высота_окна - 1)
 	
-	std::wstringstream ss;
-	ss << std::fixed << std::setprecision(3);
-	ss << "T - " << (texturing ? L"[вкл]выкл  " : L" вкл[выкл] ") << L"текстур" << std::endl;
-	ss << "L - " << (lightning ? L"[вкл]выкл  " : L" вкл[выкл] ") << L"освещение" << std::endl;
-	ss << "A - " << (alpha ? L"[вкл]выкл  " : L" вкл[выкл] ") << L"альфа-наложение" << std::endl;
-	ss << L"F - Свет из камеры" << std::endl;
-	ss << L"G - двигать свет по горизонтали" << std::endl;
-	ss << L"G+ЛКМ двигать свет по вертекали" << std::endl;
-	ss << L"Коорд. света: (" << std::setw(7) <<  light.x() << "," << std::setw(7) << light.y() << "," << std::setw(7) << light.z() << ")" << std::endl;
-	ss << L"Коорд. камеры: (" << std::setw(7) << camera.x() << "," << std::setw(7) << camera.y() << "," << std::setw(7) << camera.z() << ")" << std::endl;
-	ss << L"Параметры камеры: R=" << std::setw(7) << camera.distance() << ",fi1=" << std::setw(7) << camera.fi1() << ",fi2=" << std::setw(7) << camera.fi2() << std::endl;
-	ss << L"delta_time: " << std::setprecision(5)<< delta_time << std::endl;
-
-	text.setPosition(10, gl.getHeight() - 10 - 180);
-	text.setText(ss.str().c_str());
-	text.Draw();
+	//строки HUD переформатируются только когда поменялись их значения
+	hud.setFlag(Hud::Texturing, texturing);
+	hud.setFlag(Hud::Lightning, lightning);
+	hud.setFlag(Hud::Alpha, alpha);
+	hud.setFlag(Hud::Mipmapping, mipmapping);
+	hud.setVec3(Hud::LightPos, light.x(), light.y(), light.z());
+	hud.setVec3(Hud::CameraPos, camera.x(), camera.y(), camera.z());
+	hud.setVec3(Hud::CameraParams, camera.distance(), camera.fi1(), camera.fi2());
+	hud.setDeltaTime(delta_time);
+	FrameStats::Summary frames = gl.stats.stats();
+	hud.setFrameTimes(frames.min, frames.avg, frames.p99);
+
+	if (font.isLoaded())
+	{
+		font.drawText(hud.text(), 10, gl.getHeight() - 10, hud_text_size);
+	}
+	else
+	{
+		text.setPosition(10, gl.getHeight() - 10 - 200);
+		//перерисовываем текстуру с текстом, только если текст поменялся
+		if (hud.changed())
+			text.setText(hud.text());
+		text.Draw();
+	}
+
+	//график времени кадров справа от текста
+	unsigned attributes = imm.enabledAttributes();
+	gl.stats.DrawGraph(10 + 512 + 10, gl.getHeight() - 10 - 100, FrameStats::HISTORY, 100);
+
+	//HUD тоже шел через imm - дорисовываем до возврата матриц
+	imm.flush();
+	imm.setAttributes(attributes);
+	glState.disable(GL_BLEND);
 
 	//восстанавливаем матрицу проекции на перспективу, которую сохраняли ранее.
 	glMatrixMode(GL_PROJECTION);
 	glPopMatrix();
 	glMatrixMode(GL_MODELVIEW);
 	glPopMatrix();
-}   
\ No newline at end of file
+}   
+
+void shutdownRender()
+{
+	texPrism.reset();
+	textures.clear();
+	font.release();
+	text.release();
+	stressMesh.release();
+	staticScene.release();
+	displayLists.clear();
+	imm.stream().release();
+	programs.clear();
+}
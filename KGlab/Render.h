@@ -1,2 +1,41 @@
 ﻿void initRender();
-void Render(double );
\ No newline at end of file
+void Render(double );
+//удаляет текстуры, буферы и программы сцены - до platformDestroyContext:
+//глобальные объекты умирают позже, когда звать OpenGL уже нельзя
+void shutdownRender();
+//идут ли еще фоновые загрузки текстур
+bool renderLoading();
+
+//Состояние сцены для сценариев пакетного режима (см. BenchmarkScript.h)
+void setCameraPosition(double x, double y, double z);
+void setLightPosition(double x, double y, double z);
+//режим по клавише, как в switchModes: 'T', 'L', 'A', 'M'
+void setRenderMode(char key, bool on);
+//HUD и график времени кадров. В них время кадра - для сравнения картинок их выключают
+void setRenderOverlay(bool on);
+
+//Как рисуется геометрия сцены: прямо через glBegin/glVertex, пачками из буфера вершин
+//(ImmediateBatch.h) или display list'ами (DisplayListCache.h).
+//Indirect - оси и нагрузочная сцена лежат в общей арене и рисуются одним
+//glMultiDrawElementsIndirect на тип примитивов (MeshArena.h), призма - пачками:
+//у ее частей разные текстуры и прозрачность.
+//Без буферов вершин (GL 1.1) initRender сам выбирает списки
+enum class GeometryPath { Immediate, Batched, DisplayLists, Indirect };
+void setGeometryPath(GeometryPath path);
+GeometryPath geometryPath();
+
+//Чем считается освещение: фиксированным конвейером (GL_LIGHT0, по вершинам) или
+//шейдером по пикселям (ShadedLighting.h). Без шейдеров и буферов uniform остается
+//фиксированное, что бы ни выбрали
+enum class LightingPath { FixedFunction, Shaders };
+void setLightingPath(LightingPath path);
+LightingPath lightingPath();
+
+//Нагрузочная сцена: count копий призмы сеткой под основной (InstancedMesh.h), 0 - без нее.
+//Копии рисуются одним glDrawElementsInstanced, а без instancing (или если выбрано Replicated) -
+//размножением вершин на процессоре. instancingPath() - как нарисован последний кадр
+enum class InstancingPath { Hardware, Replicated };
+void setStressInstances(int count);
+int stressInstances();
+void setInstancingPath(InstancingPath path);
+InstancingPath instancingPath();
@@ -0,0 +1,16 @@
+#include "RenderModes.h"
+
+#include <string>
+
+const char* modeDefines(unsigned modes)
+{
+	static std::array<std::string, MODE_COUNT> defines;
+	std::string& d = defines[modes % MODE_COUNT];
+	if (d.empty())
+	{
+		d += "#define LIGHTING " + std::to_string((modes & ModeLighting) ? 1 : 0) + "\n";
+		d += "#define TEXTURING " + std::to_string((modes & ModeTexturing) ? 1 : 0) + "\n";
+		d += "#define ALPHA " + std::to_string((modes & ModeAlpha) ? 1 : 0) + "\n";
+	}
+	return d.c_str();
+}
@@ -0,0 +1,74 @@
+#ifndef RENDERMODES_H
+#define RENDERMODES_H
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+#include "ImmediateBatch.h"
+
+//Режимы отрисовки (клавиши L, T, A) как параметр шаблона.
+//Код, зависящий от режима, пишется один раз шаблоном от M и проверяет режим через
+//if constexpr - компилятор собирает отдельный вариант на каждую комбинацию, и в нем
+//проверок уже нет. Вариант выбирается раз за кадр по таблице:
+//    template<unsigned M>
+//    struct DrawThing
+//    {
+//        static void run(const Thing& t)
+//        {
+//            if constexpr (RenderModes<M>::lighting)
+//                imm.normal3dv(t.normal);
+//            ...
+//        }
+//    };
+//    static const auto drawThing = modeTable<DrawThing>();
+//    drawThing[renderModes(lightning, texturing, alpha)](thing);
+//Для шейдеров та же комбинация дает строку #define (modeDefines).
+
+enum RenderMode : unsigned
+{
+	ModeLighting = 1,
+	ModeTexturing = 2,
+	ModeAlpha = 4,
+
+	MODE_COUNT = 8
+};
+
+template<unsigned M>
+struct RenderModes
+{
+	static constexpr bool lighting = (M & ModeLighting) != 0;
+	static constexpr bool texturing = (M & ModeTexturing) != 0;
+	static constexpr bool alpha = (M & ModeAlpha) != 0;
+
+	//формат вершины: нормали нужны только освещению, текстурные координаты - текстурам,
+	//а цвет вершины при освещении без GL_COLOR_MATERIAL не используется (цвет дает материал)
+	static constexpr unsigned attributes =
+		(lighting ? ImmediateBatch::Normals : 0) |
+		(lighting ? 0 : ImmediateBatch::Colors) |
+		(texturing ? ImmediateBatch::TexCoords : 0);
+};
+
+//номер комбинации для таблицы вариантов
+inline unsigned renderModes(bool lighting, bool texturing, bool alpha)
+{
+	return (lighting ? ModeLighting : 0) | (texturing ? ModeTexturing : 0) | (alpha ? ModeAlpha : 0);
+}
+
+//таблица Variant<M>::run по всем комбинациям M
+template<template<unsigned> class Variant, size_t... M>
+constexpr auto modeTable(std::index_sequence<M...>)
+{
+	return std::array<decltype(&Variant<0>::run), MODE_COUNT>{ &Variant<M>::run... };
+}
+template<template<unsigned> class Variant>
+constexpr auto modeTable()
+{
+	return modeTable<Variant>(std::make_index_sequence<MODE_COUNT>());
+}
+
+//#define LIGHTING/TEXTURING/ALPHA 0 или 1 для комбинации - вставляется в шейдер
+//после строки #version, по варианту программы на комбинацию
+const char* modeDefines(unsigned modes);
+
+#endif
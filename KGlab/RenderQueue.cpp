@@ -0,0 +1,214 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "GLState.h"
+#include "ShadedLighting.h"
+
+RenderQueue renderQueue;
+
+namespace
+{
+	const int DEPTH_BITS = 16;
+	const uint64_t DEPTH_MAX = (1u << DEPTH_BITS) - 1;
+	const int STATE_BITS = 12;
+	const uint32_t STATE_MAX = (1u << STATE_BITS) - 1;
+	const uint64_t FIELD_16 = (1u << 16) - 1;
+
+	//разряд - не больше 11 бит (гистограмма 8 КБ - помещается в кэш),
+	//над номером до 46 бит - не больше пяти разрядов
+	const int MAX_DIGIT_BITS = 11;
+	const int MAX_DIGITS = (64 - RenderQueue::INDEX_BITS + MAX_DIGIT_BITS - 1) / MAX_DIGIT_BITS;
+	const int RADIX = 1 << MAX_DIGIT_BITS;
+}
+
+
+void RenderQueue::setEye(double x, double y, double z, double far_plane_)
+{
+	eye[0] = x;
+	eye[1] = y;
+	eye[2] = z;
+	far_plane = far_plane_;
+}
+
+int RenderQueue::material(const Material& m)
+{
+	for (size_t i = 0; i < materials.size(); ++i)
+		if (memcmp(&materials[i], &m, sizeof(Material)) == 0)
+			return (int)i;
+	materials.push_back(m);
+	return (int)materials.size() - 1;
+}
+
+void RenderQueue::submit(Item item)
+{
+	if (items.size() == MAX_ITEMS)
+		execute();
+	if (item.shader)
+		shaded = true;
+	entries[item.pass].push_back({ makeKey(item, items.size()) });
+	items.push_back(std::move(item));
+}
+
+uint64_t RenderQueue::makeKey(const Item& item, size_t index)
+{
+	double dx = item.center[0] - eye[0];
+	double dy = item.center[1] - eye[1];
+	double dz = item.center[2] - eye[2];
+	double d = std::min(1.0, sqrt(dx * dx + dy * dy + dz * dz) / far_plane);
+	uint64_t depth = (uint64_t)(d * DEPTH_MAX);
+
+	uint64_t texture = 0;
+	if (item.texture)
+	{
+		auto it = std::find(textures.begin(), textures.end(), item.texture);
+		texture = it - textures.begin() + 1;
+		if (it == textures.end())
+			textures.push_back(item.texture);
+	}
+	//программы тоже по номеру в кадре
+	uint64_t shader = 0;
+	if (item.shader)
+	{
+		auto it = std::find(shaders.begin(), shaders.end(), item.shader);
+		shader = it - shaders.begin() + 1;
+		if (it == shaders.end())
+			shaders.push_back(item.shader);
+	}
+	//номер 0 - "не трогать" (у программы - фиксированный конвейер), остальные со сдвигом на 1
+	uint64_t code = ((uint64_t)item.blend << 48) | (std::min(shader, FIELD_16) << 32) |
+		(std::min(texture, FIELD_16) << 16) | std::min((uint64_t)(item.material + 1), FIELD_16);
+	//номер состояния в кадре; лишние сливаются с последним - меньше группировки,
+	//но состояние все равно ставится у каждого элемента
+	uint64_t state = std::min(states.emplace(code, (uint32_t)states.size()).first->second, STATE_MAX);
+
+	if (item.pass == Opaque)
+		return (((state << DEPTH_BITS) | depth) << INDEX_BITS) | index;
+	//прозрачные - дальние первыми
+	return ((((DEPTH_MAX - depth) << STATE_BITS) | state) << INDEX_BITS) | index;
+}
+
+void RenderQueue::sort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch)
+{
+	size_t n = entries.size();
+	if (n < 2)
+		return;
+
+	//какие биты над номером вообще меняются: разряды - только по ним
+	uint64_t first = entries[0].key;
+	uint64_t varying = 0;
+	for (const SortEntry& e : entries)
+		varying |= e.key ^ first;
+	varying >>= INDEX_BITS;
+	if (!varying)
+		return;
+	int low = INDEX_BITS;
+	for (; !(varying & 1); varying >>= 1)
+		++low;
+	int width = 1;
+	while (varying >> width)
+		++width;
+	int digits = (width + MAX_DIGIT_BITS - 1) / MAX_DIGIT_BITS;
+	int digit_bits = (width + digits - 1) / digits;
+	uint32_t mask = (1u << digit_bits) - 1;
+
+	scratch.resize(n);
+
+	//гистограммы всех разрядов за один проход
+	static uint32_t counts[MAX_DIGITS][RADIX];
+	memset(counts, 0, sizeof(counts));
+	for (const SortEntry& e : entries)
+	{
+		uint64_t k = e.key >> low;
+		for (int d = 0; d < digits; ++d)
+			++counts[d][(k >> d * digit_bits) & mask];
+	}
+
+	SortEntry* src = entries.data();
+	SortEntry* dst = scratch.data();
+	for (int d = 0; d < digits; ++d)
+	{
+		int shift = low + d * digit_bits;
+		//у всех один и тот же разряд - проход не нужен
+		if (counts[d][(src[0].key >> shift) & mask] == n)
+			continue;
+
+		uint32_t* offsets = counts[d];
+		uint32_t sum = 0;
+		for (uint32_t i = 0; i <= mask; ++i)
+		{
+			uint32_t c = offsets[i];
+			offsets[i] = sum;
+			sum += c;
+		}
+		for (size_t i = 0; i < n; ++i)
+			dst[offsets[(src[i].key >> shift) & mask]++] = src[i];
+		std::swap(src, dst);
+	}
+	if (src != entries.data())
+		entries.swap(scratch);
+}
+
+void RenderQueue::execute()
+{
+	auto start = std::chrono::steady_clock::now();
+	sort(entries[Opaque], scratch);
+	sort(entries[Transparent], scratch);
+	last_sort_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	last_count = items.size();
+
+	//камера, свет и материалы для программ - один раз на весь проход
+	if (shaded)
+		shadedLighting.upload(materials);
+
+	//непрозрачные, потом прозрачные
+	for (const std::vector<SortEntry>& pass : entries)
+		for (const SortEntry& e : pass)
+		{
+			const Item& item = items[e.index()];
+
+			if (shaded)
+				glState.useProgram(item.shader);
+
+			switch (item.blend)
+			{
+			case BlendNone:
+				glState.disable(GL_BLEND);
+				break;
+			case BlendAlpha:
+				glState.enable(GL_BLEND);
+				glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				break;
+			case BlendAdditive:
+				glState.enable(GL_BLEND);
+				glState.blendFunc(GL_SRC_ALPHA, GL_ONE);
+				break;
+			}
+			if (item.texture)
+				item.texture->bind();
+			if (item.material >= 0 && item.shader)
+				shadedLighting.bindMaterial(item.material);
+			else if (item.material >= 0)
+			{
+				const Material& m = materials[item.material];
+				glState.material(GL_FRONT, GL_AMBIENT, m.ambient);
+				glState.material(GL_FRONT, GL_DIFFUSE, m.diffuse);
+				glState.material(GL_FRONT, GL_SPECULAR, m.specular);
+				glState.material(GL_FRONT, GL_SHININESS, m.shininess);
+			}
+			item.draw();
+		}
+	if (shaded)
+		glState.useProgram(0);
+
+	items.clear();
+	entries[Opaque].clear();
+	entries[Transparent].clear();
+	textures.clear();
+	shaders.clear();
+	states.clear();
+	shaded = false;
+}
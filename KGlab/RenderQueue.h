@@ -0,0 +1,127 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "GLCallCount.h"
+#include "TextureManager.h"
+
+//Очередь отрисовки.
+//Сцена не рисует сразу, а кладет в очередь элементы: что нарисовать (блок, обычно через imm)
+//и в каком состоянии. execute() сортирует их по 64-битному ключу и рисует подряд:
+//сначала непрозрачные - сгруппированными по состоянию (меньше переключений) и спереди назад
+//внутри одного состояния (ранний тест глубины отбрасывает закрытое), потом прозрачные -
+//строго сзади вперед, иначе смешивание зависит от порядка в коде.
+//
+//Непрозрачные и прозрачные - в разных списках, ключ, старшие биты первыми:
+//  непрозрачные: состояние 12 | глубина 16 | номер 18
+//  прозрачные:   глубина (обратная) 16 | состояние 12 | номер 18
+//Состояние (смешивание, программа, текстура, материал) - номер в кадре по первому появлению,
+//в младших битах - номер элемента: запись сортировки - одно 64-битное слово.
+//Сортировка поразрядная (LSD) только по битам, которые в кадре меняются, - при немногих
+//состояниях это два прохода; линейная по числу элементов.
+//Только поток рендера.
+
+struct Material
+{
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+	float shininess;
+};
+
+class RenderQueue
+{
+public:
+
+	enum Pass { Opaque, Transparent };
+	enum Blend { BlendNone, BlendAlpha, BlendAdditive };
+
+	struct Item
+	{
+		Pass pass = Opaque;
+		Blend blend = BlendNone;
+		//программа GLSL, 0 - фиксированный конвейер. С программой материал берется
+		//из буфера ShadedLighting, а не через glMaterial
+		GLuint shader = 0;
+		//nullptr - текстура остается, какая была
+		const TextureHandle* texture = nullptr;
+		//номер из material(), -1 - материал не трогаем
+		int material = -1;
+		//точка, по расстоянию до которой сортируется глубина
+		double center[3] = { 0, 0, 0 };
+		std::function<void()> draw;
+	};
+
+	//бит под номер элемента в ключе; больше элементов за раз очередь не держит
+	static const int INDEX_BITS = 18;
+	static const size_t MAX_ITEMS = (size_t)1 << INDEX_BITS;
+
+	//запись сортировки - ключ с номером элемента в младших битах
+	struct SortEntry
+	{
+		uint64_t key;
+
+		uint32_t index() const
+		{
+			return (uint32_t)(key & (MAX_ITEMS - 1));
+		}
+	};
+
+	//откуда смотрим и дальняя плоскость - для глубины в ключе
+	void setEye(double x, double y, double z, double far_plane);
+
+	//номер материала для Item::material (одинаковые материалы получают один номер)
+	int material(const Material& m);
+
+	//если очередь полна (MAX_ITEMS), сначала рисует набранное
+	void submit(Item item);
+
+	//сортирует и рисует все, очередь после этого пуста, программа - 0
+	void execute();
+
+	//поразрядная сортировка по key над INDEX_BITS (номер в младших битах не учитывается -
+	//порядок при равных ключах сохраняется), scratch - рабочий буфер
+	static void sort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch);
+
+	//элементов и время сортировки в последнем execute()
+	size_t lastCount() const
+	{
+		return last_count;
+	}
+	double lastSortMs() const
+	{
+		return last_sort_ms;
+	}
+
+private:
+
+	uint64_t makeKey(const Item& item, size_t index);
+
+	double eye[3] = { 0, 0, 0 };
+	double far_plane = 1;
+
+	std::vector<Item> items;
+	//по проходам: Opaque, Transparent
+	std::vector<SortEntry> entries[2];
+	std::vector<SortEntry> scratch;
+	std::vector<Material> materials;
+	//текстуры этого кадра - номер в состоянии
+	std::vector<const TextureHandle*> textures;
+	//программы этого кадра - номер в состоянии
+	std::vector<GLuint> shaders;
+	//состояния этого кадра - номер в ключе
+	std::unordered_map<uint64_t, uint32_t> states;
+	//есть элементы с программой
+	bool shaded = false;
+
+	size_t last_count = 0;
+	double last_sort_ms = 0;
+};
+
+extern RenderQueue renderQueue;
+
+#endif
@@ -0,0 +1,462 @@
+#include "SdfFont.h"
+
+#include "GLCallCount.h"
+#include "GLState.h"
+#include "ImmediateBatch.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+
+namespace
+{
+	const unsigned int CACHE_MAGIC = 0x46445353; //"SSDF"
+	const unsigned int CACHE_VERSION = 2;
+	//магия, версия, размеры ячейки и атласа, параметры поля, длина имени шрифта, число символов;
+	//дальше имя шрифта (по 4 байта на символ) и символы
+	const int CACHE_HEADER = 11;
+
+	const float INF = 1e20f;
+
+	//одномерное точное преобразование расстояний (Felzenszwalb, Huttenlocher)
+	//f - исходные значения (0 - точка контура, INF - нет), d - квадраты расстояний
+	void edt1d(const float* f, float* d, int* v, float* z, int n)
+	{
+		int k = 0;
+		v[0] = 0;
+		z[0] = -INF;
+		z[1] = INF;
+		for (int q = 1; q < n; ++q)
+		{
+			float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * q - 2.0f * v[k]);
+			while (s <= z[k])
+			{
+				--k;
+				s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * q - 2.0f * v[k]);
+			}
+			++k;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = INF;
+		}
+
+		k = 0;
+		for (int q = 0; q < n; ++q)
+		{
+			while (z[k + 1] < q)
+				++k;
+			d[q] = (float)(q - v[k]) * (q - v[k]) + f[v[k]];
+		}
+	}
+
+	//растеризатор одного потока: свой холст, свои буферы.
+	//Объекты GDI и соединения с X-сервером нельзя делить между потоками, поэтому у каждого потока все свое
+	struct GlyphRaster
+	{
+		static const int RES = SdfFont::CELL * SdfFont::OVERSAMPLE;
+
+		TextRaster raster;
+
+		std::vector<float> outside, inside;
+		std::vector<float> f, d, z;
+		std::vector<int> v;
+
+		bool init(const wchar_t* face)
+		{
+			//без сглаживания - нам нужна четкая маска внутри/снаружи
+			if (!raster.init(RES, RES, face, SdfFont::GLYPH_HEIGHT * SdfFont::OVERSAMPLE, false))
+				return false;
+
+			outside.resize(RES * RES);
+			inside.resize(RES * RES);
+			f.resize(RES);
+			d.resize(RES);
+			z.resize(RES + 1);
+			v.resize(RES);
+			return true;
+		}
+
+		//двумерное преобразование: сначала по столбцам, потом по строкам
+		void edt2d(float* grid)
+		{
+			for (int x = 0; x < RES; ++x)
+			{
+				for (int y = 0; y < RES; ++y)
+					f[y] = grid[y * RES + x];
+				edt1d(f.data(), d.data(), v.data(), z.data(), RES);
+				for (int y = 0; y < RES; ++y)
+					grid[y * RES + x] = d[y];
+			}
+			for (int y = 0; y < RES; ++y)
+			{
+				std::copy(grid + y * RES, grid + (y + 1) * RES, f.begin());
+				edt1d(f.data(), d.data(), v.data(), z.data(), RES);
+				std::copy(d.begin(), d.end(), grid + y * RES);
+			}
+		}
+
+		//рисует символ c и пишет его поле расстояний в ячейку атласа
+		void rasterize(wchar_t c, SdfFont::Glyph& glyph, unsigned char* atlas)
+		{
+			const wchar_t text[2] = { c, 0 };
+			raster.clear();
+			raster.draw(text, SdfFont::PAD * SdfFont::OVERSAMPLE, SdfFont::PAD * SdfFont::OVERSAMPLE);
+			glyph.advance = (float)raster.textWidth(text, 1) / SdfFont::OVERSAMPLE;
+
+			const unsigned char* mask = raster.mask();
+			for (int i = 0; i < RES * RES; ++i)
+			{
+				bool in = mask[i] > 127;
+				outside[i] = in ? 0 : INF;
+				inside[i] = in ? INF : 0;
+			}
+			edt2d(outside.data());
+			edt2d(inside.data());
+
+			//усредняем знаковое расстояние по блоку OVERSAMPLE x OVERSAMPLE
+			const int os = SdfFont::OVERSAMPLE;
+			const float norm = 1.0f / (os * os) / os;
+			for (int cy = 0; cy < SdfFont::CELL; ++cy)
+				for (int cx = 0; cx < SdfFont::CELL; ++cx)
+				{
+					float sum = 0;
+					for (int j = 0; j < os; ++j)
+						for (int i = 0; i < os; ++i)
+						{
+							int p = (cy * os + j) * RES + cx * os + i;
+							sum += std::sqrt(outside[p]) - std::sqrt(inside[p]);
+						}
+					//расстояние в пикселях ячейки, >0 - снаружи буквы
+					float dist = sum * norm;
+					float value = 0.5f - dist / (2.0f * SdfFont::SPREAD);
+					value = std::clamp(value, 0.0f, 1.0f);
+
+					int ax = glyph.cell_x * SdfFont::CELL + cx;
+					int ay = glyph.cell_y * SdfFont::CELL + cy;
+					atlas[ay * SdfFont::ATLAS_W + ax] = (unsigned char)(value * 255.0f + 0.5f);
+				}
+		}
+	};
+}
+
+
+SdfFont::SdfFont()
+{
+}
+
+SdfFont::~SdfFont()
+{
+	release();
+}
+
+void SdfFont::release()
+{
+	if (tex_id)
+		glState.deleteTextures(1, &tex_id);
+	tex_id = 0;
+}
+
+std::vector<wchar_t> SdfFont::charset()
+{
+	std::vector<wchar_t> chars;
+	for (wchar_t c = 0x20; c <= 0x7E; ++c)
+		chars.push_back(c);
+	chars.push_back(0x0401); //Ё
+	for (wchar_t c = 0x0410; c <= 0x044F; ++c)
+		chars.push_back(c);
+	chars.push_back(0x0451); //ё
+	return chars;
+}
+
+bool SdfFont::build(const wchar_t* face, unsigned threads)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<wchar_t> chars = charset();
+	const int count = (int)chars.size();
+	const int cols = ATLAS_W / CELL;
+	if (count > cols * (ATLAS_H / CELL))
+		return false;
+
+	glyphs.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		glyphs[i].code = chars[i];
+		glyphs[i].advance = 0;
+		glyphs[i].cell_x = (short)(i % cols);
+		glyphs[i].cell_y = (short)(i / cols);
+	}
+	atlas.assign(ATLAS_W * ATLAS_H, 0);
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min<unsigned>(threads, count);
+
+	//потоки разбирают символы по одному, пока не кончатся
+	std::atomic_int next = 0;
+	std::atomic_bool failed = false;
+	auto worker = [&]()
+	{
+		GlyphRaster raster;
+		if (!raster.init(face))
+		{
+			failed = true;
+			return;
+		}
+		for (int i = next++; i < count; i = next++)
+			raster.rasterize(glyphs[i].code, glyphs[i], atlas.data());
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; ++t)
+		pool.emplace_back(worker);
+	worker();
+	for (auto& t : pool)
+		t.join();
+
+	if (failed)
+	{
+		glyphs.clear();
+		atlas.clear();
+		return false;
+	}
+
+	buildLookup();
+
+	build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	build_threads = threads;
+	from_cache = false;
+	return true;
+}
+
+bool SdfFont::load(const wchar_t* face, const char* cache_path, unsigned threads)
+{
+	if (cache_path && readCache(cache_path, face))
+	{
+		from_cache = true;
+	}
+	else
+	{
+		if (!build(face, threads))
+			return false;
+		if (cache_path)
+			writeCache(cache_path, face);
+	}
+
+	upload();
+	return true;
+}
+
+void SdfFont::buildLookup()
+{
+	lookup.assign(0x10000, -1);
+	for (size_t i = 0; i < glyphs.size(); ++i)
+		if ((unsigned)glyphs[i].code < lookup.size())
+			lookup[glyphs[i].code] = (short)i;
+}
+
+const SdfFont::Glyph* SdfFont::find(wchar_t c) const
+{
+	//wchar_t в Linux 32-битный - символы за пределами BMP не должны попадать в чужую ячейку
+	short i = (unsigned)c < lookup.size() ? lookup[c] : -1;
+	if (i < 0)
+		i = lookup[L'?'];
+	return &glyphs[i];
+}
+
+void SdfFont::upload()
+{
+	if (tex_id)
+		glState.deleteTextures(1, &tex_id);
+	glGenTextures(1, &tex_id);
+	glState.bindTexture(tex_id);
+
+	//по байту на пиксель - строки не выровнены на 4
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, ATLAS_W, ATLAS_H, 0, GL_ALPHA, GL_UNSIGNED_BYTE, atlas.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	//линейная фильтрация обязательна - именно она дает гладкий край после альфа-теста
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+	//в оперативке атлас больше не нужен
+	atlas.clear();
+	atlas.shrink_to_fit();
+}
+
+void SdfFont::drawText(const wchar_t* text, double x, double y, double size, double r, double g, double b)
+{
+	if (!tex_id)
+		return;
+
+	const double scale = size / GLYPH_HEIGHT;
+	const double cell = CELL * scale;
+	const double pad = PAD * scale;
+	const double du = (double)CELL / ATLAS_W;
+	const double dv = (double)CELL / ATLAS_H;
+
+	glState.texEnvMode(GL_MODULATE);
+
+	glState.disable(GL_LIGHTING);
+	bool _b = glState.isEnabled(GL_TEXTURE_2D);
+
+	glState.enable(GL_TEXTURE_2D);
+	glState.bindTexture(tex_id);
+
+	//отсекаем все, что снаружи контура (поле < 0.5)
+	glState.enable(GL_ALPHA_TEST);
+	glAlphaFunc(GL_GREATER, 0.5f);
+
+	//строки каждый кадр новые - четырехугольники идут через imm в потоковый буфер
+	unsigned attributes = imm.enabledAttributes();
+	imm.setAttributes(ImmediateBatch::Colors | ImmediateBatch::TexCoords);
+
+	imm.color3d(r, g, b);
+	imm.begin(GL_QUADS);
+
+	double pen_x = x;
+	double pen_y = y;
+	for (const wchar_t* c = text; *c; ++c)
+	{
+		if (*c == L'\n')
+		{
+			pen_x = x;
+			pen_y -= size;
+			continue;
+		}
+
+		const Glyph* glyph = find(*c);
+		if (*c != L' ')
+		{
+			double left = pen_x - pad;
+			double top = pen_y + pad;
+			double u0 = glyph->cell_x * du;
+			double v0 = glyph->cell_y * dv;
+
+			imm.texCoord2d(u0, v0 + dv);
+			imm.vertex2d(left, top - cell);
+
+			imm.texCoord2d(u0, v0);
+			imm.vertex2d(left, top);
+
+			imm.texCoord2d(u0 + du, v0);
+			imm.vertex2d(left + cell, top);
+
+			imm.texCoord2d(u0 + du, v0 + dv);
+			imm.vertex2d(left + cell, top - cell);
+		}
+		pen_x += glyph->advance * scale;
+	}
+
+	imm.end();
+
+	//glAlphaFunc мимо glState - пачку с альфа-тестом дорисовываем сразу
+	imm.setAttributes(attributes);
+	imm.flush();
+	glState.disable(GL_ALPHA_TEST);
+
+	if (!_b)
+		glState.disable(GL_TEXTURE_2D);
+}
+
+bool SdfFont::readCache(const char* path, const wchar_t* face)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return false;
+
+	unsigned int header[CACHE_HEADER];
+	in.read((char*)header, sizeof(header));
+	if (!in || header[0] != CACHE_MAGIC || header[1] != CACHE_VERSION ||
+		header[2] != CELL || header[3] != ATLAS_W || header[4] != ATLAS_H ||
+		header[5] != GLYPH_HEIGHT || header[6] != PAD || header[7] != SPREAD || header[8] != OVERSAMPLE)
+		return false;
+
+	//шрифт другой - атлас строим заново
+	std::wstring name(face);
+	if (header[9] != name.size())
+		return false;
+	for (wchar_t c : name)
+	{
+		unsigned int code = 0;
+		in.read((char*)&code, sizeof(code));
+		if (!in || code != (unsigned int)c)
+			return false;
+	}
+
+	//набор символов тоже должен совпадать
+	std::vector<wchar_t> chars = charset();
+	if (header[10] != chars.size())
+		return false;
+
+	std::vector<Glyph> g(header[10]);
+	for (auto& x : g)
+	{
+		unsigned int code;
+		in.read((char*)&code, sizeof(code));
+		in.read((char*)&x.advance, sizeof(x.advance));
+		in.read((char*)&x.cell_x, sizeof(x.cell_x));
+		in.read((char*)&x.cell_y, sizeof(x.cell_y));
+		x.code = (wchar_t)code;
+	}
+	for (size_t i = 0; i < g.size(); ++i)
+		if (g[i].code != chars[i])
+			return false;
+
+	std::vector<unsigned char> a(ATLAS_W * ATLAS_H);
+	in.read((char*)a.data(), a.size());
+	if (!in)
+		return false;
+
+	glyphs = std::move(g);
+	atlas = std::move(a);
+	buildLookup();
+	build_ms = 0;
+	build_threads = 0;
+	return true;
+}
+
+bool SdfFont::writeCache(const char* path, const wchar_t* face) const
+{
+	//во временный файл: недописанный кеш прочитался бы как настоящий
+	std::string temporary = temporaryPath(path);
+	std::ofstream out(temporary, std::ios::binary);
+	if (!out)
+		return false;
+
+	std::wstring name(face);
+	unsigned int header[CACHE_HEADER] = { CACHE_MAGIC, CACHE_VERSION, CELL, ATLAS_W, ATLAS_H,
+		GLYPH_HEIGHT, PAD, SPREAD, OVERSAMPLE, (unsigned int)name.size(), (unsigned int)glyphs.size() };
+	out.write((const char*)header, sizeof(header));
+	for (wchar_t c : name)
+	{
+		unsigned int code = c;
+		out.write((const char*)&code, sizeof(code));
+	}
+	for (auto& x : glyphs)
+	{
+		unsigned int code = x.code;
+		out.write((const char*)&code, sizeof(code));
+		out.write((const char*)&x.advance, sizeof(x.advance));
+		out.write((const char*)&x.cell_x, sizeof(x.cell_x));
+		out.write((const char*)&x.cell_y, sizeof(x.cell_y));
+	}
+	out.write((const char*)atlas.data(), atlas.size());
+	out.close();
+	if (!out)
+	{
+		std::remove(temporary.c_str());
+		return false;
+	}
+	return replaceFile(temporary, path);
+}
@@ -0,0 +1,103 @@
+#ifndef SDFFONT_H
+#define SDFFONT_H
+
+#include <vector>
+
+//Шрифт на основе поля расстояний (signed distance field).
+//Каждый символ один раз растеризуется шрифтом ОС (TextRaster) в большом разрешении,
+//по нему считается поле расстояний до контура, которое и хранится в атласе.
+//При отрисовке текстура фильтруется линейно, а край буквы вырезается
+//альфа-тестом по уровню 0.5 - поэтому текст любого размера
+//остается четким и стоит только пару треугольников на символ,
+//без перерисовки текстуры, как в GuiTextRectangle.
+class SdfFont
+{
+public:
+
+	//размер ячейки одного символа в атласе, пикселей
+	static const int CELL = 48;
+	//высота шрифта внутри ячейки, пикселей
+	static const int GLYPH_HEIGHT = 32;
+	//отступ от края ячейки, пикселей
+	static const int PAD = 8;
+	//на каком расстоянии от контура поле насыщается, пикселей ячейки
+	static const int SPREAD = 6;
+	//во сколько раз растеризация точнее ячейки
+	static const int OVERSAMPLE = 4;
+
+	static const int ATLAS_W = 1024;
+	static const int ATLAS_H = 512;
+
+	struct Glyph
+	{
+		wchar_t code;
+		//сдвиг пера после символа, в пикселях ячейки
+		float advance;
+		//координаты ячейки в атласе
+		short cell_x, cell_y;
+	};
+
+	SdfFont();
+	~SdfFont();
+
+	//загружает атлас из cache_path, а если его нет (или он от другой версии, шрифта, размера) -
+	//строит заново в threads потоков (0 - по числу ядер) и сохраняет туда же.
+	//cache_path может быть nullptr - тогда кеш не используется.
+	//Нужен активный контекст OpenGL.
+	bool load(const wchar_t* face, const char* cache_path, unsigned threads = 0);
+
+	//строит атлас без обращения к OpenGL, можно звать из любого потока
+	bool build(const wchar_t* face, unsigned threads = 0);
+
+	bool isLoaded() const
+	{
+		return tex_id != 0;
+	}
+	//удаляет текстуру атласа, пока контекст OpenGL еще жив
+	void release();
+
+	//рисует текст, (x, y) - левый верхний угол первой строки
+	//в текущей системе координат (ось y вверх, как в glOrtho HUD-а).
+	//size - высота шрифта в пикселях экрана.
+	void drawText(const wchar_t* text, double x, double y, double size,
+		double r = 0, double g = 0, double b = 0);
+
+	//время последнего построения атласа и число потоков, которыми строили
+	double buildTimeMs() const
+	{
+		return build_ms;
+	}
+	unsigned buildThreads() const
+	{
+		return build_threads;
+	}
+	bool fromCache() const
+	{
+		return from_cache;
+	}
+
+	//все символы, которые есть в атласе: латиница, кириллица, Ё/ё
+	static std::vector<wchar_t> charset();
+
+private:
+
+	std::vector<Glyph> glyphs;
+	//быстрый поиск ячейки по коду символа: индексы в glyphs, -1 - нет символа
+	std::vector<short> lookup;
+	std::vector<unsigned char> atlas;
+
+	unsigned int tex_id = 0;
+
+	double build_ms = 0;
+	unsigned build_threads = 0;
+	bool from_cache = false;
+
+	const Glyph* find(wchar_t c) const;
+	void buildLookup();
+	void upload();
+
+	bool readCache(const char* path, const wchar_t* face);
+	bool writeCache(const char* path, const wchar_t* face) const;
+};
+
+#endif
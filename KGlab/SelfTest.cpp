@@ -0,0 +1,397 @@
+#include "SelfTest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#include "MappedFile.h"
+#include "PngDecode.h"
+#include "RenderQueue.h"
+#include "TextureAtlas.h"
+#include "stb_image.h"
+
+namespace
+{
+	//детерминированный генератор - от запуска к запуску одни и те же данные
+	struct Lcg
+	{
+		unsigned state = 12345;
+		int next(int lo, int hi)
+		{
+			state = state * 1664525u + 1013904223u;
+			return lo + (int)((state >> 8) % (unsigned)(hi - lo + 1));
+		}
+	};
+
+	//Атлас из одноцветных картинок случайного размера: на каждом загружаемом уровне все
+	//тексели, которые билинейная выборка берет где-нибудь внутри картинки (до самого края),
+	//должны быть ее цвета. Иначе на этом уровне подмешивается сосед или пустое место
+	bool atlasMips(std::string& error)
+	{
+		const int paddings[] = { 1, 2, 3, 5, 8 };
+		for (int pad : paddings)
+		{
+			Lcg rnd;
+			TextureAtlas atlas;
+			std::vector<unsigned char> colors;
+			for (int i = 0; i < 200; ++i)
+			{
+				Image image;
+				image.width = rnd.next(1, 40);
+				image.height = rnd.next(1, 40);
+				unsigned char c[4] = { (unsigned char)rnd.next(0, 255), (unsigned char)rnd.next(0, 255),
+					(unsigned char)rnd.next(0, 255), 255 };
+				image.pixels.assign((size_t)image.width * image.height * 4, 0);
+				for (size_t p = 0; p < image.pixels.size(); ++p)
+					image.pixels[p] = c[p % 4];
+				colors.insert(colors.end(), c, c + 4);
+				atlas.add(std::move(image));
+			}
+
+			AtlasOptions options;
+			options.padding = pad;
+			options.page_size = 256;
+			if (!atlas.pack(options))
+			{
+				error = "pack failed";
+				return false;
+			}
+
+			for (int page = 0; page < atlas.pageCount(); ++page)
+			{
+				std::vector<Image> levels = atlas.pageLevels(page);
+				for (int i = 0; i < atlas.imageCount(); ++i)
+				{
+					const AtlasRegion& r = atlas.region(i);
+					if (r.page != page)
+						continue;
+					for (size_t l = 0; l < levels.size(); ++l)
+					{
+						const Image& level = levels[l];
+						const double s = double(1 << l);
+						//тексели, центр которых ближе s к какой-нибудь точке [x, x + width]
+						const int x0 = (int)std::floor(r.x / s - 1.5) + 1;
+						const int x1 = (int)std::ceil((r.x + r.width) / s + 0.5) - 1;
+						const int y0 = (int)std::floor(r.y / s - 1.5) + 1;
+						const int y1 = (int)std::ceil((r.y + r.height) / s + 0.5) - 1;
+						for (int y = y0; y <= y1; ++y)
+							for (int x = x0; x <= x1; ++x)
+							{
+								bool inside = x >= 0 && y >= 0 && x < level.width && y < level.height;
+								const unsigned char* t = inside ? level.pixels.data() + ((size_t)y * level.width + x) * 4 : nullptr;
+								for (int c = 0; inside && c < 4; ++c)
+									inside = std::abs(t[c] - colors[i * 4 + c]) <= 1;
+								if (!inside)
+								{
+									char buf[160];
+									snprintf(buf, sizeof(buf), "padding %d: image %d (%dx%d at %d,%d) bleeds at level %d, texel %d,%d",
+										pad, i, r.width, r.height, r.x, r.y, (int)l, x, y);
+									error = buf;
+									return false;
+								}
+							}
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	//Картинки из случайных пикселей: uv центра каждого текселя после remapUVs (float и double)
+	//должны попасть на тот же пиксель страницы - иначе сетка после переписывания координат
+	//показывает не ту картинку или сдвинута на тексель
+	bool atlasUVs(std::string& message)
+	{
+		Lcg rnd;
+		TextureAtlas atlas;
+		std::vector<Image> sources;
+		for (int i = 0; i < 100; ++i)
+		{
+			Image image;
+			image.width = rnd.next(1, 50);
+			image.height = rnd.next(1, 50);
+			image.pixels.assign((size_t)image.width * image.height * 4, 0);
+			for (size_t p = 0; p < image.pixels.size(); ++p)
+				image.pixels[p] = (unsigned char)rnd.next(0, 255);
+			sources.push_back(image);
+			atlas.add(std::move(image));
+		}
+		AtlasOptions options;
+		options.page_size = 256;
+		if (!atlas.pack(options))
+		{
+			message = "pack failed";
+			return false;
+		}
+
+		size_t texels = 0;
+		for (int i = 0; i < atlas.imageCount(); ++i)
+		{
+			const Image& source = sources[i];
+			const Image& page = atlas.page(atlas.region(i).page);
+			std::vector<float> uv;
+			std::vector<double> uvd;
+			for (int y = 0; y < source.height; ++y)
+				for (int x = 0; x < source.width; ++x)
+				{
+					float u = (x + 0.5f) / source.width, v = (y + 0.5f) / source.height;
+					uv.insert(uv.end(), { u, v });
+					uvd.insert(uvd.end(), { u, v });
+				}
+			atlas.remapUVs(i, uv.data(), uv.size() / 2);
+			atlas.remapUVs(i, uvd.data(), uvd.size() / 2);
+
+			//пиксель страницы под uv должен быть текселем t картинки
+			auto lands = [&](size_t t, double u, double v)
+			{
+				int px = (int)std::floor(u * page.width);
+				int py = (int)std::floor(v * page.height);
+				if (px >= 0 && py >= 0 && px < page.width && py < page.height &&
+					memcmp(page.pixels.data() + ((size_t)py * page.width + px) * 4, source.pixels.data() + t * 4, 4) == 0)
+					return true;
+				char buf[128];
+				snprintf(buf, sizeof(buf), "image %d texel %d,%d lands on page pixel %d,%d",
+					i, (int)(t % source.width), (int)(t / source.width), px, py);
+				message = buf;
+				return false;
+			};
+			for (size_t t = 0; t < uv.size() / 2; ++t, ++texels)
+				if (!lands(t, uv[t * 2], uv[t * 2 + 1]) || !lands(t, uvd[t * 2], uvd[t * 2 + 1]))
+					return false;
+		}
+		char buf[64];
+		snprintf(buf, sizeof(buf), "%zu texels on %d pages", texels, atlas.pageCount());
+		message = buf;
+		return true;
+	}
+
+	//набор PNG (см. testdata/make_png_corpus.py), путь - от рабочего каталога, как у texture.png
+	const char* PNG_CORPUS = "testdata/png";
+
+	//decodeImage (свой разбор PNG, где он умеет, иначе stb) против stbi_load_from_memory
+	bool pngDecode(std::string& message)
+	{
+		int files = 0, fast = 0;
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::directory_iterator(PNG_CORPUS, ec))
+		{
+			const std::string path = entry.path().string();
+			MappedFile file(path.c_str());
+			if (!file.isOpen())
+				continue;
+			++files;
+
+			stbi_set_flip_vertically_on_load_thread(1);
+			int w, h, n;
+			unsigned char* expected = stbi_load_from_memory(file.data(), (int)file.size(), &w, &h, &n, 4);
+			stbi_set_flip_vertically_on_load_thread(0);
+			if (!expected)
+			{
+				message = path + ": stb can't read it";
+				return false;
+			}
+			const size_t row = (size_t)w * 4;
+			std::vector<unsigned char> got(row * h), direct(row * h);
+			bool same = decodeImage(file.data(), file.size(), got.data()) && std::memcmp(got.data(), expected, got.size()) == 0;
+			//и отдельно - те, что прошли мимо stb
+			if (same && decodePng(file.data(), file.size(), direct.data() + row * (h - 1), -(ptrdiff_t)row))
+			{
+				++fast;
+				same = std::memcmp(direct.data(), expected, direct.size()) == 0;
+			}
+			stbi_image_free(expected);
+			if (!same)
+			{
+				message = path + ": differs from stb";
+				return false;
+			}
+		}
+		if (files == 0)
+		{
+			message = std::string("no files in ") + PNG_CORPUS;
+			return false;
+		}
+		message = std::to_string(files) + " files, " + std::to_string(fast) + " without stb";
+		return true;
+	}
+
+	bool collect(void* user, const unsigned char* data, size_t size)
+	{
+		std::vector<unsigned char>& out = *(std::vector<unsigned char>*)user;
+		out.insert(out.end(), data, data + size);
+		return true;
+	}
+
+	//Сжатые потоки из набора PNG: FastInflate (через stb и потоком по кускам IDAT) должен давать
+	//побайтно то же, что штатный распаковщик stb. Обрезанные потоки он может и не принять, хотя stb
+	//принял (stb молча дочитывает нули за концом), но не наоборот, а если приняли оба - то же самое.
+	//Заодно - во сколько раз он быстрее на целых потоках
+	bool inflate(std::string& message)
+	{
+		if (!stbi_set_fast_inflate(1))
+		{
+			message = "stb_image is built without STBI_FAST_INFLATE";
+			return false;
+		}
+
+		int streams = 0;
+		double stb_ms = 0, fast_ms = 0;
+		size_t total = 0;
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::directory_iterator(PNG_CORPUS, ec))
+		{
+			const std::string path = entry.path().string();
+			MappedFile file(path.c_str());
+			std::vector<InflateInput> idat;
+			bool plain;
+			if (!file.isOpen() || !pngData(file.data(), file.size(), idat, plain))
+				continue;
+			std::vector<unsigned char> joined;
+			for (const InflateInput& part : idat)
+				joined.insert(joined.end(), part.data, part.data + part.size);
+
+			//целиком и обрезанные в нескольких местах
+			const size_t cuts[] = { joined.size(), joined.size() - 1, joined.size() * 3 / 4, joined.size() / 2, 7, 2 };
+			for (size_t cut : cuts)
+			{
+				const bool whole = cut == joined.size();
+				int ref_len = 0, fast_len = 0;
+				auto t0 = std::chrono::steady_clock::now();
+				stbi_set_fast_inflate(0);
+				char* ref = stbi_zlib_decode_malloc_guesssize_headerflag((const char*)joined.data(), (int)cut, 16384, &ref_len, 1);
+				auto t1 = std::chrono::steady_clock::now();
+				stbi_set_fast_inflate(1);
+				char* fast = stbi_zlib_decode_malloc_guesssize_headerflag((const char*)joined.data(), (int)cut, 16384, &fast_len, 1);
+				auto t2 = std::chrono::steady_clock::now();
+
+				std::vector<unsigned char> streamed;
+				std::vector<unsigned char> window(INFLATE_STREAM_MIN);
+				InflateInput part = { joined.data(), cut };
+				const InflateInput* parts = whole ? idat.data() : &part;
+				size_t count = whole ? idat.size() : 1;
+				bool streamed_ok = fastInflateStream(parts, count, true, window.data(), window.size(), collect, &streamed);
+
+				bool same = (fast != nullptr) == streamed_ok && (whole ? (ref != nullptr) == (fast != nullptr) : ref || !fast);
+				if (same && ref && fast)
+					same = ref_len == fast_len && std::memcmp(ref, fast, ref_len) == 0 &&
+						streamed.size() == (size_t)ref_len && std::memcmp(ref, streamed.data(), ref_len) == 0;
+				if (whole)
+				{
+					stb_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+					fast_ms += std::chrono::duration<double, std::milli>(t2 - t1).count();
+					total += ref_len;
+				}
+				stbi_image_free(ref);
+				stbi_image_free(fast);
+				if (!same)
+				{
+					message = path + ": differs from stb, " + std::to_string(cut) + " of " +
+						std::to_string(joined.size()) + " bytes";
+					return false;
+				}
+			}
+			++streams;
+		}
+		if (streams == 0)
+		{
+			message = std::string("no files in ") + PNG_CORPUS;
+			return false;
+		}
+		char buf[128];
+		snprintf(buf, sizeof(buf), "%d streams, %.1f MB, %.2fx stb", streams, total / 1048576.0, stb_ms / std::max(fast_ms, 1e-6));
+		message = buf;
+		return true;
+	}
+
+	//RenderQueue::sort на 100 тыс. ключей: сортирует по возрастанию, каждый номер на месте.
+	//Ключи как у непрозрачных: 16 состояний, глубина 16 бит случайная - лучшее из нескольких
+	//время меньше 1 мс. Для сравнения - время, когда меняются все 12 бит состояния
+	//лучшее время из нескольких; -1, если порядок неверный
+	double timeSort(const std::vector<RenderQueue::SortEntry>& source)
+	{
+		std::vector<RenderQueue::SortEntry> entries, scratch;
+		double best_ms = 1e9;
+		for (int run = 0; run < 5; ++run)
+		{
+			entries = source;
+			auto t0 = std::chrono::steady_clock::now();
+			RenderQueue::sort(entries, scratch);
+			best_ms = std::min(best_ms, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+		}
+
+		std::vector<bool> seen(source.size());
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			uint32_t index = entries[i].index();
+			if (entries[i].key != source[index].key || seen[index] || (i && entries[i - 1].key > entries[i].key))
+				return -1;
+			seen[index] = true;
+		}
+		return best_ms;
+	}
+
+	bool renderQueueSort(std::string& message)
+	{
+		const size_t count = 100000;
+		const double budget_ms = 1;
+		Lcg rnd;
+		std::vector<RenderQueue::SortEntry> typical(count), worst(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint64_t depth = (uint64_t)rnd.next(0, 0xffff);
+			typical[i].key = ((((uint64_t)rnd.next(0, 15) << 16) | depth) << RenderQueue::INDEX_BITS) | i;
+			worst[i].key = ((((uint64_t)rnd.next(0, 4095) << 16) | depth) << RenderQueue::INDEX_BITS) | i;
+		}
+
+		double typical_ms = timeSort(typical);
+		double worst_ms = timeSort(worst);
+		if (typical_ms < 0 || worst_ms < 0)
+		{
+			message = "wrong order";
+			return false;
+		}
+		char buf[128];
+		snprintf(buf, sizeof(buf), "%zu items in %.3f ms (budget %.0f ms), %.3f ms with 4096 states",
+			count, typical_ms, budget_ms, worst_ms);
+		message = buf;
+		return typical_ms < budget_ms;
+	}
+
+	struct Check
+	{
+		const char* name;
+		//false - проверка не прошла; в message - почему, а если прошла - что проверено
+		bool (*run)(std::string& message);
+	};
+
+	const Check checks[] = {
+		{ "atlas mips", atlasMips },
+		{ "atlas uv", atlasUVs },
+		{ "render queue sort", renderQueueSort },
+		{ "inflate", inflate },
+		{ "png decode", pngDecode },
+	};
+}
+
+bool isSelfTest(const std::vector<std::string>& args)
+{
+	return std::find(args.begin(), args.end(), "--self-test") != args.end();
+}
+
+int runSelfTest()
+{
+	int failed = 0;
+	for (const Check& check : checks)
+	{
+		std::string message;
+		bool ok = check.run(message);
+		printf("%-24s %s%s%s\n", check.name, ok ? "ok" : "FAILED", message.empty() ? "" : ": ", message.c_str());
+		if (!ok)
+			++failed;
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,14 @@
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+#include <string>
+#include <vector>
+
+//Самопроверка без окна и без OpenGL: KGlab --self-test.
+//Прогоняет проверки того, что картинкой не увидишь (соседние ячейки атласа на мелких
+//мип-уровнях и т.п.), печатает по строке на проверку, возвращает код выхода:
+//0 - все прошли, 1 - что-то не так
+bool isSelfTest(const std::vector<std::string>& args);
+int runSelfTest();
+
+#endif
@@ -0,0 +1,246 @@
+#include "ShadedLighting.h"
+
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include "GLState.h"
+#include "ImmediateBatch.h"
+#include "ProgramCache.h"
+#include "RenderModes.h"
+#include "RenderQueue.h"
+
+ShadedLighting shadedLighting;
+
+namespace
+{
+	const GLuint CAMERA_BINDING = 0;
+	const GLuint LIGHT_BINDING = 1;
+	const GLuint MATERIAL_BINDING = 2;
+
+	const GLsizeiptr CAMERA_SIZE = 16 * sizeof(float);
+	const GLsizeiptr LIGHT_SIZE = 5 * 4 * sizeof(float);
+	//vec4 x3 + float, округляется до vec4
+	const GLsizeiptr MATERIAL_SIZE = 16 * sizeof(float);
+
+	const GLuint FAILED = ~0u;
+
+	const char* VERSION = "#version 150 compatibility";
+
+	//блоки общие для обоих шейдеров
+	const char* BLOCKS = R"(
+layout(std140) uniform Camera
+{
+	mat4 view;
+};
+
+layout(std140) uniform Light
+{
+	vec4 light_position;
+	vec4 light_ambient;
+	vec4 light_diffuse;
+	vec4 light_specular;
+	vec4 scene_ambient;
+};
+
+layout(std140) uniform Material
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float shininess;
+} material;
+)";
+
+	const char* VERTEX_SOURCE = R"(
+out vec3 normal;
+out vec3 to_light;
+out vec3 to_eye;
+#if TEXTURING
+out vec2 tex_coord;
+#endif
+
+void main()
+{
+	//все в координатах камеры, как у фиксированного конвейера
+	vec4 position = gl_ModelViewMatrix * gl_Vertex;
+	normal = gl_NormalMatrix * gl_Normal;
+	to_light = (view * light_position).xyz - position.xyz;
+	to_eye = -position.xyz;
+#if TEXTURING
+	tex_coord = gl_MultiTexCoord0.xy;
+#endif
+	gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+}
+)";
+
+	const char* FRAGMENT_SOURCE = R"(
+in vec3 normal;
+in vec3 to_light;
+in vec3 to_eye;
+#if TEXTURING
+in vec2 tex_coord;
+uniform sampler2D tex;
+#endif
+
+out vec4 frag_color;
+
+void main()
+{
+	vec3 n = normalize(normal);
+	vec3 l = normalize(to_light);
+	vec3 h = normalize(l + normalize(to_eye));
+
+	float lambert = max(dot(n, l), 0.0);
+	float blinn = lambert > 0.0 ? pow(max(dot(n, h), 0.0), material.shininess) : 0.0;
+
+	vec3 color = (scene_ambient.rgb + light_ambient.rgb) * material.ambient.rgb +
+		light_diffuse.rgb * material.diffuse.rgb * lambert +
+		light_specular.rgb * material.specular.rgb * blinn;
+	//как GL_MODULATE: освещенный цвет (уже в [0, 1]) умножается на текстуру
+	frag_color = vec4(clamp(color, 0.0, 1.0), material.diffuse.a);
+#if TEXTURING
+	frag_color *= texture(tex, tex_coord);
+#endif
+}
+)";
+
+	//матрица gluLookAt, по столбцам
+	void lookAt(const double eye[3], const double center[3], const double up[3], float m[16])
+	{
+		double f[3] = { center[0] - eye[0], center[1] - eye[1], center[2] - eye[2] };
+		double fl = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+		for (double& v : f)
+			v /= fl;
+		double s[3] = { f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0] };
+		double sl = sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+		for (double& v : s)
+			v /= sl;
+		double u[3] = { s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0] };
+
+		float r[16] = {
+			(float)s[0], (float)u[0], (float)-f[0], 0,
+			(float)s[1], (float)u[1], (float)-f[1], 0,
+			(float)s[2], (float)u[2], (float)-f[2], 0,
+			(float)-(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]),
+			(float)-(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]),
+			(float)(f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2]), 1
+		};
+		memcpy(m, r, sizeof(r));
+	}
+}
+
+
+bool ShadedLighting::supported() const
+{
+	const GLCaps& caps = glCaps();
+	//встроенные атрибуты есть только в профиле совместимости
+	return caps.uniform_buffer && caps.atLeast(3, 2) && caps.compatibility;
+}
+
+GLsizeiptr ShadedLighting::aligned(GLsizeiptr size) const
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+GLuint ShadedLighting::program(unsigned modes)
+{
+	if (!enabled || !supported())
+		return 0;
+
+	GLuint& p = variants[modes % MODE_COUNT];
+	if (p == FAILED)
+		return 0;
+	if (p)
+		return p;
+
+	static const std::string vertex = std::string(BLOCKS) + VERTEX_SOURCE;
+	static const std::string fragment = std::string(BLOCKS) + FRAGMENT_SOURCE;
+	p = programs.get("lighting", modes, VERSION, vertex.c_str(), fragment.c_str());
+	if (!p)
+	{
+		p = FAILED;
+		return 0;
+	}
+	//неиспользуемый блок компилятор может выбросить - тогда его индекса нет
+	const char* blocks[] = { "Camera", "Light", "Material" };
+	const GLuint bindings[] = { CAMERA_BINDING, LIGHT_BINDING, MATERIAL_BINDING };
+	for (int i = 0; i < 3; ++i)
+	{
+		GLuint index = glfn.GetUniformBlockIndex(p, blocks[i]);
+		if (index != GL_INVALID_INDEX)
+			glfn.UniformBlockBinding(p, index, bindings[i]);
+	}
+	GLint tex = glfn.GetUniformLocation(p, "tex");
+	if (tex >= 0)
+	{
+		glState.useProgram(p);
+		glfn.Uniform1i(tex, 0);
+	}
+	return p;
+}
+
+void ShadedLighting::setView(const double eye[3], const double center[3], const double up[3])
+{
+	lookAt(eye, center, up, frame.view);
+}
+
+void ShadedLighting::setLight(const float position[4], const float ambient[4], const float diffuse[4], const float specular[4])
+{
+	memcpy(frame.light_position, position, sizeof(frame.light_position));
+	memcpy(frame.light_ambient, ambient, sizeof(frame.light_ambient));
+	memcpy(frame.light_diffuse, diffuse, sizeof(frame.light_diffuse));
+	memcpy(frame.light_specular, specular, sizeof(frame.light_specular));
+	//GL_LIGHT_MODEL_AMBIENT по умолчанию
+	const float scene[4] = { 0.2f, 0.2f, 0.2f, 1 };
+	memcpy(frame.scene_ambient, scene, sizeof(scene));
+}
+
+void ShadedLighting::upload(const std::vector<Material>& materials)
+{
+	if (!supported())
+		return;
+	//накопленное рекордером рисуется со старыми данными
+	imm.flush();
+
+	if (!frame_buffer)
+	{
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		if (alignment < 16)
+			alignment = 16;
+		glfn.GenBuffers(1, &frame_buffer);
+		glfn.GenBuffers(1, &material_buffer);
+	}
+
+	//камера и свет - одним вызовом, каждый блок со своего выровненного места
+	GLsizeiptr light_offset = aligned(CAMERA_SIZE);
+	std::vector<unsigned char> data(light_offset + LIGHT_SIZE);
+	memcpy(data.data(), frame.view, CAMERA_SIZE);
+	memcpy(data.data() + light_offset, frame.light_position, LIGHT_SIZE);
+	glfn.BindBuffer(GL_UNIFORM_BUFFER, frame_buffer);
+	//новый буфер каждый кадр - драйвер не ждет прошлый кадр, который его читает
+	glfn.BufferData(GL_UNIFORM_BUFFER, data.size(), data.data(), GL_STREAM_DRAW);
+
+	//материалы меняются редко
+	GLsizeiptr stride = aligned(MATERIAL_SIZE);
+	std::vector<unsigned char> packed(materials.size() * stride);
+	for (size_t i = 0; i < materials.size(); ++i)
+		memcpy(packed.data() + i * stride, &materials[i], sizeof(Material));
+	if (packed != uploaded_materials && !packed.empty())
+	{
+		glfn.BindBuffer(GL_UNIFORM_BUFFER, material_buffer);
+		glfn.BufferData(GL_UNIFORM_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+		uploaded_materials.swap(packed);
+	}
+	glfn.BindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glState.uniformBuffer(CAMERA_BINDING, frame_buffer, 0, CAMERA_SIZE);
+	glState.uniformBuffer(LIGHT_BINDING, frame_buffer, light_offset, LIGHT_SIZE);
+}
+
+void ShadedLighting::bindMaterial(int index)
+{
+	if (index < 0 || (size_t)(index + 1) * aligned(MATERIAL_SIZE) > uploaded_materials.size())
+		return;
+	glState.uniformBuffer(MATERIAL_BINDING, material_buffer, index * aligned(MATERIAL_SIZE), MATERIAL_SIZE);
+}
@@ -0,0 +1,84 @@
+#ifndef SHADEDLIGHTING_H
+#define SHADEDLIGHTING_H
+
+#include <cstddef>
+#include <vector>
+
+#include "GLLoader.h"
+
+struct Material;
+
+//Освещение по Блинну-Фонгу в каждом пикселе вместо фиксированного GL_LIGHT0.
+//Фиксированный конвейер считает свет в вершинах и тянет цвет по треугольнику (Гуро),
+//поэтому блик получается гладким только на частой сетке. Здесь в вершинах считаются
+//только векторы, а свет - во фрагментном шейдере.
+//Данные лежат в буферах uniform и заливаются один раз за кадр (upload):
+//    Camera   (точка 0) - матрица вида, ею свет переводится в координаты камеры;
+//    Light    (точка 1) - положение и цвета источника, фоновый свет сцены;
+//    Material (точка 2) - материалы очереди, каждый на своем выровненном месте,
+//                         текущий выбирается bindMaterial без заливки.
+//Положение вершин, нормали и текстурные координаты шейдер берет из встроенных
+//атрибутов (gl_Vertex, gl_Normal, ...), поэтому геометрия рисуется как раньше -
+//imm, glBegin или display list. Нужен контекст 3.2 с профилем совместимости,
+//иначе program() дает 0 и свет остается фиксированным. Только поток рендера.
+class ShadedLighting
+{
+public:
+
+	//выключенное освещение шейдером - program() всегда 0
+	void setEnabled(bool on)
+	{
+		enabled = on;
+	}
+	bool isEnabled() const
+	{
+		return enabled;
+	}
+
+	//программа освещения для комбинации режимов (RenderModes.h), 0 - светить фиксированным конвейером
+	GLuint program(unsigned modes);
+
+	//камера как у gluLookAt
+	void setView(const double eye[3], const double center[3], const double up[3]);
+	//источник как у glLightfv: положение в мировых координатах, цвета
+	void setLight(const float position[4], const float ambient[4], const float diffuse[4], const float specular[4]);
+
+	//заливает камеру, свет и материалы (если поменялись) и привязывает блоки - раз за кадр,
+	//перед рисованием программами освещения
+	void upload(const std::vector<Material>& materials);
+	//материал из последнего upload для следующей отрисовки
+	void bindMaterial(int index);
+
+private:
+
+	bool supported() const;
+	//выровненный размер блока
+	GLsizeiptr aligned(GLsizeiptr size) const;
+
+	bool enabled = true;
+
+	//0 - еще не собиралась, ~0 - не собралась
+	GLuint variants[8] = {};
+
+	//блоки Camera и Light, как в std140
+	struct FrameBlock
+	{
+		float view[16];
+		float light_position[4];
+		float light_ambient[4];
+		float light_diffuse[4];
+		float light_specular[4];
+		float scene_ambient[4];
+	};
+	FrameBlock frame = {};
+
+	GLuint frame_buffer = 0;
+	GLuint material_buffer = 0;
+	GLint alignment = 16;
+	//что лежит в material_buffer
+	std::vector<unsigned char> uploaded_materials;
+};
+
+extern ShadedLighting shadedLighting;
+
+#endif
@@ -0,0 +1,141 @@
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+	//кольцо - три такие области, старый буфер - 4 МБ
+	const size_t REGION_SIZE = 2 * 1024 * 1024;
+	const size_t ORPHAN_SIZE = 4 * 1024 * 1024;
+
+	//пачки - с выровненного места
+	size_t align(size_t offset)
+	{
+		return (offset + 63) & ~(size_t)63;
+	}
+}
+
+
+size_t StreamBuffer::write(const void* data, size_t bytes)
+{
+	if (!persistent || !glCaps().buffer_storage)
+		return writeOrphaned(data, bytes);
+
+	if (!mapped || bytes > region_size)
+	{
+		allocate(std::max(REGION_SIZE, bytes));
+		//отображать насовсем драйвер не дал - дальше по-старому
+		if (!mapped)
+		{
+			persistent = false;
+			return writeOrphaned(data, bytes);
+		}
+	}
+	else
+		glfn.BindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	if (offset + bytes > (current + 1) * region_size)
+		nextRegion();
+
+	//буфер когерентный - видеокарта увидит запись без glFlushMappedBufferRange
+	memcpy(mapped + offset, data, bytes);
+	size_t at = offset;
+	offset = align(offset + bytes);
+	return at;
+}
+
+void StreamBuffer::allocate(size_t region)
+{
+	//старый буфер GL удалит сам, когда видеокарта его дочитает
+	release();
+
+	region_size = align(region);
+	capacity = region_size * REGIONS;
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glfn.GenBuffers(1, &buffer);
+	glfn.BindBuffer(GL_ARRAY_BUFFER, buffer);
+	glfn.BufferStorage(GL_ARRAY_BUFFER, capacity, nullptr, flags);
+	mapped = (char*)glfn.MapBufferRange(GL_ARRAY_BUFFER, 0, capacity, flags);
+	if (!mapped)
+		release();
+}
+
+void StreamBuffer::nextRegion()
+{
+	//все, что рисовалось из текущей области, уже отдано драйверу - fence встает после него
+	fences[current] = glfn.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	current = (current + 1) % REGIONS;
+	offset = current * region_size;
+
+	GLsync fence = fences[current];
+	if (!fence)
+		return;
+	if (glfn.ClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+	{
+		//видеокарта отстала на целых две области - тут уж ждем
+		auto start = std::chrono::steady_clock::now();
+		while (glfn.ClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+		{
+		}
+		++wait_count;
+		wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+	glfn.DeleteSync(fence);
+	fences[current] = nullptr;
+}
+
+size_t StreamBuffer::writeOrphaned(const void* data, size_t bytes)
+{
+	if (!buffer)
+		glfn.GenBuffers(1, &buffer);
+	glfn.BindBuffer(GL_ARRAY_BUFFER, buffer);
+	if (offset + bytes > capacity)
+	{
+		capacity = std::max(capacity, std::max(ORPHAN_SIZE, bytes));
+		glfn.BufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+		offset = 0;
+	}
+
+	void* dst = nullptr;
+	if (glCaps().map_buffer_range)
+		dst = glfn.MapBufferRange(GL_ARRAY_BUFFER, offset, bytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (dst)
+	{
+		memcpy(dst, data, bytes);
+		glfn.UnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	else
+		glfn.BufferSubData(GL_ARRAY_BUFFER, offset, bytes, data);
+
+	size_t at = offset;
+	offset = align(offset + bytes);
+	return at;
+}
+
+void StreamBuffer::setPersistent(bool on)
+{
+	//неизменяемый буфер не перевыделить через glBufferData и наоборот
+	if (on != persistent)
+		release();
+	persistent = on;
+}
+
+void StreamBuffer::release()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+			glfn.DeleteSync(fence);
+		fence = nullptr;
+	}
+	//отображение снимается вместе с буфером
+	if (buffer)
+		glfn.DeleteBuffers(1, &buffer);
+	buffer = 0;
+	mapped = nullptr;
+	capacity = region_size = offset = 0;
+	current = 0;
+}
@@ -0,0 +1,76 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <cstddef>
+
+#include "GLLoader.h"
+
+//Потоковый буфер вершин для данных, которые каждый кадр новые (пачки imm: HUD, гизмо света,
+//графики и т.п.):
+//    size_t offset = stream.write(data, bytes);   //буфер остается привязан к GL_ARRAY_BUFFER
+//    glVertexPointer(..., (const void*)offset);
+//С GLCaps::buffer_storage - кольцо из трех областей в одном буфере, отображенном в память
+//насовсем (GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT): запись - просто memcpy, без вызовов GL.
+//Когда область кончается, за ней ставится fence, а следующую можно брать только после ее fence -
+//видеокарта к тому времени давно дочитала то, что было там два оборота назад, так что ждать
+//почти никогда не приходится (waitCount() это показывает).
+//Без buffer_storage - старый способ: glMapBufferRange без синхронизации или glBufferSubData
+//в один буфер, а когда он кончился - перевыделение (orphaning), драйвер не ждет кадр,
+//который читает старый. Только поток рендера.
+class StreamBuffer
+{
+public:
+
+	//копирует bytes байт и возвращает смещение в буфере, выровненное на 64
+	size_t write(const void* data, size_t bytes);
+
+	//false - только orphaning и там, где есть buffer_storage (для замеров)
+	void setPersistent(bool on);
+	//кольцо ли сейчас (после первой записи)
+	bool isPersistent() const
+	{
+		return mapped != nullptr;
+	}
+	size_t size() const
+	{
+		return capacity;
+	}
+
+	//сколько раз за все время запись ждала видеокарту и сколько всего, мс
+	unsigned long long waitCount() const
+	{
+		return wait_count;
+	}
+	double waitMs() const
+	{
+		return wait_ms;
+	}
+
+	//удаляет буфер и fence (например, перед сменой контекста)
+	void release();
+
+private:
+
+	static const int REGIONS = 3;
+
+	void allocate(size_t region);
+	//следующая область кольца, ждет ее fence
+	void nextRegion();
+	size_t writeOrphaned(const void* data, size_t bytes);
+
+	bool persistent = true;
+	GLuint buffer = 0;
+	size_t capacity = 0;
+	size_t offset = 0;
+
+	//кольцо: область - region_size байт, current - куда пишем
+	char* mapped = nullptr;
+	size_t region_size = 0;
+	int current = 0;
+	GLsync fences[REGIONS] = {};
+
+	unsigned long long wait_count = 0;
+	double wait_ms = 0;
+};
+
+#endif
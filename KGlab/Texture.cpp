@@ -0,0 +1,548 @@
+#include "Texture.h"
+
+#include "GLLoader.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include "MappedFile.h"
+#include "PngDecode.h"
+
+//реализация собрана в Render.cpp (STB_IMAGE_IMPLEMENTATION)
+#include "stb_image.h"
+
+//этого нет в заголовках OpenGL 1.1
+#ifndef GL_LINEAR_MIPMAP_LINEAR
+#define GL_LINEAR_MIPMAP_LINEAR 0x2703
+#endif
+#define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
+
+
+namespace
+{
+	//таблицы перевода sRGB <-> линейный свет
+	struct GammaTables
+	{
+		float to_linear[256];
+		unsigned char to_srgb[4096];
+
+		GammaTables()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				double c = i / 255.0;
+				to_linear[i] = (float)(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+			}
+			for (int i = 0; i < 4096; ++i)
+			{
+				double l = i / 4095.0;
+				double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1 / 2.4) - 0.055;
+				to_srgb[i] = (unsigned char)std::clamp((int)(c * 255.0 + 0.5), 0, 255);
+			}
+		}
+	};
+
+	const GammaTables& gamma()
+	{
+		static GammaTables t;
+		return t;
+	}
+
+	//строки [y0, y1) уменьшенной картинки
+	void downsampleRows(const Image& src, Image& dst, bool gamma_correct, int y0, int y1)
+	{
+		const GammaTables& g = gamma();
+		const int sw = src.width;
+		const unsigned char* s = src.pixels.data();
+		unsigned char* d = dst.pixels.data();
+
+		for (int y = y0; y < y1; ++y)
+		{
+			//у нечетных размеров последний столбец/строка повторяются
+			const unsigned char* r0 = s + std::min(2 * y, src.height - 1) * sw * 4;
+			const unsigned char* r1 = s + std::min(2 * y + 1, src.height - 1) * sw * 4;
+			unsigned char* out = d + y * dst.width * 4;
+
+			for (int x = 0; x < dst.width; ++x)
+			{
+				int a = std::min(2 * x, sw - 1) * 4;
+				int b = std::min(2 * x + 1, sw - 1) * 4;
+
+				for (int c = 0; c < 3; ++c)
+				{
+					if (gamma_correct)
+					{
+						float l = (g.to_linear[r0[a + c]] + g.to_linear[r0[b + c]] +
+							g.to_linear[r1[a + c]] + g.to_linear[r1[b + c]]) * 0.25f;
+						out[x * 4 + c] = g.to_srgb[(int)(l * 4095.0f + 0.5f)];
+					}
+					else
+					{
+						out[x * 4 + c] = (unsigned char)((r0[a + c] + r0[b + c] + r1[a + c] + r1[b + c] + 2) / 4);
+					}
+				}
+				//альфа - это не цвет, усредняем как есть
+				out[x * 4 + 3] = (unsigned char)((r0[a + 3] + r0[b + 3] + r1[a + 3] + r1[b + 3] + 2) / 4);
+			}
+		}
+	}
+}
+
+
+PixelBuffer::PixelBuffer(std::initializer_list<unsigned char> bytes)
+{
+	resize(bytes.size());
+	std::copy(bytes.begin(), bytes.end(), ptr);
+}
+
+PixelBuffer::PixelBuffer(const PixelBuffer& other)
+{
+	*this = other;
+}
+
+PixelBuffer::PixelBuffer(PixelBuffer&& other) noexcept
+	: ptr(other.ptr), length(other.length)
+{
+	other.ptr = nullptr;
+	other.length = 0;
+}
+
+PixelBuffer& PixelBuffer::operator=(const PixelBuffer& other)
+{
+	if (this != &other)
+	{
+		clear();
+		if (other.length)
+		{
+			ptr = (unsigned char*)std::malloc(other.length);
+			if (!ptr)
+				throw std::bad_alloc();
+			std::memcpy(ptr, other.ptr, other.length);
+			length = other.length;
+		}
+	}
+	return *this;
+}
+
+PixelBuffer& PixelBuffer::operator=(PixelBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		clear();
+		ptr = other.ptr;
+		length = other.length;
+		other.ptr = nullptr;
+		other.length = 0;
+	}
+	return *this;
+}
+
+PixelBuffer::~PixelBuffer()
+{
+	clear();
+}
+
+PixelBuffer PixelBuffer::adopt(unsigned char* data, size_t size)
+{
+	PixelBuffer b;
+	b.ptr = data;
+	b.length = size;
+	return b;
+}
+
+void PixelBuffer::resize(size_t size)
+{
+	if (size == length)
+		return;
+	if (size == 0)
+	{
+		clear();
+		return;
+	}
+	unsigned char* p = (unsigned char*)std::realloc(ptr, size);
+	if (!p)
+		throw std::bad_alloc();
+	if (size > length)
+		std::memset(p + length, 0, size - length);
+	ptr = p;
+	length = size;
+}
+
+void PixelBuffer::assign(size_t size, unsigned char value)
+{
+	//старое содержимое не нужно - не даем realloc его копировать
+	if (size != length)
+		clear();
+	resize(size);
+	std::memset(ptr, value, size);
+}
+
+void PixelBuffer::clear()
+{
+	//stbi_image_free - это тот же free
+	std::free(ptr);
+	ptr = nullptr;
+	length = 0;
+}
+
+
+bool loadImage(const char* path, Image& out)
+{
+	//не читаем файл, а отображаем его в память:
+	//stb разбирает PNG прямо из страниц файлового кеша
+	MappedFile file(path);
+	if (!file.isOpen())
+		return false;
+	return loadImageFromMemory(file.data(), file.size(), out);
+}
+
+bool loadImageFromMemory(const unsigned char* data, size_t size, Image& out)
+{
+	if (size > INT_MAX)
+		return false;
+
+	//обычный PNG - сразу в конечный буфер, без буферов stb
+	PngHeader png;
+	if (readPngHeader(data, size, png) && png.supported)
+	{
+		size_t bytes = (size_t)png.width * png.height * 4;
+		unsigned char* pixels = (unsigned char*)std::malloc(bytes);
+		if (!pixels)
+			return false;
+		PixelBuffer buffer = PixelBuffer::adopt(pixels, bytes);
+		if (decodePng(data, size, pixels + (bytes - (size_t)png.width * 4), -(ptrdiff_t)png.width * 4))
+		{
+			out.width = png.width;
+			out.height = png.height;
+			out.pixels = std::move(buffer);
+			return true;
+		}
+	}
+
+	//Картинка хранится в памяти перевернутой
+	//так как ее начало в левом верхнем углу
+	//по этому просим stb перевернуть ее: первая строка становится последней и т.д.
+	//stb меняет строки местами прямо в своем буфере, без второй копии картинки
+	stbi_set_flip_vertically_on_load_thread(1);
+
+	int x, y, n;
+	//загружаем картинку
+	//см. #include "stb_image.h"
+	unsigned char* pixels = stbi_load_from_memory(data, (int)size, &x, &y, &n, 4);
+	//x - ширина изображения
+	//y - высота изображения
+	//n - количество каналов
+	//4 - нужное нам количество каналов
+	//пиксели будут храниться в памяти [R-G-B-A]-[R-G-B-A]-[.....
+	// по 4 байта на пиксель - по байту на канал
+	//пустые каналы будут равны 255
+	stbi_set_flip_vertically_on_load_thread(0);
+	if (!pixels)
+		return false;
+
+	//буфер stb и есть наша картинка, освободится вместе с out.pixels
+	out.width = x;
+	out.height = y;
+	out.pixels = PixelBuffer::adopt(pixels, (size_t)x * y * 4);
+	return true;
+}
+
+bool imageSize(const unsigned char* data, size_t size, int& width, int& height)
+{
+	if (size > INT_MAX)
+		return false;
+	int n;
+	return stbi_info_from_memory(data, (int)size, &width, &height, &n) != 0;
+}
+
+bool decodeImage(const unsigned char* data, size_t size, unsigned char* dst)
+{
+	int width, height;
+	if (!imageSize(data, size, width, height))
+		return false;
+	const size_t row = (size_t)width * 4;
+	if (decodePng(data, size, dst + row * (height - 1), -(ptrdiff_t)row))
+		return true;
+
+	Image image;
+	if (!loadImageFromMemory(data, size, image) || image.width != width || image.height != height)
+		return false;
+	std::memcpy(dst, image.pixels.data(), row * height);
+	return true;
+}
+
+namespace
+{
+	uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+	{
+		//таблица строится один раз при первом вызове, потокобезопасно - saveImagePng можно звать из любого потока
+		static const std::array<uint32_t, 256> table = []
+		{
+			std::array<uint32_t, 256> t;
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t c = i;
+				for (int k = 0; k < 8; ++k)
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[i] = c;
+			}
+			return t;
+		}();
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void putBE32(std::vector<unsigned char>& out, uint32_t v)
+	{
+		out.push_back((unsigned char)(v >> 24));
+		out.push_back((unsigned char)(v >> 16));
+		out.push_back((unsigned char)(v >> 8));
+		out.push_back((unsigned char)v);
+	}
+
+	void writeChunk(FILE* f, const char* type, const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> head;
+		putBE32(head, (uint32_t)data.size());
+		head.insert(head.end(), type, type + 4);
+		uint32_t crc = crc32(head.data() + 4, 4);
+		crc = crc32(data.data(), data.size(), crc);
+		std::vector<unsigned char> tail;
+		putBE32(tail, crc);
+		fwrite(head.data(), 1, head.size(), f);
+		fwrite(data.data(), 1, data.size(), f);
+		fwrite(tail.data(), 1, tail.size(), f);
+	}
+}
+
+bool saveImagePng(const char* path, const Image& image)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	fwrite(signature, 1, 8, f);
+
+	std::vector<unsigned char> ihdr;
+	putBE32(ihdr, (uint32_t)image.width);
+	putBE32(ihdr, (uint32_t)image.height);
+	//8 бит на канал, RGBA, без чересстрочности
+	ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 });
+	writeChunk(f, "IHDR", ihdr);
+
+	//Поток zlib из несжатых блоков deflate (до 65535 байт каждый).
+	//Перед каждой строкой - байт фильтра 0 (без фильтра)
+	const size_t row = (size_t)image.width * 4;
+	std::vector<unsigned char> raw;
+	raw.reserve((row + 1) * image.height);
+	for (int y = image.height - 1; y >= 0; --y)
+	{
+		raw.push_back(0);
+		const unsigned char* src = image.pixels.data() + (size_t)y * row;
+		raw.insert(raw.end(), src, src + row);
+	}
+
+	std::vector<unsigned char> idat;
+	idat.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	idat.push_back(0x78);
+	idat.push_back(0x01);
+	size_t pos = 0;
+	do
+	{
+		size_t n = std::min<size_t>(raw.size() - pos, 65535);
+		bool last = pos + n == raw.size();
+		idat.push_back(last ? 1 : 0);
+		idat.push_back((unsigned char)n);
+		idat.push_back((unsigned char)(n >> 8));
+		idat.push_back((unsigned char)~n);
+		idat.push_back((unsigned char)(~n >> 8));
+		idat.insert(idat.end(), raw.begin() + pos, raw.begin() + pos + n);
+		pos += n;
+	} while (pos < raw.size());
+
+	uint32_t a = 1, b = 0;
+	for (unsigned char c : raw)
+	{
+		a = (a + c) % 65521;
+		b = (b + a) % 65521;
+	}
+	putBE32(idat, (b << 16) | a);
+	writeChunk(f, "IDAT", idat);
+	writeChunk(f, "IEND", {});
+
+	bool ok = ferror(f) == 0;
+	return fclose(f) == 0 && ok;
+}
+
+Image downsample(const Image& src, bool gamma_correct, unsigned threads)
+{
+	Image dst;
+	dst.width = std::max(1, src.width / 2);
+	dst.height = std::max(1, src.height / 2);
+	dst.pixels.resize((size_t)dst.width * dst.height * 4);
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	//маленькие уровни быстрее посчитать в одном потоке, чем запускать потоки
+	threads = std::min<unsigned>(threads, std::max(1, dst.width * dst.height / (128 * 128)));
+
+	if (threads <= 1)
+	{
+		downsampleRows(src, dst, gamma_correct, 0, dst.height);
+		return dst;
+	}
+
+	//каждый поток считает свою полосу строк
+	std::vector<std::thread> pool;
+	int step = (dst.height + threads - 1) / threads;
+	for (unsigned t = 1; t < threads; ++t)
+	{
+		int y0 = t * step;
+		int y1 = std::min(dst.height, y0 + step);
+		if (y0 < y1)
+			pool.emplace_back(downsampleRows, std::cref(src), std::ref(dst), gamma_correct, y0, y1);
+	}
+	downsampleRows(src, dst, gamma_correct, 0, std::min(step, dst.height));
+	for (auto& t : pool)
+		t.join();
+
+	return dst;
+}
+
+std::vector<Image> buildMipChain(Image base, bool gamma_correct, unsigned threads)
+{
+	std::vector<Image> levels;
+	levels.push_back(std::move(base));
+	while (levels.back().width > 1 || levels.back().height > 1)
+	{
+		Image next = downsample(levels.back(), gamma_correct, threads);
+		levels.push_back(std::move(next));
+	}
+	return levels;
+}
+
+void setTextureFiltering(bool mipmaps, float anisotropy)
+{
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	//трилинейная: линейно внутри уровня и линейно между двумя ближайшими уровнями
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+	const GLCaps& caps = glCaps();
+	if (caps.anisotropy)
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+			mipmaps ? std::clamp(anisotropy, 1.0f, caps.max_anisotropy) : 1.0f);
+}
+
+bool hasGenerateMipmaps()
+{
+	return glCaps().generate_mipmap;
+}
+
+bool generateMipmaps()
+{
+	if (!glCaps().generate_mipmap)
+		return false;
+	glfn.GenerateMipmap(GL_TEXTURE_2D);
+	return true;
+}
+
+unsigned int createTexture(const std::vector<Image>& levels, const TextureOptions& options)
+{
+	if (levels.empty())
+		return 0;
+
+	GLuint id;
+	glGenTextures(1, &id);
+	glState.bindTexture(id);
+
+	//4 байта на хранение пикселя
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	for (size_t i = 0; i < levels.size(); ++i)
+		glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA, levels[i].width, levels[i].height, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, levels[i].pixels.data());
+
+	//настройка тайлинга
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, options.wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, options.wrap);
+
+	setTextureFiltering(options.mipmaps && levels.size() > 1, options.anisotropy);
+	return id;
+}
+
+unsigned int createTexture(const Image& image, const TextureOptions& options)
+{
+	if (!options.mipmaps)
+		return createTexture(std::vector<Image>{ image }, options);
+
+	if (options.gpu_mipmaps && hasGenerateMipmaps())
+	{
+		TextureOptions base = options;
+		base.mipmaps = false;
+		GLuint id = createTexture(std::vector<Image>{ image }, base);
+		generateMipmaps();
+		setTextureFiltering(true, options.anisotropy);
+		return id;
+	}
+
+	return createTexture(buildMipChain(image, options.gamma_correct, options.threads), options);
+}
+
+unsigned int loadTexture(const char* path, const TextureOptions& options)
+{
+	const bool gpu_levels = !options.mipmaps || (options.gpu_mipmaps && hasGenerateMipmaps());
+	if (glCaps().pixel_buffer && gpu_levels)
+	{
+		MappedFile file(path);
+		int width, height;
+		if (!file.isOpen() || !imageSize(file.data(), file.size(), width, height))
+			return 0;
+
+		//Буфер распаковки - память драйвера: glTexImage2D читает из него по смещению,
+		//а не из памяти процесса
+		const size_t bytes = (size_t)width * height * 4;
+		GLuint pbo;
+		glfn.GenBuffers(1, &pbo);
+		glfn.BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+		glfn.BufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)bytes, nullptr, GL_STREAM_DRAW);
+		unsigned char* dst = (unsigned char*)glfn.MapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+		bool ok = dst && decodeImage(file.data(), file.size(), dst);
+		//отображение снимаем в любом случае, а испорченный при этом буфер - тоже ошибка
+		if (dst && !glfn.UnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+			ok = false;
+
+		GLuint id = 0;
+		if (ok)
+		{
+			glGenTextures(1, &id);
+			glState.bindTexture(id);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, options.wrap);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, options.wrap);
+			if (options.mipmaps)
+				generateMipmaps();
+			setTextureFiltering(options.mipmaps, options.anisotropy);
+		}
+		glfn.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glfn.DeleteBuffers(1, &pbo);
+		return id;
+	}
+
+	Image image;
+	if (!loadImage(path, image))
+		return 0;
+	return createTexture(image, options);
+}
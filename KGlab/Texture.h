@@ -0,0 +1,135 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+//Пиксели картинки.
+//Память выделяется через malloc, как и в stb_image,
+//поэтому буфер, который вернул stbi_load, забирается как есть, без копии.
+//По поведению - как std::vector<unsigned char> (новые байты нулевые)
+class PixelBuffer
+{
+public:
+
+	PixelBuffer() = default;
+	PixelBuffer(std::initializer_list<unsigned char> bytes);
+	PixelBuffer(const PixelBuffer& other);
+	PixelBuffer(PixelBuffer&& other) noexcept;
+	PixelBuffer& operator=(const PixelBuffer& other);
+	PixelBuffer& operator=(PixelBuffer&& other) noexcept;
+	~PixelBuffer();
+
+	//забирает буфер, выделенный malloc (в том числе stbi_load)
+	static PixelBuffer adopt(unsigned char* data, size_t size);
+
+	unsigned char* data()
+	{
+		return ptr;
+	}
+	const unsigned char* data() const
+	{
+		return ptr;
+	}
+	size_t size() const
+	{
+		return length;
+	}
+	bool empty() const
+	{
+		return length == 0;
+	}
+
+	unsigned char& operator[](size_t i)
+	{
+		return ptr[i];
+	}
+	unsigned char operator[](size_t i) const
+	{
+		return ptr[i];
+	}
+
+	void resize(size_t size);
+	void assign(size_t size, unsigned char value);
+	void clear();
+
+private:
+
+	unsigned char* ptr = nullptr;
+	size_t length = 0;
+};
+
+//картинка в оперативке, 4 байта на пиксель [R-G-B-A],
+//первая строка - нижняя (как ждет OpenGL)
+struct Image
+{
+	int width = 0;
+	int height = 0;
+	PixelBuffer pixels;
+};
+
+//настройки создания текстуры
+struct TextureOptions
+{
+	//строить мип-уровни и включать трилинейную фильтрацию
+	bool mipmaps = true;
+	//строить уровни на видеокарте через glGenerateMipmap, если драйвер умеет.
+	//Быстрее, но усредняет без гамма-коррекции
+	bool gpu_mipmaps = false;
+	//усреднять цвета в линейном пространстве, а не в sRGB
+	bool gamma_correct = true;
+	//анизотропная фильтрация, 1 - выключена.
+	//Обрезается до максимума, который поддерживает драйвер
+	float anisotropy = 8;
+	//потоков для построения мип-уровней, 0 - по числу ядер
+	unsigned threads = 0;
+	//GL_REPEAT / GL_CLAMP
+	int wrap = 0x2901;
+	//хранить в видеопамяти сжатой блоками (BC1/BC3, см. TextureCompress.h),
+	//если драйвер умеет S3TC
+	bool compress = false;
+};
+
+//загружает картинку с диска и переворачивает ее.
+//Файл отображается в память (см. MappedFile.h) и разбирается прямо оттуда,
+//переворот делается на месте, готовый буфер stb становится out.pixels
+bool loadImage(const char* path, Image& out);
+//то же, но из уже прочитанного в память файла (PNG, JPG...)
+bool loadImageFromMemory(const unsigned char* data, size_t size, Image& out);
+//размер картинки по заголовку файла в памяти, без распаковки
+bool imageSize(const unsigned char* data, size_t size, int& width, int& height);
+//Распаковывает картинку прямо в чужой буфер dst (width * height * 4 байт, RGBA),
+//уже перевернутой, как loadImage. dst может быть и отображенным буфером OpenGL (PBO).
+//Обычный PNG (8 бит на канал, см. PngDecode.h) разжимается строка за строкой, кроме dst
+//нужно несколько сотен КБ. Остальное декодирует stb в свой буфер, потом копия в dst
+bool decodeImage(const unsigned char* data, size_t size, unsigned char* dst);
+//Пишет картинку в PNG (строки обратно переворачиваются, первая - верхняя).
+//Без сжатия: это снимки кадров для сравнения, а не ассеты
+bool saveImagePng(const char* path, const Image& image);
+
+//уменьшает картинку вдвое по каждой оси (бокс-фильтр 2x2)
+Image downsample(const Image& src, bool gamma_correct, unsigned threads = 0);
+
+//полная цепочка уровней до 1x1, levels[0] - сама картинка
+std::vector<Image> buildMipChain(Image base, bool gamma_correct, unsigned threads = 0);
+
+//создает текстуру OpenGL, возвращает ее id (0 - не получилось).
+//Нужен активный контекст OpenGL
+unsigned int createTexture(const Image& image, const TextureOptions& options = TextureOptions());
+unsigned int createTexture(const std::vector<Image>& levels, const TextureOptions& options = TextureOptions());
+//Грузит файл сразу в текстуру. Если есть PBO (GLCaps::pixel_buffer), картинка распаковывается
+//прямо в отображенный буфер OpenGL, а мип-уровни строит видеокарта: в памяти процесса ее копии нет.
+//Без PBO или с мип-уровнями на процессоре (gpu_mipmaps = false) - через loadImage
+unsigned int loadTexture(const char* path, const TextureOptions& options = TextureOptions());
+
+//переключает фильтрацию у текущей привязанной текстуры
+//(mipmaps=true требует, чтобы у нее были все уровни)
+void setTextureFiltering(bool mipmaps, float anisotropy);
+
+//glGenerateMipmap для текущей привязанной текстуры.
+//false - драйвер не умеет, уровни надо строить самим
+bool hasGenerateMipmaps();
+bool generateMipmaps();
+
+#endif
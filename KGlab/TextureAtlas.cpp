@@ -0,0 +1,327 @@
+#include "TextureAtlas.h"
+
+#include "GLCallCount.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+//этого нет в заголовках OpenGL 1.1
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
+
+SkylinePacker::SkylinePacker(int width, int height)
+{
+	reset(width, height);
+}
+
+void SkylinePacker::reset(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	used_width = 0;
+	used_height = 0;
+	used_area = 0;
+	skyline.clear();
+	skyline.push_back({ 0, 0, width });
+}
+
+int SkylinePacker::fit(size_t i, int w, int h) const
+{
+	int x = skyline[i].x;
+	if (x + w > width)
+		return -1;
+
+	//прямоугольник ляжет на самую высокую из ступенек под ним
+	int y = 0;
+	int left = w;
+	for (size_t j = i; left > 0; ++j)
+	{
+		y = std::max(y, skyline[j].y);
+		if (y + h > height)
+			return -1;
+		left -= skyline[j].width;
+	}
+	return y;
+}
+
+bool SkylinePacker::insert(int w, int h, int& x, int& y)
+{
+	//лучшая ступенька: ниже верх прямоугольника, при равенстве - уже ступенька
+	int best = -1;
+	int best_top = 0;
+	int best_width = 0;
+	for (size_t i = 0; i < skyline.size(); ++i)
+	{
+		int fy = fit(i, w, h);
+		if (fy < 0)
+			continue;
+		if (best < 0 || fy + h < best_top || (fy + h == best_top && skyline[i].width < best_width))
+		{
+			best = (int)i;
+			best_top = fy + h;
+			best_width = skyline[i].width;
+		}
+	}
+	if (best < 0)
+		return false;
+
+	x = skyline[best].x;
+	y = best_top - h;
+
+	//новая ступенька поверх прямоугольника
+	skyline.insert(skyline.begin() + best, { x, best_top, w });
+
+	//ступеньки, которые он накрыл, укорачиваем или убираем
+	for (size_t i = best + 1; i < skyline.size(); )
+	{
+		int right = skyline[i - 1].x + skyline[i - 1].width;
+		if (skyline[i].x >= right)
+			break;
+		int cut = right - skyline[i].x;
+		if (cut < skyline[i].width)
+		{
+			skyline[i].x += cut;
+			skyline[i].width -= cut;
+			break;
+		}
+		skyline.erase(skyline.begin() + i);
+	}
+
+	//соседние ступеньки одной высоты сливаем
+	for (size_t i = 1; i < skyline.size(); )
+	{
+		if (skyline[i - 1].y == skyline[i].y)
+		{
+			skyline[i - 1].width += skyline[i].width;
+			skyline.erase(skyline.begin() + i);
+		}
+		else
+			++i;
+	}
+
+	used_width = std::max(used_width, x + w);
+	used_height = std::max(used_height, best_top);
+	used_area += (long long)w * h;
+	return true;
+}
+
+double SkylinePacker::occupancy() const
+{
+	if (!used_width || !used_height)
+		return 0;
+	return (double)used_area / ((double)used_width * used_height);
+}
+
+
+namespace
+{
+	int roundUp(int v, int align)
+	{
+		return (v + align - 1) / align * align;
+	}
+
+	int nextPow2(int v)
+	{
+		int p = 1;
+		while (p < v)
+			p *= 2;
+		return p;
+	}
+
+	//копирует картинку на страницу, поля заполняет ее крайними пикселями
+	void blit(const Image& src, Image& page, int x, int y, int pad)
+	{
+		const size_t row = (size_t)src.width * 4;
+		for (int r = -pad; r < src.height + pad; ++r)
+		{
+			const unsigned char* s = src.pixels.data() + std::clamp(r, 0, src.height - 1) * row;
+			unsigned char* d = page.pixels.data() + ((size_t)(y + r) * page.width + x) * 4;
+
+			for (int i = -pad; i < 0; ++i)
+				std::memcpy(d + i * 4, s, 4);
+			std::memcpy(d, s, row);
+			for (int i = 0; i < pad; ++i)
+				std::memcpy(d + row + i * 4, s + row - 4, 4);
+		}
+	}
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	releaseTextures();
+}
+
+void TextureAtlas::releaseTextures()
+{
+	if (!page_textures.empty())
+		glState.deleteTextures((GLsizei)page_textures.size(), page_textures.data());
+	page_textures.clear();
+}
+
+int TextureAtlas::add(Image image)
+{
+	images.push_back(std::move(image));
+	return (int)images.size() - 1;
+}
+
+int TextureAtlas::addFile(const char* path)
+{
+	Image image;
+	if (!loadImage(path, image))
+		return -1;
+	return add(std::move(image));
+}
+
+bool TextureAtlas::pack(const AtlasOptions& options)
+{
+	this->options = options;
+	const int align = std::max(1, options.align);
+	const int pad = std::max(0, options.padding);
+
+	auto start = std::chrono::steady_clock::now();
+
+	//ячейка = картинка + поля, округленная до выравнивания
+	std::vector<int> cell_w(images.size()), cell_h(images.size());
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		cell_w[i] = roundUp(images[i].width + 2 * pad, align);
+		cell_h[i] = roundUp(images[i].height + 2 * pad, align);
+	}
+
+	//skyline плотнее всего, если класть от высоких к низким
+	std::vector<int> order(images.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = (int)i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		return cell_h[a] != cell_h[b] ? cell_h[a] > cell_h[b] : cell_w[a] > cell_w[b];
+		});
+
+	regions.assign(images.size(), AtlasRegion());
+	std::vector<SkylinePacker> packers;
+	bool all_fit = true;
+
+	for (int i : order)
+	{
+		if (cell_w[i] > options.page_size || cell_h[i] > options.page_size)
+		{
+			all_fit = false;
+			continue;
+		}
+
+		//сначала пробуем уже начатые страницы
+		int x = 0, y = 0;
+		int page = -1;
+		for (size_t p = 0; p < packers.size() && page < 0; ++p)
+			if (packers[p].insert(cell_w[i], cell_h[i], x, y))
+				page = (int)p;
+		if (page < 0)
+		{
+			packers.emplace_back(options.page_size, options.page_size);
+			packers.back().insert(cell_w[i], cell_h[i], x, y);
+			page = (int)packers.size() - 1;
+		}
+
+		AtlasRegion& r = regions[i];
+		r.page = page;
+		r.x = x + pad;
+		r.y = y + pad;
+		r.width = images[i].width;
+		r.height = images[i].height;
+	}
+
+	auto placed = std::chrono::steady_clock::now();
+	pack_ms = std::chrono::duration<double, std::milli>(placed - start).count();
+
+	//страницы обрезаем до занятого места (со степенью двойки по каждой оси)
+	pages.assign(packers.size(), Image());
+	page_occupancy.assign(packers.size(), 0);
+	for (size_t p = 0; p < packers.size(); ++p)
+	{
+		pages[p].width = nextPow2(packers[p].usedWidth());
+		pages[p].height = nextPow2(packers[p].usedHeight());
+		pages[p].pixels.assign((size_t)pages[p].width * pages[p].height * 4, 0);
+		page_occupancy[p] = packers[p].occupancy();
+	}
+
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		AtlasRegion& r = regions[i];
+		if (r.page < 0)
+			continue;
+		const Image& page = pages[r.page];
+		blit(images[i], pages[r.page], r.x, r.y, pad);
+
+		r.u0 = (float)r.x / page.width;
+		r.v0 = (float)r.y / page.height;
+		r.u1 = (float)(r.x + r.width) / page.width;
+		r.v1 = (float)(r.y + r.height) / page.height;
+	}
+
+	blit_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - placed).count();
+	return all_fit;
+}
+
+int TextureAtlas::mipLevels() const
+{
+	const int pad = std::max(0, options.padding);
+	int levels = 1;
+	while (((3 << levels) - 1) / 2 <= pad)
+		++levels;
+	return levels;
+}
+
+std::vector<Image> TextureAtlas::pageLevels(int page) const
+{
+	const int count = mipLevels();
+	std::vector<Image> levels;
+	levels.push_back(pages[page]);
+	while ((int)levels.size() < count && (levels.back().width > 1 || levels.back().height > 1))
+		levels.push_back(downsample(levels.back(), options.gamma_correct));
+	return levels;
+}
+
+void TextureAtlas::upload()
+{
+	releaseTextures();
+
+	TextureOptions tex;
+	tex.gamma_correct = options.gamma_correct;
+	tex.anisotropy = options.anisotropy;
+
+	for (int p = 0; p < pageCount(); ++p)
+	{
+		std::vector<Image> levels = pageLevels(p);
+
+		tex.mipmaps = levels.size() > 1;
+		unsigned int id = createTexture(levels, tex);
+		//цепочка неполная - говорим, что уровней больше нет, иначе текстура будет "неполной"
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+		page_textures.push_back(id);
+	}
+}
+
+void TextureAtlas::bind(int image) const
+{
+	glState.bindTexture(page_textures[regions[image].page]);
+}
+
+void TextureAtlas::remapUVs(int image, float* uv, size_t count, size_t stride) const
+{
+	const AtlasRegion& r = regions[image];
+	for (size_t i = 0; i < count; ++i, uv += stride)
+		r.map(uv[0], uv[1], uv[0], uv[1]);
+}
+
+void TextureAtlas::remapUVs(int image, double* uv, size_t count, size_t stride) const
+{
+	const AtlasRegion& r = regions[image];
+	for (size_t i = 0; i < count; ++i, uv += stride)
+	{
+		uv[0] = r.u0 + (r.u1 - r.u0) * uv[0];
+		uv[1] = r.v0 + (r.v1 - r.v0) * uv[1];
+	}
+}
@@ -0,0 +1,180 @@
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include <vector>
+
+#include "Texture.h"
+
+//Упаковщик прямоугольников "skyline" (линия горизонта).
+//Хранит верхнюю границу уже занятого места как ступеньки слева направо
+//и ставит каждый новый прямоугольник на ту ступеньку, где он встанет ниже всего.
+//Дешевый (ступенек обычно десятки) и плотный, если класть от высоких к низким.
+class SkylinePacker
+{
+public:
+
+	SkylinePacker(int width = 0, int height = 0);
+
+	void reset(int width, int height);
+
+	//ищет место под w x h, false - не влезло
+	bool insert(int w, int h, int& x, int& y);
+
+	//правее и выше этого ничего не занято
+	int usedWidth() const
+	{
+		return used_width;
+	}
+	int usedHeight() const
+	{
+		return used_height;
+	}
+
+	//доля занятой площади
+	double occupancy() const;
+
+private:
+
+	struct Segment
+	{
+		int x, y, width;
+	};
+
+	std::vector<Segment> skyline;
+	int width = 0;
+	int height = 0;
+	int used_width = 0;
+	int used_height = 0;
+	long long used_area = 0;
+
+	//на какой высоте встанет прямоугольник шириной w, если левым краем на ступеньку i.
+	//-1 - не влезает
+	int fit(size_t i, int w, int h) const;
+};
+
+//где картинка оказалась в атласе
+struct AtlasRegion
+{
+	//-1 - картинка не влезла ни на одну страницу
+	int page = -1;
+	//картинка в пикселях страницы, без полей
+	int x = 0, y = 0, width = 0, height = 0;
+	//то же в текстурных координатах страницы
+	float u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+
+	//переводит uv картинки ([0, 1], повтор не поддерживается) в uv страницы
+	void map(float u, float v, float& au, float& av) const
+	{
+		au = u0 + (u1 - u0) * u;
+		av = v0 + (v1 - v0) * v;
+	}
+};
+
+struct AtlasOptions
+{
+	//максимальный размер страницы (степень двойки)
+	int page_size = 2048;
+	//каждая ячейка выравнивается на align пикселей (степень двойки)
+	int align = 4;
+	//поле вокруг картинки, заполняется ее крайними пикселями,
+	//чтобы билинейная выборка у края не цепляла соседа.
+	//От него зависит, сколько мип-уровней безопасно (см. TextureAtlas::mipLevels)
+	int padding = 2;
+	bool gamma_correct = true;
+	float anisotropy = 8;
+};
+
+//Атлас: много маленьких картинок на нескольких больших страницах.
+//Все объекты, текстуры которых попали на одну страницу,
+//рисуются с одним glBindTexture - одной пачкой.
+//
+//add/pack можно звать из любого потока, upload - только из потока рендера.
+class TextureAtlas
+{
+public:
+
+	TextureAtlas() = default;
+	~TextureAtlas();
+
+	TextureAtlas(const TextureAtlas&) = delete;
+	TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+	//добавляет картинку, возвращает ее номер
+	int add(Image image);
+	//то же из файла, -1 - файл не прочитался
+	int addFile(const char* path);
+
+	//раскладывает все добавленные картинки по страницам.
+	//false - какая-то картинка больше страницы, у нее region().page == -1
+	bool pack(const AtlasOptions& options = AtlasOptions());
+
+	int imageCount() const
+	{
+		return (int)images.size();
+	}
+	const AtlasRegion& region(int image) const
+	{
+		return regions[image];
+	}
+
+	int pageCount() const
+	{
+		return (int)pages.size();
+	}
+	const Image& page(int i) const
+	{
+		return pages[i];
+	}
+	double occupancy(int page) const
+	{
+		return page_occupancy[page];
+	}
+
+	//сколько уровней (вместе с нулевым) можно строить, чтобы билинейная выборка
+	//внутри картинки не доставала за ее поле. Тексель уровня L - это 2^L пикселей,
+	//выборка у края берет и соседний тексель, и в худшем случае они заходят
+	//за край на (3 * 2^L - 1) / 2 пикселей: при поле 2 - только уровни 0 и 1
+	int mipLevels() const;
+	//уровни страницы, как их загружает upload
+	std::vector<Image> pageLevels(int page) const;
+
+	//создает текстуры страниц с безопасными мип-уровнями.
+	//Нужен активный контекст OpenGL
+	void upload();
+	unsigned int pageTexture(int page) const
+	{
+		return page_textures[page];
+	}
+	//glBindTexture страницы, на которой лежит картинка
+	void bind(int image) const;
+
+	//переписывает текстурные координаты меша под атлас:
+	//count пар (u, v), между началами соседних пар stride чисел
+	void remapUVs(int image, float* uv, size_t count, size_t stride = 2) const;
+	void remapUVs(int image, double* uv, size_t count, size_t stride = 2) const;
+
+	//сколько заняла раскладка и сколько - копирование пикселей
+	double packTimeMs() const
+	{
+		return pack_ms;
+	}
+	double blitTimeMs() const
+	{
+		return blit_ms;
+	}
+
+private:
+
+	AtlasOptions options;
+	std::vector<Image> images;
+	std::vector<AtlasRegion> regions;
+	std::vector<Image> pages;
+	std::vector<double> page_occupancy;
+	std::vector<unsigned int> page_textures;
+	double pack_ms = 0;
+	double blit_ms = 0;
+
+	void releaseTextures();
+};
+
+#endif
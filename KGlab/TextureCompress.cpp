@@ -0,0 +1,487 @@
+#include "TextureCompress.h"
+
+#include "GLLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include "MappedFile.h"
+
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+
+
+namespace
+{
+	//----------------------------- кодировщик ------------------------------
+
+	unsigned short to565(const float c[3])
+	{
+		int r = std::clamp((int)(c[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+		int g = std::clamp((int)(c[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+		int b = std::clamp((int)(c[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+		return (unsigned short)((r << 11) | (g << 5) | b);
+	}
+
+	void from565(unsigned short v, float c[3])
+	{
+		int r = (v >> 11) & 31;
+		int g = (v >> 5) & 63;
+		int b = v & 31;
+		c[0] = (float)((r << 3) | (r >> 2));
+		c[1] = (float)((g << 2) | (g >> 4));
+		c[2] = (float)((b << 3) | (b >> 2));
+	}
+
+	//цветовая часть блока (8 байт), всегда в 4-цветном режиме (color0 > color1)
+	void encodeColorBlock(const unsigned char px[16][4], unsigned char* out)
+	{
+		//ищем главную ось разброса цветов блока и берем крайние точки на ней
+		float mean[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; ++i)
+			for (int c = 0; c < 3; ++c)
+				mean[c] += px[i][c];
+		for (int c = 0; c < 3; ++c)
+			mean[c] /= 16;
+
+		float cov[6] = { 0, 0, 0, 0, 0, 0 };
+		for (int i = 0; i < 16; ++i)
+		{
+			float r = px[i][0] - mean[0], g = px[i][1] - mean[1], b = px[i][2] - mean[2];
+			cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+			cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+		}
+
+		//степенной метод, нескольких итераций хватает
+		float axis[3] = { 1, 1, 1 };
+		for (int it = 0; it < 8; ++it)
+		{
+			float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+			float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+			float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+			float m = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+			if (m == 0)
+				break;
+			axis[0] = x / m;
+			axis[1] = y / m;
+			axis[2] = z / m;
+		}
+
+		float tmin = 1e30f, tmax = -1e30f;
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = (px[i][0] - mean[0]) * axis[0] + (px[i][1] - mean[1]) * axis[1] + (px[i][2] - mean[2]) * axis[2];
+			tmin = std::min(tmin, t);
+			tmax = std::max(tmax, t);
+		}
+		//чуть сжимаем отрезок внутрь - так меньше ошибка на промежуточных цветах
+		float inset = (tmax - tmin) / 16;
+		tmin += inset;
+		tmax -= inset;
+
+		float e0[3], e1[3];
+		float len2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		for (int c = 0; c < 3; ++c)
+		{
+			e0[c] = len2 > 0 ? mean[c] + axis[c] * tmax / len2 : mean[c];
+			e1[c] = len2 > 0 ? mean[c] + axis[c] * tmin / len2 : mean[c];
+		}
+
+		unsigned short c0 = to565(e0);
+		unsigned short c1 = to565(e1);
+		if (c0 < c1)
+			std::swap(c0, c1);
+
+		unsigned int indices = 0;
+		if (c0 != c1)
+		{
+			float pal[4][3];
+			from565(c0, pal[0]);
+			from565(c1, pal[1]);
+			for (int c = 0; c < 3; ++c)
+			{
+				pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+				pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; ++i)
+			{
+				int best = 0;
+				float best_d = 1e30f;
+				for (int k = 0; k < 4; ++k)
+				{
+					float dr = px[i][0] - pal[k][0], dg = px[i][1] - pal[k][1], db = px[i][2] - pal[k][2];
+					float d = dr * dr + dg * dg + db * db;
+					if (d < best_d)
+					{
+						best_d = d;
+						best = k;
+					}
+				}
+				indices |= (unsigned int)best << (2 * i);
+			}
+		}
+
+		out[0] = (unsigned char)(c0 & 0xFF);
+		out[1] = (unsigned char)(c0 >> 8);
+		out[2] = (unsigned char)(c1 & 0xFF);
+		out[3] = (unsigned char)(c1 >> 8);
+		for (int i = 0; i < 4; ++i)
+			out[4 + i] = (unsigned char)(indices >> (8 * i));
+	}
+
+	//альфа-часть блока BC3 (8 байт), 8-уровневый режим (alpha0 > alpha1)
+	void encodeAlphaBlock(const unsigned char px[16][4], unsigned char* out)
+	{
+		int a0 = 0, a1 = 255;
+		for (int i = 0; i < 16; ++i)
+		{
+			a0 = std::max<int>(a0, px[i][3]);
+			a1 = std::min<int>(a1, px[i][3]);
+		}
+
+		unsigned long long indices = 0;
+		if (a0 != a1)
+		{
+			int pal[8];
+			pal[0] = a0;
+			pal[1] = a1;
+			for (int k = 2; k < 8; ++k)
+				pal[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+
+			for (int i = 0; i < 16; ++i)
+			{
+				int best = 0, best_d = 1 << 30;
+				for (int k = 0; k < 8; ++k)
+				{
+					int d = std::abs(px[i][3] - pal[k]);
+					if (d < best_d)
+					{
+						best_d = d;
+						best = k;
+					}
+				}
+				indices |= (unsigned long long)best << (3 * i);
+			}
+		}
+
+		out[0] = (unsigned char)a0;
+		out[1] = (unsigned char)a1;
+		for (int i = 0; i < 6; ++i)
+			out[2 + i] = (unsigned char)(indices >> (8 * i));
+	}
+
+	//строки блоков [by0, by1)
+	void compressRows(const Image& image, BlockFormat format, CompressedImage& out, int by0, int by1)
+	{
+		const int bw = (image.width + 3) / 4;
+		const int block_size = format == BlockFormat::BC1 ? 8 : 16;
+		unsigned char px[16][4];
+
+		for (int by = by0; by < by1; ++by)
+			for (int bx = 0; bx < bw; ++bx)
+			{
+				//блоки на краю картинки, не кратной 4, добиваем повтором крайних пикселей
+				for (int y = 0; y < 4; ++y)
+				{
+					int sy = std::min(by * 4 + y, image.height - 1);
+					for (int x = 0; x < 4; ++x)
+					{
+						int sx = std::min(bx * 4 + x, image.width - 1);
+						std::memcpy(px[y * 4 + x], image.pixels.data() + ((size_t)sy * image.width + sx) * 4, 4);
+					}
+				}
+
+				unsigned char* dst = out.data.data() + ((size_t)by * bw + bx) * block_size;
+				if (format == BlockFormat::BC3)
+				{
+					encodeAlphaBlock(px, dst);
+					dst += 8;
+				}
+				encodeColorBlock(px, dst);
+			}
+	}
+
+	//----------------------------- KTX ------------------------------
+
+	const unsigned char KTX_ID[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+	//пара ключ-значение KTX вместе с нулями в конце: первая строка файла - нижняя
+	const char KTX_ORIENTATION[] = "KTXorientation\0S=r,T=u";
+
+	//меняется вместе с результатом компрессора или построения уровней - старые кеши
+	//тогда не подходят
+	const unsigned int ENCODER_VERSION = 1;
+
+	struct KTXHeader
+	{
+		unsigned int endianness;
+		unsigned int glType;
+		unsigned int glTypeSize;
+		unsigned int glFormat;
+		unsigned int glInternalFormat;
+		unsigned int glBaseInternalFormat;
+		unsigned int pixelWidth;
+		unsigned int pixelHeight;
+		unsigned int pixelDepth;
+		unsigned int numberOfArrayElements;
+		unsigned int numberOfFaces;
+		unsigned int numberOfMipmapLevels;
+		unsigned int bytesOfKeyValueData;
+	};
+
+	size_t levelSize(BlockFormat format, int w, int h)
+	{
+		return (size_t)((w + 3) / 4) * ((h + 3) / 4) * (format == BlockFormat::BC1 ? 8 : 16);
+	}
+}
+
+
+unsigned int blockFormatGL(BlockFormat format)
+{
+	return format == BlockFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+bool hasAlpha(const Image& image)
+{
+	for (size_t i = 3; i < image.pixels.size(); i += 4)
+		if (image.pixels[i] != 255)
+			return true;
+	return false;
+}
+
+CompressedImage compressImage(const Image& image, BlockFormat format, unsigned threads)
+{
+	CompressedImage out;
+	out.width = image.width;
+	out.height = image.height;
+	out.data.resize(levelSize(format, image.width, image.height));
+
+	const int bh = (image.height + 3) / 4;
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	//на маленьких уровнях потоки дороже самой работы
+	threads = std::min<unsigned>(threads, std::max(1, bh * ((image.width + 3) / 4) / 1024));
+
+	if (threads <= 1)
+	{
+		compressRows(image, format, out, 0, bh);
+		return out;
+	}
+
+	std::vector<std::thread> pool;
+	int step = (bh + threads - 1) / threads;
+	for (unsigned t = 1; t < threads; ++t)
+	{
+		int y0 = t * step;
+		int y1 = std::min(bh, y0 + step);
+		if (y0 < y1)
+			pool.emplace_back(compressRows, std::cref(image), format, std::ref(out), y0, y1);
+	}
+	compressRows(image, format, out, 0, std::min(step, bh));
+	for (auto& t : pool)
+		t.join();
+
+	return out;
+}
+
+unsigned long long contentHash(const void* data, size_t size, unsigned long long seed)
+{
+	unsigned long long h = seed;
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		h ^= p[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+std::string compressedCachePath(const char* source, unsigned long long hash)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), ".%016llx.ktx", hash);
+	return std::string(source) + buf;
+}
+
+bool writeKTX(const char* path, BlockFormat format, const std::vector<CompressedImage>& levels)
+{
+	if (levels.empty())
+		return false;
+
+	std::string temporary = temporaryPath(path);
+	std::ofstream out(temporary, std::ios::binary);
+	if (!out)
+		return false;
+
+	//ключ-значение: размер, строки с нулями, выравнивание на 4 байта
+	const unsigned int orientation_size = sizeof(KTX_ORIENTATION);
+	const unsigned int orientation_padded = (orientation_size + 3) & ~3u;
+
+	KTXHeader h;
+	h.endianness = 0x04030201;
+	//у сжатых форматов glType = glFormat = 0
+	h.glType = 0;
+	h.glTypeSize = 1;
+	h.glFormat = 0;
+	h.glInternalFormat = blockFormatGL(format);
+	h.glBaseInternalFormat = format == BlockFormat::BC1 ? GL_RGB : GL_RGBA;
+	h.pixelWidth = levels[0].width;
+	h.pixelHeight = levels[0].height;
+	h.pixelDepth = 0;
+	h.numberOfArrayElements = 0;
+	h.numberOfFaces = 1;
+	h.numberOfMipmapLevels = (unsigned int)levels.size();
+	h.bytesOfKeyValueData = sizeof(orientation_size) + orientation_padded;
+
+	out.write((const char*)KTX_ID, sizeof(KTX_ID));
+	out.write((const char*)&h, sizeof(h));
+	const char padding[4] = {};
+	out.write((const char*)&orientation_size, sizeof(orientation_size));
+	out.write(KTX_ORIENTATION, orientation_size);
+	out.write(padding, orientation_padded - orientation_size);
+	for (auto& l : levels)
+	{
+		unsigned int size = (unsigned int)l.data.size();
+		out.write((const char*)&size, sizeof(size));
+		out.write((const char*)l.data.data(), size);
+		//размеры блоков кратны 8, выравнивание на 4 байта не нужно
+	}
+	out.close();
+	if (!out)
+	{
+		std::remove(temporary.c_str());
+		return false;
+	}
+	return replaceFile(temporary, path);
+}
+
+bool readKTX(const char* path, BlockFormat& format, std::vector<CompressedImage>& levels)
+{
+	std::ifstream in(path, std::ios::binary | std::ios::ate);
+	if (!in)
+		return false;
+	unsigned long long file_size = (unsigned long long)in.tellg();
+	in.seekg(0);
+
+	unsigned char id[12];
+	KTXHeader h;
+	in.read((char*)id, sizeof(id));
+	in.read((char*)&h, sizeof(h));
+	if (!in || std::memcmp(id, KTX_ID, sizeof(id)) != 0 || h.endianness != 0x04030201)
+		return false;
+
+	if (h.glInternalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+		format = BlockFormat::BC1;
+	else if (h.glInternalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+		format = BlockFormat::BC3;
+	else
+		return false;
+
+	//поля заголовка не верим: испорченный или чужой файл - просто промах кеша,
+	//а не гигантский resize или текстура, которую OpenGL не примет
+	//(без контекста - предел, который дает любая карта с BC1/BC3)
+	const unsigned int max_size = glCaps().max_texture_size > 0 ? glCaps().max_texture_size : 16384;
+	unsigned int max_levels = 1;
+	while ((std::max(h.pixelWidth, h.pixelHeight) >> max_levels) != 0)
+		++max_levels;
+	if (h.pixelWidth == 0 || h.pixelHeight == 0 || h.pixelWidth > max_size || h.pixelHeight > max_size ||
+		h.numberOfMipmapLevels > max_levels)
+		return false;
+	std::vector<CompressedImage> result(std::max(1u, h.numberOfMipmapLevels));
+	unsigned long long total = sizeof(id) + sizeof(h) + (unsigned long long)h.bytesOfKeyValueData;
+	int w = h.pixelWidth, hh = h.pixelHeight;
+	for (size_t l = 0; l < result.size(); ++l)
+	{
+		total += sizeof(unsigned int) + levelSize(format, w, hh);
+		w = std::max(1, w / 2);
+		hh = std::max(1, hh / 2);
+	}
+	if (total > file_size)
+		return false;
+
+	in.seekg(h.bytesOfKeyValueData, std::ios::cur);
+
+	w = h.pixelWidth;
+	hh = h.pixelHeight;
+	for (auto& l : result)
+	{
+		unsigned int size = 0;
+		in.read((char*)&size, sizeof(size));
+		if (!in || size != levelSize(format, w, hh))
+			return false;
+		l.width = w;
+		l.height = hh;
+		l.data.resize(size);
+		in.read((char*)l.data.data(), size);
+		w = std::max(1, w / 2);
+		hh = std::max(1, hh / 2);
+	}
+	if (!in)
+		return false;
+
+	levels = std::move(result);
+	return true;
+}
+
+bool loadCompressed(const char* path, const TextureOptions& options,
+	BlockFormat& format, std::vector<CompressedImage>& levels, bool* from_cache)
+{
+	MappedFile file(path);
+	if (!file.isOpen())
+		return false;
+
+	//ключ - содержимое файла (от него же зависит BC1 или BC3), настройки построения уровней
+	//и версия компрессора: поменялось что-то из этого - кеш пересоберется сам
+	const unsigned int settings[] = { ENCODER_VERSION, options.mipmaps ? 1u : 0u, options.gamma_correct ? 1u : 0u };
+	std::string cache = compressedCachePath(path,
+		contentHash(settings, sizeof(settings), contentHash(file.data(), file.size())));
+	if (readKTX(cache.c_str(), format, levels))
+	{
+		if (from_cache)
+			*from_cache = true;
+		return true;
+	}
+	if (from_cache)
+		*from_cache = false;
+
+	Image image;
+	if (!loadImageFromMemory(file.data(), file.size(), image))
+		return false;
+	file.close();
+
+	format = hasAlpha(image) ? BlockFormat::BC3 : BlockFormat::BC1;
+
+	std::vector<Image> mips;
+	if (options.mipmaps)
+		mips = buildMipChain(std::move(image), options.gamma_correct, options.threads);
+	else
+		mips.push_back(std::move(image));
+
+	levels.clear();
+	for (auto& m : mips)
+		levels.push_back(compressImage(m, format, options.threads));
+
+	writeKTX(cache.c_str(), format, levels);
+	return true;
+}
+
+bool supportsS3TC()
+{
+	return glCaps().s3tc;
+}
+
+void uploadCompressed(BlockFormat format, const std::vector<CompressedImage>& levels)
+{
+	//в opengl32.lib есть только OpenGL 1.1, функция из 1.3 - из таблицы GLLoader
+	if (!glCaps().compressed_textures)
+		return;
+
+	for (size_t i = 0; i < levels.size(); ++i)
+		glfn.CompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, blockFormatGL(format), levels[i].width, levels[i].height, 0,
+			(GLsizei)levels[i].data.size(), levels[i].data.data());
+}
@@ -0,0 +1,63 @@
+#ifndef TEXTURECOMPRESS_H
+#define TEXTURECOMPRESS_H
+
+#include <string>
+#include <vector>
+
+#include "Texture.h"
+
+//Сжатие текстур блоками 4x4 (S3TC / BC) и кеш сжатых текстур на диске.
+//BC1 - 8 байт на блок (0.5 байта на пиксель, без альфы),
+//BC3 - 16 байт на блок (1 байт на пиксель, с альфой),
+//против 4 байт на пиксель у GL_RGBA.
+//Видеокарта читает такие текстуры как есть, распаковывать ничего не надо.
+
+enum class BlockFormat
+{
+	BC1,
+	BC3
+};
+
+//один уровень сжатой текстуры
+struct CompressedImage
+{
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> data;
+};
+
+//GL_COMPRESSED_..._S3TC_DXT?_EXT для формата
+unsigned int blockFormatGL(BlockFormat format);
+
+//есть ли в картинке хоть один не совсем непрозрачный пиксель
+bool hasAlpha(const Image& image);
+
+//сжимает картинку, полосы блоков раздаются по потокам (0 - по числу ядер)
+CompressedImage compressImage(const Image& image, BlockFormat format, unsigned threads = 0);
+
+//64-битный FNV-1a, ключ кеша. seed - хеш предыдущей части, если ключ собирается из нескольких
+unsigned long long contentHash(const void* data, size_t size, unsigned long long seed = 14695981039346656037ull);
+
+//файл кеша лежит рядом с исходником: texture.png -> texture.png.<хеш>.ktx
+std::string compressedCachePath(const char* source, unsigned long long hash);
+
+//KTX 1.1, только сжатые форматы. Строки, как у OpenGL, снизу вверх - это записано
+//в ключе KTXorientation (S=r,T=u), другие программы покажут картинку не перевернутой.
+//Пишется через временный файл (см. replaceFile в MappedFile.h)
+bool writeKTX(const char* path, BlockFormat format, const std::vector<CompressedImage>& levels);
+bool readKTX(const char* path, BlockFormat& format, std::vector<CompressedImage>& levels);
+
+//Загружает текстуру в сжатом виде со всеми мип-уровнями.
+//Если для этого содержимого PNG уже есть кеш - просто читает его,
+//иначе распаковывает PNG, строит уровни, сжимает (BC1 или BC3, смотря по альфе)
+//и сохраняет кеш. Можно звать из любого потока.
+bool loadCompressed(const char* path, const TextureOptions& options,
+	BlockFormat& format, std::vector<CompressedImage>& levels, bool* from_cache = nullptr);
+
+//умеет ли драйвер S3TC. Нужен активный контекст OpenGL
+bool supportsS3TC();
+
+//заливает уровни в текущую привязанную текстуру
+void uploadCompressed(BlockFormat format, const std::vector<CompressedImage>& levels);
+
+#endif
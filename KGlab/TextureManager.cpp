@@ -0,0 +1,325 @@
+#include "TextureManager.h"
+
+#include "GLCallCount.h"
+#include "GLState.h"
+
+#include <cstdio>
+
+
+TextureHandle::TextureHandle(TextureManager* owner, int slot)
+	: owner(owner), slot(slot)
+{
+	owner->addRef(slot);
+}
+
+TextureHandle::TextureHandle(const TextureHandle& other)
+	: owner(other.owner), slot(other.slot)
+{
+	if (owner)
+		owner->addRef(slot);
+}
+
+TextureHandle::TextureHandle(TextureHandle&& other) noexcept
+	: owner(other.owner), slot(other.slot)
+{
+	other.owner = nullptr;
+	other.slot = -1;
+}
+
+TextureHandle& TextureHandle::operator=(const TextureHandle& other)
+{
+	if (this != &other)
+	{
+		//сначала держим новую, потом отпускаем старую:
+		//если это одна и та же текстура, она не успеет удалиться
+		if (other.owner)
+			other.owner->addRef(other.slot);
+		reset();
+		owner = other.owner;
+		slot = other.slot;
+	}
+	return *this;
+}
+
+TextureHandle& TextureHandle::operator=(TextureHandle&& other) noexcept
+{
+	if (this != &other)
+	{
+		reset();
+		owner = other.owner;
+		slot = other.slot;
+		other.owner = nullptr;
+		other.slot = -1;
+	}
+	return *this;
+}
+
+TextureHandle::~TextureHandle()
+{
+	reset();
+}
+
+void TextureHandle::bind() const
+{
+	if (owner)
+		owner->bind(slot);
+	else
+		glState.bindTexture(0);
+}
+
+void TextureHandle::reset()
+{
+	if (owner)
+		owner->release(slot);
+	owner = nullptr;
+	slot = -1;
+}
+
+
+namespace
+{
+	//одинаковый файл с разными настройками - это разные текстуры
+	std::string makeKey(const char* path, const TextureOptions& o)
+	{
+		char buf[64];
+		snprintf(buf, sizeof(buf), "|%d%d%d%d|%g|%d", o.mipmaps, o.gpu_mipmaps, o.gamma_correct,
+			o.compress, o.anisotropy, o.wrap);
+		return std::string(path) + buf;
+	}
+}
+
+TextureManager::TextureManager(AssetLoader& loader)
+	: loader(loader)
+{
+}
+
+TextureManager::~TextureManager()
+{
+	for (int i = 0; i < (int)entries.size(); ++i)
+		if (entries[i].state != State::Free && entries[i].tex_id)
+			glState.deleteTextures(1, &entries[i].tex_id);
+}
+
+void TextureManager::clear()
+{
+	for (Entry& e : entries)
+	{
+		if (e.state != State::Free && e.tex_id)
+			glState.deleteTextures(1, &e.tex_id);
+		e.tex_id = 0;
+		//ручки еще держат слоты, но грузить в них больше нечего
+		if (e.state != State::Free)
+			e.state = State::Failed;
+	}
+	by_id.clear();
+	used_bytes = 0;
+}
+
+TextureHandle TextureManager::load(const char* path, const TextureOptions& options)
+{
+	std::string key = makeKey(path, options);
+	auto it = by_key.find(key);
+	if (it != by_key.end())
+		return TextureHandle(this, it->second);
+
+	int slot;
+	if (!free_slots.empty())
+	{
+		slot = free_slots.back();
+		free_slots.pop_back();
+	}
+	else
+	{
+		slot = (int)entries.size();
+		entries.emplace_back();
+	}
+
+	Entry& e = entries[slot];
+	e = Entry();
+	e.key = key;
+	e.path = path;
+	e.options = options;
+	by_key[key] = slot;
+	request(slot);
+
+	return TextureHandle(this, slot);
+}
+
+void TextureManager::request(int slot)
+{
+	Entry& e = entries[slot];
+	e.tex_id = loader.requestTexture(e.path.c_str(), e.options);
+	e.state = State::Loading;
+	e.bytes = 0;
+	//у заглушки все уровни и трилинейная фильтрация
+	e.mipmapped = true;
+	by_id[e.tex_id] = slot;
+}
+
+void TextureManager::addRef(int slot)
+{
+	++entries[slot].refs;
+}
+
+void TextureManager::release(int slot)
+{
+	Entry& e = entries[slot];
+	if (--e.refs > 0)
+		return;
+
+	//картинка еще грузится - текстуру удалим, когда loader ее зальет,
+	//иначе он привяжет уже удаленный id и создаст его заново
+	if (e.state == State::Loading)
+		return;
+	destroy(slot);
+}
+
+void TextureManager::destroy(int slot)
+{
+	Entry& e = entries[slot];
+	if (e.tex_id)
+	{
+		glState.deleteTextures(1, &e.tex_id);
+		by_id.erase(e.tex_id);
+	}
+	if (e.state == State::Resident)
+		used_bytes -= e.bytes;
+
+	by_key.erase(e.key);
+	e = Entry();
+	free_slots.push_back(slot);
+}
+
+void TextureManager::evict(int slot)
+{
+	Entry& e = entries[slot];
+	glState.deleteTextures(1, &e.tex_id);
+	by_id.erase(e.tex_id);
+	used_bytes -= e.bytes;
+
+	char buf[512];
+	snprintf(buf, sizeof(buf), "TextureManager: evicted %s (%zu KB), %zu KB in use\n",
+		e.path.c_str(), e.bytes / 1024, used_bytes / 1024);
+	platformDebugOutput(buf);
+
+	e.tex_id = 0;
+	e.bytes = 0;
+	e.state = State::Evicted;
+}
+
+void TextureManager::bind(int slot)
+{
+	Entry& e = entries[slot];
+	e.last_used = frame;
+
+	if (e.state == State::Evicted)
+	{
+		char buf[512];
+		snprintf(buf, sizeof(buf), "TextureManager: reloading %s\n", e.path.c_str());
+		platformDebugOutput(buf);
+		request(slot);
+	}
+
+	glState.bindTexture(e.tex_id);
+
+	bool want = mipmapping && e.options.mipmaps;
+	if (e.mipmapped != want)
+	{
+		setTextureFiltering(want, e.options.anisotropy);
+		e.mipmapped = want;
+	}
+}
+
+int TextureManager::poll(int max_uploads)
+{
+	++frame;
+
+	uploads.clear();
+	int uploaded = loader.poll(max_uploads, &uploads);
+
+	for (const auto& u : uploads)
+	{
+		auto it = by_id.find(u.tex_id);
+		if (it == by_id.end())
+			continue;
+		int slot = it->second;
+		Entry& e = entries[slot];
+
+		if (u.ok)
+		{
+			e.state = State::Resident;
+			e.bytes = u.bytes;
+			used_bytes += u.bytes;
+			e.mipmapped = e.options.mipmaps;
+			//только что залитую не выгружаем, пока ее ни разу не нарисовали
+			e.last_used = frame;
+		}
+		else
+		{
+			e.state = State::Failed;
+		}
+
+		//пока грузилась, все ручки отпустили
+		if (e.refs == 0)
+			destroy(slot);
+	}
+
+	enforceBudget();
+	return uploaded;
+}
+
+void TextureManager::setBudget(size_t bytes)
+{
+	budget_bytes = bytes;
+	over_budget_logged = false;
+}
+
+void TextureManager::enforceBudget()
+{
+	while (budget_bytes && used_bytes > budget_bytes)
+	{
+		//самая давно не привязанная из загруженных.
+		//То, что рисовали в прошлом кадре, не трогаем: иначе
+		//при слишком маленьком бюджете текстуры грузились бы каждый кадр заново
+		int victim = -1;
+		for (int i = 0; i < (int)entries.size(); ++i)
+		{
+			const Entry& e = entries[i];
+			if (e.state != State::Resident || e.last_used + 1 >= frame)
+				continue;
+			if (victim < 0 || e.last_used < entries[victim].last_used)
+				victim = i;
+		}
+
+		if (victim < 0)
+		{
+			if (!over_budget_logged)
+			{
+				char buf[256];
+				snprintf(buf, sizeof(buf), "TextureManager: %zu KB in use, budget %zu KB, nothing to evict\n",
+					used_bytes / 1024, budget_bytes / 1024);
+				platformDebugOutput(buf);
+				over_budget_logged = true;
+			}
+			return;
+		}
+		evict(victim);
+	}
+	over_budget_logged = false;
+}
+
+int TextureManager::residentCount() const
+{
+	int n = 0;
+	for (const auto& e : entries)
+		n += e.state == State::Resident;
+	return n;
+}
+
+int TextureManager::evictedCount() const
+{
+	int n = 0;
+	for (const auto& e : entries)
+		n += e.state == State::Evicted;
+	return n;
+}
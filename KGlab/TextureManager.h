@@ -0,0 +1,153 @@
+#ifndef TEXTUREMANAGER_H
+#define TEXTUREMANAGER_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AssetLoader.h"
+#include "Texture.h"
+
+class TextureManager;
+
+//Ссылка на текстуру из TextureManager.
+//Копии считаются: когда пропадает последняя, текстура удаляется из видеопамяти.
+//Сам id OpenGL может поменяться (после выгрузки текстура грузится заново),
+//поэтому хранить надо ручку, а не id.
+class TextureHandle
+{
+public:
+
+	TextureHandle() = default;
+	TextureHandle(const TextureHandle& other);
+	TextureHandle(TextureHandle&& other) noexcept;
+	TextureHandle& operator=(const TextureHandle& other);
+	TextureHandle& operator=(TextureHandle&& other) noexcept;
+	~TextureHandle();
+
+	bool valid() const
+	{
+		return owner != nullptr;
+	}
+
+	//glBindTexture. Выгруженная текстура запрашивается заново,
+	//пока она грузится - привязывается заглушка
+	void bind() const;
+
+	//отпустить текстуру раньше, чем умрет ручка
+	void reset();
+
+private:
+
+	friend class TextureManager;
+	TextureHandle(TextureManager* owner, int slot);
+
+	TextureManager* owner = nullptr;
+	int slot = -1;
+};
+
+//Все текстуры из файлов.
+//Один и тот же файл с одинаковыми настройками грузится один раз,
+//сколько бы раз его ни просили. Менеджер знает, сколько видеопамяти
+//занимает каждая текстура, и если вместе они не влезают в бюджет -
+//выгружает те, которые дольше всех не привязывались (LRU).
+//Выгруженная текстура сама грузится заново при следующем bind().
+//
+//Работает только из потока рендера.
+class TextureManager
+{
+public:
+
+	TextureManager(AssetLoader& loader);
+	~TextureManager();
+
+	//нужен активный контекст OpenGL.
+	//Текстура появляется сразу (заглушкой), картинка догружается в фоне
+	TextureHandle load(const char* path, const TextureOptions& options = TextureOptions());
+
+	//вызывать раз в кадр до рисования: заливает догруженные картинки
+	//и выгружает лишнее, если бюджет превышен. Возвращает, сколько текстур заменено
+	int poll(int max_uploads = 1);
+
+	//бюджет видеопамяти в байтах, 0 - без ограничения
+	void setBudget(size_t bytes);
+	size_t budget() const
+	{
+		return budget_bytes;
+	}
+	//сколько занято сейчас
+	size_t used() const
+	{
+		return used_bytes;
+	}
+
+	//трилинейная фильтрация для всех текстур, у которых есть мип-уровни.
+	//Применяется лениво, при bind()
+	void setMipmapping(bool on)
+	{
+		mipmapping = on;
+	}
+
+	//удаляет из видеопамяти все текстуры сразу, даже если на них еще есть ручки
+	//(они дальше привязывают 0). Вызывать до разрушения контекста: глобальные
+	//ручки и сам менеджер умирают позже, когда звать OpenGL уже нельзя
+	void clear();
+
+	//сколько текстур загружено и сколько выгружено
+	int residentCount() const;
+	int evictedCount() const;
+
+private:
+
+	friend class TextureHandle;
+
+	enum class State
+	{
+		Free,
+		//в текстуре заглушка, картинка грузится
+		Loading,
+		Resident,
+		//удалена из видеопамяти, загрузится при bind()
+		Evicted,
+		//картинку не прочитали, осталась заглушка
+		Failed
+	};
+
+	struct Entry
+	{
+		std::string key;
+		std::string path;
+		TextureOptions options;
+		State state = State::Free;
+		unsigned int tex_id = 0;
+		int refs = 0;
+		size_t bytes = 0;
+		//номер кадра последнего bind()
+		unsigned long long last_used = 0;
+		//какая фильтрация сейчас стоит у текстуры
+		bool mipmapped = true;
+	};
+
+	AssetLoader& loader;
+	std::vector<Entry> entries;
+	std::vector<int> free_slots;
+	std::unordered_map<std::string, int> by_key;
+	std::unordered_map<unsigned int, int> by_id;
+	std::vector<AssetLoader::Upload> uploads;
+
+	size_t budget_bytes = 0;
+	size_t used_bytes = 0;
+	unsigned long long frame = 0;
+	bool mipmapping = true;
+	bool over_budget_logged = false;
+
+	void addRef(int slot);
+	void release(int slot);
+	void bind(int slot);
+	void request(int slot);
+	void destroy(int slot);
+	void evict(int slot);
+	void enforceBudget();
+};
+
+#endif
@@ -1,150 +1,176 @@
-#ifndef UNICODE
-	#define UNICODE		//чтобы все winapi-функции принимали строки wchar_t*, а не char* - это
-#endif					//юникод - двухбайтовая кодировка - нет проблем с русским.
-
-
-#include <windows.h>
-
+#include "Platform.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Headless.h"
+#include "InputJournal.h"
 #include "MyOGL.h"
+#include "SelfTest.h"
 
-LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+//--record: журнал ввода (см. InputJournal.h)
+InputRecorder recorder;
 
-//ф-ция main под Windows
-int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow)
+//--smoke-test [кадров]: окно, контекст, SwapBuffers и ввод на настоящей ОС.
+//Ждем кадры, шлем себе ввод через очередь окна (platformSendTestInput) - он же закрывает окно,
+//и проверяем, что дошло каждое сообщение. Код возврата 0 - все работает
+struct SmokeTest
 {
-    // Register the window class.
-    const wchar_t CLASS_NAME[] = L"Window Class";
-	
-    WNDCLASS wc = { };
-
-    wc.lpfnWndProc = WindowProc;
-    wc.hInstance = hInstance;
-    wc.lpszClassName = CLASS_NAME;
-    wc.style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC;
-	wc.hCursor = LoadCursor(NULL, IDC_ARROW);
-
-    RegisterClass(&wc);
-
-    // Create the window.
-
-    HWND hwnd = CreateWindowEx(
-        0,                              // Optional window styles.
-        CLASS_NAME,                     // Window class
-        L"Лабораторка по КГ",    // Window text
-        WS_OVERLAPPEDWINDOW,            // Window style
-
-        // Size and position
-		CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT,
-
-        NULL,       // Parent window    
-        NULL,       // Menu
-        hInstance,  // Instance handle
-        NULL        // Additional application data
-    );
-
-    if (hwnd == NULL)
-    {
-        return 0;
-    }
-
-    ShowWindow(hwnd, nCmdShow);
-
-    // Run the message loop.
-
-    MSG msg = { };
-    while (GetMessage(&msg, NULL, 0, 0) > 0)
-    {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
-    }
-
-    return 0;
-}
-bool trackMouse = false;
-LRESULT CALLBACK WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+	bool on = false;
+	int frames = 30;
+	//бит на каждый Message::Type, который дошел до on_message
+	std::atomic<unsigned> seen{ 0 };
+	std::thread input;
+};
+SmokeTest smoke;
+
+extern OpenGL gl;
+
+//все сообщения окна уходят в очередь потока сообщений (MyOGL.cpp)
+void on_message(const Message& m)
 {
-    Message m = {uMsg,wParam,lParam };
-    
-    switch (uMsg)
-    {
-		case WM_CREATE:
-		{
-			setHwnd(hWnd);
-			start_msg_thread();
-			start_gl_thread();
-
-			return 0;
-		}
+	smoke.seen |= 1u << m.type;
+	recorder.record(m);
+
+	//пока проигрывается журнал, мышь и клавиатура - из него
+	bool live = m.type == Message::Resize || m.type == Message::Close || !inputReplayRunning();
+	if (live)
+		add_message(m);
+
+	//окно разрушается сразу после возврата - рендер к этому моменту должен стоять
+	if (m.type == Message::Close)
+	{
+		stopInputReplay();
+		stop_all_threads();
+		recorder.close();
+	}
+}
 
-		case WM_MOUSELEAVE:
+//итог --smoke-test в stdout: platformDebugOutput в Release молчит
+int smokeTestResult()
+{
+	static const char* const NAMES[] = { "MouseMove", "MouseLeave", "MouseDown", "MouseUp", "Wheel",
+		"KeyDown", "KeyUp", "Resize", "Close" };
+	const Message::Type need[] = { Message::MouseMove, Message::MouseDown, Message::MouseUp, Message::Wheel,
+		Message::KeyDown, Message::KeyUp, Message::Resize, Message::Close };
+
+	bool ok = true;
+	int frames = gl.stats.stats().count;
+	if (frames < smoke.frames)
+	{
+		printf("smoke test: %d of %d frames presented\n", frames, smoke.frames);
+		ok = false;
+	}
+	for (Message::Type type : need)
+		if (!(smoke.seen & (1u << type)))
 		{
-			trackMouse = false;
-			add_message(m);
-			return 0;
+			printf("smoke test: no %s message\n", NAMES[type]);
+			ok = false;
 		}
+	printf("smoke test: %s\n", ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
 
-		case WM_LBUTTONDOWN:
-		case WM_RBUTTONDOWN:
-		case WM_MBUTTONDOWN:
-		{
-			SetCapture(hWnd);
-			add_message(m);
-			return 0;
-		}
-		case WM_LBUTTONUP:
-		case WM_RBUTTONUP:
-		case WM_MBUTTONUP:
+int run(const std::vector<std::string>& args)
+{
+	if (isSelfTest(args))
+		return runSelfTest();
+
+	if (isHeadless(args))
+	{
+		HeadlessOptions options;
+		std::string error;
+		if (!parseHeadlessOptions(args, options, error))
 		{
-			ReleaseCapture();
-			add_message(m);
-			return 0;
+			fprintf(stderr, "%s\n", error.c_str());
+			return 2;
 		}
-
-		case WM_KEYDOWN:
-		case WM_KEYUP:
-		case WM_MOUSEWHEEL:
-			add_message(m);
-			return 0;
-		case WM_MOUSEMOVE:
+		return runHeadless(options);
+	}
+
+	std::string record_path, replay_path;
+	double replay_speed = 1;
+	for (size_t i = 0; i < args.size(); ++i)
+	{
+		if (i + 1 < args.size() && args[i] == "--record")
+			record_path = args[++i];
+		else if (i + 1 < args.size() && args[i] == "--replay")
+			replay_path = args[++i];
+		else if (i + 1 < args.size() && args[i] == "--replay-speed" && atof(args[i + 1].c_str()) > 0)
+			replay_speed = atof(args[++i].c_str());
+		else if (args[i] == "--smoke-test")
 		{
-			if (!trackMouse)
-			{
-				TRACKMOUSEEVENT tme_arg;
-				tme_arg.cbSize = sizeof(TRACKMOUSEEVENT);
-				tme_arg.dwFlags = TME_LEAVE;
-				tme_arg.dwHoverTime = HOVER_DEFAULT;
-				tme_arg.hwndTrack = hWnd;
-				trackMouse = TrackMouseEvent(&tme_arg);
-			}
-			add_message(m);
-			return 0;
+			smoke.on = true;
+			//в истории FrameStats не больше HISTORY - 1 кадров
+			if (i + 1 < args.size() && atoi(args[i + 1].c_str()) > 0)
+				smoke.frames = std::min(atoi(args[++i].c_str()), FrameStats::HISTORY - 1);
 		}
-		case WM_SIZE:
-			add_message(m);
-			return 0;
-
-		case WM_CLOSE:
-			add_message(m);
-			stop_all_threads();
-			DestroyWindow(hWnd);
-			return 0;
-		case WM_DESTROY:
-			PostQuitMessage(0);
-			return 0;
-
-		case WM_PAINT:
+		else
 		{
-			PAINTSTRUCT ps;
-			HDC hdc = BeginPaint(hWnd, &ps);
-
-			// All painting occurs here, between BeginPaint and EndPaint.
-
-			//FillRect(hdc, &ps.rcPaint, (HBRUSH)(COLOR_WINDOW + 1));
-
-			EndPaint(hWnd, &ps);
+			fprintf(stderr, "bad argument %s\n", args[i].c_str());
+			return 2;
 		}
-		return 0;
+	}
+
+	//первые сообщения (размер окна) приходят еще из platformCreateWindow
+	if (!record_path.empty() && !recorder.open(record_path.c_str()))
+	{
+		fprintf(stderr, "can't write %s\n", record_path.c_str());
+		return 1;
+	}
+
+	if (!platformCreateWindow(L"Лабораторка по КГ", on_message))
+		return 1;
+
+	start_msg_thread();
+	start_gl_thread();
+
+	std::string error;
+	if (!replay_path.empty() && !startInputReplay(replay_path.c_str(), replay_speed, error))
+		platformDebugOutput((error + "\n").c_str());
+
+	if (smoke.on)
+		smoke.input = std::thread([] {
+			//контекст могли и не создать - тогда кадров не будет, закрываемся по таймауту
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+			while (gl.stats.stats().count < smoke.frames && std::chrono::steady_clock::now() < deadline)
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			platformSendTestInput();
+		});
+
+	platformRunMessageLoop();
+
+	if (smoke.on)
+	{
+		smoke.input.join();
+		return smokeTestResult();
+	}
+	return 0;
+}
 
-    }
-    return DefWindowProc(hWnd, uMsg, wParam, lParam);
-}
\ No newline at end of file
+#ifdef _WIN32
+//ф-ция main под Windows
+int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow)
+{
+	//аргументы в кодировке системы - так их понимает fopen
+	std::vector<std::string> args;
+	for (int i = 1; i < __argc; ++i)
+	{
+		char buf[1024];
+		WideCharToMultiByte(CP_ACP, 0, __wargv[i], -1, buf, sizeof(buf), nullptr, nullptr);
+		args.push_back(buf);
+	}
+	return run(args);
+}
+#else
+int main(int argc, char** argv)
+{
+	return run(std::vector<std::string>(argv + 1, argv + argc));
+}
+#endif
@@ -526,6 +526,11 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
 
 // ZLIB client - used by PNG, available for other purposes
 
+// KGlab: with STBI_FAST_INFLATE defined for the implementation, zlib streams go through
+// FastInflate.cpp; pass 0 to get stb's own inflater back (comparisons, benchmarks).
+// Returns 0 if the fast inflater is not compiled in. Not thread-safe, like the setters above
+STBIDEF int stbi_set_fast_inflate(int flag_true_if_fast);
+
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
 STBIDEF char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, int len, int initial_size, int *outlen, int parse_header);
 STBIDEF char *stbi_zlib_decode_malloc(const char *buffer, int len, int *outlen);
@@ -4507,8 +4512,49 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
    return 1;
 }
 
+#ifdef STBI_FAST_INFLATE
+// KGlab: table-driven inflater from FastInflate.cpp (C++ only), byte-exact with the one above
+#include "FastInflate.h"
+
+static int stbi__fast_inflate = 1;
+
+static void *stbi__fast_inflate_realloc(void *p, size_t old_size, size_t new_size)
+{
+   STBI_NOTUSED(old_size);
+   return STBI_REALLOC_SIZED(p, old_size, new_size);
+}
+#endif
+
+STBIDEF int stbi_set_fast_inflate(int flag_true_if_fast)
+{
+#ifdef STBI_FAST_INFLATE
+   stbi__fast_inflate = flag_true_if_fast;
+   return 1;
+#else
+   STBI_NOTUSED(flag_true_if_fast);
+   return 0;
+#endif
+}
+
 static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse_header)
 {
+#ifdef STBI_FAST_INFLATE
+   if (stbi__fast_inflate) {
+      InflateOutput out;
+      int ok;
+      out.data = (unsigned char *) obuf;
+      out.capacity = (size_t) olen;
+      ok = fastInflate(a->zbuffer, (size_t) (a->zbuffer_end - a->zbuffer), parse_header != 0, out,
+                       exp ? stbi__fast_inflate_realloc : NULL);
+      // callers free zout_start on failure, so it must follow any realloc
+      a->zout_start = (char *) out.data;
+      a->zout       = a->zout_start + out.size;
+      a->zout_end   = a->zout_start + out.capacity;
+      a->z_expandable = exp;
+      if (!ok) return stbi__err("bad zlib stream", "Corrupt PNG");
+      return 1;
+   }
+#endif
    a->zout_start = obuf;
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
@@ -0,0 +1,166 @@
+# Набор PNG для KGlab --self-test (проверка PngDecode/FastInflate против stb).
+# Запуск из KGlab/: python3 testdata/make_png_corpus.py
+# Нужен только стандартный Python: все типы цвета, глубины 8 и 16, палитра, tRNS,
+# interlace, каждый фильтр отдельно и вперемешку, уровни и стратегии zlib, IDAT разного размера.
+import os
+import random
+import struct
+import zlib
+
+OUT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "png")
+
+
+def chunk(kind, data):
+    body = kind + data
+    return struct.pack(">I", len(data)) + body + struct.pack(">I", zlib.crc32(body) & 0xFFFFFFFF)
+
+
+def paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def apply_filter(f, row, prev, bpp):
+    out = bytearray(len(row))
+    for i in range(len(row)):
+        a = row[i - bpp] if i >= bpp else 0
+        b = prev[i]
+        c = prev[i - bpp] if i >= bpp else 0
+        pred = [0, a, b, (a + b) >> 1, paeth(a, b, c)][f]
+        out[i] = (row[i] - pred) & 255
+    return out
+
+
+def pixels(w, h, channels, depth, seed, kind):
+    rnd = random.Random(seed)
+    top = (1 << depth) - 1
+    rows = []
+    for y in range(h):
+        row = []
+        for x in range(w):
+            for c in range(channels):
+                if kind == "noise":
+                    v = rnd.randint(0, top)
+                elif kind == "flat":
+                    v = top * ((x // 7 + y // 5 + c) % 3) // 2
+                else:
+                    v = (x * (c + 1) * 5 + y * 3 + rnd.randint(0, 6)) * top // 255
+                    v = max(0, min(top, v))
+                row.append(v)
+        rows.append(row)
+    return rows
+
+
+def to_bytes(row, depth):
+    if depth == 16:
+        return b"".join(struct.pack(">H", v) for v in row)
+    if depth == 8:
+        return bytes(row)
+    # 1, 2, 4 бита - упаковка старшими битами вперед
+    per = 8 // depth
+    out = bytearray()
+    for i in range(0, len(row), per):
+        b = 0
+        part = row[i:i + per]
+        for j, v in enumerate(part):
+            b |= v << (8 - depth * (j + 1))
+        out.append(b)
+    return bytes(out)
+
+
+def scanlines(rows, w, channels, depth, filters):
+    bpp = max(1, channels * depth // 8)
+    raw = bytearray()
+    prev = bytes(len(to_bytes(rows[0], depth)))
+    for y, row in enumerate(rows):
+        data = to_bytes(row, depth)
+        f = filters[y % len(filters)]
+        raw.append(f)
+        raw += apply_filter(f, data, prev, bpp)
+        prev = data
+    return bytes(raw)
+
+
+def write_png(name, w, h, color, depth, rows, filters=(0,), level=6, strategy=zlib.Z_DEFAULT_STRATEGY,
+              idat_size=1 << 30, extra=b"", interlace=False):
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color]
+    if interlace:
+        raw = bytearray()
+        passes = [(0, 0, 8, 8), (4, 0, 8, 8), (0, 4, 4, 8), (2, 0, 4, 4), (0, 2, 2, 4), (1, 0, 2, 2), (0, 1, 1, 2)]
+        for x0, y0, dx, dy in passes:
+            sub = []
+            for y in range(y0, h, dy):
+                sub.append([v for x in range(x0, w, dx) for v in rows[y][x * channels:(x + 1) * channels]])
+            if sub and sub[0]:
+                raw += scanlines(sub, len(sub[0]) // channels, channels, depth, filters)
+        raw = bytes(raw)
+    else:
+        raw = scanlines(rows, w, channels, depth, filters)
+    z = zlib.compressobj(level, zlib.DEFLATED, 15, 9, strategy)
+    data = z.compress(raw) + z.flush()
+    png = b"\x89PNG\r\n\x1a\n" + chunk(b"IHDR", struct.pack(">IIBBBBB", w, h, depth, color, 0, 0, 1 if interlace else 0))
+    png += extra
+    for i in range(0, len(data), idat_size):
+        png += chunk(b"IDAT", data[i:i + idat_size])
+    png += chunk(b"IEND", b"")
+    with open(os.path.join(OUT, name), "wb") as f:
+        f.write(png)
+
+
+def main():
+    os.makedirs(OUT, exist_ok=True)
+    n = 0
+    # все фильтры по отдельности и вперемешку, у всех 8-битных типов цвета
+    for color, channels in ((0, 1), (2, 3), (4, 2), (6, 4)):
+        for filters in ((0,), (1,), (2,), (3,), (4,), (0, 1, 2, 3, 4)):
+            for kind in ("noise", "smooth"):
+                w, h = 1 + (n * 7) % 61, 1 + (n * 5) % 43
+                rows = pixels(w, h, channels, 8, n, kind)
+                write_png("f%d_c%d_%s_%03d.png" % (filters[0] if len(filters) == 1 else 9, color, kind, n),
+                          w, h, color, 8, rows, filters)
+                n += 1
+    # уровни и стратегии zlib (сохраненные, фиксированные и динамические блоки, длинные повторы)
+    strategies = {"default": zlib.Z_DEFAULT_STRATEGY, "filtered": zlib.Z_FILTERED,
+                  "huffman": zlib.Z_HUFFMAN_ONLY, "rle": zlib.Z_RLE, "fixed": zlib.Z_FIXED}
+    for level in (0, 1, 6, 9):
+        for sname, strategy in strategies.items():
+            for kind in ("smooth", "flat"):
+                rows = pixels(97, 33, 4, 8, n, kind)
+                write_png("z%d_%s_%s_%03d.png" % (level, sname, kind, n), 97, 33, 6, 8, rows,
+                          (0, 1, 2, 3, 4), level, strategy)
+                n += 1
+    # много маленьких IDAT и картинка больше окна 32 КБ
+    rows = pixels(300, 200, 3, 8, n, "smooth")
+    write_png("idat_split_%03d.png" % n, 300, 200, 2, 8, rows, (4, 1, 2), 6, idat_size=57)
+    n += 1
+    rows = pixels(256, 256, 4, 8, n, "flat")
+    write_png("large_flat_%03d.png" % n, 256, 256, 6, 8, rows, (2,), 9)
+    n += 1
+    # то, что PngDecode отдает stb: палитра, 16 бит, мелкие глубины, tRNS, interlace
+    rows = [[(x + y) % 16 for x in range(40)] for y in range(30)]
+    plte = chunk(b"PLTE", bytes(v for i in range(16) for v in (i * 16, 255 - i * 16, i * 8)))
+    write_png("pal_%03d.png" % n, 40, 30, 3, 4, rows, (0, 1), extra=plte)
+    n += 1
+    rows = pixels(33, 17, 4, 16, n, "smooth")
+    write_png("rgba16_%03d.png" % n, 33, 17, 6, 16, rows, (4,))
+    n += 1
+    rows = [[(x * y) % 4 for x in range(50)] for y in range(9)]
+    write_png("gray2_%03d.png" % n, 50, 9, 0, 2, rows, (1,))
+    n += 1
+    rows = pixels(31, 29, 3, 8, n, "flat")
+    write_png("trns_%03d.png" % n, 31, 29, 2, 8, rows, (0,), extra=chunk(b"tRNS", struct.pack(">HHH", 0, 0, 0)))
+    n += 1
+    rows = pixels(37, 23, 4, 8, n, "smooth")
+    write_png("interlaced_%03d.png" % n, 37, 23, 6, 8, rows, (4, 0), interlace=True)
+    n += 1
+    # PLTE у RGB - подсказка для экрана с палитрой, stb его не смотрит
+    rows = pixels(20, 20, 3, 8, n, "noise")
+    write_png("rgb_plte_%03d.png" % n, 20, 20, 2, 8, rows, (3,), extra=plte)
+    n += 1
+
+
+if __name__ == "__main__":
+    main()